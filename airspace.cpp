@@ -0,0 +1,497 @@
+#include "airspace.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QtMath>
+#include <QDebug>
+#include <algorithm>
+
+#define M_PER_DEGREE 111195.0
+#define M_PER_NM 1852.0
+#define M_PER_FT 0.3048
+
+// A depth-first query holds the unvisited siblings of every level above it
+#define QUERY_STACK_SIZE (1 + (AIRSPACE_MAX_LEVELS - 1) * (AIRSPACE_NODE_SIZE - 1))
+
+namespace
+{
+
+// "52:25:30 N 013:10:15 E", "52:25.5N 13:10.25E" and the like
+bool parseCoordinate(const QByteArray &text, QPointF &point)
+{
+    double fields[3] = {0, 0, 0};
+    int field = 0;
+    int found = 0;
+    double latitude = 0;
+    QByteArray number;
+
+    for (int i = 0; i <= text.size() && found < 2; i++)
+    {
+        const char c = i < text.size() ? text.at(i) : ' ';
+        if((c >= '0' && c <= '9') || c == '.')
+        {
+            number += c;
+            continue;
+        }
+        if(!number.isEmpty())
+        {
+            if(field < 3)
+                fields[field] = number.toDouble();
+            number.clear();
+        }
+        if(c == ':')
+        {
+            field++;
+            continue;
+        }
+
+        const char hemisphere = c & ~0x20;
+        if(hemisphere == 'N' || hemisphere == 'S' || hemisphere == 'E' || hemisphere == 'W')
+        {
+            double value = fields[0] + fields[1] / 60 + fields[2] / 3600;
+            if(hemisphere == 'S' || hemisphere == 'W')
+                value = -value;
+            if(found == 0)
+                latitude = value;
+            else
+                point = QPointF(value, latitude);
+            found++;
+            fields[0] = fields[1] = fields[2] = 0;
+            field = 0;
+        }
+        else if(c == '*')
+            break;
+    }
+    return found == 2;
+}
+
+// "FL95", "3500ft MSL", "2000 ft AGL", "1000m", "GND", "SFC", "UNL"
+void parseHeight(const QByteArray &text, double &meters, bool &agl)
+{
+    QByteArray value = text.trimmed().toUpper();
+    agl = value.contains("AGL") || value.contains("AGH") || value.contains("GND") || value.contains("SFC");
+    meters = 0;
+
+    if(value.startsWith("UNL"))
+    {
+        meters = AIRSPACE_UNLIMITED;
+        agl = false;
+        return;
+    }
+
+    bool flightLevel = value.startsWith("FL");
+    int i = flightLevel ? 2 : 0;
+    while (i < value.size() && value.at(i) == ' ')
+        i++;
+    int start = i;
+    while (i < value.size() && ((value.at(i) >= '0' && value.at(i) <= '9') || value.at(i) == '.'))
+        i++;
+    if(i == start)
+        return;
+
+    const double number = value.mid(start, i - start).toDouble();
+    if(flightLevel)
+    {
+        meters = number * 100 * M_PER_FT;
+        agl = false;
+        return;
+    }
+
+    value.replace("MSL", "");
+    const int unit = value.indexOf('M', start);
+    meters = unit >= 0 && !value.contains("FT") ? number : number * M_PER_FT;
+}
+
+double bearing(const QPointF &center, const QPointF &point)
+{
+    const double cosLatitude = qCos(qDegreesToRadians(center.y()));
+    return qRadiansToDegrees(qAtan2((point.x() - center.x()) * cosLatitude, point.y() - center.y()));
+}
+
+double distance(const QPointF &center, const QPointF &point)
+{
+    const double cosLatitude = qCos(qDegreesToRadians(center.y()));
+    const double dx = (point.x() - center.x()) * cosLatitude;
+    const double dy = point.y() - center.y();
+    return qSqrt(dx * dx + dy * dy) * M_PER_DEGREE;
+}
+
+void appendArc(QVector<QPointF> &points, const QPointF &center, double radius,
+               double start, double end, bool clockwise)
+{
+    if(clockwise)
+        while (end <= start)
+            end += 360;
+    else
+        while (end >= start)
+            end -= 360;
+
+    const double cosLatitude = qCos(qDegreesToRadians(center.y()));
+    const int steps = qMax(1, static_cast<int>(qCeil(qAbs(end - start) / AIRSPACE_ARC_STEP)));
+    for (int i = 0; i <= steps; i++)
+    {
+        const double angle = qDegreesToRadians(start + (end - start) * i / steps);
+        points.append(QPointF(center.x() + radius * qSin(angle) / (M_PER_DEGREE * cosLatitude),
+                              center.y() + radius * qCos(angle) / M_PER_DEGREE));
+    }
+}
+
+}
+
+AirspaceIndex::AirspaceIndex()
+{
+}
+
+bool AirspaceIndex::load(const QString &fileName, const QString &cacheFileName)
+{
+    QFileInfo info(fileName);
+    if(!info.exists())
+        return false;
+
+    const qint64 size = info.size();
+    const qint64 time = info.lastModified().toMSecsSinceEpoch();
+    if(readCache(cacheFileName, size, time))
+        return true;
+
+    if(!parse(fileName))
+        return false;
+    if(!writeCache(cacheFileName, size, time))
+        qDebug() << "Airspace cache not written" << cacheFileName;
+    return true;
+}
+
+bool AirspaceIndex::parse(const QString &fileName)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    m_airspaces.clear();
+    m_points.clear();
+
+    Airspace current = Airspace();
+    current.first = -1;
+    QPointF center;
+    bool clockwise = true;
+
+    auto finish = [this, &current]() {
+        if(current.first < 0)
+            return;
+        current.count = m_points.size() - current.first;
+        if(current.count < 3)
+        {
+            m_points.resize(current.first);
+            current.first = -1;
+            return;
+        }
+
+        current.minLatitude = current.maxLatitude = m_points.at(current.first).y();
+        current.minLongitude = current.maxLongitude = m_points.at(current.first).x();
+        for (int i = current.first + 1; i < m_points.size(); i++)
+        {
+            const QPointF &point = m_points.at(i);
+            current.minLatitude = qMin(current.minLatitude, point.y());
+            current.maxLatitude = qMax(current.maxLatitude, point.y());
+            current.minLongitude = qMin(current.minLongitude, point.x());
+            current.maxLongitude = qMax(current.maxLongitude, point.x());
+        }
+        m_airspaces.append(current);
+        current.first = -1;
+    };
+
+    while (!file.atEnd())
+    {
+        const QByteArray line = file.readLine().trimmed();
+        if(line.size() < 2 || line.at(0) == '*')
+            continue;
+
+        const QByteArray command = line.left(2).toUpper();
+        const QByteArray argument = line.mid(2).trimmed();
+
+        if(command == "AC")
+        {
+            finish();
+            current = Airspace();
+            current.type = QString::fromLatin1(argument);
+            current.ceiling = AIRSPACE_UNLIMITED;
+            current.first = m_points.size();
+            clockwise = true;
+        }
+        else if(current.first < 0)
+            continue;
+        else if(command == "AN")
+            current.name = QString::fromLatin1(argument);
+        else if(command == "AL")
+            parseHeight(argument, current.floor, current.floorAgl);
+        else if(command == "AH")
+            parseHeight(argument, current.ceiling, current.ceilingAgl);
+        else if(command == "V ")
+        {
+            const QByteArray variable = argument.left(2).toUpper();
+            if(variable == "X=")
+                parseCoordinate(argument.mid(2), center);
+            else if(variable == "D=")
+                clockwise = !argument.mid(2).trimmed().startsWith('-');
+        }
+        else if(command == "DP")
+        {
+            QPointF point;
+            if(parseCoordinate(argument, point))
+                m_points.append(point);
+        }
+        else if(command == "DC")
+        {
+            const double radius = argument.toDouble() * M_PER_NM;
+            // Full circle without repeating the first point
+            appendArc(m_points, center, radius, 0, 360 - AIRSPACE_ARC_STEP, true);
+        }
+        else if(command == "DA")
+        {
+            const QList<QByteArray> values = argument.split(',');
+            if(values.size() == 3)
+                appendArc(m_points, center, values.at(0).trimmed().toDouble() * M_PER_NM,
+                          values.at(1).trimmed().toDouble(), values.at(2).trimmed().toDouble(), clockwise);
+        }
+        else if(command == "DB")
+        {
+            const int comma = argument.indexOf(',');
+            QPointF from, to;
+            if(comma > 0 && parseCoordinate(argument.left(comma), from) && parseCoordinate(argument.mid(comma + 1), to))
+                appendArc(m_points, center, distance(center, from),
+                          bearing(center, from), bearing(center, to), clockwise);
+        }
+    }
+    finish();
+
+    buildTree();
+    return !m_airspaces.isEmpty();
+}
+
+void AirspaceIndex::buildTree()
+{
+    QVector<Node> level(m_airspaces.size());
+    for (int i = 0; i < m_airspaces.size(); i++)
+    {
+        const Airspace &airspace = m_airspaces.at(i);
+        level[i] = {airspace.minLatitude, airspace.minLongitude, airspace.maxLatitude, airspace.maxLongitude, i, 0};
+    }
+
+    m_nodes.clear();
+    while (!level.isEmpty())
+    {
+        // Sort-tile-recursive: vertical slices by longitude, each sorted by
+        // latitude, so every run of AIRSPACE_NODE_SIZE entries is compact.
+        const int pages = (level.size() + AIRSPACE_NODE_SIZE - 1) / AIRSPACE_NODE_SIZE;
+        const int slice = static_cast<int>(qCeil(qSqrt(pages))) * AIRSPACE_NODE_SIZE;
+        std::sort(level.begin(), level.end(), [](const Node &a, const Node &b) {
+            return a.minLongitude + a.maxLongitude < b.minLongitude + b.maxLongitude;
+        });
+        for (int i = 0; i < level.size(); i += slice)
+            std::sort(level.begin() + i, level.begin() + qMin(i + slice, level.size()), [](const Node &a, const Node &b) {
+                return a.minLatitude + a.maxLatitude < b.minLatitude + b.maxLatitude;
+            });
+
+        const int offset = m_nodes.size();
+        m_nodes += level;
+        if(level.size() == 1)
+            break;
+
+        QVector<Node> parents;
+        parents.reserve(pages);
+        for (int i = 0; i < level.size(); i += AIRSPACE_NODE_SIZE)
+        {
+            Node parent = level.at(i);
+            parent.first = offset + i;
+            parent.count = qMin(AIRSPACE_NODE_SIZE, level.size() - i);
+            for (int j = i + 1; j < i + parent.count; j++)
+            {
+                const Node &child = level.at(j);
+                parent.minLatitude = qMin(parent.minLatitude, child.minLatitude);
+                parent.minLongitude = qMin(parent.minLongitude, child.minLongitude);
+                parent.maxLatitude = qMax(parent.maxLatitude, child.maxLatitude);
+                parent.maxLongitude = qMax(parent.maxLongitude, child.maxLongitude);
+            }
+            parents.append(parent);
+        }
+        level = parents;
+    }
+    Q_ASSERT(treeHeight() <= AIRSPACE_MAX_LEVELS);
+}
+
+// Levels from the root down to the airspace entries; the packed tree is
+// balanced, so the first child of every node leads there
+int AirspaceIndex::treeHeight() const
+{
+    int height = 0;
+    int node = m_nodes.size() - 1;
+    while (node >= 0 && node < m_nodes.size() && height <= m_nodes.size())
+    {
+        height++;
+        node = m_nodes.at(node).count > 0 ? m_nodes.at(node).first : -1;
+    }
+    return height;
+}
+
+int AirspaceIndex::query(double latitude, double longitude, double altitude, double groundElevation,
+                         double maxDistance, QVector<AirspaceHit> &hits) const
+{
+    hits.resize(0);
+    if(m_nodes.isEmpty())
+        return 0;
+
+    const double marginLatitude = maxDistance / M_PER_DEGREE;
+    const double marginLongitude = marginLatitude / qMax(0.01, qCos(qDegreesToRadians(latitude)));
+    const double minLatitude = latitude - marginLatitude, maxLatitude = latitude + marginLatitude;
+    const double minLongitude = longitude - marginLongitude, maxLongitude = longitude + marginLongitude;
+
+    // buildTree() and readCache() keep the height within AIRSPACE_MAX_LEVELS
+    int stack[QUERY_STACK_SIZE];
+    int depth = 0;
+    stack[depth++] = m_nodes.size() - 1;
+
+    while (depth > 0)
+    {
+        const Node &node = m_nodes.at(stack[--depth]);
+        if(node.maxLatitude < minLatitude || node.minLatitude > maxLatitude
+                || node.maxLongitude < minLongitude || node.minLongitude > maxLongitude)
+            continue;
+
+        if(node.count == 0)
+        {
+            const AirspaceHit hit = test(node.first, latitude, longitude, altitude, groundElevation);
+            if(hit.inside || hit.distance <= maxDistance)
+                hits.append(hit);
+            continue;
+        }
+
+        Q_ASSERT(depth + node.count <= QUERY_STACK_SIZE);
+        for (int i = node.first; i < node.first + node.count; i++)
+            stack[depth++] = i;
+    }
+    return hits.size();
+}
+
+AirspaceHit AirspaceIndex::test(int index, double latitude, double longitude, double altitude,
+                                double groundElevation) const
+{
+    const Airspace &airspace = m_airspaces.at(index);
+    const double scaleX = qCos(qDegreesToRadians(latitude)) * M_PER_DEGREE;
+    const QPointF *points = m_points.constData() + airspace.first;
+
+    // Crossing number and closest edge in a local metric frame around the fix
+    bool inside = false;
+    double best = 1e300;
+    double previousX = (points[airspace.count - 1].x() - longitude) * scaleX;
+    double previousY = (points[airspace.count - 1].y() - latitude) * M_PER_DEGREE;
+    for (int i = 0; i < airspace.count; i++)
+    {
+        const double x = (points[i].x() - longitude) * scaleX;
+        const double y = (points[i].y() - latitude) * M_PER_DEGREE;
+
+        if((y > 0) != (previousY > 0) && 0 < previousX + (x - previousX) * (0 - previousY) / (y - previousY))
+            inside = !inside;
+
+        const double ex = x - previousX;
+        const double ey = y - previousY;
+        const double length = ex * ex + ey * ey;
+        double t = length > 0 ? -(previousX * ex + previousY * ey) / length : 0;
+        t = qBound(0.0, t, 1.0);
+        const double dx = previousX + t * ex;
+        const double dy = previousY + t * ey;
+        best = qMin(best, dx * dx + dy * dy);
+
+        previousX = x;
+        previousY = y;
+    }
+
+    const double floor = airspace.floor + (airspace.floorAgl ? groundElevation : 0);
+    const double ceiling = airspace.ceiling + (airspace.ceilingAgl ? groundElevation : 0);
+    double clearance;
+    if(altitude < floor)
+        clearance = floor - altitude;
+    else if(altitude > ceiling)
+        clearance = altitude - ceiling;
+    else
+        clearance = -qMin(altitude - floor, ceiling - altitude);
+
+    return {index, inside, qSqrt(best), clearance};
+}
+
+bool AirspaceIndex::readCache(const QString &cacheFileName, qint64 sourceSize, qint64 sourceTime)
+{
+    QFile file(cacheFileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    qint32 version, airspaces, nodes;
+    qint64 size, time;
+    in >> version >> size >> time;
+    if(version != AIRSPACE_CACHE_VERSION || size != sourceSize || time != sourceTime)
+        return false;
+
+    in >> airspaces;
+    if(airspaces < 0)
+        return false;
+    m_airspaces.resize(airspaces);
+    for (Airspace &airspace : m_airspaces)
+    {
+        qint32 first, count;
+        in >> airspace.name >> airspace.type >> airspace.floor >> airspace.ceiling
+           >> airspace.floorAgl >> airspace.ceilingAgl >> first >> count
+           >> airspace.minLatitude >> airspace.minLongitude >> airspace.maxLatitude >> airspace.maxLongitude;
+        airspace.first = first;
+        airspace.count = count;
+    }
+
+    in >> m_points >> nodes;
+    if(nodes < 0)
+        return false;
+    m_nodes.resize(nodes);
+    for (Node &node : m_nodes)
+    {
+        qint32 first, count;
+        in >> node.minLatitude >> node.minLongitude >> node.maxLatitude >> node.maxLongitude >> first >> count;
+        if(count < 0 || count > AIRSPACE_NODE_SIZE)
+            in.setStatus(QDataStream::ReadCorruptData);
+        node.first = first;
+        node.count = count;
+    }
+
+    if(in.status() != QDataStream::Ok || treeHeight() > AIRSPACE_MAX_LEVELS)
+    {
+        m_airspaces.clear();
+        m_points.clear();
+        m_nodes.clear();
+        return false;
+    }
+    return true;
+}
+
+bool AirspaceIndex::writeCache(const QString &cacheFileName, qint64 sourceSize, qint64 sourceTime) const
+{
+    QSaveFile file(cacheFileName);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out << qint32(AIRSPACE_CACHE_VERSION) << sourceSize << sourceTime;
+
+    out << qint32(m_airspaces.size());
+    for (const Airspace &airspace : m_airspaces)
+    {
+        out << airspace.name << airspace.type << airspace.floor << airspace.ceiling
+            << airspace.floorAgl << airspace.ceilingAgl << qint32(airspace.first) << qint32(airspace.count)
+            << airspace.minLatitude << airspace.minLongitude << airspace.maxLatitude << airspace.maxLongitude;
+    }
+
+    out << m_points << qint32(m_nodes.size());
+    for (const Node &node : m_nodes)
+    {
+        out << node.minLatitude << node.minLongitude << node.maxLatitude << node.maxLongitude
+            << qint32(node.first) << qint32(node.count);
+    }
+    return file.commit();
+}
@@ -0,0 +1,82 @@
+#ifndef AIRSPACE_H
+#define AIRSPACE_H
+
+#include <QString>
+#include <QVector>
+#include <QPointF>
+
+#define AIRSPACE_ARC_STEP 5.0           // deg between tessellated arc points
+#define AIRSPACE_NODE_SIZE 16           // R-tree fan-out
+#define AIRSPACE_MAX_LEVELS 8           // R-tree height, 16^7 airspaces
+#define AIRSPACE_CACHE_VERSION 1
+#define AIRSPACE_UNLIMITED 1e6          // m, ceiling of UNL
+
+struct Airspace
+{
+    QString name;
+    QString type;           // AC: R, Q, P, A, B, C, D, E, F, G, CTR, TMZ, ...
+    double floor;           // m, above ground if floorAgl
+    double ceiling;         // m, above ground if ceilingAgl
+    bool floorAgl;
+    bool ceilingAgl;
+    int first;              // range in the shared point array
+    int count;
+    double minLatitude, minLongitude, maxLatitude, maxLongitude;
+};
+
+struct AirspaceHit
+{
+    int index;
+    bool inside;            // horizontally inside the polygon
+    double distance;        // m to the boundary
+    double clearance;       // m above or below the vertical band, <= 0 inside it
+};
+
+/*
+ * OpenAir airspaces as tessellated polygons. Arcs and circles are turned into
+ * points every AIRSPACE_ARC_STEP degrees when the file is parsed, and the
+ * bounding boxes are bulk loaded into a packed sort-tile-recursive R-tree,
+ * so a proximity query only tests the few polygons whose box is within the
+ * search radius. Parsed polygons and the tree are cached in a binary file
+ * next to the source and reused while the source is unchanged.
+ */
+class AirspaceIndex
+{
+public:
+    AirspaceIndex();
+
+    // Reads the cache if it matches fileName, otherwise parses and writes it
+    bool load(const QString &fileName, const QString &cacheFileName);
+    bool parse(const QString &fileName);
+
+    int size() const { return m_airspaces.size(); }
+    const Airspace &at(int index) const { return m_airspaces.at(index); }
+
+    // Airspaces within maxDistance m of the position, reusing the caller's
+    // vector so a query per fix does not allocate. groundElevation resolves
+    // AGL limits. Returns the number of hits.
+    int query(double latitude, double longitude, double altitude, double groundElevation,
+              double maxDistance, QVector<AirspaceHit> &hits) const;
+
+private:
+    struct Node
+    {
+        double minLatitude, minLongitude, maxLatitude, maxLongitude;
+        int first;          // child node, or airspace index for a leaf entry
+        int count;          // 0 for a leaf entry
+    };
+
+    void buildTree();
+    int treeHeight() const;
+    bool readCache(const QString &cacheFileName, qint64 sourceSize, qint64 sourceTime);
+    bool writeCache(const QString &cacheFileName, qint64 sourceSize, qint64 sourceTime) const;
+    AirspaceHit test(int index, double latitude, double longitude, double altitude,
+                     double groundElevation) const;
+
+private:
+    QVector<Airspace> m_airspaces;
+    QVector<QPointF> m_points;      // x longitude, y latitude
+    QVector<Node> m_nodes;          // root last
+};
+
+#endif // AIRSPACE_H
@@ -0,0 +1,76 @@
+#include "altitudefusion.h"
+#include <cmath>
+
+namespace {
+
+constexpr double kInitialVariance = 1.e6;
+constexpr double kDefaultAccuracy = 20;      // metres, if the fix has none
+constexpr double kConvergedVariance = 25;    // 5 m standard deviation
+
+}  // namespace
+
+AltitudeFusion::AltitudeFusion()
+  :var_drift_(0.01),
+   gate_sigmas_(5)
+{
+  Reset();
+}
+
+AltitudeFusion::AltitudeFusion(const double var_drift)
+  :var_drift_(var_drift),
+   gate_sigmas_(5)
+{
+  Reset();
+}
+
+void AltitudeFusion::Reset()
+{
+  offset_ = 0;
+  var_offset_ = kInitialVariance;
+}
+
+bool AltitudeFusion::IsConverged() const
+{
+  return var_offset_ < kConvergedVariance;
+}
+
+bool AltitudeFusion::Update(const double gps_altitude, const double baro_altitude,
+                            const double vertical_accuracy, const double dt)
+{
+  if (std::isnan(gps_altitude) || std::isnan(baro_altitude))
+    return false;
+
+  // Predict step: the offset stays put, its uncertainty grows.
+  if (dt > 0)
+    var_offset_ += var_drift_ * dt;
+
+  const double accuracy = vertical_accuracy > 0 ? vertical_accuracy : kDefaultAccuracy;
+  const double var_z = accuracy * accuracy;
+
+  // Update step.
+  const double y = gps_altitude - baro_altitude - offset_;  // Innovation.
+  const double s = var_offset_ + var_z;
+  if (IsConverged() && y * y > gate_sigmas_ * gate_sigmas_ * s)
+    return false;
+
+  const double k = var_offset_ / s;
+  offset_ += k * y;
+  var_offset_ -= k * var_offset_;
+  return true;
+}
+
+double AltitudeFusion::GetQnh(const double pressure, const double baro_altitude) const
+{
+  const double altitude = baro_altitude + offset_;
+  return pressure / std::pow(1.0 - altitude / 44330.0, 1.0 / 0.19);
+}
+
+double PressureToAltitude(const double pressure, const double sea_level_pressure)
+{
+  return 44330.0 * (1.0 - std::pow(pressure / sea_level_pressure, 0.19));
+}
+
+double AltitudeToPressure(const double altitude, const double sea_level_pressure)
+{
+  return sea_level_pressure * std::pow(1.0 - altitude / 44330.0, 1.0 / 0.19);
+}
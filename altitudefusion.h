@@ -0,0 +1,51 @@
+#ifndef ALTITUDEFUSION_H
+#define ALTITUDEFUSION_H
+
+// Estimates the offset between barometric altitude computed against the
+// standard atmosphere and GPS altitude, i.e. the effect of the actual QNH.
+// The offset is a random walk whose variance grows with weather drift; each
+// GPS fix is a measurement of it weighted by the fix's vertical accuracy.
+// The first good fixes pull the offset in almost immediately, after which
+// it follows pressure changes slowly without picking up GPS noise, and the
+// vario, which only depends on the baro filter, is never disturbed.
+class AltitudeFusion {
+  double offset_;       // GPS altitude minus baro altitude, in metres.
+  double var_offset_;   // Variance of offset_.
+
+  // Variance added to the offset per second, in square metres. Weather moves
+  // the QNH by about 1 hPa per hour, i.e. a few metres per hour.
+  double var_drift_;
+
+  // Fixes whose innovation exceeds this many standard deviations are GPS
+  // glitches and are ignored once the filter has converged.
+  double gate_sigmas_;
+
+ public:
+  AltitudeFusion();
+  explicit AltitudeFusion(double var_drift);
+
+  void Reset();
+
+  /**
+   * Feeds one GPS fix. vertical_accuracy is the 1-sigma GPS altitude error in
+   * metres, or <= 0 if unknown; dt is the time since the previous fix in
+   * seconds. Returns false if the fix was rejected as an outlier.
+   */
+  bool Update(double gps_altitude, double baro_altitude, double vertical_accuracy, double dt);
+
+  double GetOffset() const { return offset_; }
+  double GetOffsetVariance() const { return var_offset_; }
+  bool IsConverged() const;
+
+  // Sea level pressure, in the unit of pressure, for which the standard
+  // atmosphere gives the fused altitude at the given pressure.
+  double GetQnh(double pressure, double baro_altitude) const;
+};
+
+// Standard atmosphere altitude for a pressure relative to sea level pressure.
+double PressureToAltitude(double pressure, double sea_level_pressure);
+
+// Inverse of PressureToAltitude.
+double AltitudeToPressure(double altitude, double sea_level_pressure);
+
+#endif // ALTITUDEFUSION_H
@@ -0,0 +1,129 @@
+#include "circlingdetector.h"
+#include <QtMath>
+
+CirclingDetector::CirclingDetector()
+{
+    reset();
+}
+
+void CirclingDetector::reset()
+{
+    m_lastTime = -1;
+    m_lastHeading = 0;
+    m_lastAltitude = 0;
+    m_turnRate = 0;
+    m_turningFor = 0;
+    m_direction = 0;
+    m_circling = false;
+    m_entryTime = 0;
+    m_entryAltitude = 0;
+    m_thermal = Thermal();
+}
+
+bool CirclingDetector::update(qint64 timeMs, double heading, double latitude, double longitude,
+                              double altitude, double vario)
+{
+    if(m_lastTime < 0 || timeMs <= m_lastTime)
+    {
+        m_lastTime = timeMs;
+        m_lastHeading = heading;
+        m_lastAltitude = altitude;
+        return false;
+    }
+
+    const double dt = (timeMs - m_lastTime) / 1000.;
+    const qint64 previousTime = m_lastTime;
+    const double previousAltitude = m_lastAltitude;
+    m_lastTime = timeMs;
+    m_lastAltitude = altitude;
+
+    // Heading change unwrapped to (-180, 180]
+    double change = heading - m_lastHeading;
+    m_lastHeading = heading;
+    while (change > 180)
+        change -= 360;
+    while (change <= -180)
+        change += 360;
+
+    const double alpha = qMin(1.0, dt / CIRCLING_RATE_SMOOTHING_S);
+    m_turnRate += alpha * (change / dt - m_turnRate);
+
+    const int direction = m_turnRate > 0 ? 1 : -1;
+    const bool turning = qAbs(m_turnRate) >= CIRCLING_MIN_TURN_RATE;
+
+    bool left = false;
+    if(!m_circling)
+    {
+        if(turning && (direction == m_direction || m_turningFor == 0))
+            m_turningFor += dt;
+        else
+            m_turningFor = turning ? dt : 0;
+        m_direction = direction;
+
+        // Turning began at the previous fix: if it lasts, the thermal starts there
+        if(turning && m_turningFor == dt)
+        {
+            m_entryTime = previousTime;
+            m_entryAltitude = previousAltitude;
+            m_minAltitude = previousAltitude;
+            m_maxAltitude = previousAltitude;
+        }
+        if(m_turningFor > 0)
+        {
+            m_minAltitude = qMin(m_minAltitude, altitude);
+            m_maxAltitude = qMax(m_maxAltitude, altitude);
+        }
+
+        if(m_turningFor >= CIRCLING_ENTER_S)
+            enter();
+    }
+    else
+    {
+        m_turningFor = turning ? 0 : m_turningFor + dt;
+        if(m_turningFor >= CIRCLING_EXIT_S)
+            left = leave(timeMs);
+    }
+
+    if(m_circling)
+    {
+        // Weight by climb so the core sits where the lift is strongest
+        const double weight = qMax(vario, 0.0) + 0.1;
+        m_sumWeight += weight;
+        m_sumLatitude += weight * latitude;
+        m_sumLongitude += weight * longitude;
+        m_minAltitude = qMin(m_minAltitude, altitude);
+        m_maxAltitude = qMax(m_maxAltitude, altitude);
+    }
+    return left;
+}
+
+// Entry time, altitude and range were recorded when the turning began
+void CirclingDetector::enter()
+{
+    m_circling = true;
+    m_turningFor = 0;
+    m_sumWeight = 0;
+    m_sumLatitude = 0;
+    m_sumLongitude = 0;
+}
+
+bool CirclingDetector::leave(qint64 timeMs)
+{
+    m_circling = false;
+    m_turningFor = 0;
+
+    // The straight stretch that confirmed the exit is not part of the thermal
+    const qint64 exitTime = timeMs - static_cast<qint64>(CIRCLING_EXIT_S * 1000);
+    const double duration = (exitTime - m_entryTime) / 1000.;
+    if(duration < THERMAL_MIN_DURATION_S || m_sumWeight <= 0)
+        return false;
+
+    m_thermal.latitude = m_sumLatitude / m_sumWeight;
+    m_thermal.longitude = m_sumLongitude / m_sumWeight;
+    m_thermal.base = m_minAltitude;
+    m_thermal.top = m_maxAltitude;
+    m_thermal.climb = (m_maxAltitude - m_entryAltitude) / duration;
+    m_thermal.time = m_entryTime;
+    m_thermal.duration = static_cast<int>(duration);
+    return m_thermal.top > m_thermal.base;
+}
@@ -0,0 +1,71 @@
+#ifndef CIRCLINGDETECTOR_H
+#define CIRCLINGDETECTOR_H
+
+#include <QtGlobal>
+
+#define CIRCLING_MIN_TURN_RATE 4.0      // deg/s
+#define CIRCLING_ENTER_S 15.0           // sustained turning before circling
+#define CIRCLING_EXIT_S 10.0            // sustained straight flight before leaving
+#define CIRCLING_RATE_SMOOTHING_S 4.0   // time constant of the turn rate filter
+#define THERMAL_MIN_DURATION_S 30.0
+
+struct Thermal
+{
+    double latitude;        // core: climb-weighted centre of the circles
+    double longitude;
+    double base;            // m
+    double top;             // m
+    double climb;           // average m/s over the whole thermal
+    qint64 time;            // ms since epoch at entry, 0 if unknown
+    int duration;           // s
+};
+
+/*
+ * Online circling detector. The heading sequence gives a smoothed turn rate;
+ * circling starts after CIRCLING_ENTER_S of turning faster than
+ * CIRCLING_MIN_TURN_RATE in one direction and ends after CIRCLING_EXIT_S
+ * below it. While circling, the vario weights the core position so the
+ * centre follows the strongest lift. O(1) per fix.
+ */
+class CirclingDetector
+{
+public:
+    CirclingDetector();
+
+    void reset();
+
+    // Returns true when a thermal has just been left; see thermal().
+    bool update(qint64 timeMs, double heading, double latitude, double longitude,
+                double altitude, double vario);
+
+    bool isCircling() const { return m_circling; }
+    double turnRate() const { return m_turnRate; }
+    qint64 circlingSince() const { return m_entryTime; }
+    double entryAltitude() const { return m_entryAltitude; }
+    const Thermal &thermal() const { return m_thermal; }
+
+private:
+    void enter();
+    bool leave(qint64 timeMs);
+
+private:
+    qint64 m_lastTime;
+    double m_lastHeading;
+    double m_lastAltitude;
+    double m_turnRate;
+    double m_turningFor;    // s turning (circling: straight) against the current state
+    int m_direction;
+    bool m_circling;
+
+    qint64 m_entryTime;     // first fix of the turning that led to circling
+    double m_entryAltitude;
+    double m_sumWeight;
+    double m_sumLatitude;
+    double m_sumLongitude;
+    double m_minAltitude;
+    double m_maxAltitude;
+
+    Thermal m_thermal;
+};
+
+#endif // CIRCLINGDETECTOR_H
@@ -0,0 +1,156 @@
+#include "climbstats.h"
+
+ClimbWindow::ClimbWindow(double seconds)
+    : m_length(static_cast<qint64>(seconds * 1000))
+    , m_bucketLength(qMax<qint64>(1, (m_length + CLIMB_WINDOW_CAPACITY - 2) / (CLIMB_WINDOW_CAPACITY - 1)))
+{
+    reset();
+}
+
+void ClimbWindow::reset()
+{
+    m_head = m_tail = 0;
+    m_sum = m_sumTime = 0;
+    m_bucket = 0;
+    m_pendingEnd = 0;
+    m_pendingSum = m_pendingTime = 0;
+    m_pendingMin = m_pendingMax = 0;
+    m_minHead = m_minTail = 0;
+    m_maxHead = m_maxTail = 0;
+}
+
+void ClimbWindow::dropOldest()
+{
+    const Sample &oldest = m_samples[m_head % CLIMB_WINDOW_CAPACITY];
+    m_sum -= oldest.value * oldest.dt;
+    m_sumTime -= oldest.dt;
+    if(m_minHead != m_minTail && m_min[m_minHead % CLIMB_WINDOW_CAPACITY] == m_head)
+        m_minHead++;
+    if(m_maxHead != m_maxTail && m_max[m_maxHead % CLIMB_WINDOW_CAPACITY] == m_head)
+        m_maxHead++;
+    m_head++;
+
+    // Running sums drift with many add/subtract pairs; an empty window resets them
+    if(m_head == m_tail)
+        m_sum = m_sumTime = 0;
+}
+
+void ClimbWindow::add(qint64 timeMs, double value, double dt)
+{
+    // A sample in a new bucket closes the one being filled
+    const qint64 bucket = timeMs / m_bucketLength;
+    if(m_pendingTime == 0 || bucket != m_bucket)
+    {
+        if(m_pendingTime > 0)
+            push(m_pendingEnd, m_pendingSum / m_pendingTime, m_pendingTime, m_pendingMin, m_pendingMax);
+        m_bucket = bucket;
+        m_pendingSum = m_pendingTime = 0;
+        m_pendingMin = m_pendingMax = value;
+    }
+    m_pendingMin = qMin(m_pendingMin, value);
+    m_pendingMax = qMax(m_pendingMax, value);
+    m_pendingSum += value * dt;
+    m_pendingTime += dt;
+    m_pendingEnd = timeMs;
+
+    while (m_head != m_tail && m_samples[m_head % CLIMB_WINDOW_CAPACITY].time <= timeMs - m_length)
+        dropOldest();
+}
+
+// The buckets of a whole window fit; the capacity check only guards against
+// timestamps that jump backwards
+void ClimbWindow::push(qint64 timeMs, double value, double dt, double minimum, double maximum)
+{
+    if(m_tail - m_head == CLIMB_WINDOW_CAPACITY)
+        dropOldest();
+
+    m_samples[m_tail % CLIMB_WINDOW_CAPACITY] = {timeMs, value, dt, minimum, maximum};
+    m_sum += value * dt;
+    m_sumTime += dt;
+
+    // Samples that can no longer be the minimum (maximum) leave from the back
+    while (m_minHead != m_minTail && m_samples[m_min[(m_minTail - 1) % CLIMB_WINDOW_CAPACITY] % CLIMB_WINDOW_CAPACITY].minimum >= minimum)
+        m_minTail--;
+    m_min[m_minTail++ % CLIMB_WINDOW_CAPACITY] = m_tail;
+    while (m_maxHead != m_maxTail && m_samples[m_max[(m_maxTail - 1) % CLIMB_WINDOW_CAPACITY] % CLIMB_WINDOW_CAPACITY].maximum <= maximum)
+        m_maxTail--;
+    m_max[m_maxTail++ % CLIMB_WINDOW_CAPACITY] = m_tail;
+    m_tail++;
+}
+
+double ClimbWindow::average() const
+{
+    const double time = m_sumTime + m_pendingTime;
+    return time > 0 ? (m_sum + m_pendingSum) / time : 0;
+}
+
+double ClimbWindow::minimum() const
+{
+    const double pending = m_pendingTime > 0 ? m_pendingMin : 0;
+    if(m_minHead == m_minTail)
+        return pending;
+    const double value = m_samples[m_min[m_minHead % CLIMB_WINDOW_CAPACITY] % CLIMB_WINDOW_CAPACITY].minimum;
+    return m_pendingTime > 0 ? qMin(value, pending) : value;
+}
+
+double ClimbWindow::maximum() const
+{
+    const double pending = m_pendingTime > 0 ? m_pendingMax : 0;
+    if(m_maxHead == m_maxTail)
+        return pending;
+    const double value = m_samples[m_max[m_maxHead % CLIMB_WINDOW_CAPACITY] % CLIMB_WINDOW_CAPACITY].maximum;
+    return m_pendingTime > 0 ? qMax(value, pending) : value;
+}
+
+ClimbStats::ClimbStats()
+    : m_second(1)
+    , m_short(10)
+    , m_long(30)
+{
+    reset();
+}
+
+void ClimbStats::reset()
+{
+    m_second.reset();
+    m_short.reset();
+    m_long.reset();
+    m_inThermal = false;
+    m_thermalTime = 0;
+    m_thermalAltitude = 0;
+    m_thermalClimbed = 0;
+    m_lastTime = 0;
+    m_lastAltitude = 0;
+}
+
+void ClimbStats::update(qint64 timeMs, double vario, double altitude, double dt, bool circling)
+{
+    if(dt > 0)
+    {
+        m_second.add(timeMs, vario, dt);
+        m_short.add(timeMs, vario, dt);
+        m_long.add(timeMs, vario, dt);
+    }
+
+    if(circling && !m_inThermal)
+    {
+        m_inThermal = true;
+        m_thermalTime = timeMs;
+        m_thermalAltitude = altitude;
+        m_thermalClimbed = 0;
+    }
+    else if(circling && altitude > m_lastAltitude)
+        m_thermalClimbed += altitude - m_lastAltitude;
+    else if(!circling)
+        m_inThermal = false;
+
+    m_lastTime = timeMs;
+    m_lastAltitude = altitude;
+}
+
+double ClimbStats::thermalAverage() const
+{
+    if(!m_inThermal || m_lastTime <= m_thermalTime)
+        return 0;
+    return (m_lastAltitude - m_thermalAltitude) * 1000 / (m_lastTime - m_thermalTime);
+}
@@ -0,0 +1,103 @@
+#ifndef CLIMBSTATS_H
+#define CLIMBSTATS_H
+
+#include <QtGlobal>
+
+#define CLIMB_WINDOW_CAPACITY 2048      // buckets per window
+
+/*
+ * Time-weighted average, minimum and maximum of the samples in the last
+ * seconds. Samples are averaged into buckets of a fixed share of the window,
+ * 15 ms for 30 s, so the window covers its whole length at any sensor rate;
+ * the bucket being filled counts as well. Each bucket also keeps the lowest
+ * and highest sample in it, so a spike shorter than a bucket still shows.
+ * The closed buckets live in a ring buffer with a running sum; minimum and
+ * maximum are kept in monotonic deques of bucket sequence numbers, so add()
+ * is amortized O(1) and the memory is fixed.
+ */
+class ClimbWindow
+{
+public:
+    explicit ClimbWindow(double seconds);
+
+    void reset();
+    void add(qint64 timeMs, double value, double dt);
+
+    bool isEmpty() const { return m_head == m_tail && m_pendingTime == 0; }
+    double average() const;
+    double minimum() const;
+    double maximum() const;
+
+private:
+    void push(qint64 timeMs, double value, double dt, double minimum, double maximum);
+    void dropOldest();
+
+private:
+    struct Sample
+    {
+        qint64 time;
+        double value;       // mean
+        double dt;
+        double minimum;
+        double maximum;
+    };
+
+    qint64 m_length;            // ms
+    qint64 m_bucketLength;      // ms
+    qint64 m_bucket;            // index of the bucket being filled
+    qint64 m_pendingEnd;        // ms, its newest sample
+    double m_pendingSum;
+    double m_pendingTime;
+    double m_pendingMin;
+    double m_pendingMax;
+    Sample m_samples[CLIMB_WINDOW_CAPACITY];
+    quint64 m_head;             // sequence number of the oldest sample
+    quint64 m_tail;             // sequence number of the next sample
+    double m_sum;
+    double m_sumTime;
+
+    quint64 m_min[CLIMB_WINDOW_CAPACITY];
+    quint64 m_minHead, m_minTail;
+    quint64 m_max[CLIMB_WINDOW_CAPACITY];
+    quint64 m_maxHead, m_maxTail;
+};
+
+/*
+ * Climb statistics fed with every filtered vario sample: 1 s (one IGC fix),
+ * 10 s and 30 s averages, the strongest climb and sink of the last 30 s, and
+ * for the current thermal the average climb, the net gain and the total of
+ * all climbing in it.
+ */
+class ClimbStats
+{
+public:
+    ClimbStats();
+
+    void reset();
+    void update(qint64 timeMs, double vario, double altitude, double dt, bool circling);
+
+    double current() const { return m_second.average(); }
+    double average10() const { return m_short.average(); }
+    double average30() const { return m_long.average(); }
+    double maxClimb() const { return m_long.maximum(); }
+    double maxSink() const { return m_long.minimum(); }
+
+    bool inThermal() const { return m_inThermal; }
+    double thermalAverage() const;
+    double thermalGain() const { return m_inThermal ? m_lastAltitude - m_thermalAltitude : 0; }
+    double thermalTotalGain() const { return m_inThermal ? m_thermalClimbed : 0; }
+
+private:
+    ClimbWindow m_second;
+    ClimbWindow m_short;
+    ClimbWindow m_long;
+
+    bool m_inThermal;
+    qint64 m_thermalTime;
+    double m_thermalAltitude;
+    double m_thermalClimbed;
+    qint64 m_lastTime;
+    double m_lastAltitude;
+};
+
+#endif // CLIMBSTATS_H
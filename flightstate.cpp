@@ -0,0 +1,33 @@
+#include "flightstate.h"
+
+FlightStatePublisher::FlightStatePublisher()
+    : m_sequence(0)
+    , m_state()
+{
+}
+
+FlightState &FlightStatePublisher::beginWrite()
+{
+    m_sequence.store(m_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return m_state;
+}
+
+void FlightStatePublisher::endWrite()
+{
+    m_sequence.store(m_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+FlightState FlightStatePublisher::read() const
+{
+    FlightState state;
+    quint32 before, after;
+    do
+    {
+        before = m_sequence.load(std::memory_order_acquire);
+        state = m_state;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = m_sequence.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    return state;
+}
@@ -0,0 +1,52 @@
+#ifndef FLIGHTSTATE_H
+#define FLIGHTSTATE_H
+
+#include <QtGlobal>
+#include <atomic>
+
+struct FlightState
+{
+    // Pressure sensor, or GPS when there is none
+    qint64 varioTime;       // ms since epoch
+    double vario;           // m/s
+    double altitude;        // m
+    quint32 varioUpdates;
+
+    qint64 gpsTime;         // ms since epoch
+    double latitude;
+    double longitude;
+    double gpsAltitude;     // m
+    double speed;           // km/h
+    double heading;         // deg
+    quint32 gpsUpdates;
+
+    int satellitesInUse;
+    int satellitesInView;
+};
+
+/*
+ * Publishes the FlightState from the producers (sensor, GPS) to the UI tick
+ * through a sequence lock. The writer makes the sequence odd, changes the
+ * fields and makes it even again; a reader copies the state and retries if
+ * the sequence was odd or changed meanwhile, so it never sees an altitude
+ * from one sample with the vario of another and never blocks the writer.
+ * Writers must not run concurrently with each other.
+ */
+class FlightStatePublisher
+{
+public:
+    FlightStatePublisher();
+
+    // Between beginWrite() and endWrite() the returned state can be changed
+    FlightState &beginWrite();
+    void endWrite();
+
+    FlightState read() const;
+    quint32 sequence() const { return m_sequence.load(std::memory_order_acquire); }
+
+private:
+    std::atomic<quint32> m_sequence;
+    FlightState m_state;
+};
+
+#endif // FLIGHTSTATE_H
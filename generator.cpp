@@ -1,4 +1,5 @@
 #include "generator.h"
+#include <trace.h>
 
 Generator::Generator(const QAudioFormat &format,
                      qint64 durationUs,
@@ -69,6 +70,7 @@ void Generator::generateData(const QAudioFormat &format, qint64 durationUs, int
 
 qint64 Generator::readData(char *data, qint64 len)
 {
+    TRACE_SCOPE("audio.fill");
     qint64 total = 0;
     if (!m_buffer.isEmpty()) {
         while (len - total > 0) {
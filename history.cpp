@@ -0,0 +1,196 @@
+#include "history.h"
+#include <QtMath>
+#include <limits>
+
+HistoryChannel::HistoryChannel()
+    : m_levels(HISTORY_LEVELS)
+{
+    reset();
+}
+
+void HistoryChannel::reset()
+{
+    for (int i = 0; i < m_levels.size(); i++)
+    {
+        Level &level = m_levels[i];
+        level.length = static_cast<qint64>(HISTORY_BASE_MS) << i;
+        level.head = 0;
+        level.size = 0;
+        level.open.count = 0;
+    }
+    m_first = -1;
+    m_last = -1;
+}
+
+void HistoryChannel::append(qint64 timeMs, double value)
+{
+    if(timeMs < m_last)
+        return;
+    if(m_first < 0)
+        m_first = timeMs;
+    m_last = timeMs;
+
+    const float sample = static_cast<float>(value);
+    for (Level &level : m_levels)
+    {
+        const qint64 start = timeMs - timeMs % level.length;
+        Bucket &open = level.open;
+        if(open.count > 0 && open.time != start)
+        {
+            // Close the bucket into the ring, overwriting the oldest when full
+            if(level.size == HISTORY_LEVEL_CAPACITY)
+            {
+                level.buckets[level.head] = open;
+                level.head = (level.head + 1) % HISTORY_LEVEL_CAPACITY;
+            }
+            else
+                level.buckets[(level.head + level.size++) % HISTORY_LEVEL_CAPACITY] = open;
+            open.count = 0;
+        }
+
+        if(open.count == 0)
+        {
+            open.time = start;
+            open.minimum = open.maximum = sample;
+            open.sum = 0;
+        }
+        open.minimum = qMin(open.minimum, sample);
+        open.maximum = qMax(open.maximum, sample);
+        open.sum += value;
+        open.count++;
+    }
+}
+
+int HistoryChannel::levelFor(qint64 from, qint64 bucketLength) const
+{
+    int best = 0;
+    for (int i = 0; i < m_levels.size(); i++)
+    {
+        const Level &level = m_levels.at(i);
+        if(level.length > bucketLength && i > 0)
+            break;
+        best = i;
+    }
+
+    // Coarser until the ring reaches back to from
+    while (best < m_levels.size() - 1)
+    {
+        const Level &level = m_levels.at(best);
+        const qint64 oldest = level.size > 0 ? level.buckets[level.head].time : level.open.time;
+        if(level.size < HISTORY_LEVEL_CAPACITY || oldest <= from)
+            break;
+        best++;
+    }
+    return best;
+}
+
+int HistoryChannel::firstBucket(const Level &level, qint64 from) const
+{
+    // Binary search over the ring, which is sorted by time
+    int low = 0, high = level.size;
+    while (low < high)
+    {
+        const int middle = (low + high) / 2;
+        const Bucket &bucket = level.buckets[(level.head + middle) % HISTORY_LEVEL_CAPACITY];
+        if(bucket.time + level.length <= from)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+template<typename Visit>
+void HistoryChannel::visit(const Level &level, qint64 from, qint64 to, Visit visitBucket) const
+{
+    for (int i = firstBucket(level, from); i < level.size; i++)
+    {
+        const Bucket &bucket = level.buckets[(level.head + i) % HISTORY_LEVEL_CAPACITY];
+        if(bucket.time >= to)
+            return;
+        visitBucket(bucket);
+    }
+    if(level.open.count > 0 && level.open.time < to && level.open.time + level.length > from)
+        visitBucket(level.open);
+}
+
+void HistoryChannel::minMax(qint64 from, qint64 to, int columns, float *minimum, float *maximum) const
+{
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    for (int i = 0; i < columns; i++)
+        minimum[i] = maximum[i] = nan;
+    if(isEmpty() || columns <= 0 || to <= from)
+        return;
+
+    const double columnLength = static_cast<double>(to - from) / columns;
+    const Level &level = m_levels.at(levelFor(from, static_cast<qint64>(columnLength)));
+    visit(level, from, to, [&](const Bucket &bucket) {
+        const int column = qBound(0, static_cast<int>((qMax(bucket.time, from) - from) / columnLength), columns - 1);
+        if(qIsNaN(minimum[column]) || bucket.minimum < minimum[column])
+            minimum[column] = bucket.minimum;
+        if(qIsNaN(maximum[column]) || bucket.maximum > maximum[column])
+            maximum[column] = bucket.maximum;
+    });
+}
+
+void HistoryChannel::lttb(qint64 from, qint64 to, int points, QVector<QPointF> &out) const
+{
+    out.resize(0);
+    if(isEmpty() || points < 3 || to <= from)
+        return;
+
+    // Bucket means at a level giving a few times more points than wanted
+    QVector<QPointF> means;
+    const Level &level = m_levels.at(levelFor(from, (to - from) / (4 * points)));
+    visit(level, from, to, [&](const Bucket &bucket) {
+        means.append(QPointF(bucket.time + level.length / 2, bucket.sum / bucket.count));
+    });
+
+    if(means.size() <= points)
+    {
+        out = means;
+        return;
+    }
+
+    // First and last kept; every other output point is the one of its bucket
+    // spanning the largest triangle with the previous pick and the mean of
+    // the next bucket
+    out.reserve(points);
+    out.append(means.first());
+    const double every = static_cast<double>(means.size() - 2) / (points - 2);
+    int previous = 0;
+    for (int i = 0; i < points - 2; i++)
+    {
+        const int start = static_cast<int>(i * every) + 1;
+        const int end = static_cast<int>((i + 1) * every) + 1;
+        const int nextStart = end;
+        const int nextEnd = qMin(static_cast<int>((i + 2) * every) + 1, means.size());
+
+        double meanX = 0, meanY = 0;
+        for (int j = nextStart; j < nextEnd; j++)
+        {
+            meanX += means.at(j).x();
+            meanY += means.at(j).y();
+        }
+        const int nextCount = qMax(1, nextEnd - nextStart);
+        meanX /= nextCount;
+        meanY /= nextCount;
+
+        const QPointF &a = means.at(previous);
+        double largest = -1;
+        int pick = start;
+        for (int j = start; j < end; j++)
+        {
+            const QPointF &b = means.at(j);
+            const double area = qAbs((a.x() - meanX) * (b.y() - a.y()) - (a.x() - b.x()) * (meanY - a.y()));
+            if(area > largest)
+            {
+                largest = area;
+                pick = j;
+            }
+        }
+        out.append(means.at(pick));
+        previous = pick;
+    }
+    out.append(means.last());
+}
@@ -0,0 +1,72 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <QPointF>
+
+#define HISTORY_BASE_MS 100             // bucket length of the finest level
+#define HISTORY_LEVELS 12               // each level doubles the bucket length
+#define HISTORY_LEVEL_CAPACITY 2048     // buckets kept per level
+
+/*
+ * History of one filter output as a min/max pyramid. Every level is a ring
+ * of HISTORY_LEVEL_CAPACITY buckets (time, min, max, mean) whose length
+ * doubles from level to level: the finest covers the last 3.4 minutes in
+ * 0.1 s buckets, the coarsest about five days in 205 s buckets. Memory is
+ * fixed however long the flight, and appending touches one open bucket per
+ * level.
+ *
+ * A time span is drawn from the coarsest level whose buckets are still no
+ * longer than one pixel column and which reaches back far enough, so the
+ * cost is proportional to the width in pixels and not to the samples.
+ */
+class HistoryChannel
+{
+public:
+    HistoryChannel();
+
+    void reset();
+    void append(qint64 timeMs, double value);
+
+    bool isEmpty() const { return m_first < 0; }
+    qint64 firstTime() const { return m_first; }
+    qint64 lastTime() const { return m_last; }
+
+    // Per pixel column minimum and maximum of [from, to); NaN where empty
+    void minMax(qint64 from, qint64 to, int columns, float *minimum, float *maximum) const;
+
+    // Largest-triangle-three-buckets decimation of the bucket means in
+    // [from, to) to at most points points; x is the time in ms
+    void lttb(qint64 from, qint64 to, int points, QVector<QPointF> &out) const;
+
+private:
+    struct Bucket
+    {
+        qint64 time;        // start, ms
+        float minimum;
+        float maximum;
+        double sum;
+        int count;
+    };
+
+    struct Level
+    {
+        qint64 length;      // ms per bucket
+        Bucket buckets[HISTORY_LEVEL_CAPACITY];
+        int head;           // index of the oldest bucket
+        int size;
+        Bucket open;        // bucket being filled, count 0 if none
+    };
+
+    int levelFor(qint64 from, qint64 bucketLength) const;
+    int firstBucket(const Level &level, qint64 from) const;
+    template<typename Visit> void visit(const Level &level, qint64 from, qint64 to, Visit visitBucket) const;
+
+private:
+    QVector<Level> m_levels;
+    qint64 m_first;
+    qint64 m_last;
+};
+
+#endif // HISTORY_H
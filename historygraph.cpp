@@ -0,0 +1,118 @@
+#include "historygraph.h"
+#include "history.h"
+#include <QPainter>
+#include <QPolygonF>
+#include <QtMath>
+#include <trace.h>
+
+#define GRAPH_BACKGROUND "#001a1a"
+#define GRAPH_ALTITUDE "#F78181"
+#define GRAPH_VARIO "#FFDD33"
+#define GRAPH_AXIS "#00cccc"
+
+HistoryGraph::HistoryGraph(const HistoryChannel *altitude, const HistoryChannel *vario, QWidget *parent)
+    : QWidget(parent)
+    , m_altitude(altitude)
+    , m_vario(vario)
+    , m_fullFlight(false)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+void HistoryGraph::resizeEvent(QResizeEvent *event)
+{
+    m_minimum.resize(qMax(1, width()));
+    m_maximum.resize(qMax(1, width()));
+    m_line.reserve(qMax(3, width()));
+    QWidget::resizeEvent(event);
+}
+
+void HistoryGraph::mouseReleaseEvent(QMouseEvent *event)
+{
+    m_fullFlight = !m_fullFlight;
+    update();
+    QWidget::mouseReleaseEvent(event);
+}
+
+void HistoryGraph::paintEnvelope(QPainter &painter, const QRect &area, const QColor &color, bool zeroLine)
+{
+    const int columns = qMin(area.width(), m_minimum.size());
+    float low = zeroLine ? -1 : 0, high = zeroLine ? 1 : 0;
+    bool any = false;
+    for (int i = 0; i < columns; i++)
+    {
+        if(qIsNaN(m_minimum.at(i)))
+            continue;
+        low = any || zeroLine ? qMin(low, m_minimum.at(i)) : m_minimum.at(i);
+        high = any || zeroLine ? qMax(high, m_maximum.at(i)) : m_maximum.at(i);
+        any = true;
+    }
+    if(!any)
+        return;
+    if(high - low < 1)
+        high = low + 1;
+
+    const double scale = (area.height() - 1) / (high - low);
+    if(zeroLine)
+    {
+        painter.setPen(QColor(GRAPH_AXIS));
+        const int y = area.bottom() - qRound(-low * scale);
+        painter.drawLine(area.left(), y, area.right(), y);
+    }
+
+    painter.setPen(color);
+    for (int i = 0; i < columns; i++)
+    {
+        if(qIsNaN(m_minimum.at(i)))
+            continue;
+        painter.drawLine(area.left() + i, area.bottom() - qRound((m_minimum.at(i) - low) * scale),
+                         area.left() + i, area.bottom() - qRound((m_maximum.at(i) - low) * scale));
+    }
+}
+
+void HistoryGraph::paintEvent(QPaintEvent *event)
+{
+    TRACE_SCOPE("ui.paint.history");
+    Q_UNUSED(event);
+    QPainter painter(this);
+    painter.fillRect(rect(), QColor(GRAPH_BACKGROUND));
+    if(m_altitude->isEmpty())
+        return;
+
+    const QRect barogram(0, 0, width(), height() * 6 / 10);
+    const QRect trace(0, barogram.bottom() + 1, width(), height() - barogram.height() - 1);
+    const qint64 end = m_altitude->lastTime() + 1;
+    const int columns = qMin(width(), m_minimum.size());
+
+    if(m_fullFlight)
+    {
+        m_altitude->lttb(m_altitude->firstTime(), end, barogram.width(), m_line);
+        if(m_line.size() >= 2)
+        {
+            double low = m_line.first().y(), high = low;
+            for (const QPointF &point : m_line)
+            {
+                low = qMin(low, point.y());
+                high = qMax(high, point.y());
+            }
+            const double xScale = (barogram.width() - 1) / qMax(1.0, m_line.last().x() - m_line.first().x());
+            const double yScale = (barogram.height() - 1) / qMax(1.0, high - low);
+            const double x0 = m_line.first().x();
+            for (QPointF &point : m_line)
+                point = QPointF(barogram.left() + (point.x() - x0) * xScale, barogram.bottom() - (point.y() - low) * yScale);
+
+            painter.setRenderHint(QPainter::Antialiasing);
+            painter.setPen(QColor(GRAPH_ALTITUDE));
+            painter.drawPolyline(m_line.constData(), m_line.size());
+            painter.setRenderHint(QPainter::Antialiasing, false);
+        }
+    }
+    else
+    {
+        m_altitude->minMax(end - HISTORY_RECENT_MS, end, columns, m_minimum.data(), m_maximum.data());
+        paintEnvelope(painter, barogram, QColor(GRAPH_ALTITUDE), false);
+    }
+
+    m_vario->minMax(end - HISTORY_RECENT_MS, end, columns, m_minimum.data(), m_maximum.data());
+    paintEnvelope(painter, trace, QColor(GRAPH_VARIO), true);
+}
@@ -0,0 +1,44 @@
+#ifndef HISTORYGRAPH_H
+#define HISTORYGRAPH_H
+
+#include <QWidget>
+#include <QVector>
+#include <QPointF>
+
+class HistoryChannel;
+
+#define HISTORY_RECENT_MS (5 * 60 * 1000)
+
+/*
+ * Barogram over the vario trace. The barogram shows the last five minutes as
+ * a per-column min/max envelope, or after a tap the whole flight as an LTTB
+ * line; the vario trace below always shows the last five minutes. The
+ * column buffers are sized on resize rather than per paint.
+ */
+class HistoryGraph : public QWidget
+{
+    Q_OBJECT
+
+public:
+    HistoryGraph(const HistoryChannel *altitude, const HistoryChannel *vario, QWidget *parent = nullptr);
+
+    bool showsFullFlight() const { return m_fullFlight; }
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+
+private:
+    void paintEnvelope(QPainter &painter, const QRect &area, const QColor &color, bool zeroLine);
+
+private:
+    const HistoryChannel *m_altitude;
+    const HistoryChannel *m_vario;
+    bool m_fullFlight;
+    QVector<float> m_minimum;
+    QVector<float> m_maximum;
+    QVector<QPointF> m_line;
+};
+
+#endif // HISTORYGRAPH_H
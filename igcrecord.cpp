@@ -0,0 +1,173 @@
+#include "igcrecord.h"
+#include <QFile>
+#include <QtMath>
+
+static inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// Reads count digits starting at 0-based offset; on error returns the
+// 1-based column of the bad character.
+static inline int readDigits(const char *line, int offset, int count, int &value)
+{
+    value = 0;
+    for (int i = offset; i < offset + count; i++)
+    {
+        if(!isDigit(line[i]))
+            return i + 1;
+        value = value * 10 + (line[i] - '0');
+    }
+    return 0;
+}
+
+// Pressure and GNSS altitudes may be negative: "-0012"
+static inline int readAltitude(const char *line, int offset, int &value)
+{
+    if(line[offset] == '-')
+    {
+        const int error = readDigits(line, offset + 1, 4, value);
+        value = -value;
+        return error;
+    }
+    return readDigits(line, offset, 5, value);
+}
+
+int parseBRecord(const char *line, int length, IgcFix &fix)
+{
+    if(length < IGC_B_RECORD_LENGTH)
+        return length + 1;
+    if(line[0] != 'B')
+        return 1;
+
+    int hours, minutes, seconds;
+    int error;
+    if((error = readDigits(line, 1, 2, hours)) || (error = readDigits(line, 3, 2, minutes))
+            || (error = readDigits(line, 5, 2, seconds)))
+        return error;
+    if(hours > 23)
+        return 2;
+    if(minutes > 59)
+        return 4;
+    if(seconds > 59)
+        return 6;
+    fix.time = hours * 3600 + minutes * 60 + seconds;
+
+    int degrees, thousandths;
+    if((error = readDigits(line, 7, 2, degrees)) || (error = readDigits(line, 9, 5, thousandths)))
+        return error;
+    if(degrees > 90 || (degrees == 90 && thousandths > 0))
+        return 8;
+    if(thousandths >= 60000)
+        return 10;
+    if(line[14] != 'N' && line[14] != 'S')
+        return 15;
+    fix.latitude = degrees + thousandths / 60000.0;
+    if(line[14] == 'S')
+        fix.latitude = -fix.latitude;
+
+    if((error = readDigits(line, 15, 3, degrees)) || (error = readDigits(line, 18, 5, thousandths)))
+        return error;
+    if(degrees > 180 || (degrees == 180 && thousandths > 0))
+        return 16;
+    if(thousandths >= 60000)
+        return 19;
+    if(line[23] != 'E' && line[23] != 'W')
+        return 24;
+    fix.longitude = degrees + thousandths / 60000.0;
+    if(line[23] == 'W')
+        fix.longitude = -fix.longitude;
+
+    if(line[24] != 'A' && line[24] != 'V')
+        return 25;
+    fix.valid = line[24] == 'A';
+
+    if((error = readAltitude(line, 25, fix.pressureAltitude)) || (error = readAltitude(line, 30, fix.gpsAltitude)))
+        return error;
+
+    return 0;
+}
+
+static inline char *writeDigits(char *out, int value, int count)
+{
+    for (int i = count - 1; i >= 0; i--)
+    {
+        out[i] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+    return out + count;
+}
+
+// MMmmm is always five digits, rounding up to 60' carries into the degrees
+static char *writeAngle(char *out, double angle, int degreeDigits, char positive, char negative)
+{
+    const char hemisphere = angle < 0 ? negative : positive;
+    angle = qAbs(angle);
+    int degrees = static_cast<int>(angle);
+    int thousandths = qRound((angle - degrees) * 60000.0);
+    if(thousandths >= 60000)
+    {
+        degrees++;
+        thousandths -= 60000;
+    }
+    out = writeDigits(out, degrees, degreeDigits);
+    out = writeDigits(out, thousandths, 5);
+    *out++ = hemisphere;
+    return out;
+}
+
+static inline char *writeAltitude(char *out, int value)
+{
+    if(value < 0)
+    {
+        *out++ = '-';
+        return writeDigits(out, qMin(-value, 9999), 4);
+    }
+    return writeDigits(out, qMin(value, 99999), 5);
+}
+
+int formatBRecord(const IgcFix &fix, char *line)
+{
+    char *out = line;
+    *out++ = 'B';
+    out = writeDigits(out, fix.time / 3600 % 24, 2);
+    out = writeDigits(out, fix.time / 60 % 60, 2);
+    out = writeDigits(out, fix.time % 60, 2);
+    out = writeAngle(out, fix.latitude, 2, 'N', 'S');
+    out = writeAngle(out, fix.longitude, 3, 'E', 'W');
+    *out++ = fix.valid ? 'A' : 'V';
+    out = writeAltitude(out, fix.pressureAltitude);
+    out = writeAltitude(out, fix.gpsAltitude);
+    return static_cast<int>(out - line);
+}
+
+int formatSignedField(int value, int width, char *out)
+{
+    int limit = 1;
+    for (int i = 1; i < width; i++)
+        limit *= 10;
+    value = qBound(1 - limit, value, limit - 1);
+    out[0] = value < 0 ? '-' : '+';
+    writeDigits(out + 1, qAbs(value), width - 1);
+    return width;
+}
+
+bool readIgcFixes(const QString &fileName, QVector<IgcFix> &fixes)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    char line[IGC_MAX_LINE];
+    qint64 length;
+    while ((length = file.readLine(line, IGC_MAX_LINE)) > 0)
+    {
+        if(line[0] != 'B')
+            continue;
+
+        IgcFix fix;
+        if(parseBRecord(line, static_cast<int>(length), fix) == 0)
+            fixes.append(fix);
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef IGCRECORD_H
+#define IGCRECORD_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <QString>
+
+// Minimum length of a B record without I-record extensions:
+// B HHMMSS DDMMmmmN DDDMMmmmE V PPPPP GGGGG
+#define IGC_B_RECORD_LENGTH 35
+#define IGC_MAX_LINE 256
+
+struct IgcFix
+{
+    int time;               // seconds since midnight UTC
+    double latitude;        // decimal degrees, south negative
+    double longitude;       // decimal degrees, west negative
+    int pressureAltitude;   // metres
+    int gpsAltitude;        // metres
+    bool valid;             // 'A' = 3D fix, 'V' = 2D or no fix
+};
+
+/**
+ * Parses the fixed part of a B record in place. Returns 0 on success or
+ * the 1-based column of the first malformed character, so callers can
+ * report precise positions without allocating.
+ */
+int parseBRecord(const char *line, int length, IgcFix &fix);
+
+/**
+ * Writes the fixed part of a B record for fix to line, which must hold
+ * IGC_B_RECORD_LENGTH characters, and returns the number written. The
+ * inverse of parseBRecord; no terminator is added and nothing is allocated.
+ */
+int formatBRecord(const IgcFix &fix, char *line);
+
+/**
+ * Writes value as a signed field of width characters ("+050", "-999"),
+ * clamped to what fits, for I-record extensions. Returns width.
+ */
+int formatSignedField(int value, int width, char *out);
+
+/**
+ * Appends all well-formed B records of an igc file to fixes. Returns false
+ * if the file can't be read.
+ */
+bool readIgcFixes(const QString &fileName, QVector<IgcFix> &fixes);
+
+#endif // IGCRECORD_H
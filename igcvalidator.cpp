@@ -0,0 +1,312 @@
+#include "igcvalidator.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <cstring>
+
+#define MIDNIGHT_ROLLOVER_S (12 * 3600)
+#define SECONDS_PER_DAY (24 * 3600)
+
+// Gives access to the whole file, memory-mapped when the platform allows it
+class IgcData
+{
+public:
+    explicit IgcData(const QString &fileName)
+        : m_file(fileName)
+        , m_data(nullptr)
+        , m_size(0)
+    {
+        if(!m_file.open(QIODevice::ReadOnly))
+            return;
+
+        m_size = m_file.size();
+        uchar *mapped = m_size > 0 ? m_file.map(0, m_size) : nullptr;
+        if(mapped)
+        {
+            m_data = reinterpret_cast<const char *>(mapped);
+        }
+        else
+        {
+            m_buffer = m_file.readAll();
+            m_data = m_buffer.constData();
+            m_size = m_buffer.size();
+        }
+    }
+
+    bool isOpen() const { return m_file.isOpen(); }
+    QString errorString() const { return m_file.errorString(); }
+
+    // Returns the next line without its CR/LF terminator, false at the end
+    bool nextLine(qint64 &pos, const char *&line, int &length) const
+    {
+        if(pos >= m_size)
+            return false;
+
+        line = m_data + pos;
+        const void *lf = memchr(line, '\n', static_cast<size_t>(m_size - pos));
+        const qint64 end = lf ? static_cast<const char *>(lf) - m_data : m_size;
+        pos = end + 1;
+
+        length = static_cast<int>(end - (line - m_data));
+        if(length > 0 && line[length - 1] == '\r')
+            length--;
+        return true;
+    }
+
+private:
+    QFile m_file;
+    QByteArray m_buffer;
+    const char *m_data;
+    qint64 m_size;
+};
+
+static inline bool isRecordType(char c)
+{
+    return c >= 'A' && c <= 'L';
+}
+
+IgcValidator::IgcValidator()
+    : m_issueCount(0)
+    , m_fixCount(0)
+    , m_repairable(true)
+{
+}
+
+void IgcValidator::addIssue(int line, int column, const QString &message, bool repairable)
+{
+    m_issueCount++;
+    if(!repairable)
+        m_repairable = false;
+    if(m_issues.size() < IGC_MAX_REPORTED_ISSUES)
+        m_issues.append({ line, column, message, repairable });
+}
+
+QString IgcValidator::firstIssue() const
+{
+    if(m_issues.isEmpty())
+        return QString();
+
+    const IgcIssue &issue = m_issues.first();
+    return QString("Line %1, column %2: %3").arg(issue.line).arg(issue.column).arg(issue.message);
+}
+
+QString IgcValidator::repairedFileName(const QString &fileName)
+{
+    QFileInfo info(fileName);
+    return info.absolutePath() + "/" + info.completeBaseName() + "_repaired.igc";
+}
+
+// HFDTEddmmyy (IGC 2008) or HFDTEDATE:ddmmyy,nn (IGC 2016)
+bool IgcValidator::isDateHeader(const char *line, int length, int &column)
+{
+    int offset = 5;
+    if(length >= 10 && memcmp(line + 5, "DATE:", 5) == 0)
+        offset = 10;
+
+    column = offset + 1;
+    if(length < offset + 6)
+        return false;
+
+    for (int i = offset; i < offset + 6; i++)
+    {
+        if(line[i] < '0' || line[i] > '9')
+        {
+            column = i + 1;
+            return false;
+        }
+    }
+
+    const int day = (line[offset] - '0') * 10 + (line[offset + 1] - '0');
+    const int month = (line[offset + 2] - '0') * 10 + (line[offset + 3] - '0');
+    if(day < 1 || day > 31)
+        return false;
+    column = offset + 3;
+    return month >= 1 && month <= 12;
+}
+
+bool IgcValidator::validate(const QString &fileName)
+{
+    m_issues.clear();
+    m_issueCount = 0;
+    m_fixCount = 0;
+    m_repairable = true;
+
+    IgcData data(fileName);
+    if(!data.isOpen())
+    {
+        addIssue(0, 0, data.errorString(), false);
+        return false;
+    }
+
+    qint64 pos = 0;
+    const char *line;
+    int length;
+    int lineNumber = 0;
+    bool haveDate = false;
+    int lastTime = -1;
+    int dayOffset = 0;
+    QByteArray repaired;
+
+    while (data.nextLine(pos, line, length))
+    {
+        lineNumber++;
+
+        if(length == 0)
+        {
+            addIssue(lineNumber, 1, "Empty line", true);
+            continue;
+        }
+
+        if(lineNumber == 1 && line[0] != 'A')
+            addIssue(lineNumber, 1, "First record must be an A record", false);
+
+        if(!isRecordType(line[0]))
+        {
+            addIssue(lineNumber, 1, QString("Unknown record type '%1'").arg(QChar(line[0])), false);
+            continue;
+        }
+
+        if(line[0] == 'H' && length >= 5 && memcmp(line + 1, "FDTE", 4) == 0)
+        {
+            int column;
+            if(isDateHeader(line, length, column))
+                haveDate = true;
+            else
+                addIssue(lineNumber, column, "Malformed HFDTE date", false);
+            continue;
+        }
+
+        if(line[0] != 'B')
+            continue;
+
+        if(!haveDate)
+        {
+            addIssue(lineNumber, 1, "B record before the HFDTE header", false);
+            haveDate = true; // report once
+        }
+
+        IgcFix fix;
+        const int column = parseBRecord(line, length, fix);
+        if(column)
+        {
+            repaired.clear();
+            if(repairBRecord(line, length, repaired))
+                addIssue(lineNumber, column, "Malformed coordinate field", true);
+            else
+                addIssue(lineNumber, column, "Malformed B record", false);
+            continue;
+        }
+
+        int time = fix.time + dayOffset;
+        if(lastTime >= 0 && time < lastTime)
+        {
+            if(lastTime - time > MIDNIGHT_ROLLOVER_S)
+            {
+                dayOffset += SECONDS_PER_DAY;
+                time += SECONDS_PER_DAY;
+            }
+            else
+            {
+                addIssue(lineNumber, 2, "Fix time goes backwards", true);
+                continue;
+            }
+        }
+        lastTime = time;
+        m_fixCount++;
+    }
+
+    if(m_fixCount == 0 && m_issueCount == 0)
+        addIssue(lineNumber, 1, "No B records", false);
+
+    return m_issueCount == 0;
+}
+
+// Re-reads the coordinate fields without fixed widths. Older versions wrote
+// minutes with "%2.3f", which loses the leading zero below 10 minutes
+// ("DD5123N"), and could round up to 60.000.
+bool IgcValidator::repairBRecord(const char *line, int length, QByteArray &out)
+{
+    int pos = 7;
+    out.append(line, qMin(length, pos));
+
+    auto coordinate = [&](int degreeDigits, char positive, char negative) {
+        if(pos + degreeDigits > length)
+            return false;
+        out.append(line + pos, degreeDigits);
+        pos += degreeDigits;
+
+        const int start = pos;
+        int thousandths = 0;
+        while (pos < length && line[pos] >= '0' && line[pos] <= '9')
+            thousandths = thousandths * 10 + (line[pos++] - '0');
+
+        const int digits = pos - start;
+        if(digits < 4 || digits > 5 || pos >= length || (line[pos] != positive && line[pos] != negative))
+            return false;
+
+        out.append(QByteArray::number(qMin(thousandths, 59999)).rightJustified(5, '0'));
+        out.append(line[pos++]);
+        return true;
+    };
+
+    if(!coordinate(2, 'N', 'S') || !coordinate(3, 'E', 'W'))
+        return false;
+
+    out.append(line + pos, length - pos);
+
+    IgcFix fix;
+    return parseBRecord(out.constData(), out.size(), fix) == 0;
+}
+
+bool IgcValidator::repair(const QString &fileName, const QString &repairedFileName)
+{
+    IgcData data(fileName);
+    QSaveFile out(repairedFileName);
+    if(!data.isOpen() || !out.open(QIODevice::WriteOnly))
+        return false;
+
+    qint64 pos = 0;
+    const char *line;
+    int length;
+    int lastTime = -1;
+    int dayOffset = 0;
+    QByteArray record;
+
+    while (data.nextLine(pos, line, length))
+    {
+        if(length == 0)
+            continue;
+
+        if(line[0] == 'B')
+        {
+            IgcFix fix;
+            record = QByteArray::fromRawData(line, length);
+            if(parseBRecord(line, length, fix))
+            {
+                record.clear();
+                if(!repairBRecord(line, length, record))
+                    return false;
+                parseBRecord(record.constData(), record.size(), fix);
+            }
+
+            int time = fix.time + dayOffset;
+            if(lastTime >= 0 && time < lastTime)
+            {
+                if(lastTime - time <= MIDNIGHT_ROLLOVER_S)
+                    continue;
+                dayOffset += SECONDS_PER_DAY;
+                time += SECONDS_PER_DAY;
+            }
+            lastTime = time;
+
+            out.write(record);
+        }
+        else
+        {
+            out.write(line, length);
+        }
+        out.write("\r\n", 2);
+    }
+
+    return out.commit();
+}
@@ -0,0 +1,58 @@
+#ifndef IGCVALIDATOR_H
+#define IGCVALIDATOR_H
+
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+#include <igcrecord.h>
+
+#define IGC_MAX_REPORTED_ISSUES 100
+
+struct IgcIssue
+{
+    int line;           // 1-based, 0 if the file itself can't be read
+    int column;         // 1-based
+    QString message;
+    bool repairable;
+};
+
+/*
+ * Single pass igc checker run before a flight is queued for upload, so an
+ * invalid file is caught locally instead of by the server. It checks the
+ * record grammar, the HFDTE header, B record coordinate ranges and that
+ * fix times never go backwards (midnight roll-over allowed).
+ *
+ * Trivial problems, such as the 4-digit minutes fields older XcVario
+ * versions wrote for minutes below 10, blank lines or fixes that jump back
+ * in time, can be repaired into a new file. The original is never touched.
+ */
+class IgcValidator
+{
+public:
+    IgcValidator();
+
+    bool validate(const QString &fileName);
+    bool repair(const QString &fileName, const QString &repairedFileName);
+
+    bool isValid() const { return m_issueCount == 0; }
+    bool isRepairable() const { return m_repairable; }
+    int issueCount() const { return m_issueCount; }
+    int fixCount() const { return m_fixCount; }
+    const QVector<IgcIssue> &issues() const { return m_issues; }
+    QString firstIssue() const;
+
+    static QString repairedFileName(const QString &fileName);
+
+private:
+    void addIssue(int line, int column, const QString &message, bool repairable);
+    static bool repairBRecord(const char *line, int length, QByteArray &out);
+    static bool isDateHeader(const char *line, int length, int &column);
+
+private:
+    QVector<IgcIssue> m_issues;
+    int m_issueCount;
+    int m_fixCount;
+    bool m_repairable;
+};
+
+#endif // IGCVALIDATOR_H
@@ -0,0 +1,236 @@
+#include "instrumentpanel.h"
+#include <QPainter>
+#include <QPaintEvent>
+#include <QFontMetrics>
+#include <QTextDocumentFragment>
+#include <QElapsedTimer>
+#include <QtMath>
+#include <cstring>
+#include <trace.h>
+#include <metrics.h>
+
+static const MetricHistogram paintTime("ui.paint");
+
+#define PANEL_BACKGROUND "#001a1a"
+#define PANEL_VARIO "#FFDD33"
+#define PANEL_VALUE "#F78181"
+#define PANEL_UNIT "#00cccc"
+#define PANEL_TEXT "#F2EDED"
+
+DigitAtlas::DigitAtlas()
+    : m_height(0)
+{
+}
+
+int DigitAtlas::glyphIndex(char c) const
+{
+    const char *glyph = strchr(DIGIT_ATLAS_GLYPHS, c);
+    return glyph && c ? static_cast<int>(glyph - DIGIT_ATLAS_GLYPHS) : -1;
+}
+
+void DigitAtlas::render(const QFont &font, const QColor &color, int pixelHeight, qreal devicePixelRatio)
+{
+    QFont glyphFont(font);
+    glyphFont.setPixelSize(qMax(1, pixelHeight));
+    QFontMetrics metrics(glyphFont);
+
+    const int count = static_cast<int>(strlen(DIGIT_ATLAS_GLYPHS));
+    m_offsets.resize(count);
+    m_widths.resize(count);
+    int x = 0;
+    for (int i = 0; i < count; i++)
+    {
+        m_offsets[i] = x;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+        m_widths[i] = metrics.horizontalAdvance(QLatin1Char(DIGIT_ATLAS_GLYPHS[i]));
+#else
+        m_widths[i] = metrics.width(QLatin1Char(DIGIT_ATLAS_GLYPHS[i]));
+#endif
+        x += m_widths[i];
+    }
+    m_height = metrics.height();
+
+    m_pixmap = QPixmap(qCeil(x * devicePixelRatio), qCeil(m_height * devicePixelRatio));
+    m_pixmap.setDevicePixelRatio(devicePixelRatio);
+    m_pixmap.fill(Qt::transparent);
+
+    QPainter painter(&m_pixmap);
+    painter.setRenderHint(QPainter::TextAntialiasing);
+    painter.setFont(glyphFont);
+    painter.setPen(color);
+    for (int i = 0; i < count; i++)
+        painter.drawText(QRect(m_offsets.at(i), 0, m_widths.at(i), m_height), Qt::AlignCenter,
+                         QString(QLatin1Char(DIGIT_ATLAS_GLYPHS[i])));
+}
+
+int DigitAtlas::width(const char *text) const
+{
+    int width = 0;
+    for (; *text; text++)
+    {
+        const int glyph = glyphIndex(*text);
+        if(glyph >= 0)
+            width += m_widths.at(glyph);
+    }
+    return width;
+}
+
+int DigitAtlas::draw(QPainter &painter, int x, int y, const char *text) const
+{
+    const qreal ratio = m_pixmap.devicePixelRatio();
+    for (; *text; text++)
+    {
+        const int glyph = glyphIndex(*text);
+        if(glyph < 0)
+            continue;
+        const int width = m_widths.at(glyph);
+        painter.drawPixmap(QRectF(x, y, width, m_height), m_pixmap,
+                           QRectF(m_offsets.at(glyph) * ratio, 0, width * ratio, m_height * ratio));
+        x += width;
+    }
+    return x;
+}
+
+InstrumentPanel::InstrumentPanel(QWidget *parent)
+    : QWidget(parent)
+    , m_lastPaintNs(0)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+
+    m_vario.atlas = &m_varioDigits;
+    m_vario.unit.setText(" m/s");
+    m_speed.atlas = &m_valueDigits;
+    m_speed.unit.setText(" km/h");
+    m_altitude.atlas = &m_valueDigits;
+    m_altitude.unit.setText(" m");
+    for (Field *field : {&m_vario, &m_speed, &m_altitude})
+    {
+        field->unit.setTextFormat(Qt::PlainText);
+        strcpy(field->text, "-");
+    }
+}
+
+bool InstrumentPanel::setNumber(Field &field, double value)
+{
+    char text[INSTRUMENT_MAX_DIGITS];
+    qsnprintf(text, sizeof(text), "%.1f", value);
+    if(strcmp(text, field.text) == 0)
+        return false;
+
+    strcpy(field.text, text);
+    update(field.rect);
+    return true;
+}
+
+void InstrumentPanel::setVario(double vario)
+{
+    setNumber(m_vario, vario);
+}
+
+void InstrumentPanel::setSpeed(double speed)
+{
+    setNumber(m_speed, speed);
+}
+
+void InstrumentPanel::setAltitude(double altitude)
+{
+    setNumber(m_altitude, altitude);
+}
+
+void InstrumentPanel::setGpsHtml(const QString &html)
+{
+    QString plain = QTextDocumentFragment::fromHtml(html).toPlainText();
+    plain.replace(QChar::LineSeparator, '\n');
+    plain.replace(QChar::ParagraphSeparator, '\n');
+    if(plain == m_gpsPlain)
+        return;
+
+    m_gpsPlain = plain;
+    m_gpsLines.clear();
+    foreach (const QString &line, plain.split('\n', QString::SkipEmptyParts))
+    {
+        QStaticText text(line.trimmed());
+        text.setTextFormat(Qt::PlainText);
+        text.prepare(QTransform(), m_gpsFont);
+        m_gpsLines.append(text);
+    }
+    update(m_gpsRect);
+}
+
+void InstrumentPanel::layoutFields()
+{
+    const QRect area = rect();
+    const int varioHeight = area.height() * 35 / 100;
+    const int valueHeight = area.height() * 15 / 100;
+
+    m_vario.rect = QRect(area.left(), area.top(), area.width(), varioHeight);
+    m_speed.rect = QRect(area.left(), m_vario.rect.bottom() + 1, area.width(), valueHeight);
+    m_altitude.rect = QRect(area.left(), m_speed.rect.bottom() + 1, area.width(), valueHeight);
+    m_gpsRect = QRect(area.left(), m_altitude.rect.bottom() + 1, area.width(), area.bottom() - m_altitude.rect.bottom());
+
+    QFont digits(font());
+    digits.setWeight(QFont::DemiBold);
+    m_varioDigits.render(digits, QColor(PANEL_VARIO), varioHeight * 7 / 10, devicePixelRatioF());
+    m_valueDigits.render(digits, QColor(PANEL_VALUE), valueHeight * 7 / 10, devicePixelRatioF());
+
+    m_unitFont = digits;
+    m_unitFont.setPixelSize(qMax(1, valueHeight / 3));
+    for (Field *field : {&m_vario, &m_speed, &m_altitude})
+        field->unit.prepare(QTransform(), m_unitFont);
+
+    m_gpsFont = digits;
+    m_gpsFont.setPixelSize(qBound(1, m_gpsRect.height() / 12, 28));
+    for (QStaticText &line : m_gpsLines)
+        line.prepare(QTransform(), m_gpsFont);
+}
+
+void InstrumentPanel::resizeEvent(QResizeEvent *event)
+{
+    layoutFields();
+    QWidget::resizeEvent(event);
+}
+
+void InstrumentPanel::paintField(QPainter &painter, const Field &field)
+{
+    painter.fillRect(field.rect, QColor(PANEL_BACKGROUND));
+
+    const QSizeF unitSize = field.unit.size();
+    const int width = field.atlas->width(field.text) + qCeil(unitSize.width());
+    const int x = field.rect.left() + (field.rect.width() - width) / 2;
+    const int y = field.rect.top() + (field.rect.height() - field.atlas->height()) / 2;
+
+    const int end = field.atlas->draw(painter, x, y, field.text);
+    painter.setFont(m_unitFont);
+    painter.setPen(QColor(PANEL_UNIT));
+    painter.drawStaticText(QPointF(end, y + field.atlas->height() - unitSize.height() * 1.2), field.unit);
+}
+
+void InstrumentPanel::paintEvent(QPaintEvent *event)
+{
+    TRACE_SCOPE("ui.paint.panel");
+    QElapsedTimer timer;
+    timer.start();
+
+    QPainter painter(this);
+    const QRect dirty = event->rect();
+    for (const Field *field : {&m_vario, &m_speed, &m_altitude})
+        if(dirty.intersects(field->rect))
+            paintField(painter, *field);
+
+    if(dirty.intersects(m_gpsRect))
+    {
+        painter.fillRect(m_gpsRect, QColor(PANEL_BACKGROUND));
+        painter.setFont(m_gpsFont);
+        painter.setPen(QColor(PANEL_TEXT));
+        qreal y = m_gpsRect.top();
+        for (const QStaticText &line : m_gpsLines)
+        {
+            const QSizeF size = line.size();
+            painter.drawStaticText(QPointF(m_gpsRect.left() + (m_gpsRect.width() - size.width()) / 2, y), line);
+            y += size.height();
+        }
+    }
+
+    m_lastPaintNs = timer.nsecsElapsed();
+    paintTime.record(m_lastPaintNs);
+}
@@ -0,0 +1,96 @@
+#ifndef INSTRUMENTPANEL_H
+#define INSTRUMENTPANEL_H
+
+#include <QWidget>
+#include <QPixmap>
+#include <QStaticText>
+#include <QColor>
+#include <QFont>
+#include <QVector>
+
+#define DIGIT_ATLAS_GLYPHS "0123456789.-+ "
+#define INSTRUMENT_MAX_DIGITS 16
+
+/*
+ * The characters of DIGIT_ATLAS_GLYPHS rendered once into a pixmap at one
+ * pixel size and colour. Drawing a number is then one pixmap blit per
+ * character, without text shaping or allocation.
+ */
+class DigitAtlas
+{
+public:
+    DigitAtlas();
+
+    void render(const QFont &font, const QColor &color, int pixelHeight, qreal devicePixelRatio);
+    bool isNull() const { return m_pixmap.isNull(); }
+    int height() const { return m_height; }
+
+    int width(const char *text) const;
+    // Returns the x after the last character
+    int draw(QPainter &painter, int x, int y, const char *text) const;
+
+private:
+    int glyphIndex(char c) const;
+
+private:
+    QPixmap m_pixmap;
+    QVector<int> m_offsets;     // x of each glyph in the pixmap, device independent pixels
+    QVector<int> m_widths;
+    int m_height;
+};
+
+/*
+ * Instrument panel painted with QPainter, a drop-in for the vario, altitude
+ * and gps labels: setVario(), setSpeed() and setAltitude() take the values,
+ * setGpsHtml() the same rich text the gps label gets. A setter that doesn't
+ * change the displayed text does nothing, otherwise only the field it
+ * belongs to is repainted. Numbers come from digit atlases rebuilt on resize,
+ * units and gps lines are pre-laid-out QStaticText.
+ */
+class InstrumentPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit InstrumentPanel(QWidget *parent = nullptr);
+
+    void setVario(double vario);
+    void setSpeed(double speed);
+    void setAltitude(double altitude);
+    void setGpsHtml(const QString &html);
+
+    qint64 lastPaintNs() const { return m_lastPaintNs; }
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    struct Field
+    {
+        QRect rect;
+        DigitAtlas *atlas;
+        QStaticText unit;
+        char text[INSTRUMENT_MAX_DIGITS];
+    };
+
+    bool setNumber(Field &field, double value);
+    void paintField(QPainter &painter, const Field &field);
+    void layoutFields();
+
+private:
+    DigitAtlas m_varioDigits;
+    DigitAtlas m_valueDigits;
+    Field m_vario;
+    Field m_speed;
+    Field m_altitude;
+
+    QFont m_unitFont;
+    QFont m_gpsFont;
+    QRect m_gpsRect;
+    QString m_gpsPlain;
+    QVector<QStaticText> m_gpsLines;
+    qint64 m_lastPaintNs;
+};
+
+#endif // INSTRUMENTPANEL_H
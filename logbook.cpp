@@ -0,0 +1,320 @@
+#include "logbook.h"
+#include <QtConcurrent>
+#include <QFutureWatcher>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+#include <igcrecord.h>
+#include <tracksimplifier.h>
+#include <xcscore.h>
+
+#define LOGBOOK_MAGIC 0x58434c42    // "XCLB"
+#define REPAIRED_SUFFIX "_repaired.igc"
+
+static void writeEntry(QDataStream &out, const LogbookEntry &entry)
+{
+    out << entry.fileName << entry.modified << entry.date << qint32(entry.takeoff) << qint32(entry.duration)
+        << qint32(entry.maxAltitude) << entry.distance << entry.score << qint32(entry.uploadStatus);
+}
+
+static void readEntry(QDataStream &in, LogbookEntry &entry)
+{
+    qint32 takeoff, duration, maxAltitude, uploadStatus;
+    in >> entry.fileName >> entry.modified >> entry.date >> takeoff >> duration
+       >> maxAltitude >> entry.distance >> entry.score >> uploadStatus;
+    entry.takeoff = takeoff;
+    entry.duration = duration;
+    entry.maxAltitude = maxAltitude;
+    entry.uploadStatus = uploadStatus;
+}
+
+Logbook::Logbook(const QString &fileName, const QString &directory, QObject *parent)
+    : QObject(parent)
+    , m_fileName(fileName)
+    , m_directory(directory)
+    , m_records(0)
+    , m_backfilling(false)
+{
+}
+
+void Logbook::apply(const LogbookEntry &entry)
+{
+    auto found = m_index.constFind(entry.fileName);
+    if(found != m_index.constEnd())
+    {
+        m_entries[found.value()] = entry;
+        return;
+    }
+    m_index.insert(entry.fileName, m_entries.size());
+    m_entries.append(entry);
+}
+
+bool Logbook::load()
+{
+    m_entries.clear();
+    m_index.clear();
+    m_records = 0;
+
+    QFile file(m_fileName);
+    if(!file.open(QIODevice::ReadWrite))
+        return false;
+
+    QDataStream in(&file);
+    quint32 magic;
+    qint32 version;
+    in >> magic >> version;
+    if(in.status() != QDataStream::Ok || magic != LOGBOOK_MAGIC || version != LOGBOOK_VERSION)
+    {
+        file.close();
+        return compact();
+    }
+
+    qint64 good = file.pos();
+    while (!in.atEnd())
+    {
+        qint8 type;
+        LogbookEntry entry;
+        in >> type;
+        readEntry(in, entry);
+        if(in.status() != QDataStream::Ok || (type != FlightRecord && type != StatusRecord))
+            break;
+
+        // A status record only carries fileName and uploadStatus
+        if(type == StatusRecord)
+        {
+            const int index = indexOf(entry.fileName);
+            if(index >= 0)
+                m_entries[index].uploadStatus = entry.uploadStatus;
+        }
+        else
+            apply(entry);
+        m_records++;
+        good = file.pos();
+    }
+
+    if(good < file.size())
+    {
+        qDebug() << "logbook: dropping" << file.size() - good << "bytes of torn records";
+        file.resize(good);
+    }
+    file.close();
+
+    if(m_records > 2 * m_entries.size() + 16)
+        compact();
+    return true;
+}
+
+bool Logbook::compact()
+{
+    QSaveFile file(m_fileName);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out << quint32(LOGBOOK_MAGIC) << qint32(LOGBOOK_VERSION);
+    for (const LogbookEntry &entry : m_entries)
+    {
+        out << qint8(FlightRecord);
+        writeEntry(out, entry);
+    }
+    m_records = m_entries.size();
+    return file.commit();
+}
+
+bool Logbook::append(const LogbookEntry &entry, RecordType type)
+{
+    // A new book is written whole, entry included
+    if(!QFile::exists(m_fileName))
+        return compact();
+
+    QFile file(m_fileName);
+    if(!file.open(QIODevice::Append))
+        return false;
+
+    QDataStream out(&file);
+    out << qint8(type);
+    writeEntry(out, entry);
+    m_records++;
+    return out.status() == QDataStream::Ok;
+}
+
+int Logbook::indexOf(const QString &igcFileName) const
+{
+    QString name = QFileInfo(igcFileName).fileName();
+    // Uploads of repaired copies count for the original flight
+    if(name.endsWith(REPAIRED_SUFFIX) && !m_index.contains(name))
+        name = name.left(name.size() - int(strlen(REPAIRED_SUFFIX))) + ".igc";
+    return m_index.value(name, -1);
+}
+
+void Logbook::addFlight(const LogbookEntry &flight)
+{
+    LogbookEntry entry = flight;
+    const int index = indexOf(entry.fileName);
+    if(index >= 0)
+        entry.uploadStatus = m_entries.at(index).uploadStatus;
+    apply(entry);
+    append(entry, FlightRecord);
+}
+
+void Logbook::setUploadStatus(const QString &igcFileName, LogbookEntry::UploadStatus status)
+{
+    const int index = indexOf(igcFileName);
+    if(index < 0 || m_entries.at(index).uploadStatus == status)
+        return;
+    m_entries[index].uploadStatus = status;
+    append(m_entries.at(index), StatusRecord);
+}
+
+QVector<int> Logbook::filter(const QDate &from, const QDate &to, double minDistance) const
+{
+    QVector<int> result;
+    for (int i = 0; i < m_entries.size(); i++)
+    {
+        const LogbookEntry &entry = m_entries.at(i);
+        if((from.isValid() && entry.date < from) || (to.isValid() && entry.date > to) || entry.distance < minDistance)
+            continue;
+        result.append(i);
+    }
+    std::sort(result.begin(), result.end(), [this](int a, int b) {
+        const LogbookEntry &first = m_entries.at(a);
+        const LogbookEntry &second = m_entries.at(b);
+        return first.date != second.date ? first.date > second.date : first.takeoff > second.takeoff;
+    });
+    return result;
+}
+
+// HFDTEddmmyy (IGC 2008) or HFDTEDATE:ddmmyy,nn (IGC 2016)
+static QDate headerDate(const char *line, int length)
+{
+    int column = 5;
+    if(length >= 10 && memcmp(line + 5, "DATE:", 5) == 0)
+        column = 10;
+    if(length < column + 6)
+        return QDate();
+    int digits[6];
+    for (int i = 0; i < 6; i++)
+    {
+        const char c = line[column + i];
+        if(c < '0' || c > '9')
+            return QDate();
+        digits[i] = c - '0';
+    }
+    return QDate(2000 + digits[4] * 10 + digits[5], digits[2] * 10 + digits[3], digits[0] * 10 + digits[1]);
+}
+
+LogbookEntry Logbook::summarize(const QString &fileName)
+{
+    QFileInfo info(fileName);
+    LogbookEntry entry;
+    entry.fileName = info.fileName();
+    entry.modified = info.lastModified().toMSecsSinceEpoch();
+    entry.date = info.lastModified().toUTC().date();
+    entry.takeoff = 0;
+    entry.duration = 0;
+    entry.maxAltitude = 0;
+    entry.distance = 0;
+    entry.score = 0;
+    entry.uploadStatus = LogbookEntry::NotUploaded;
+
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return entry;
+
+    // Scored on the simplified track: every B record is within the tolerance
+    // of it, and a long flight gives XcScore a tenth of the fixes
+    TrackSimplifier simplifier;
+    XcScore xcScore;
+    char line[IGC_MAX_LINE];
+    qint64 length;
+    int first = -1, previous = -1, day = 0;
+    bool anyFix = false;
+    while ((length = file.readLine(line, IGC_MAX_LINE)) > 0)
+    {
+        if(line[0] == 'H' && length > 5 && memcmp(line, "HFDTE", 5) == 0)
+        {
+            const QDate date = headerDate(line, static_cast<int>(length));
+            if(date.isValid())
+                entry.date = date;
+            continue;
+        }
+
+        IgcFix fix;
+        if(line[0] != 'B' || parseBRecord(line, static_cast<int>(length), fix) != 0)
+            continue;
+
+        // Flights across midnight UTC
+        if(previous >= 0 && fix.time + day < previous - 43200)
+            day += 86400;
+        const int time = fix.time + day;
+        if(first < 0)
+            first = time;
+        previous = time;
+
+        const int altitude = fix.pressureAltitude != 0 ? fix.pressureAltitude : fix.gpsAltitude;
+        entry.maxAltitude = anyFix ? qMax(entry.maxAltitude, altitude) : altitude;
+        anyFix = true;
+        if(simplifier.add(fix))
+            xcScore.addFix(QGeoCoordinate(simplifier.track().last().latitude, simplifier.track().last().longitude));
+    }
+
+    const int kept = simplifier.track().size();
+    simplifier.flush();
+    if(simplifier.track().size() > kept)
+        xcScore.addFix(QGeoCoordinate(simplifier.track().last().latitude, simplifier.track().last().longitude));
+
+    if(first >= 0)
+    {
+        entry.takeoff = first % 86400;
+        entry.duration = previous - first;
+        entry.distance = xcScore.best().distance;
+        entry.score = xcScore.best().score;
+    }
+    return entry;
+}
+
+void Logbook::backfill()
+{
+    if(m_backfilling)
+        return;
+
+    // New files, and files changed since they were summarized
+    QStringList files;
+    QDir dir(m_directory);
+    foreach (const QFileInfo &info, dir.entryInfoList(QStringList() << "*.igc", QDir::Files))
+    {
+        if(info.fileName().endsWith(REPAIRED_SUFFIX))
+            continue;
+        const int index = m_index.value(info.fileName(), -1);
+        if(index < 0 || m_entries.at(index).modified != info.lastModified().toMSecsSinceEpoch())
+            files << info.absoluteFilePath();
+    }
+    if(files.isEmpty())
+        return;
+    m_backfilling = true;
+
+    auto watcher = new QFutureWatcher<LogbookEntry>(this);
+    connect(watcher, &QFutureWatcher<LogbookEntry>::finished, this, [this, watcher]() {
+        const QList<LogbookEntry> entries = watcher->future().results();
+        watcher->deleteLater();
+
+        for (LogbookEntry entry : entries)
+        {
+            const int index = m_index.value(entry.fileName, -1);
+            if(index >= 0)
+                entry.uploadStatus = m_entries.at(index).uploadStatus;
+            apply(entry);
+        }
+        // One rewrite instead of an append per file
+        compact();
+        m_backfilling = false;
+        emit backfilled(entries.size());
+    });
+    watcher->setFuture(QtConcurrent::mapped(files, &Logbook::summarize));
+}
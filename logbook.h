@@ -0,0 +1,90 @@
+#ifndef LOGBOOK_H
+#define LOGBOOK_H
+
+#include <QObject>
+#include <QVector>
+#include <QHash>
+#include <QDate>
+
+#define LOGBOOK_VERSION 1
+
+struct LogbookEntry
+{
+    enum UploadStatus
+    {
+        NotUploaded,
+        Queued,
+        Uploaded,
+        Rejected
+    };
+
+    QString fileName;       // igc file name inside the archive directory
+    qint64 modified;        // ms since epoch of the igc file when summarized
+    QDate date;             // from HFDTE, else the file time
+    int takeoff;            // seconds since midnight UTC of the first fix
+    int duration;           // s
+    int maxAltitude;        // m
+    double distance;        // km, best cross-country distance
+    double score;           // points, distance times the route factor
+    int uploadStatus;
+};
+
+/*
+ * Flight logbook: one summary row per igc file, so listing and filtering
+ * never touch the flights themselves. The book is an append-only file of
+ * flight and upload status records; loading replays it, the newest record
+ * for a file wins, and a torn tail from a crash is cut off. Once superseded
+ * records outnumber the live ones the file is rewritten compactly.
+ * Files missing from the book are summarized on a thread pool, one file per
+ * task, like the thermal store.
+ */
+class Logbook : public QObject
+{
+    Q_OBJECT
+
+public:
+    Logbook(const QString &fileName, const QString &directory, QObject *parent);
+
+    bool load();
+
+    // Appends a closed flight summarized while it was logged
+    void addFlight(const LogbookEntry &flight);
+    void setUploadStatus(const QString &igcFileName, LogbookEntry::UploadStatus status);
+
+    int size() const { return m_entries.size(); }
+    const LogbookEntry &at(int index) const { return m_entries.at(index); }
+    int indexOf(const QString &igcFileName) const;
+
+    // Indexes of the flights between from and to with at least minDistance
+    // km, newest first. Null dates leave that end open.
+    QVector<int> filter(const QDate &from = QDate(), const QDate &to = QDate(), double minDistance = 0) const;
+
+    // Summarizes the igc files of the directory that the book doesn't have
+    // yet in parallel, then emits backfilled
+    void backfill();
+    static LogbookEntry summarize(const QString &fileName);
+
+signals:
+    void backfilled(int added);
+
+private:
+    enum RecordType
+    {
+        FlightRecord = 1,
+        StatusRecord = 2
+    };
+
+    void apply(const LogbookEntry &entry);
+    bool append(const LogbookEntry &entry, RecordType type);
+    bool compact();
+
+private:
+    QString m_fileName;
+    QString m_directory;
+    QVector<LogbookEntry> m_entries;
+    QHash<QString, int> m_index;
+    int m_records;
+    bool m_backfilling;
+};
+
+#endif // LOGBOOK_H
@@ -1,24 +1,51 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 
+static const MetricCounter sensorSamples("sensor.samples");
+static const MetricCounter sensorGaps("sensor.gaps");
+static const MetricHistogram sensorInterval("sensor.interval");
+static const MetricHistogram filterTime("filter.update");
+static const MetricHistogram igcWriteTime("igc.write");
+static const MetricHistogram uiFrameTime("ui.frame");
+static const MetricGauge firstFrameTime("startup.first_frame");
+static const MetricGauge firstVarioTime("startup.first_vario");
+
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     varioBeep(nullptr),
     networkmanager(nullptr),
+    uploadQueue(nullptr),
+    trackingClient(nullptr),
+    thermalStore(nullptr),
+    logbook(nullptr),
+    terrain(nullptr),
+    instrumentPanel(nullptr),
+    historyGraph(nullptr),
+    uiTimer(nullptr),
+    sensorTimer(nullptr),
+    metricsExporter(nullptr),
     m_posSource(nullptr),
     m_nmeaSource(nullptr),
+    m_varioSource(nullptr),
+    m_sourcesStarted(false),
+    m_firstFrame(false),
     m_sensorPressureValid(false),
     m_start(false),
     m_running(false),
     createIgcFile(false),
+    m_sensor(nullptr),
+    pressure_filter(nullptr),
+    altitude_filter(nullptr),
     distance(0),
     pressure (101325.0),
     altitude (0),
     vario (0),
     speed (0),
     oldaltitude(0),
+    igcFile(nullptr),
     ui(new Ui::MainWindow)
 {
+    m_startupTime = Metrics::now();
     ui->setupUi(this);
     setWindowTitle("XcVario");
 
@@ -35,6 +62,32 @@ MainWindow::MainWindow(QWidget *parent) :
     path = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + QString("/VarioLog/");
 #endif
 
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+    path = QStandardPaths::writableLocation(QStandardPaths::HomeLocation) + QString("/VarioLog/");
+#endif
+
+    QDir dir;
+    if (!dir.exists(path))
+        dir.mkpath(path);
+
+    m_SettingsFile = path + "settings.ini";
+    loadSettings();
+    QSettings settings(m_SettingsFile, QSettings::IniFormat);
+
+    // XCVARIO_TRACE or trace/file: record hot-path timings, written there as
+    // Chrome trace JSON on Stop, at the end of a replay and on exit
+    m_traceFile = qEnvironmentVariable("XCVARIO_TRACE", settings.value("trace/file").toString());
+    Trace::setEnabled(!m_traceFile.isEmpty());
+
+    // Metrics are always recorded; metrics/file gets a snapshot every
+    // metrics/interval seconds and on exit, metrics/port serves one locally
+    metricsExporter = new MetricsExporter(this);
+    metricsExporter->setFile(settings.value("metrics/file").toString(),
+                             settings.value("metrics/interval", 60).toInt() * 1000);
+    const quint16 metricsPort = static_cast<quint16>(settings.value("metrics/port", 0).toUInt());
+    if(metricsPort)
+        metricsExporter->listen(metricsPort);
+
     ui->label_vario->setStyleSheet("font-size: 16pt; color: #cccccc; background-color: #001a1a;");
     ui->label_gps->setStyleSheet("font-size: 16pt; color: #cccccc; background-color: #001a1a;");
     ui->label_altitude->setStyleSheet("font-size: 16pt; color: #cccccc; background-color: #001a1a;");
@@ -42,18 +95,163 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->label_gps->setTextInteractionFlags(Qt::TextBrowserInteraction);
     connect(ui->label_gps, &QLabel::linkActivated, this, &MainWindow::on_gpsLabel_linkActivated);
 
+    // One paced UI update instead of one per sensor sample and GPS fix
+    m_gpsTextChanged = false;
+    m_shownState = flightState.read();
+    uiTimer = new QTimer(this);
+    uiTimer->setInterval(1000 / qBound(1, settings.value("display/fps", 10).toInt(), 60));
+    connect(uiTimer, &QTimer::timeout, this, &MainWindow::uiTick);
+    uiTimer->start();
+
+    // A backend can start and then never deliver; see tryNextSensor
+    sensorTimer = new QTimer(this);
+    sensorTimer->setSingleShot(true);
+    sensorTimer->setInterval(SENSOR_FIRST_READING_MS);
+    connect(sensorTimer, &QTimer::timeout, this, &MainWindow::sensorTimedOut);
+
+    if(settings.value("display/history", true).toBool())
+    {
+        historyGraph = new HistoryGraph(&altitudeHistory, &varioHistory, this);
+        historyGraph->setMinimumHeight(120);
+        ui->gridLayout->addWidget(historyGraph, 3, 0);
+    }
+
+    // QPainter panel in place of the three labels, same data
+    if(settings.value("display/panel", false).toBool())
+    {
+        instrumentPanel = new InstrumentPanel(this);
+        ui->label_vario->hide();
+        ui->label_altitude->hide();
+        ui->label_gps->hide();
+        ui->gridLayout->addWidget(instrumentPanel, 0, 0, 3, 1);
+    }
+
+    // Both wait for startServices, which runs once the window is up
     ui->buttonStart->setEnabled(false);
+    ui->buttonFile->setEnabled(false);
 
+    // synthetic/enabled or XCVARIO_SYNTHETIC: simulated barometer in place of
+    // the hardware one, for load tests; synthetic/rate in Hz, climb and sink
+    // in m/s, cycle in s, noise in Pa, dropouts per minute of dropout ms
+    if(qEnvironmentVariableIsSet("XCVARIO_SYNTHETIC") || settings.value("synthetic/enabled", false).toBool())
+    {
+        SyntheticProfile profile = SyntheticProfile::defaults();
+        profile.rate = settings.value("synthetic/rate", profile.rate).toInt();
+        profile.climb = settings.value("synthetic/climb", profile.climb).toDouble();
+        profile.sink = settings.value("synthetic/sink", profile.sink).toDouble();
+        profile.cycle = settings.value("synthetic/cycle", profile.cycle).toDouble();
+        profile.noise = settings.value("synthetic/noise", profile.noise).toDouble();
+        profile.dropoutRate = settings.value("synthetic/dropouts", profile.dropoutRate).toDouble();
+        profile.dropoutMs = settings.value("synthetic/dropout", profile.dropoutMs).toInt();
+        SyntheticPressureBackend::registerBackend(profile);
+    }
+}
+
+MainWindow::~MainWindow()
+{
+    writeTrace();
+    metricsExporter->writeFile();
+    closeFlight();
+    delete ui;
+}
+
+void MainWindow::startSources()
+{
+    // The barometer first, it's what the pilot waits for; network, maps and
+    // gps plugins on a later turn of the event loop
     startSensors();
+    loadSensors();
+    startVarioSource();
+    QTimer::singleShot(0, this, SLOT(startServices()));
+}
+
+void MainWindow::startServices()
+{
+    QSettings settings(m_SettingsFile, QSettings::IniFormat);
+
+    //QUrl url = QUrl("http://xc.dhv.de/xc/modules/leonardo/flight_submit.php");
+    QUrl url = QUrl("http://www.paraglidingforum.com/modules/leonardo/flight_submit.php");
+    //QUrl url = QUrl("http://www.ypforum.com/modules/leonardo/flight_submit.php");
+
+    networkmanager = new NetworkAccessManager(url, this);
+    connect(networkmanager, &NetworkAccessManager::invalidUser, this, &MainWindow::invalidUser);
+    connect(networkmanager, &NetworkAccessManager::responseResult, this, &MainWindow::responseResult);
+
+    // Additional Leonardo servers (dhv, ypforum, ...) are listed under "servers"
+    QList<QUrl> servers;
+    foreach (const QString &server, settings.value("servers", url.toString()).toStringList())
+    {
+        QUrl serverUrl(server);
+        servers << serverUrl;
+
+        // "encoding/<host[:port]>" = gzip or deflate, only for servers that inflate request bodies
+        const QString key = NetworkAccessManager::serverKey(serverUrl);
+        QString encoding = settings.value("encoding/" + key).toString();
+        if(encoding == "gzip")
+            networkmanager->setContentEncoding(key, NetworkAccessManager::Gzip);
+        else if(encoding == "deflate")
+            networkmanager->setContentEncoding(key, NetworkAccessManager::Deflate);
+    }
+
+    uploadQueue = new UploadQueue(networkmanager, path + "uploadqueue.json", this);
+    uploadQueue->setServers(servers);
+    uploadQueue->setCredentials(user, pass);
+
+    // OpenAir file, parsed once and then reloaded from the binary cache
+    QString airspaceFile = settings.value("airspace/file", path + "airspace.txt").toString();
+    if(airspaces.load(airspaceFile, path + "airspace.cache"))
+        qDebug() << "Airspaces:" << airspaces.size();
+
+    trackSimplifier.setTolerance(settings.value("track/tolerance", TRACK_SIMPLIFY_TOLERANCE).toDouble());
+
+    // SeeYou .cup with a related task; takeoff and landing are dropped
+    QVector<Waypoint> waypoints;
+    QVector<Turnpoint> turnpoints;
+    if(loadWaypoints(settings.value("task/file", path + "task.cup").toString(), waypoints, &turnpoints)
+            && turnpoints.size() >= 2)
+        task.setTurnpoints(turnpoints);
+
+    terrain = new Terrain(settings.value("terrain/dir", path + "srtm").toString(), this);
+
+    thermalStore = new ThermalStore(path + "thermals.dat", this);
+    if(!thermalStore->load())
+        thermalStore->buildFromArchive(path);
+
+    // Summaries of the archived flights; files the book misses are added in the background
+    logbook = new Logbook(path + "logbook.dat", path, this);
+    logbook->load();
+    logbook->backfill();
+    connect(uploadQueue, &UploadQueue::flightUploaded, this, [this](const QString &fileName) {
+        logbook->setUploadStatus(fileName, LogbookEntry::Uploaded);
+    });
+    connect(uploadQueue, &UploadQueue::flightRejected, this, [this](const QString &fileName) {
+        logbook->setUploadStatus(fileName, LogbookEntry::Rejected);
+    });
+
+    trackingClient = new TrackingClient(this);
+    trackingClient->setServer(settings.value("tracking/host").toString(),
+                              static_cast<quint16>(settings.value("tracking/port", 0).toUInt()));
+    trackingClient->setInterval(settings.value("tracking/interval", 15).toInt() * 1000);
+    trackingClient->setPilot(user);
+
+    ui->buttonFile->setEnabled(true);
+
+    // An explicitly configured receiver or replay log wins over the core
+    // source, and so does an auto-detected serial receiver that worked last time
+    bool nmeaConfigured = settings.contains("nmea/device") || settings.contains("nmea/replay");
+    bool nmeaCached = settings.value("cache/gps").toString() == NMEA_CACHE_NAME;
 
     QString status;
-    if(!startGpsSource())
+    if((nmeaConfigured || nmeaCached) && startNmeaSource())
+    {
+        ui->buttonStart->setEnabled(true);
+    }
+    else if(!startGpsSource())
     {
         status.append("<span style='font-size:18pt; font-weight:600;color:#00cccc;'>No core gps source found!</span><br />");
         ui->label_gps->setText(status);
 
-#ifdef Q_OS_WIN
-        if(!startNmeaSource())
+        if(nmeaConfigured || nmeaCached || !startNmeaSource())
         {
             status.append("<span style='font-size:18pt; font-weight:600;color:#00cccc;'>No nmea source found!</span>");
             ui->label_gps->setText(status);
@@ -62,143 +260,196 @@ MainWindow::MainWindow(QWidget *parent) :
         {
             ui->buttonStart->setEnabled(true);
         }
-#endif
     }
     else
     {
         ui->buttonStart->setEnabled(true);
     }
-
-    //QUrl url = QUrl("http://xc.dhv.de/xc/modules/leonardo/flight_submit.php");
-    QUrl url = QUrl("http://www.paraglidingforum.com/modules/leonardo/flight_submit.php");
-    //QUrl url = QUrl("http://www.ypforum.com/modules/leonardo/flight_submit.php");
-
-    networkmanager = new NetworkAccessManager(url, this);
-    connect(networkmanager, &NetworkAccessManager::invalidUser, this, &MainWindow::invalidUser);
-    connect(networkmanager, &NetworkAccessManager::responseResult, this, &MainWindow::responseResult);
-}
-
-MainWindow::~MainWindow()
-{
-    if(igcFile->isOpen())
-    {
-        igcFile->close();
-    }
-    delete ui;
 }
 
 void MainWindow::startSensors()
 {
-    (void)QSensor::sensorTypes();
+    // Listing every sensor type loads all the plugins, so only scanSensors
+    // does it, when there is no barometer to show
     QSensor *sensor = new QSensor(QByteArray(), this);
     connect(sensor, SIGNAL(availableSensorsChanged()), this, SLOT(loadSensors()));
 }
 
 bool MainWindow::startNmeaSource()
 {
-#ifdef Q_OS_WIN
-    auto serial = new QSerialPort(this);
-    QList<QSerialPortInfo> com_ports = QSerialPortInfo::availablePorts();
+    // nmea/replay: recorded log, nmea/device: serial port or pty,
+    // nmea/baud: line speed (10 Hz receivers usually run at 115200)
+    QSettings settings(m_SettingsFile, QSettings::IniFormat);
+    QString replay = settings.value("nmea/replay").toString();
+    QString device = settings.value("nmea/device").toString();
+    int baudRate = settings.value("nmea/baud", 4800).toInt();
 
-    if (com_ports.isEmpty()) {
-        qWarning("serialnmea: No serial ports found");
-        return false;
+    m_nmeaSource = new NmeaSource(this);
+    QString description;
+    bool opened = false;
+
+    if(!replay.isEmpty())
+    {
+        opened = m_nmeaSource->openReplay(replay);
+        description = "Replay: " + replay;
+    }
+#ifdef Q_OS_UNIX
+    else if(!device.isEmpty())
+    {
+        opened = m_nmeaSource->openTty(device, baudRate);
+        description = "Port: " + device + " Baud: " + QString::number(baudRate);
     }
+#endif
+#ifdef Q_OS_WIN
+    else
+    {
+        auto serial = new QSerialPort(this);
+        QList<QSerialPortInfo> com_ports = QSerialPortInfo::availablePorts();
+
+        QSet<int> supportedDevices;
+        supportedDevices << 0x67b;  // GlobalSat (BU-353S4 and probably others)
+        supportedDevices << 0xe8d;  // Qstarz MTK II
+        supportedDevices << 0x1546; // u-blox GNNS
+
+        // Without nmea/device, the port the receiver was on last time is tried first
+        const QString cachedPort = device.isEmpty() ? settings.value("cache/port").toString() : QString();
+        for (int i = 1; i < com_ports.size(); i++) {
+            if (com_ports.at(i).portName() == cachedPort) {
+                com_ports.move(i, 0);
+                break;
+            }
+        }
 
-    QSet<int> supportedDevices;
-    supportedDevices << 0x67b;  // GlobalSat (BU-353S4 and probably others)
-    supportedDevices << 0xe8d;  // Qstarz MTK II
-    supportedDevices << 0x1546; // u-blox GNNS
-
-    QString portName;
-    QString vendorId;
-    bool deviceFound = false;
-    foreach (const QSerialPortInfo& port, com_ports) {
-        if (port.hasVendorIdentifier() && supportedDevices.contains(port.vendorIdentifier())) {
-            portName = port.portName();
-            vendorId = (port.hasVendorIdentifier()
-                        ? QByteArray::number(port.vendorIdentifier(), 16) : "no vendor id");
-            serial->setPortName(portName);
-            deviceFound = true;
-            break;
+        QString vendorId;
+        bool deviceFound = false;
+        foreach (const QSerialPortInfo& port, com_ports) {
+            if (port.portName() == device || port.portName() == cachedPort
+                    || (device.isEmpty() && port.hasVendorIdentifier() && supportedDevices.contains(port.vendorIdentifier()))) {
+                vendorId = (port.hasVendorIdentifier()
+                            ? QByteArray::number(port.vendorIdentifier(), 16) : "no vendor id");
+                serial->setPortName(port.portName());
+                deviceFound = true;
+                break;
+            }
         }
-    }
 
-    if(!deviceFound)
-        return false;
+        if (!deviceFound)
+            qWarning("serialnmea: No supported serial port found");
 
-    if(!serial->setBaudRate(QSerialPort::Baud4800))
-        qDebug() << serial->errorString();
-    if(!serial->setDataBits(QSerialPort::Data7))
-        qDebug() << serial->errorString();
-    if(!serial->setParity(QSerialPort::EvenParity))
-        qDebug() << serial->errorString();
-    if(!serial->setFlowControl(QSerialPort::HardwareControl))
-        qDebug() << serial->errorString();
-    if(!serial->setStopBits(QSerialPort::OneStop))
-        qDebug() << serial->errorString();
-
-    if (!serial->open(QIODevice::ReadOnly))
-    {
-        qWarning("Failed to open %s", qPrintable(serial->portName()));
-        serial->reset();
-        return false;
+        // NMEA 0183 framing is 8N1
+        if(deviceFound && !serial->setBaudRate(baudRate))
+            qDebug() << serial->errorString();
+        serial->setDataBits(QSerialPort::Data8);
+        serial->setParity(QSerialPort::NoParity);
+        serial->setStopBits(QSerialPort::OneStop);
+        serial->setFlowControl(QSerialPort::NoFlowControl);
+
+        if (deviceFound && serial->open(QIODevice::ReadOnly))
+        {
+            serial->setObjectName(serial->portName());
+            m_nmeaSource->setDevice(serial);
+            description = "Port: " +  serial->portName() + " VendorId: " + vendorId;
+            opened = true;
+            if(device.isEmpty())
+                settings.setValue("cache/port", serial->portName());
+        }
+        else
+        {
+            qWarning("Failed to open %s", qPrintable(serial->portName()));
+            delete serial;
+        }
     }
+#endif
 
-    m_nmeaSource = new QNmeaPositionInfoSource(QNmeaPositionInfoSource::RealTimeMode, this);
-    if (m_nmeaSource == nullptr)
+    if(!opened)
     {
+        delete m_nmeaSource;
+        m_nmeaSource = nullptr;
         return false;
     }
 
-    m_nmeaSource->setDevice(serial);
-    m_nmeaSource->setUpdateInterval(0);
+    settings.setValue("cache/gps", NMEA_CACHE_NAME);
 
-    QIODevice* dev = m_nmeaSource->device();
-    if(dev)
-    {
-        connect(m_nmeaSource, &QGeoPositionInfoSource::positionUpdated, this, &MainWindow::positionUpdated);
-        connect(m_nmeaSource, &QGeoPositionInfoSource::updateTimeout, this, &MainWindow::updateTimeout);
-        connect(m_nmeaSource, SIGNAL(error(QGeoPositionInfoSource::Error)), this, SLOT(errorChanged(QGeoPositionInfoSource::Error)));
+    connect(m_nmeaSource, &QGeoPositionInfoSource::positionUpdated, this, &MainWindow::positionUpdated);
+    // Many external varios send their pressure on the gps stream
+    connect(m_nmeaSource, &NmeaSource::pressureSample, this, &MainWindow::externalPressure);
+    connect(m_nmeaSource, &QGeoPositionInfoSource::updateTimeout, this, &MainWindow::updateTimeout);
+    connect(m_nmeaSource, SIGNAL(error(QGeoPositionInfoSource::Error)), this, SLOT(errorChanged(QGeoPositionInfoSource::Error)));
 
-        QString status;
-        status.append("<span style='font-size:18pt; font-weight:600;color:#00cccc;'>Gps nmea device found</span><br />");
-        status.append("Port: " +  serial->portName() + " VendorId: " + vendorId);
-        ui->label_gps->setText(status);
+    QString status;
+    status.append("<span style='font-size:18pt; font-weight:600;color:#00cccc;'>Gps nmea device found</span><br />");
+    status.append(description);
+    ui->label_gps->setText(status);
 
-        /*while(serial->isOpen())
-        {
-            if(!serial->waitForReadyRead(-1)) //block until new data arrives
-                qDebug() << "error: " << serial->errorString();
-            else{
-                QByteArray datas = serial->readAll();
-                qDebug() << datas << "\n";
-            }
-        }*/
+    return true;
+}
+
+void MainWindow::startVarioSource()
+{
+    // A separate external vario: vario/device serial port or pty,
+    // vario/baud, or vario/host and vario/port for a tcp stream
+    QSettings settings(m_SettingsFile, QSettings::IniFormat);
+    QString device = settings.value("vario/device").toString();
+    QString host = settings.value("vario/host").toString();
+    if(device.isEmpty() && host.isEmpty())
+        return;
+
+    m_varioSource = new NmeaSource(this);
+    bool opened = false;
+    if(!host.isEmpty())
+    {
+        auto socket = new QTcpSocket(m_varioSource);
+        socket->setObjectName(host);
+        socket->connectToHost(host, static_cast<quint16>(settings.value("vario/port", 4353).toUInt()), QIODevice::ReadOnly);
+        m_varioSource->setDevice(socket);
+        opened = true;
     }
+#ifdef Q_OS_UNIX
     else
+        opened = m_varioSource->openTty(device, settings.value("vario/baud", 115200).toInt());
+#endif
+
+    if(!opened)
     {
-        qDebug() << "failed to get device";
-        return false;
+        qWarning("vario: can't open %s", qPrintable(device));
+        delete m_varioSource;
+        m_varioSource = nullptr;
+        return;
     }
-#endif
 
-    return true;
+    connect(m_varioSource, &NmeaSource::pressureSample, this, &MainWindow::externalPressure);
+    m_varioSource->startUpdates();
 }
 
-bool MainWindow::startGpsSource()
+// Deletes a source that has no positioning methods, e.g. a cached plugin
+// whose hardware is gone
+static QGeoPositionInfoSource *usableSource(QGeoPositionInfoSource *source)
 {
-    m_posSource = QGeoPositionInfoSource::createDefaultSource(this);
-    if (m_posSource == nullptr)
+    if(source != nullptr && !source->supportedPositioningMethods())
     {
-        return false;
+        delete source;
+        return nullptr;
     }
+    return source;
+}
 
-    if(!m_posSource->supportedPositioningMethods())
+bool MainWindow::startGpsSource()
+{
+    // The plugin that worked last time, without trying the others first
+    QSettings settings(m_SettingsFile, QSettings::IniFormat);
+    const QString cached = settings.value("cache/gps").toString();
+    const bool pluginCached = !cached.isEmpty() && cached != NMEA_CACHE_NAME;
+    if(pluginCached)
+        m_posSource = usableSource(QGeoPositionInfoSource::createSource(cached, this));
+    if (m_posSource == nullptr)
+        m_posSource = usableSource(QGeoPositionInfoSource::createDefaultSource(this));
+    if (m_posSource == nullptr)
     {
-        m_posSource = nullptr;
+        if(pluginCached)
+            settings.remove("cache/gps");
         return false;
     }
+    settings.setValue("cache/gps", m_posSource->sourceName());
 
     m_posSource->setPreferredPositioningMethods(QGeoPositionInfoSource::AllPositioningMethods);
     m_posSource->setUpdateInterval(0);
@@ -224,8 +475,79 @@ bool MainWindow::startGpsSource()
 
 void MainWindow::loadSensors()
 {
+    // Also called on availableSensorsChanged
+    if(m_sensor || !m_sensorCandidates.isEmpty())
+        return;
+
+    // The barometer that worked last time, then the default one, then the
+    // others; a synthetic barometer, when enabled, is the default and wins
+    QSettings settings(m_SettingsFile, QSettings::IniFormat);
+    const QByteArray cached = settings.value("cache/sensor").toByteArray();
+    const QByteArray preferred = QSensor::defaultSensorForType(QPressureSensor::type);
+    const QList<QByteArray> available = QSensor::sensorsForType(QPressureSensor::type);
+
+    if(preferred != SYNTHETIC_IDENTIFIER && available.contains(cached))
+        m_sensorCandidates << cached;
+    if(!preferred.isEmpty() && !m_sensorCandidates.contains(preferred))
+        m_sensorCandidates << preferred;
+    foreach (const QByteArray &identifier, available)
+    {
+        if(!m_sensorCandidates.contains(identifier))
+            m_sensorCandidates << identifier;
+    }
+
+    if(m_sensorCandidates.isEmpty())
+        scanSensors();
+    else
+        tryNextSensor();
+}
+
+void MainWindow::tryNextSensor()
+{
+    // One backend per turn of the event loop, so a slow one doesn't freeze the UI
+    const QByteArray identifier = m_sensorCandidates.takeFirst();
+    m_sensor = new QPressureSensor(this);
+    connect(m_sensor, SIGNAL(readingChanged()), this, SLOT(sensor_changed()));
+    m_sensor->setIdentifier(identifier);
+    if(m_sensor->connectToBackend() && m_sensor->start())
+    {
+        // Kept only once a reading arrives, see sensor_changed; filters and
+        // beeper start with that first sample, see startPressure
+        sensorTimer->start();
+        ui->label_vario->setText("<span style='font-size:18pt; font-weight:600;color:#00cccc;'>Pressure sensor:</span><br />"
+                                 + identifier + " started succesfully.<br />");
+        return;
+    }
+
+    qDebug() << "Can't start pressure sensor" << identifier;
+    skipSensor();
+}
+
+void MainWindow::sensorTimedOut()
+{
+    // Started but silent: don't pick it first next time either
+    qDebug() << "No reading from pressure sensor" << m_sensor->identifier();
+    QSettings settings(m_SettingsFile, QSettings::IniFormat);
+    if(settings.value("cache/sensor").toByteArray() == m_sensor->identifier())
+        settings.remove("cache/sensor");
+    m_sensor->stop();
+    skipSensor();
+}
+
+void MainWindow::skipSensor()
+{
+    delete m_sensor;
+    m_sensor = nullptr;
+    if(m_sensorCandidates.isEmpty())
+        scanSensors();
+    else
+        QTimer::singleShot(0, this, SLOT(tryNextSensor()));
+}
+
+void MainWindow::scanSensors()
+{
+    // No barometer: list what there is, connecting to each backend
     QString status;
-    bool found = false;
     status.append("<span style='font-size:18pt; font-weight:600;color:#00cccc;'>Available sensors:</span><br />");
 
     int count = 1;
@@ -240,104 +562,184 @@ void MainWindow::loadSensors()
                 continue;
             }
 
-            QString sensor_type = type;
-            status.append(QString::number(count) + " - " + sensor_type + "<br />");
-            if(sensor_type.contains("Pressure"))
-            {
-                m_sensorPressureValid = true;
-
-                varioBeep = new VarioBeep(750.0, static_cast<int>(DURATION_MS * 1000), this);
-                varioBeep->setVolume(100);
-
-                m_sensor = new QPressureSensor(this);
-                connect(m_sensor, SIGNAL(readingChanged()), this, SLOT(sensor_changed()));
-                m_sensor->setIdentifier(identifier);
-                if (!m_sensor->connectToBackend()) {
-                    status.append("Can't connect to Backend sensor: " + sensor_type + "<br />");
-                    delete m_sensor;
-                    m_sensor = nullptr;
-                    return;
-                }
-                found = true;
-                if(m_sensor->start())
-                {
-                    status.append(sensor_type + " started succesfully.<br />");
-                    start = QDateTime::currentDateTime();
-                    pressure_filter = new KalmanFilter(KF_VAR_ACCEL);
-                    pressure_filter->Reset(pressure);
-                    altitude_filter = new KalmanFilter(KF_VAR_ACCEL);
-                    altitude_filter->Reset(altitude);
-                }
-            }
+            status.append(QString::number(count) + " - " + QString(type) + "<br />");
             count++;
         }
     }
-    if(!found)
-        status.append("Pressure sensor could not found.\n");
+    status.append("Pressure sensor could not found.\n");
 
     ui->label_vario->setText(status);
 }
 
 void MainWindow::showEvent(QShowEvent *event)
 {
-    // Once we're visible, load the sensors
+    // Once we're visible, load the sensors and the rest
     // (don't delay showing the UI while we load plugins, connect to backends, etc.)
-    QTimer::singleShot(0, this, SLOT(loadSensors()));
+    if(!m_sourcesStarted)
+    {
+        m_sourcesStarted = true;
+        QTimer::singleShot(0, this, SLOT(startSources()));
+    }
     QWidget::showEvent(event);
 }
 
+void MainWindow::paintEvent(QPaintEvent *event)
+{
+    if(!m_firstFrame)
+    {
+        m_firstFrame = true;
+        const qint64 ms = (Metrics::now() - m_startupTime) / 1000000;
+        firstFrameTime.set(ms);
+        qDebug() << "First frame after" << ms << "ms";
+    }
+    QMainWindow::paintEvent(event);
+}
+
 void MainWindow::sensor_changed()
 {
-    end = QDateTime::currentDateTime();
     pressure_reading = m_sensor->reading();
-    dt = start.msecsTo(end) / 1000.;
-
-    if(pressure_reading != nullptr)
+    if(pressure_reading == nullptr)
     {
-        pressure = pressure_reading->pressure();
-        temperature = pressure_reading->temperature();
-        //(pressure, KF_VAR_MEASUREMENT, millisecondsDiff);
+        text_presssure = "\nSensor: UNAVAILABLE";
+        return;
+    }
+    if(sensorTimer->isActive())
+    {
+        // First reading: this is the barometer, remember it for next time
+        sensorTimer->stop();
+        m_sensorCandidates.clear();
+        QSettings settings(m_SettingsFile, QSettings::IniFormat);
+        settings.setValue("cache/sensor", m_sensor->identifier());
+    }
+    pressureSample(PRESSURE_SOURCE_INTERNAL, pressure_reading->pressure(), pressure_reading->temperature());
+}
 
-        pressure_filter->Update(pressure,KF_VAR_MEASUREMENT,dt);
-        pressure = pressure_filter->GetXAbs();
+void MainWindow::externalPressure(double samplePressure, double sampleTemperature)
+{
+    pressureSample(PRESSURE_SOURCE_EXTERNAL, samplePressure, sampleTemperature);
+}
 
-        auto ratioPS = static_cast<float>(pressure / sealevel);
+void MainWindow::pressureSample(int source, double samplePressure, double sampleTemperature)
+{
+    TRACE_SCOPE("sensor");
+    const QDateTime now = QDateTime::currentDateTime();
+    double selected;
+    if(!pressureSelector.add(source, now.toMSecsSinceEpoch(), samplePressure, selected))
+        return;
+    if(!pressure_filter)
+        startPressure(selected);
 
-        baroaltitude = 44330.0 * (1.0 - static_cast<qreal>(powf(static_cast<float>(ratioPS), static_cast<float>(0.19f))));
-        altitude_filter->Update(baroaltitude, KF_VAR_MEASUREMENT, dt);
-        altitude = altitude_filter->GetXAbs();
-        vario = altitude_filter->GetXVel();
-        if(varioBeep)
-            varioBeep->SetVario(vario);
+    end = now;
+    dt = start.msecsTo(end) / 1000.;
 
-        fillVario();
+    sensorSamples.add();
+    sensorInterval.record(start.msecsTo(end) * 1000000);
+    if(start.msecsTo(end) > SENSOR_GAP_MS)
+        sensorGaps.add();
+
+    pressure = selected;
+    if(!qIsNaN(sampleTemperature))
+        temperature = sampleTemperature;
+
+    {
+        MetricScope filterScope(filterTime);
+        {
+            TRACE_SCOPE("filter.pressure");
+            pressure_filter->Update(pressure,KF_VAR_MEASUREMENT,dt);
+            pressure = pressure_filter->GetXAbs();
+        }
+        {
+            TRACE_SCOPE("altitude");
+            baroaltitude = PressureToAltitude(pressure, sealevel);
+        }
+        {
+            TRACE_SCOPE("filter.altitude");
+            altitude_filter->Update(baroaltitude, KF_VAR_MEASUREMENT, dt);
+        }
     }
-    else
+    // Standard atmosphere altitude corrected by the QNH offset learnt from GPS
+    altitude = altitude_filter->GetXAbs() + altitude_fusion.GetOffset();
+    vario = altitude_filter->GetXVel();
+    climbStats.update(end.toMSecsSinceEpoch(), vario, altitude, dt, circlingDetector.isCircling());
+    altitudeHistory.append(end.toMSecsSinceEpoch(), altitude);
+    varioHistory.append(end.toMSecsSinceEpoch(), vario);
+    if(varioBeep)
     {
-        text_presssure = "\nSensor: UNAVAILABLE";
+        TRACE_SCOPE("beep.vario");
+        // TODO: the audio curve follows the instantaneous vario only; pass it
+        // climbStats.current() and maxClimb() so the tone can use the averages
+        varioBeep->SetVario(vario);
     }
+
+    FlightState &state = flightState.beginWrite();
+    state.varioTime = end.toMSecsSinceEpoch();
+    state.vario = vario;
+    state.altitude = altitude;
+    state.varioUpdates++;
+    flightState.endWrite();
     oldaltitude = altitude;
     start = end;
 }
 
-void MainWindow::fillVario()
+void MainWindow::startPressure(double firstPressure)
 {
+    // Whichever pressure source speaks first, internal or external
+    m_sensorPressureValid = true;
+    const qint64 ms = (Metrics::now() - m_startupTime) / 1000000;
+    firstVarioTime.set(ms);
+    qDebug() << "First vario reading after" << ms << "ms";
+    if(!varioBeep)
+    {
+        varioBeep = new VarioBeep(750.0, static_cast<int>(DURATION_MS * 1000), this);
+        varioBeep->setVolume(100);
+        if(m_running)
+            varioBeep->startBeep();
+    }
+
+    start = QDateTime::currentDateTime();
+    pressure_filter = new KalmanFilter(KF_VAR_ACCEL);
+    pressure_filter->Reset(firstPressure);
+    altitude_filter = new KalmanFilter(KF_VAR_ACCEL);
+    altitude_filter->Reset(PressureToAltitude(firstPressure, sealevel));
+}
+
+void MainWindow::fillVario(const FlightState &state)
+{
+    if(instrumentPanel)
+    {
+        instrumentPanel->setVario(state.vario);
+        return;
+    }
+
     ui->label_vario->setText(
                 "<span style='font-size:110pt; font-weight:600; color:#FFDD33;'>"
-                + QString::number(vario, 'f', 1) +"</span>"
-                + "<span style='font-size:36pt; font-weight:600; color:#00cccc;'> m/s</span>"
+                + QString::number(state.vario, 'f', 1) +"</span>"
+                + "<span style='font-size:36pt; font-weight:600; color:#00cccc;'> m/s</span><br />"
+                + "<span style='font-size:24pt; font-weight:600; color:#F2EDED;'>10s "
+                + QString::number(climbStats.average10(), 'f', 1) + "  30s "
+                + QString::number(climbStats.average30(), 'f', 1)
+                + (climbStats.inThermal() ? "  Thermal " + QString::number(climbStats.thermalAverage(), 'f', 1)
+                   + " / +" + QString::number(climbStats.thermalGain(), 'f', 0) + " m" : QString())
+                + "</span>"
                 );
 
 }
 
-void MainWindow::fillAltitude()
+void MainWindow::fillAltitude(const FlightState &state)
 {
+    if(instrumentPanel)
+    {
+        instrumentPanel->setSpeed(state.speed);
+        instrumentPanel->setAltitude(state.altitude);
+        return;
+    }
+
     ui->label_altitude->setText(
                 "<span style='font-size:70pt; font-weight:600; color:#F78181;'>"
-                + QString::number(speed, 'f', 1) +"</span>"
+                + QString::number(state.speed, 'f', 1) +"</span>"
                 + "<span style='font-size:36pt; font-weight:600; color:#00cccc;'> km/h</span><br />"
                 + "<span style='font-size:70pt; font-weight:600; color:#F78181;'>"
-                + QString::number(altitude, 'f', 1) +"</span>"
+                + QString::number(state.altitude, 'f', 1) +"</span>"
                 + "<span style='font-size:36pt; font-weight:600; color:#00cccc;'> m</span>"
                 );
 
@@ -370,7 +772,9 @@ void MainWindow::satellitesInUseUpdated(const QList<QGeoSatelliteInfo> &satellit
     status.append("<span style='font-size:18pt; font-weight:600;color:#00cccc;'>Satellites In Use:</span><br />");
     status.append(satellitesToString(satellites));
 
-    ui->label_gps->setText(status);
+    flightState.beginWrite().satellitesInUse = satellites.size();
+    flightState.endWrite();
+    setGpsText(status);
 }
 
 void MainWindow::satellitesInViewUpdated(const QList<QGeoSatelliteInfo> &satellites)
@@ -384,14 +788,18 @@ void MainWindow::satellitesInViewUpdated(const QList<QGeoSatelliteInfo> &satelli
     status.append("<span style='font-size:18pt; font-weight:600;color:#00cccc;'>Satellites In View:</span><br />");
     status.append(satellitesToString(satellites));
 
-    ui->label_gps->setText(status);
+    flightState.beginWrite().satellitesInView = satellites.size();
+    flightState.endWrite();
+    setGpsText(status);
 }
 
 void MainWindow::positionUpdated(QGeoPositionInfo gpsPos)
 {
     if (!gpsPos.isValid() || !gpsPos.coordinate().isValid())
         return;
+    TRACE_SCOPE("gps");
 
+    auto previousFix = m_gpsPos.timestamp();
     m_gpsPos = gpsPos;
     m_coord = gpsPos.coordinate();
 
@@ -399,13 +807,20 @@ void MainWindow::positionUpdated(QGeoPositionInfo gpsPos)
     {
         m_startCoord = m_coord;
         m_start = true;
+        xcScore.reset();
+        trackSimplifier.reset();
     }
 
     if(m_start)
     {
         distance = m_coord.distanceTo(m_startCoord) / 1000;
+        xcScore.addFix(m_coord);
     }
 
+    const XcResult &score = xcScore.best();
+    const char *scoreType = &score == &xcScore.faiTriangle() ? "FAI"
+                          : &score == &xcScore.flatTriangle() ? "triangle" : "free";
+
     auto m_latitude = m_coord.latitude();
     auto m_longitude = m_coord.longitude();
     //if (m_coord.type() == QGeoCoordinate::Coordinate3D)
@@ -431,11 +846,99 @@ void MainWindow::positionUpdated(QGeoPositionInfo gpsPos)
     if(IsNan(static_cast<float>(m_magneticVariation))) m_magneticVariation = 0;
 
     auto timestamp = gpsPos.timestamp();
+
+    // Back to gps altitude and vario while no pressure source is talking
+    m_sensorPressureValid = pressure_filter && pressureSelector.active() >= 0
+            && pressureSelector.isAlive(pressureSelector.active(), QDateTime::currentMSecsSinceEpoch());
+
+    QString qnhText;
+    if(m_sensorPressureValid && m_coord.type() == QGeoCoordinate::Coordinate3D)
+    {
+        auto fixDt = previousFix.isValid() ? previousFix.msecsTo(timestamp) / 1000. : 0.;
+        altitude_fusion.Update(m_altitude, altitude_filter->GetXAbs(), m_verticalAccuracy, fixDt);
+        if(altitude_fusion.IsConverged())
+            qnhText = "<span style='font-size:18pt; font-weight:600; color:#F2EDED;'>QNH: "
+                    + QString::number(altitude_fusion.GetQnh(pressure, altitude_filter->GetXAbs()) / 100, 'f', 1)
+                    + " hPa</span><br />";
+    }
+
+    if(circlingDetector.update(timestamp.toMSecsSinceEpoch(), m_direction, m_latitude, m_longitude, altitude, vario))
+    {
+        thermalStore->add(circlingDetector.thermal());
+        thermalStore->save();
+    }
+
+    QString windText;
+    if(gpsPos.hasAttribute(QGeoPositionInfo::Direction) && gpsPos.hasAttribute(QGeoPositionInfo::GroundSpeed))
+        windEstimator.update(timestamp.toMSecsSinceEpoch(), m_groundSpeed / 3.6, m_direction,
+                             circlingDetector.isCircling());
+    if(windEstimator.confidence() >= WIND_MIN_CONFIDENCE)
+        windText = "<span style='font-size:18pt; font-weight:600; color:#F2EDED;'>Wind: "
+                + QString::number(windEstimator.speed() * 3.6, 'f', 0) + " km/h from "
+                + QString::number(windEstimator.direction(), 'f', 0) + QObject::tr(" °") + "</span><br />";
+
+    QString groundText;
+    double ground = 0;
+    if(terrain->elevation(m_latitude, m_longitude, ground))
+        groundText = "<span style='font-size:18pt; font-weight:600; color:#F2EDED;'>Height: "
+                + QString::number(altitude - ground, 'f', 0) + " m AGL</span><br />";
+    terrain->prefetch(m_latitude, m_longitude, m_direction);
+
+    // Inside wins over above/below, which wins over nearby; then the closest
+    QString airspaceText;
+    const AirspaceHit *warning = nullptr;
+    auto rank = [](const AirspaceHit &hit) { return hit.inside ? (hit.clearance <= 0 ? 0 : 1) : 2; };
+    airspaces.query(m_latitude, m_longitude, altitude, ground, AIRSPACE_WARNING_DISTANCE, airspaceHits);
+    for (const AirspaceHit &hit : airspaceHits)
+    {
+        if(hit.clearance > AIRSPACE_WARNING_CLEARANCE)
+            continue;
+        if(!warning || rank(hit) < rank(*warning)
+                || (rank(hit) == rank(*warning) && hit.distance < warning->distance))
+            warning = &hit;
+    }
+    if(warning)
+    {
+        const Airspace &airspace = airspaces.at(warning->index);
+        airspaceText = "<span style='font-size:18pt; font-weight:600; color:#FF6060;'>"
+                + airspace.type + " " + airspace.name + ": "
+                + (warning->inside && warning->clearance <= 0 ? QString("inside")
+                   : warning->inside ? QString::number(warning->clearance, 'f', 0) + " m vertical"
+                   : QString::number(warning->distance / 1000, 'f', 1) + " km")
+                + "</span><br />";
+    }
+
+    QString taskText;
+    if(task.isValid())
+    {
+        task.update(m_latitude, m_longitude);
+        taskText = "<span style='font-size:18pt; font-weight:600; color:#F2EDED;'>Task: "
+                + (task.isFinished() ? QString("goal")
+                   : task.next().waypoint.name + " " + QString::number(task.distanceToNext() / 1000, 'f', 1) + " km")
+                + ", " + QString::number(task.progress() * 100, 'f', 0) + " %</span><br />";
+    }
+
+    QString thermalText;
+    double thermalKm;
+    int thermalIndex = thermalStore->nearest(m_latitude, m_longitude, 10, &thermalKm);
+    if(thermalIndex >= 0)
+        thermalText = "<span style='font-size:18pt; font-weight:600; color:#F2EDED;'>Thermal: "
+                + QString::number(thermalKm, 'f', 1) + " km, "
+                + QString::number(thermalStore->at(thermalIndex).climb, 'f', 1) + " m/s</span><br />";
+
+    IgcFix fix;
+    fix.time = timestamp.toUTC().time().msecsSinceStartOfDay() / 1000;
+    fix.latitude = m_latitude;
+    fix.longitude = m_longitude;
+    fix.pressureAltitude = static_cast<int>(altitude);
+    fix.gpsAltitude = static_cast<int>(m_altitude);
+    fix.valid = m_coord.type() == QGeoCoordinate::Coordinate3D;
+
     auto local = timestamp.toLocalTime();
     auto dateTimeString = local.toString("hh : mm : ss");
     text_igc_name = "VarioLog_" + local.toString("dd_MM_yyyy__hh_mm_ss") + ".igc";
 
-    ui->label_gps->setText(
+    QString gpsText(
                 "<br /><span style='font-size:32pt; font-weight:600;color:#00cccc;'>"
                 + dateTimeString + "</span>" + "<br />"
                 + "<span style='font-size:18pt; font-weight:600; color:#F2EDED;'>Altitude: "
@@ -444,26 +947,106 @@ void MainWindow::positionUpdated(QGeoPositionInfo gpsPos)
                 + QString::number(m_direction, 'f', 0) + QObject::tr(" °") + "</span>" + "<br />"
                 + "<span style='font-size:18pt; font-weight:600; color:#F2EDED;'>Distance: "
                 + QString::number(distance, 'f', 1) + " km</span>" + "<br />"
+                + "<span style='font-size:18pt; font-weight:600; color:#F2EDED;'>Score: "
+                + QString::number(score.score, 'f', 1) + " pts " + scoreType + "</span>" + "<br />"
                 + "<span style='font-size:18pt; font-weight:600; color:#FFC0C0;'>"
                 + QString("Latitude: %1").arg(m_latitude) + "</span>" + "<br />"
                 + "<span style='font-size:18pt; font-weight:600; color:#FFC0C0;'>"
                 + QString("Longitude: %1").arg(m_longitude) + "</span>" + "<br />"
+                + qnhText
+                + groundText
+                + windText
+                + taskText
+                + airspaceText
+                + thermalText
                 );
+    setGpsText(gpsText);
 
     if(!m_sensorPressureValid)
     {
         altitude = m_altitude;
         vario = m_verticalSpeed;
-        fillVario();
+        if(previousFix.isValid())
+            climbStats.update(timestamp.toMSecsSinceEpoch(), vario, altitude,
+                              previousFix.msecsTo(timestamp) / 1000., circlingDetector.isCircling());
+        altitudeHistory.append(timestamp.toMSecsSinceEpoch(), altitude);
+        varioHistory.append(timestamp.toMSecsSinceEpoch(), vario);
+    }
+
+    FlightState &state = flightState.beginWrite();
+    if(!m_sensorPressureValid)
+    {
+        state.varioTime = timestamp.toMSecsSinceEpoch();
+        state.vario = vario;
+        state.altitude = altitude;
+        state.varioUpdates++;
+    }
+    state.gpsTime = timestamp.toMSecsSinceEpoch();
+    state.latitude = m_latitude;
+    state.longitude = m_longitude;
+    state.gpsAltitude = m_altitude;
+    state.speed = speed;
+    state.heading = m_direction;
+    state.gpsUpdates++;
+    flightState.endWrite();
+
+    // In GPS-only mode the altitude above was only settled after the fix was built
+    fix.pressureAltitude = static_cast<int>(altitude);
+    trackSimplifier.add(fix);
+    updateIGC(fix);
+
+    trackingClient->addFix(gpsPos);
+}
+
+void MainWindow::setGpsText(const QString &text)
+{
+    // Shown by the next UI tick
+    m_gpsText = text;
+    m_gpsTextChanged = true;
+}
+
+void MainWindow::uiTick()
+{
+    TRACE_SCOPE("ui.tick");
+    MetricScope metricScope(uiFrameTime);
+    const FlightState state = flightState.read();
+
+    if(state.varioUpdates != m_shownState.varioUpdates)
+        fillVario(state);
+    if(state.varioUpdates != m_shownState.varioUpdates || state.gpsUpdates != m_shownState.gpsUpdates)
+        fillAltitude(state);
+
+    if(m_gpsTextChanged)
+    {
+        if(instrumentPanel)
+            instrumentPanel->setGpsHtml(m_gpsText);
+        else
+            ui->label_gps->setText(m_gpsText);
+        m_gpsTextChanged = false;
     }
 
-    fillAltitude();
-    updateIGC();
+    // The graph moves by a pixel every second or so, no need to follow the frame rate
+    if(historyGraph && state.varioTime / 1000 != m_shownState.varioTime / 1000)
+        historyGraph->update();
+
+    m_shownState = state;
 }
 
 void MainWindow::updateTimeout(void)
 {
     qDebug() << "updateTimeout";
+    // Also the end of an nmea/replay log
+    writeTrace();
+}
+
+void MainWindow::writeTrace()
+{
+    if(m_traceFile.isEmpty())
+        return;
+    if(Trace::writeChromeJson(m_traceFile))
+        qDebug() << "trace written to" << m_traceFile;
+    else
+        qDebug() << "- Error, unable to write trace" << m_traceFile;
 }
 
 void MainWindow::errorChanged(QGeoPositionInfoSource::Error err)
@@ -478,8 +1061,10 @@ void MainWindow::setInterval(int msec)
 }
 
 //gps
-void MainWindow::updateIGC()
+void MainWindow::updateIGC(const IgcFix &fix)
 {
+    TRACE_SCOPE("igc");
+    MetricScope metricScope(igcWriteTime);
     if(!createIgcFile)
     {
         QDir dir;
@@ -492,36 +1077,28 @@ void MainWindow::updateIGC()
         createIgcHeader();
         createIgcFile = true;
     }
-    else
+    else if(igcFile->isOpen())
     {
-        QDateTime timestamp = m_gpsPos.timestamp();
-        //QDateTime local = timestamp.toLocalTime();
-        QString dateTimeString = timestamp.toString("hhmmss");
-
-        igcFile->open(QIODevice::Append | QIODevice::Text);
-
-        if(!igcFile->isOpen()){
-            qDebug() << "- Error, unable to open" << "outputFilename" << "for output";
-        }
-
-        QTextStream out(igcFile);
-        QString str;
-
         //B,110135,5206343N,00006198W,A,00587,00558
+        char record[IGC_MAX_LINE];
+        int length = formatBRecord(fix, record);
+        // VAT extension declared in the I record: climb over the last second, cm/s
+        length += formatSignedField(qRound(climbStats.current() * 100), 4, record + length);
+        record[length++] = '\n';
+
+        const int altitude = fix.pressureAltitude != 0 ? fix.pressureAltitude : fix.gpsAltitude;
+        if(m_flight.takeoff < 0)
+        {
+            m_flight.takeoff = fix.time;
+            m_flight.maxAltitude = altitude;
+        }
+        // Time of day wraps at midnight UTC
+        m_flight.duration = (fix.time - m_flight.takeoff + 86400) % 86400;
+        m_flight.maxAltitude = qMax(m_flight.maxAltitude, altitude);
 
-        QString record  = "B";
-
-        record.append(dateTimeString);
-        record.append(decimalToDDDMMMMMLat(m_coord.latitude()));
-        record.append(decimalToDDDMMMMMLon(m_coord.longitude()));
-        record.append("A");
-        str.sprintf("%05d",static_cast<int>(m_coord.altitude()));
-        record.append(str);
-        str.sprintf("%05d",static_cast<int>(altitude));
-        record.append(str);
-        out << record << endl;
-
-        igcFile->close();
+        // Kept open for the flight; flushed per fix so a crash loses at most one
+        igcFile->write(record, length);
+        igcFile->flush();
     }
 }
 
@@ -543,58 +1120,51 @@ void MainWindow::createIgcHeader()
     QString dateString = timestamp.toString("ddMMyy");
     loadSettings();
 
+    m_flight.fileName = QFileInfo(igcFile->fileName()).fileName();
+    m_flight.modified = 0;
+    m_flight.date = timestamp.date();
+    m_flight.takeoff = -1;
+    m_flight.duration = 0;
+    m_flight.maxAltitude = 0;
+    m_flight.distance = 0;
+    m_flight.score = 0;
+    m_flight.uploadStatus = LogbookEntry::NotUploaded;
+
     QString header  = "AXGD000 XcVario v1.0\n";
     header.append("HFDTE" + dateString + "\n");
     header.append("HOPLTPILOT:" + user + "\n");
     header.append("HOGTYGLIDERTYPE:" + QString("Coden Pro") + "\n");
     header.append("HODTM100GPSDATUM: WGS-84\n");
     header.append("HOCCLCOMPETITION CLASS:" + QString("CCC") + "\n");
-    header.append("HFFTYFRTYPE: XcVario by Türkay Biliyor");
+    header.append("HFFTYFRTYPE: XcVario by Türkay Biliyor\n");
+    header.append("I013639VAT");
     out << header << endl;
-    igcFile->close();
     createIgcFile = true;
 }
 
-QString MainWindow::decimalToDDDMMMMMLat(double angle)
+void MainWindow::closeFlight()
 {
-    QString output, strdegree, strminutes, hemisphere;
-
-    if (angle < 0) {
-        angle = -1 * angle;
-        hemisphere = "S";
-    } else {
-        hemisphere = "N";
-    }
-
-    auto degree = static_cast<int>(angle);
-    auto minutes = (angle - degree) * static_cast<qreal>(60.0f);
-    strdegree.sprintf("%02d",static_cast<int>(degree));
-    strminutes.sprintf("%2.3f",minutes);
-    output = strdegree + strminutes.remove(".") + hemisphere;
-
-    //int seconds = (int)(angle - (float)degree - (float)minutes/60.f) * 60.f * 60.f); // ignore this line if you don't need seconds
-    return output;
-}
-
-QString MainWindow::decimalToDDDMMMMMLon(double angle)
-{
-    QString output, strdegree, strminutes, hemisphere;
-
-    if (angle < 0) {
-        angle = -1 * angle;
-        hemisphere = "W";
-    } else {
-        hemisphere = "E";
-    }
-
-    auto degree =static_cast<int>(angle);
-    double minutes = (angle - degree) * static_cast<qreal>(60.f);
-    strdegree.sprintf("%03d",static_cast<int>(degree));
-    strminutes.sprintf("%2.3f",minutes);
-    output = strdegree + strminutes.remove(".") + hemisphere;
+    if(igcFile == nullptr || !igcFile->isOpen())
+        return;
 
-    //int seconds = (int)(angle - (float)degree - (float)minutes/60.f) * 60.f * 60.f); // ignore this line if you don't need seconds
-    return output;
+    igcFile->close();
+    trackSimplifier.flush();
+    qDebug() << "Track:" << trackSimplifier.inputCount() << "fixes," << trackSimplifier.track().size() << "kept";
+
+    // From what was logged, so the file isn't read back on the UI thread
+    const QFileInfo info(igcFile->fileName());
+    m_flight.modified = info.lastModified().toMSecsSinceEpoch();
+    if(!m_flight.date.isValid())
+        m_flight.date = info.lastModified().toUTC().date();
+    if(m_flight.takeoff < 0)
+        m_flight.takeoff = 0;
+    m_flight.distance = xcScore.best().distance;
+    m_flight.score = xcScore.best().score;
+    logbook->addFlight(m_flight);
+    delete igcFile;
+    igcFile = nullptr;
+    // The next start begins a new flight
+    createIgcFile = false;
 }
 
 void MainWindow::on_buttonStart_clicked()
@@ -609,6 +1179,11 @@ void MainWindow::on_buttonStart_clicked()
         else if(m_nmeaSource != nullptr)
             m_nmeaSource->stopUpdates();
 
+        trackingClient->stop();
+
+        closeFlight();
+        writeTrace();
+
         ui->buttonStart->setText("Start");
         vario = 0;
         altitude = 0;
@@ -617,6 +1192,10 @@ void MainWindow::on_buttonStart_clicked()
     }
     else
     {
+        // A new flight: the first fix sets the start point and clears the score
+        m_start = false;
+        distance = 0;
+
         if(m_posSource != nullptr)
             m_posSource->startUpdates();
         else if(m_nmeaSource != nullptr)
@@ -628,6 +1207,8 @@ void MainWindow::on_buttonStart_clicked()
             varioBeep->startBeep();
         }
 
+        trackingClient->start();
+
         ui->buttonStart->setText("Stop");
         m_running = true;
     }
@@ -679,9 +1260,7 @@ void MainWindow::responseResult(const QString &result)
 {
     if(result.contains("This is not a valid .igc file"))
     {
-        QFile igcFile(igcFileName);
-        igcFile.remove();
-        ui->label_gps->setText("This is not a valid .igc file\nFile deleted." );
+        ui->label_gps->setText("This is not a valid .igc file" );
     }
     else
     {
@@ -700,10 +1279,9 @@ void MainWindow::slotAcceptUserLogin(QString &user, QString &pass)
 
     saveSettings();
 
-    auto fileName = QFileDialog::getOpenFileName(this, tr("Open Igc"), path, tr("Igc Files (*.igc)"));
-    QFile igcFile(fileName);
-    if(networkmanager)
-        networkmanager->sendRequest(user, pass, igcFile);
+    auto fileName = chooseFlight();
+    if(QFile::exists(fileName))
+        queueFlight(fileName);
 }
 
 void MainWindow::on_gpsLabel_linkActivated(const QString & link)
@@ -735,8 +1313,6 @@ void MainWindow::on_buttonFile_clicked()
 
     ui->label_gps->setText("-");
 
-    m_SettingsFile = path + "settings.ini";
-
     if (QFile(m_SettingsFile).exists())
     {
         loadSettings();
@@ -748,11 +1324,69 @@ void MainWindow::on_buttonFile_clicked()
         return;
     }
 
-    igcFileName = QFileDialog::getOpenFileName(this, tr("Open Igc"), path, tr("Igc Files (*.igc)"));
-    QFile igcFile(igcFileName);
-    if(networkmanager && igcFile.exists())
+    igcFileName = chooseFlight();
+    if(QFile::exists(igcFileName))
+        queueFlight(igcFileName);
+}
+
+QString MainWindow::chooseFlight()
+{
+    // Newest first from the logbook, without reading any igc file
+    static const char *statusText[] = { "", ", queued", ", uploaded", ", rejected" };
+    const QVector<int> flights = logbook->filter();
+    // Numbered, so two flights with the same summary are still told apart
+    QStringList items;
+    for (int index : flights)
     {
-        ui->label_gps->setText("Sending igc file...");
-        networkmanager->sendRequest(user, pass, igcFile);
+        const LogbookEntry &entry = logbook->at(index);
+        items << QString("%1. %2 %3  %4 h %5 min  %6 m  %7 km%8")
+                 .arg(items.size() + 1)
+                 .arg(entry.date.toString("dd.MM.yyyy"))
+                 .arg(QTime(0, 0).addSecs(entry.takeoff).toString("hh:mm"))
+                 .arg(entry.duration / 3600)
+                 .arg(entry.duration / 60 % 60, 2, 10, QChar('0'))
+                 .arg(entry.maxAltitude)
+                 .arg(entry.distance, 0, 'f', 1)
+                 .arg(statusText[qBound(0, entry.uploadStatus, 3)]);
     }
+    const QString browse = tr("Browse...");
+    items << browse;
+
+    bool ok = false;
+    const QString item = QInputDialog::getItem(this, tr("Open Igc"), tr("Flight"), items, 0, false, &ok);
+    if(!ok)
+        return QString();
+    const int row = items.indexOf(item);
+    if(row < flights.size())
+        return path + logbook->at(flights.at(row)).fileName;
+    return QFileDialog::getOpenFileName(this, tr("Open Igc"), path, tr("Igc Files (*.igc)"));
+}
+
+void MainWindow::queueFlight(const QString &fileName)
+{
+    // Catch invalid files here instead of after a round-trip to the server
+    IgcValidator validator;
+    QString uploadFileName = fileName;
+
+    if(!validator.validate(fileName))
+    {
+        if(!validator.isRepairable())
+        {
+            ui->label_gps->setText("Igc file not sent.<br />" + validator.firstIssue());
+            return;
+        }
+
+        uploadFileName = IgcValidator::repairedFileName(fileName);
+        if(!validator.repair(fileName, uploadFileName))
+        {
+            ui->label_gps->setText("Igc file could not be repaired.<br />" + validator.firstIssue());
+            return;
+        }
+        qDebug() << "igc repaired:" << validator.issueCount() << "issues," << validator.firstIssue();
+    }
+
+    ui->label_gps->setText("Sending igc file...");
+    logbook->setUploadStatus(fileName, LogbookEntry::Queued);
+    uploadQueue->setCredentials(user, pass);
+    uploadQueue->enqueue(uploadFileName);
 }
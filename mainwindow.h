@@ -17,21 +17,47 @@
 #include <QGeoPositionInfoSource>
 #include <QGeoSatelliteInfoSource>
 #include <QGeoSatelliteInfo>
-#include <QNmeaPositionInfoSource>
 #include <QStandardPaths>
 #include <QDateTime>
 #include <QtMath>
 #include <QFile>
 #include <QDir>
 #include <QTimer>
+#include <QTcpSocket>
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QInputDialog>
 #include <QDesktopServices>
 
 #include <QDebug>
 
 #include <networkaccessmanager.h>
+#include <uploadqueue.h>
+#include <trackingclient.h>
+#include <igcvalidator.h>
+#include <nmeasource.h>
+#include <xcscore.h>
+#include <circlingdetector.h>
+#include <thermalstore.h>
+#include <logbook.h>
+#include <windestimator.h>
+#include <airspace.h>
+#include <terrain.h>
+#include <task.h>
+#include <climbstats.h>
+#include <instrumentpanel.h>
+#include <history.h>
+#include <historygraph.h>
+#include <flightstate.h>
+#include <trace.h>
+#include <metrics.h>
+#include <metricsexporter.h>
+#include <tracksimplifier.h>
+#include <pressureselector.h>
+#include <syntheticsensor.h>
 #include <qsensor.h>
 #include <kalmanfilter.h>
+#include <altitudefusion.h>
 #include "variobeep.h"
 #include "logindialog.h"
 
@@ -39,6 +65,11 @@
 #define KF_VAR_MEASUREMENT 0.05
 #define sealevel 101325.0
 #define DURATION_MS 1000
+#define AIRSPACE_WARNING_DISTANCE 2000.0    // m
+#define AIRSPACE_WARNING_CLEARANCE 300.0    // m
+#define SENSOR_GAP_MS 250                   // counted as a gap in the sensor stream
+#define SENSOR_FIRST_READING_MS 3000        // a started sensor with no reading by then is skipped
+#define NMEA_CACHE_NAME "nmea"              // cache/gps value for the nmea source
 
 namespace Ui {
 class MainWindow;
@@ -73,6 +104,9 @@ public:
         }
     }
 
+    // The current flight, simplified to within track/tolerance metres
+    const QVector<IgcFix> &flightTrack() const { return trackSimplifier.track(); }
+
     static void SetTextToLabel(QLabel *label, QString text)
     {
         QFontMetrics metrix(label->font());
@@ -83,27 +117,40 @@ public:
 
 private:
     void showEvent(QShowEvent *event);
+    void paintEvent(QPaintEvent *event);
     bool startNmeaSource();
+    void startVarioSource();
+    void startPressure(double firstPressure);
+    void pressureSample(int source, double samplePressure, double sampleTemperature);
     bool startGpsSource();
     void startSensors();
-    void fillVario();
-    void fillAltitude();
+    void scanSensors();
+    void skipSensor();
+    void fillVario(const FlightState &state);
+    void fillAltitude(const FlightState &state);
+    void setGpsText(const QString &text);
+    void writeTrace();
     void createTables();
-    void updateIGC();
+    void updateIGC(const IgcFix &fix);
     void createIgcHeader();
     void loadSettings();
     void saveSettings();
     void openLoginDialog();
+    void queueFlight(const QString &fileName);
+    QString chooseFlight();
+    void closeFlight();
 
-    QString decimalToDDDMMMMMLat(double angle);
-    QString decimalToDDDMMMMMLon(double angle);   
 
 public slots:
     void positionUpdated(QGeoPositionInfo gpsPos);
     void setInterval(int msec);
     void errorChanged(QGeoPositionInfoSource::Error err);
+    void startSources();
+    void startServices();
     void loadSensors();
+    void tryNextSensor();
     void sensor_changed();
+    void externalPressure(double samplePressure, double sampleTemperature);
     void satellitesInViewUpdated(const QList<QGeoSatelliteInfo> &infos);
     void satellitesInUseUpdated(const QList<QGeoSatelliteInfo> &infos);
     void updateTimeout(void);
@@ -117,23 +164,42 @@ public slots:
     void exitApp();
     void on_buttonFile_clicked();
 
+private slots:
+    void uiTick();
+    void sensorTimedOut();
+
 private:
 
     VarioBeep *varioBeep;
     NetworkAccessManager *networkmanager;
+    UploadQueue *uploadQueue;
+    TrackingClient *trackingClient;
+    ThermalStore *thermalStore;
+    Logbook *logbook;
+    Terrain *terrain;
+    InstrumentPanel *instrumentPanel;
+    HistoryGraph *historyGraph;
+    QTimer *uiTimer;
+    QTimer *sensorTimer;
+    MetricsExporter *metricsExporter;
 
     QGeoPositionInfoSource *m_posSource;
-    QNmeaPositionInfoSource *m_nmeaSource;
+    NmeaSource *m_nmeaSource;
+    NmeaSource *m_varioSource;
     QGeoPositionInfo m_gpsPos;
     QGeoCoordinate m_coord;
     QGeoCoordinate m_startCoord;
 
+    bool m_sourcesStarted;
+    bool m_firstFrame;
+    qint64 m_startupTime;
     bool m_sensorPressureValid;
     bool m_start;
     bool m_running;
     bool createIgcFile;
 
     QPressureSensor *m_sensor;
+    QList<QByteArray> m_sensorCandidates;
     QPressureReading *pressure_reading;
 
     QString m_SettingsFile;
@@ -149,6 +215,23 @@ private:
 
     KalmanFilter *pressure_filter;
     KalmanFilter *altitude_filter;
+    AltitudeFusion altitude_fusion;
+    PressureSelector pressureSelector;
+    XcScore xcScore;
+    TrackSimplifier trackSimplifier;
+    CirclingDetector circlingDetector;
+    WindEstimator windEstimator;
+    AirspaceIndex airspaces;
+    Task task;
+    ClimbStats climbStats;
+    HistoryChannel altitudeHistory;
+    HistoryChannel varioHistory;
+    FlightStatePublisher flightState;
+    FlightState m_shownState;
+    QString m_gpsText;
+    bool m_gpsTextChanged;
+    QString m_traceFile;
+    QVector<AirspaceHit> airspaceHits;
 
     qreal distance;
     qreal dt;
@@ -161,6 +244,7 @@ private:
     qreal oldaltitude;
 
     QFile * igcFile;
+    LogbookEntry m_flight;      // the flight being logged, summarized as it goes
 
 private:
     Ui::MainWindow *ui;
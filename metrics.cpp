@@ -0,0 +1,240 @@
+#include "metrics.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QMutex>
+#include <QSaveFile>
+#include <QtAlgorithms>
+#include <QtMath>
+#include <atomic>
+
+struct MetricsShard
+{
+    std::atomic<quint64> counters[METRICS_MAX_COUNTERS];
+    std::atomic<quint64> buckets[METRICS_MAX_HISTOGRAMS][METRICS_HISTOGRAM_BUCKETS];
+    std::atomic<quint64> counts[METRICS_MAX_HISTOGRAMS];
+    std::atomic<qint64> sums[METRICS_MAX_HISTOGRAMS];
+    std::atomic<qint64> maxima[METRICS_MAX_HISTOGRAMS];
+};
+
+struct MetricsRegistry
+{
+    QMutex mutex;
+    QVector<const char *> counters;
+    QVector<const char *> gauges;
+    QVector<const char *> histograms;
+    std::atomic<qint64> gaugeValues[METRICS_MAX_GAUGES];
+    // Shards outlive their threads so nothing counted is lost
+    QList<MetricsShard *> shards;
+};
+
+static MetricsRegistry &registry()
+{
+    static MetricsRegistry instance;
+    return instance;
+}
+
+static thread_local MetricsShard *threadShard = nullptr;
+
+static MetricsShard *shard()
+{
+    if(!threadShard)
+    {
+        threadShard = new MetricsShard();
+        MetricsRegistry &metrics = registry();
+        QMutexLocker locker(&metrics.mutex);
+        metrics.shards.append(threadShard);
+    }
+    return threadShard;
+}
+
+static int registerName(QVector<const char *> &names, const char *name, int maximum)
+{
+    QMutexLocker locker(&registry().mutex);
+    Q_ASSERT_X(names.size() < maximum, "Metrics", name);
+    if(names.size() >= maximum)
+        return -1;
+    names.append(name);
+    return names.size() - 1;
+}
+
+// Single writer per shard, so no read-modify-write instruction is needed
+static inline void increment(std::atomic<quint64> &value, quint64 count)
+{
+    value.store(value.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+}
+
+MetricCounter::MetricCounter(const char *name)
+    : m_id(registerName(registry().counters, name, METRICS_MAX_COUNTERS))
+{
+}
+
+void MetricCounter::add(quint64 count) const
+{
+    if(m_id >= 0)
+        increment(shard()->counters[m_id], count);
+}
+
+MetricGauge::MetricGauge(const char *name)
+    : m_id(registerName(registry().gauges, name, METRICS_MAX_GAUGES))
+{
+}
+
+void MetricGauge::set(qint64 value) const
+{
+    if(m_id >= 0)
+        registry().gaugeValues[m_id].store(value, std::memory_order_relaxed);
+}
+
+MetricHistogram::MetricHistogram(const char *name)
+    : m_id(registerName(registry().histograms, name, METRICS_MAX_HISTOGRAMS))
+{
+}
+
+void MetricHistogram::record(qint64 value) const
+{
+    if(m_id < 0)
+        return;
+    value = qMax<qint64>(0, value);
+    MetricsShard *local = shard();
+    increment(local->buckets[m_id][Metrics::bucketOf(value)], 1);
+    increment(local->counts[m_id], 1);
+    local->sums[m_id].store(local->sums[m_id].load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    if(value > local->maxima[m_id].load(std::memory_order_relaxed))
+        local->maxima[m_id].store(value, std::memory_order_relaxed);
+}
+
+int Metrics::bucketOf(qint64 value)
+{
+    const quint64 v = static_cast<quint64>(value);
+    if(v < METRICS_SUB_BUCKETS)
+        return static_cast<int>(v);
+    const int shift = 63 - static_cast<int>(qCountLeadingZeroBits(v)) - METRICS_SUB_BUCKET_BITS;
+    if(shift > METRICS_MAX_SHIFT)
+        return METRICS_HISTOGRAM_BUCKETS - 1;
+    return (shift + 1) * METRICS_SUB_BUCKETS + static_cast<int>(v >> shift) - METRICS_SUB_BUCKETS;
+}
+
+qint64 Metrics::bucketUpperBound(int bucket)
+{
+    if(bucket < METRICS_SUB_BUCKETS)
+        return bucket;
+    const int shift = bucket / METRICS_SUB_BUCKETS - 1;
+    const qint64 mantissa = bucket % METRICS_SUB_BUCKETS + METRICS_SUB_BUCKETS;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+qint64 HistogramSnapshot::percentile(double p) const
+{
+    if(count == 0)
+        return 0;
+    const quint64 rank = qMax<quint64>(1, static_cast<quint64>(qCeil(count * qBound(0.0, p, 100.0) / 100)));
+    quint64 seen = 0;
+    for (int i = 0; i < buckets.size(); i++)
+    {
+        seen += buckets.at(i);
+        if(seen >= rank)
+            return qMin(Metrics::bucketUpperBound(i), maximum);
+    }
+    return maximum;
+}
+
+qint64 Metrics::now()
+{
+    static const QElapsedTimer clock = [] {
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+    return clock.nsecsElapsed();
+}
+
+MetricsSnapshot Metrics::snapshot()
+{
+    MetricsRegistry &metrics = registry();
+    QMutexLocker locker(&metrics.mutex);
+
+    MetricsSnapshot snapshot;
+    snapshot.time = QDateTime::currentMSecsSinceEpoch();
+
+    for (int i = 0; i < metrics.counters.size(); i++)
+    {
+        quint64 total = 0;
+        for (const MetricsShard *shard : metrics.shards)
+            total += shard->counters[i].load(std::memory_order_relaxed);
+        snapshot.counters.append(qMakePair(QString::fromLatin1(metrics.counters.at(i)), total));
+    }
+
+    for (int i = 0; i < metrics.gauges.size(); i++)
+        snapshot.gauges.append(qMakePair(QString::fromLatin1(metrics.gauges.at(i)),
+                                         metrics.gaugeValues[i].load(std::memory_order_relaxed)));
+
+    for (int i = 0; i < metrics.histograms.size(); i++)
+    {
+        HistogramSnapshot histogram;
+        histogram.name = QString::fromLatin1(metrics.histograms.at(i));
+        histogram.count = 0;
+        histogram.sum = 0;
+        histogram.maximum = 0;
+        histogram.buckets.fill(0, METRICS_HISTOGRAM_BUCKETS);
+        for (const MetricsShard *shard : metrics.shards)
+        {
+            histogram.count += shard->counts[i].load(std::memory_order_relaxed);
+            histogram.sum += shard->sums[i].load(std::memory_order_relaxed);
+            histogram.maximum = qMax(histogram.maximum, shard->maxima[i].load(std::memory_order_relaxed));
+            for (int j = 0; j < METRICS_HISTOGRAM_BUCKETS; j++)
+                histogram.buckets[j] += shard->buckets[i][j].load(std::memory_order_relaxed);
+        }
+        snapshot.histograms.append(histogram);
+    }
+    return snapshot;
+}
+
+QByteArray MetricsSnapshot::toJson() const
+{
+    QJsonObject counterObject, gaugeObject, histogramObject;
+    for (const auto &counter : counters)
+        counterObject.insert(counter.first, static_cast<double>(counter.second));
+    for (const auto &gauge : gauges)
+        gaugeObject.insert(gauge.first, static_cast<double>(gauge.second));
+
+    for (const HistogramSnapshot &histogram : histograms)
+    {
+        // Non-empty buckets as [upper bound, count] pairs, enough to merge
+        // snapshots of several flights offline
+        QJsonArray bucketArray;
+        for (int i = 0; i < histogram.buckets.size(); i++)
+            if(histogram.buckets.at(i))
+                bucketArray.append(QJsonArray({static_cast<double>(Metrics::bucketUpperBound(i)),
+                                               static_cast<double>(histogram.buckets.at(i))}));
+
+        QJsonObject object;
+        object.insert("count", static_cast<double>(histogram.count));
+        object.insert("mean", histogram.mean());
+        object.insert("p50", static_cast<double>(histogram.percentile(50)));
+        object.insert("p90", static_cast<double>(histogram.percentile(90)));
+        object.insert("p99", static_cast<double>(histogram.percentile(99)));
+        object.insert("max", static_cast<double>(histogram.maximum));
+        object.insert("buckets", bucketArray);
+        histogramObject.insert(histogram.name, object);
+    }
+
+    QJsonObject root;
+    root.insert("time", static_cast<double>(time));
+    root.insert("counters", counterObject);
+    root.insert("gauges", gaugeObject);
+    root.insert("histograms", histogramObject);
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+bool Metrics::writeJson(const QString &fileName)
+{
+    QSaveFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(snapshot().toJson());
+    return file.commit();
+}
@@ -0,0 +1,112 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+#include <QPair>
+
+#define METRICS_MAX_COUNTERS 32
+#define METRICS_MAX_GAUGES 16
+#define METRICS_MAX_HISTOGRAMS 16
+#define METRICS_SUB_BUCKET_BITS 4       // 16 buckets per power of two, about 6% resolution
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BUCKET_BITS)
+#define METRICS_MAX_SHIFT 32            // values up to 2^37, 137 s in ns
+#define METRICS_HISTOGRAM_BUCKETS ((METRICS_MAX_SHIFT + 2) * METRICS_SUB_BUCKETS)
+
+/*
+ * Always-on production metrics. Counters, gauges and histograms are
+ * registered by name once, usually as file-scope statics, and recorded
+ * through their handle. Every thread writes its own shard with plain relaxed
+ * loads and stores, so recording never waits and never shares a cache line
+ * with another writer; snapshot() sums the shards. Histograms are
+ * log-bucketed like HdrHistogram: exact below 16, then 16 buckets per power
+ * of two.
+ */
+class MetricCounter
+{
+public:
+    explicit MetricCounter(const char *name);
+    void add(quint64 count = 1) const;
+
+private:
+    int m_id;
+};
+
+// Last value wins, shared by all threads
+class MetricGauge
+{
+public:
+    explicit MetricGauge(const char *name);
+    void set(qint64 value) const;
+
+private:
+    int m_id;
+};
+
+class MetricHistogram
+{
+public:
+    explicit MetricHistogram(const char *name);
+    void record(qint64 value) const;
+
+private:
+    int m_id;
+};
+
+struct HistogramSnapshot
+{
+    QString name;
+    quint64 count;
+    qint64 sum;
+    qint64 maximum;
+    QVector<quint64> buckets;
+
+    // Upper bound of the bucket holding the p-th percentile, p in 0..100
+    qint64 percentile(double p) const;
+    double mean() const { return count ? static_cast<double>(sum) / count : 0; }
+};
+
+struct MetricsSnapshot
+{
+    qint64 time;    // ms since epoch
+    QVector<QPair<QString, quint64>> counters;
+    QVector<QPair<QString, qint64>> gauges;
+    QVector<HistogramSnapshot> histograms;
+
+    QByteArray toJson() const;
+};
+
+class Metrics
+{
+public:
+    static qint64 now();        // ns, monotonic
+    static MetricsSnapshot snapshot();
+    static bool writeJson(const QString &fileName);
+
+    static int bucketOf(qint64 value);
+    static qint64 bucketUpperBound(int bucket);
+};
+
+// Records the lifetime of the scope, in ns
+class MetricScope
+{
+public:
+    explicit MetricScope(const MetricHistogram &histogram)
+        : m_histogram(histogram)
+        , m_start(Metrics::now())
+    {
+    }
+
+    ~MetricScope()
+    {
+        m_histogram.record(Metrics::now() - m_start);
+    }
+
+private:
+    const MetricHistogram &m_histogram;
+    qint64 m_start;
+};
+
+#endif // METRICS_H
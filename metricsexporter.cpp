@@ -0,0 +1,57 @@
+#include "metricsexporter.h"
+#include "metrics.h"
+#include <QTcpSocket>
+#include <QDebug>
+
+MetricsExporter::MetricsExporter(QObject *parent)
+    : QObject(parent)
+    , m_server(nullptr)
+{
+    connect(&m_timer, &QTimer::timeout, this, &MetricsExporter::writeFile);
+}
+
+void MetricsExporter::setFile(const QString &fileName, int intervalMs)
+{
+    m_fileName = fileName;
+    if(m_fileName.isEmpty() || intervalMs <= 0)
+    {
+        m_timer.stop();
+        return;
+    }
+    m_timer.start(intervalMs);
+}
+
+void MetricsExporter::writeFile()
+{
+    if(!m_fileName.isEmpty() && !Metrics::writeJson(m_fileName))
+        qDebug() << "- Error, unable to write metrics" << m_fileName;
+}
+
+bool MetricsExporter::listen(quint16 port)
+{
+    if(!m_server)
+    {
+        m_server = new QTcpServer(this);
+        connect(m_server, &QTcpServer::newConnection, this, &MetricsExporter::serve);
+    }
+    // Local only: the snapshot is not meant for the network
+    if(!m_server->listen(QHostAddress::LocalHost, port))
+    {
+        qDebug() << "- Error, metrics port" << port << m_server->errorString();
+        return false;
+    }
+    return true;
+}
+
+void MetricsExporter::serve()
+{
+    while (QTcpSocket *socket = m_server->nextPendingConnection())
+    {
+        // The request itself doesn't matter, every path gets the snapshot
+        const QByteArray body = Metrics::snapshot().toJson();
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        socket->write("HTTP/1.0 200 OK\r\nContent-Type: application/json\r\nContent-Length: "
+                      + QByteArray::number(body.size()) + "\r\n\r\n" + body);
+        socket->disconnectFromHost();
+    }
+}
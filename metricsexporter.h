@@ -0,0 +1,35 @@
+#ifndef METRICSEXPORTER_H
+#define METRICSEXPORTER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QTcpServer>
+
+/*
+ * Publishes metrics snapshots as JSON: periodically to a file, and to
+ * whoever connects to a local port (curl http://localhost:<port>/). The
+ * server answers every connection with one HTTP/1.0 response and closes.
+ */
+class MetricsExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MetricsExporter(QObject *parent = nullptr);
+
+    void setFile(const QString &fileName, int intervalMs);
+    bool listen(quint16 port);
+
+public slots:
+    void writeFile();
+
+private slots:
+    void serve();
+
+private:
+    QTimer m_timer;
+    QTcpServer *m_server;
+    QString m_fileName;
+};
+
+#endif // METRICSEXPORTER_H
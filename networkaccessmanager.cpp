@@ -1,51 +1,331 @@
 #include "networkaccessmanager.h"
+#include <QtConcurrent>
+#include <QFutureWatcher>
+#include <QTemporaryFile>
+#include <QUuid>
+#include <QDir>
+#include <zlib.h>
+#include <trace.h>
+#include <metrics.h>
+
+static const MetricHistogram uploadTime("upload.duration");
+static const MetricCounter uploadBytes("upload.bytes");
+static const MetricCounter uploadErrors("upload.errors");
+
+#define COMPRESS_CHUNK 65536
+
+struct CompressedBody
+{
+    QString fileName;
+    qint64 rawBytes;
+};
+
+static QHttpPart formField(const QString &name, const QByteArray &value)
+{
+    QHttpPart part;
+    part.setHeader(QNetworkRequest::ContentDispositionHeader,
+                   QVariant("form-data; name=\"" + name + "\""));
+    part.setBody(value);
+    return part;
+}
+
+static QByteArray formFieldText(const QByteArray &boundary, const QByteArray &name, const QByteArray &value)
+{
+    return "--" + boundary + "\r\nContent-Disposition: form-data; name=\"" + name + "\"\r\n\r\n"
+            + value + "\r\n";
+}
+
+// Runs on a worker thread: writes head + igc file + tail through zlib into a
+// temporary file, COMPRESS_CHUNK bytes at a time. windowBits selects the
+// gzip (31) or zlib/"deflate" (15) wrapper. Returns an empty name on error.
+static CompressedBody compressFlightForm(const QByteArray &head, const QString &igcFileName,
+                                         const QByteArray &tail, int windowBits)
+{
+    CompressedBody body;
+    body.rawBytes = 0;
+
+    QFile igc(igcFileName);
+    QTemporaryFile out(QDir::tempPath() + "/xcvario_upload_XXXXXX");
+    out.setAutoRemove(false);
+    if(!igc.open(QIODevice::ReadOnly) || !out.open())
+        return body;
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        out.remove();
+        return body;
+    }
+
+    QByteArray in(COMPRESS_CHUNK, Qt::Uninitialized);
+    QByteArray compressed(COMPRESS_CHUNK, Qt::Uninitialized);
+    bool ok = true;
+
+    auto feed = [&](const char *data, qint64 len, int flush) {
+        zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        zs.avail_in = static_cast<uInt>(len);
+        do {
+            zs.next_out = reinterpret_cast<Bytef *>(compressed.data());
+            zs.avail_out = COMPRESS_CHUNK;
+            deflate(&zs, flush);
+            const qint64 have = COMPRESS_CHUNK - zs.avail_out;
+            if(out.write(compressed.constData(), have) != have)
+                ok = false;
+        } while (zs.avail_out == 0 && ok);
+        body.rawBytes += len;
+    };
+
+    feed(head.constData(), head.size(), Z_NO_FLUSH);
+    while (ok && !igc.atEnd())
+    {
+        const qint64 len = igc.read(in.data(), COMPRESS_CHUNK);
+        if(len < 0)
+        {
+            ok = false;
+            break;
+        }
+        feed(in.constData(), len, Z_NO_FLUSH);
+    }
+    if(ok)
+        feed(tail.constData(), tail.size(), Z_FINISH);
+
+    deflateEnd(&zs);
+
+    if(!ok)
+    {
+        out.remove();
+        return body;
+    }
+
+    body.fileName = out.fileName();
+    return body;
+}
 
 NetworkAccessManager::NetworkAccessManager(QUrl &url, QObject* parent):
     QObject(parent)
 {    
     manager = new QNetworkAccessManager(this);
 
+    // Content-Type (multipart/form-data + boundary) is filled in per request
     request.setUrl(url);
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
     connect(manager, &QNetworkAccessManager::finished, this, &NetworkAccessManager::replyFinished);
 }
 
-void NetworkAccessManager::sendRequest(const QString &user, const QString &pass, QFile &file)
+void NetworkAccessManager::setContentEncoding(const QString &server, ContentEncoding encoding)
+{
+    encodings.insert(server, encoding);
+}
+
+NetworkAccessManager::ContentEncoding NetworkAccessManager::contentEncoding(const QString &server) const
+{
+    return encodings.value(server, Identity);
+}
+
+QString NetworkAccessManager::serverKey(const QUrl &url)
+{
+    return url.authority(QUrl::RemoveUserInfo);
+}
+
+QHttpMultiPart *NetworkAccessManager::createFlightForm(const QString &user, const QString &pass, const QString &fileName)
+{
+    QFileInfo fileInfo(fileName);
+    QHttpMultiPart *multiPart = new QHttpMultiPart(QHttpMultiPart::FormDataType);
+
+    QFile *file = new QFile(fileName, multiPart);
+    if(!file->open(QIODevice::ReadOnly))
+    {
+        qDebug() << file->errorString();
+        delete multiPart;
+        return nullptr;
+    }
+
+    multiPart->append(formField("user", user.toUtf8()));
+    multiPart->append(formField("pass", pass.toUtf8()));
+    multiPart->append(formField("igcfn", fileInfo.completeBaseName().toUtf8()));
+    multiPart->append(formField("Klasse", "3"));
+
+    // No filename in the disposition: Leonardo reads IGCigcIGC from $_POST,
+    // so the part has to look like a plain form field, not a file upload.
+    QHttpPart igcPart;
+    igcPart.setHeader(QNetworkRequest::ContentDispositionHeader,
+                      QVariant("form-data; name=\"IGCigcIGC\""));
+    igcPart.setHeader(QNetworkRequest::ContentTypeHeader, QVariant("text/plain"));
+    igcPart.setBodyDevice(file);
+    multiPart->append(igcPart);
+
+    return multiPart;
+}
+
+void NetworkAccessManager::sendRequest(const QString &user, const QString &pass, const QString &fileName)
 {
-    QUrlQuery params;
-    QFileInfo fileInfo(file);
+    submitFlight(0, request.url(), user, pass, fileName);
+}
 
-    if(!file.open(QIODevice::ReadOnly))
+bool NetworkAccessManager::submitFlight(int id, const QUrl &url, const QString &user, const QString &pass, const QString &fileName)
+{
+    const ContentEncoding encoding = contentEncoding(serverKey(url));
+    if(encoding != Identity)
     {
-        qDebug() << file.errorString();
-        return;
+        if(!QFileInfo(fileName).isReadable())
+            return false;
+
+        submitCompressed(id, url, user, pass, fileName, encoding);
+        return true;
     }
 
-    QTextStream  in(&file);
+    QHttpMultiPart *multiPart = createFlightForm(user, pass, fileName);
+    if(!multiPart)
+        return false;
+
+    QNetworkRequest submit(request);
+    submit.setUrl(url);
 
-    params.addQueryItem("user", user);
-    params.addQueryItem("pass", pass);
-    params.addQueryItem("igcfn", fileInfo.fileName().remove(".igc"));
-    params.addQueryItem("Klasse", "3");
-    params.addQueryItem("IGCigcIGC", in.readAll());
+    QNetworkReply *reply = manager->post(submit, multiPart);
+    multiPart->setParent(reply);
 
-    manager->post(request, params.query().toUtf8());
+    track(reply, id, fileName, QFileInfo(fileName).size());
+    return true;
+}
+
+void NetworkAccessManager::submitCompressed(int id, const QUrl &url, const QString &user, const QString &pass,
+                                            const QString &fileName, ContentEncoding encoding)
+{
+    const QByteArray boundary = "xcvario" + QUuid::createUuid().toRfc4122().toHex();
+
+    QByteArray head;
+    head += formFieldText(boundary, "user", user.toUtf8());
+    head += formFieldText(boundary, "pass", pass.toUtf8());
+    head += formFieldText(boundary, "igcfn", QFileInfo(fileName).completeBaseName().toUtf8());
+    head += formFieldText(boundary, "Klasse", "3");
+    head += "--" + boundary + "\r\nContent-Disposition: form-data; name=\"IGCigcIGC\"\r\n"
+            "Content-Type: text/plain\r\n\r\n";
+    const QByteArray tail = "\r\n--" + boundary + "--\r\n";
+
+    QNetworkRequest submit(request);
+    submit.setUrl(url);
+    submit.setHeader(QNetworkRequest::ContentTypeHeader, "multipart/form-data; boundary=" + boundary);
+    submit.setRawHeader("Content-Encoding", encoding == Gzip ? "gzip" : "deflate");
+
+    const int windowBits = encoding == Gzip ? MAX_WBITS + 16 : MAX_WBITS;
+
+    auto watcher = new QFutureWatcher<CompressedBody>(this);
+    connect(watcher, &QFutureWatcher<CompressedBody>::finished, this, [this, watcher, id, submit, fileName]() {
+        const CompressedBody body = watcher->result();
+        watcher->deleteLater();
+
+        if(body.fileName.isEmpty())
+        {
+            qDebug() << "compression failed for" << fileName;
+            emit submitFinished(id, NetworkError);
+            return;
+        }
+
+        QNetworkReply *reply = post(id, submit, body.fileName, fileName, body.rawBytes);
+        if(!reply)
+            emit submitFinished(id, NetworkError);
+    });
+    watcher->setFuture(QtConcurrent::run(compressFlightForm, head, fileName, tail, windowBits));
+}
+
+QNetworkReply *NetworkAccessManager::post(int id, const QNetworkRequest &submit, const QString &bodyFileName,
+                                          const QString &fileName, qint64 rawBytes)
+{
+    QFile *body = new QFile(bodyFileName);
+    if(!body->open(QIODevice::ReadOnly))
+    {
+        delete body;
+        QFile::remove(bodyFileName);
+        return nullptr;
+    }
+
+    QNetworkReply *reply = manager->post(submit, body);
+    body->setParent(reply);
+    connect(reply, &QObject::destroyed, [bodyFileName]() { QFile::remove(bodyFileName); });
+
+    track(reply, id, fileName, rawBytes);
+    return reply;
+}
+
+void NetworkAccessManager::track(QNetworkReply *reply, int id, const QString &fileName, qint64 rawBytes)
+{
+    Transfer &transfer = transfers[reply];
+    transfer.id = id;
+    transfer.fileName = fileName;
+    transfer.rawBytes = rawBytes;
+    transfer.wireBytes = 0;
+    transfer.timer.start();
+    connect(reply, &QNetworkReply::uploadProgress, this, [this, reply](qint64 bytesSent, qint64) {
+        auto it = transfers.find(reply);
+        if(it != transfers.end())
+            it->wireBytes = bytesSent;
+    });
+}
+
+// Scans the body in RESPONSE_CHUNK pieces for the few markers we act on,
+// keeping only a marker-sized overlap between chunks plus the first
+// RESPONSE_TEXT_MAX bytes for display.
+NetworkAccessManager::SubmitResult NetworkAccessManager::readResponse(QNetworkReply *reply, QByteArray &text)
+{
+    static const QByteArray invalidUserMarker("Invalid user data");
+    static const QByteArray invalidIgcMarker("This is not a valid .igc file");
+    const int overlap = qMax(invalidUserMarker.size(), invalidIgcMarker.size()) - 1;
+
+    SubmitResult result = Submitted;
+    QByteArray window;
+    char chunk[RESPONSE_CHUNK];
+
+    for (;;)
+    {
+        const qint64 len = reply->read(chunk, RESPONSE_CHUNK);
+        if(len <= 0)
+            break;
+
+        if(text.size() < RESPONSE_TEXT_MAX)
+            text.append(chunk, static_cast<int>(qMin<qint64>(len, RESPONSE_TEXT_MAX - text.size())));
+
+        window.append(chunk, static_cast<int>(len));
+        if(window.contains(invalidUserMarker))
+            result = InvalidUser;
+        else if(result == Submitted && window.contains(invalidIgcMarker))
+            result = InvalidIgc;
+        window = window.right(overlap);
+    }
+    return result;
 }
 
 void NetworkAccessManager::replyFinished(QNetworkReply *reply)
 {
+    TRACE_SCOPE("net.reply");
+    // Releases the request body and, for compressed uploads, its temp file
+    reply->deleteLater();
+
+    const bool tracked = transfers.contains(reply);
+    const Transfer transfer = transfers.take(reply);
+    if(tracked)
+    {
+        qDebug() << "upload" << transfer.fileName << transfer.rawBytes << "bytes raw,"
+                 << transfer.wireBytes << "bytes sent in" << transfer.timer.elapsed() << "ms";
+        emit uploadStats(transfer.fileName, transfer.rawBytes, transfer.wireBytes, transfer.timer.elapsed());
+        uploadTime.record(transfer.timer.nsecsElapsed());
+        uploadBytes.add(static_cast<quint64>(transfer.wireBytes));
+    }
+
     if(reply->error())
     {
+        uploadErrors.add();
         qDebug()<<"error";
         qDebug()<<reply->errorString();
+        emit submitFinished(transfer.id, NetworkError);
     }
     else
     {
-        QString data = (QString) reply->readAll();
-        if(data.contains("Invalid user data"))
+        QByteArray text;
+        const SubmitResult result = readResponse(reply, text);
+        if(result == InvalidUser)
             emit invalidUser();
 
-        emit responseResult(data.remove("problem"));//.remove(QRegExp("<[^>]*>")).remove("problem"));
+        emit responseResult(QString::fromUtf8(text).remove("problem"));//.remove(QRegExp("<[^>]*>")).remove("problem"));
+        emit submitFinished(transfer.id, result);
     }
 }
-
@@ -3,27 +3,89 @@
 
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
-#include <QUrlQuery>
+#include <QHttpMultiPart>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QFile>
 #include <QFileInfo>
 
+#define RESPONSE_TEXT_MAX 2048
+#define RESPONSE_CHUNK 4096
+
 class NetworkAccessManager :public QObject
 {
     Q_OBJECT
 
 public:
+    enum SubmitResult
+    {
+        Submitted,
+        InvalidUser,
+        InvalidIgc,
+        NetworkError
+    };
+    Q_ENUM(SubmitResult)
+
+    // Request body encoding. Leonardo servers only accept compressed bodies
+    // if their web server inflates them, so this is configured per server.
+    enum ContentEncoding
+    {
+        Identity,
+        Gzip,
+        Deflate
+    };
+    Q_ENUM(ContentEncoding)
+
     NetworkAccessManager(QUrl &url, QObject* parent);
-    void sendRequest(const QString &user, const QString &pass, QFile &file);
+    void sendRequest(const QString &user, const QString &pass, const QString &fileName);
+
+    void setContentEncoding(const QString &server, ContentEncoding encoding);
+    ContentEncoding contentEncoding(const QString &server) const;
+
+    // Servers are told apart by host and port; the key of per server
+    // settings like the content encoding and the upload backoff
+    static QString serverKey(const QUrl &url);
+
+    // Posts a flight to the given Leonardo server. All submissions share one
+    // QNetworkAccessManager, so requests to the same host reuse its
+    // keep-alive connections. Compressed bodies are built on a worker thread
+    // first, so the request may start later. Returns false if the file can't
+    // be read; otherwise submitFinished(id, ...) follows.
+    bool submitFlight(int id, const QUrl &url, const QString &user, const QString &pass, const QString &fileName);
+
+private:
+    struct Transfer
+    {
+        int id;
+        QString fileName;
+        qint64 rawBytes;
+        qint64 wireBytes;
+        QElapsedTimer timer;
+    };
+
+    // Builds the Leonardo submit form. The igc body is a QFile owned by the
+    // returned multipart and is streamed from disk while the request is sent.
+    QHttpMultiPart *createFlightForm(const QString &user, const QString &pass, const QString &fileName);
+    void submitCompressed(int id, const QUrl &url, const QString &user, const QString &pass,
+                          const QString &fileName, ContentEncoding encoding);
+    QNetworkReply *post(int id, const QNetworkRequest &submit, const QString &bodyFileName,
+                        const QString &fileName, qint64 rawBytes);
+    void track(QNetworkReply *reply, int id, const QString &fileName, qint64 rawBytes);
+    SubmitResult readResponse(QNetworkReply *reply, QByteArray &text);
 
 private:
     QNetworkAccessManager * manager;
     QNetworkRequest request;
+    QHash<QString, ContentEncoding> encodings;
+    QHash<QNetworkReply *, Transfer> transfers;
 
 public slots:
     void replyFinished(QNetworkReply *reply);
 signals:
     void invalidUser();
     void responseResult(const QString &result);
+    void submitFinished(int id, NetworkAccessManager::SubmitResult result);
+    void uploadStats(const QString &fileName, qint64 rawBytes, qint64 wireBytes, qint64 msecs);
 };
 
 #endif // NETWORKACCESSMANAGER_H
@@ -0,0 +1,338 @@
+#include "nmeaparser.h"
+#include <cstring>
+#include <cmath>
+
+#define KNOTS_TO_MS 0.514444
+
+static inline int hexValue(char c)
+{
+    if(c >= '0' && c <= '9')
+        return c - '0';
+    if(c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if(c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+NmeaParser::NmeaParser()
+{
+    reset();
+}
+
+void NmeaParser::reset()
+{
+    m_length = 0;
+    m_haveEpoch = false;
+    m_haveGGA = false;
+    m_haveRMC = false;
+    m_queueHead = 0;
+    m_queueSize = 0;
+    m_sentences = 0;
+    m_checksumErrors = 0;
+
+    m_epoch.date = 0;
+    m_epoch.time = 0;
+    m_epoch.latitude = NAN;
+    m_epoch.longitude = NAN;
+    m_epoch.altitude = NAN;
+    m_epoch.groundSpeed = NAN;
+    m_epoch.course = NAN;
+    m_epoch.hdop = NAN;
+    m_epoch.vdop = NAN;
+    m_epoch.satellites = 0;
+    m_epoch.fixType = 0;
+    m_epoch.valid = false;
+}
+
+void NmeaParser::feed(const char *data, int length)
+{
+    while (length > 0)
+    {
+        const int chunk = qMin(length, NMEA_BUFFER_SIZE - m_length);
+        memcpy(m_buffer + m_length, data, static_cast<size_t>(chunk));
+        m_length += chunk;
+        data += chunk;
+        length -= chunk;
+
+        char *begin = m_buffer;
+        char *end = m_buffer + m_length;
+        while (char *lf = static_cast<char *>(memchr(begin, '\n', static_cast<size_t>(end - begin))))
+        {
+            parseLine(begin, static_cast<int>(lf - begin));
+            begin = lf + 1;
+        }
+
+        // A remainder longer than any sentence is line noise
+        m_length = static_cast<int>(end - begin);
+        if(m_length > NMEA_MAX_SENTENCE)
+            m_length = 0;
+        else if(begin != m_buffer)
+            memmove(m_buffer, begin, static_cast<size_t>(m_length));
+    }
+}
+
+void NmeaParser::parseLine(char *line, int length)
+{
+    const char *start = static_cast<const char *>(memchr(line, '$', static_cast<size_t>(length)));
+    if(!start)
+    {
+        while (length > 0 && (line[length - 1] == '\r' || line[length - 1] == ' '))
+            length--;
+        if(length > 0 && length <= NMEA_MAX_SENTENCE && parseUnframed(line, length))
+            m_sentences++;
+        return;
+    }
+
+    length -= static_cast<int>(start - line);
+    while (length > 0 && (start[length - 1] == '\r' || start[length - 1] == ' '))
+        length--;
+    if(length < 6 || length > NMEA_MAX_SENTENCE)
+        return;
+
+    // XOR of everything between '$' and '*'; the checksum is optional
+    int end = length;
+    unsigned char checksum = 0;
+    for (int i = 1; i < length; i++)
+    {
+        if(start[i] == '*')
+        {
+            end = i;
+            break;
+        }
+        checksum ^= static_cast<unsigned char>(start[i]);
+    }
+    if(end < length)
+    {
+        if(end + 3 > length || hexValue(start[end + 1]) < 0 || hexValue(start[end + 2]) < 0
+                || ((hexValue(start[end + 1]) << 4) | hexValue(start[end + 2])) != checksum)
+        {
+            m_checksumErrors++;
+            return;
+        }
+    }
+
+    Field fields[NMEA_MAX_FIELDS];
+    int count = 0;
+    const char *field = start + 1;
+    for (const char *p = field; count < NMEA_MAX_FIELDS; p++)
+    {
+        if(p == start + end || *p == ',')
+        {
+            fields[count].data = field;
+            fields[count].length = static_cast<int>(p - field);
+            count++;
+            field = p + 1;
+            if(p == start + end)
+                break;
+        }
+    }
+
+    m_sentences++;
+    parseSentence(fields, count);
+}
+
+bool NmeaParser::parseSentence(const Field *fields, int count)
+{
+    const Field &address = fields[0];
+    if(address.length != 5 || address.data[0] == 'P')
+        return false;
+
+    const char *type = address.data + 2;
+    if(memcmp(type, "GGA", 3) == 0)
+        parseGGA(fields, count);
+    else if(memcmp(type, "RMC", 3) == 0)
+        parseRMC(fields, count);
+    else if(memcmp(type, "VTG", 3) == 0)
+        parseVTG(fields, count);
+    else if(memcmp(type, "GSA", 3) == 0)
+        parseGSA(fields, count);
+    else
+        return false;
+    return true;
+}
+
+bool NmeaParser::parseUnframed(const char *line, int length)
+{
+    Q_UNUSED(line)
+    Q_UNUSED(length)
+    return false;
+}
+
+void NmeaParser::beginEpoch(int time)
+{
+    if(m_haveEpoch && time == m_epoch.time)
+        return;
+
+    if(m_haveEpoch)
+        completeEpoch();
+
+    // Date, DOPs, fix type and velocity carry over until updated
+    m_haveEpoch = true;
+    m_epoch.time = time;
+    m_epoch.latitude = NAN;
+    m_epoch.longitude = NAN;
+    m_epoch.altitude = NAN;
+    m_epoch.valid = false;
+}
+
+void NmeaParser::completeEpoch()
+{
+    if(m_haveEpoch && !std::isnan(m_epoch.latitude))
+    {
+        // Keep the newest fixes if the consumer falls behind
+        if(m_queueSize == NMEA_FIX_QUEUE)
+        {
+            m_queueHead = (m_queueHead + 1) % NMEA_FIX_QUEUE;
+            m_queueSize--;
+        }
+        m_queue[(m_queueHead + m_queueSize) % NMEA_FIX_QUEUE] = m_epoch;
+        m_queueSize++;
+    }
+
+    m_haveEpoch = false;
+    m_haveGGA = false;
+    m_haveRMC = false;
+}
+
+void NmeaParser::flush()
+{
+    completeEpoch();
+}
+
+bool NmeaParser::nextFix(NmeaFix &fix)
+{
+    if(m_queueSize == 0)
+        return false;
+
+    fix = m_queue[m_queueHead];
+    m_queueHead = (m_queueHead + 1) % NMEA_FIX_QUEUE;
+    m_queueSize--;
+    return true;
+}
+
+void NmeaParser::parseGGA(const Field *fields, int count)
+{
+    if(count < 10 || fields[1].length == 0)
+        return;
+
+    beginEpoch(toTime(fields[1]));
+
+    const int quality = toInt(fields[6]);
+    if(quality > 0)
+    {
+        m_epoch.latitude = toCoordinate(fields[2], fields[3]);
+        m_epoch.longitude = toCoordinate(fields[4], fields[5]);
+        m_epoch.altitude = toDouble(fields[9]);
+        m_epoch.valid = true;
+    }
+    m_epoch.satellites = toInt(fields[7]);
+    m_epoch.hdop = toDouble(fields[8]);
+
+    m_haveGGA = true;
+    if(m_haveRMC)
+        completeEpoch();
+}
+
+void NmeaParser::parseRMC(const Field *fields, int count)
+{
+    if(count < 10 || fields[1].length == 0)
+        return;
+
+    beginEpoch(toTime(fields[1]));
+
+    if(equals(fields[2], "A"))
+    {
+        if(std::isnan(m_epoch.latitude))
+        {
+            m_epoch.latitude = toCoordinate(fields[3], fields[4]);
+            m_epoch.longitude = toCoordinate(fields[5], fields[6]);
+        }
+        m_epoch.groundSpeed = toDouble(fields[7]) * KNOTS_TO_MS;
+        m_epoch.course = toDouble(fields[8]);
+        m_epoch.valid = true;
+    }
+    if(fields[9].length == 6)
+        m_epoch.date = toInt(fields[9]);
+
+    m_haveRMC = true;
+    if(m_haveGGA)
+        completeEpoch();
+}
+
+void NmeaParser::parseVTG(const Field *fields, int count)
+{
+    if(count < 8 || fields[1].length == 0)
+        return;
+
+    m_epoch.course = toDouble(fields[1]);
+    m_epoch.groundSpeed = toDouble(fields[5]) * KNOTS_TO_MS;
+}
+
+void NmeaParser::parseGSA(const Field *fields, int count)
+{
+    if(count < 18)
+        return;
+
+    m_epoch.fixType = toInt(fields[2]);
+    m_epoch.hdop = toDouble(fields[16]);
+    m_epoch.vdop = toDouble(fields[17]);
+}
+
+double NmeaParser::toDouble(const Field &field)
+{
+    if(field.length == 0)
+        return NAN;
+
+    const char *p = field.data;
+    const char *end = p + field.length;
+    bool negative = false;
+    if(*p == '-' || *p == '+')
+        negative = *p++ == '-';
+
+    double value = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        value = value * 10 + (*p++ - '0');
+
+    if(p < end && *p == '.')
+    {
+        double scale = 0.1;
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, scale *= 0.1)
+            value += (*p - '0') * scale;
+    }
+    return negative ? -value : value;
+}
+
+int NmeaParser::toInt(const Field &field)
+{
+    int value = 0;
+    for (int i = 0; i < field.length && field.data[i] >= '0' && field.data[i] <= '9'; i++)
+        value = value * 10 + (field.data[i] - '0');
+    return value;
+}
+
+bool NmeaParser::equals(const Field &field, const char *text)
+{
+    const int length = static_cast<int>(strlen(text));
+    return field.length == length && memcmp(field.data, text, static_cast<size_t>(length)) == 0;
+}
+
+// hhmmss.sss
+int NmeaParser::toTime(const Field &field)
+{
+    const double value = toDouble(field);
+    const int hhmmss = static_cast<int>(value);
+    const int millis = static_cast<int>(std::lround((value - hhmmss) * 1000));
+    return ((hhmmss / 10000) * 3600 + ((hhmmss / 100) % 100) * 60 + hhmmss % 100) * 1000 + millis;
+}
+
+// ddmm.mmmm / dddmm.mmmm
+double NmeaParser::toCoordinate(const Field &value, const Field &hemisphere)
+{
+    const double raw = toDouble(value);
+    const double degrees = std::floor(raw / 100);
+    double coordinate = degrees + (raw - degrees * 100) / 60;
+    if(equals(hemisphere, "S") || equals(hemisphere, "W"))
+        coordinate = -coordinate;
+    return coordinate;
+}
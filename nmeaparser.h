@@ -0,0 +1,95 @@
+#ifndef NMEAPARSER_H
+#define NMEAPARSER_H
+
+#include <QtGlobal>
+
+#define NMEA_BUFFER_SIZE 4096
+#define NMEA_MAX_SENTENCE 96
+#define NMEA_MAX_FIELDS 24
+#define NMEA_FIX_QUEUE 8
+
+struct NmeaFix
+{
+    int date;               // ddmmyy as written in RMC, 0 if unknown
+    int time;               // milliseconds since midnight UTC
+    double latitude;        // decimal degrees, south negative
+    double longitude;       // decimal degrees, west negative
+    double altitude;        // metres above MSL, NaN without a 3D fix
+    double groundSpeed;     // m/s, NaN if unknown
+    double course;          // degrees true, NaN if unknown
+    double hdop;            // NaN if unknown
+    double vdop;            // NaN if unknown
+    int satellites;
+    int fixType;            // GSA: 1 none, 2 2D, 3 3D
+    bool valid;
+};
+
+/*
+ * Allocation free NMEA 0183 parser. Bytes are appended to a fixed buffer,
+ * complete sentences are checksum-verified and split into fields in place.
+ * GGA, RMC, VTG and GSA sentences from any talker (GP, GN, GL, ...) are
+ * merged per epoch; an epoch is complete when both GGA and RMC for one time
+ * have arrived, or when the next epoch starts. Completed fixes wait in a
+ * small queue until taken with nextFix().
+ */
+class NmeaParser
+{
+public:
+    NmeaParser();
+    virtual ~NmeaParser() {}
+
+    void reset();
+    void feed(const char *data, int length);
+    bool nextFix(NmeaFix &fix);
+
+    // Flushes a pending epoch, e.g. at the end of a replay file
+    void flush();
+
+    qint64 sentenceCount() const { return m_sentences; }
+    qint64 checksumErrors() const { return m_checksumErrors; }
+
+protected:
+    struct Field
+    {
+        const char *data;
+        int length;
+    };
+
+    // Hook for proprietary sentences; fields[0] is the address ("PGRMZ")
+    virtual bool parseSentence(const Field *fields, int count);
+    // Hook for lines without a '$', which some devices send ("PRS 1828E")
+    virtual bool parseUnframed(const char *line, int length);
+
+    static double toDouble(const Field &field);
+    static int toInt(const Field &field);
+    static bool equals(const Field &field, const char *text);
+
+private:
+    void parseLine(char *line, int length);
+    void parseGGA(const Field *fields, int count);
+    void parseRMC(const Field *fields, int count);
+    void parseVTG(const Field *fields, int count);
+    void parseGSA(const Field *fields, int count);
+    void beginEpoch(int time);
+    void completeEpoch();
+    static int toTime(const Field &field);
+    static double toCoordinate(const Field &value, const Field &hemisphere);
+
+private:
+    char m_buffer[NMEA_BUFFER_SIZE];
+    int m_length;
+
+    NmeaFix m_epoch;
+    bool m_haveEpoch;
+    bool m_haveGGA;
+    bool m_haveRMC;
+
+    NmeaFix m_queue[NMEA_FIX_QUEUE];
+    int m_queueHead;
+    int m_queueSize;
+
+    qint64 m_sentences;
+    qint64 m_checksumErrors;
+};
+
+#endif // NMEAPARSER_H
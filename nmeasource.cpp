@@ -0,0 +1,272 @@
+#include "nmeasource.h"
+#include "altitudefusion.h"
+#include <QDebug>
+#include <cmath>
+#include <cerrno>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+// Typical GPS user equivalent range error, scales DOP to metres
+#define NMEA_UERE_M 5.0
+
+NmeaSource::NmeaSource(QObject *parent)
+    : QGeoPositionInfoSource(parent)
+    , m_device(nullptr)
+    , m_notifier(nullptr)
+    , m_error(NoError)
+    , m_fd(-1)
+    , m_lastReplayTime(-1)
+    , m_running(false)
+    , m_singleUpdate(false)
+{
+    m_replayTimer.setSingleShot(true);
+    connect(&m_replayTimer, &QTimer::timeout, this, &NmeaSource::replayNext);
+}
+
+NmeaSource::~NmeaSource()
+{
+#ifdef Q_OS_UNIX
+    if(m_fd >= 0)
+        ::close(m_fd);
+#endif
+}
+
+void NmeaSource::setDevice(QIODevice *device)
+{
+    m_device = device;
+    m_deviceName = device->objectName();
+    connect(m_device, &QIODevice::readyRead, this, &NmeaSource::readDevice);
+}
+
+bool NmeaSource::openTty(const QString &path, int baudRate)
+{
+#ifdef Q_OS_UNIX
+    m_fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_NOCTTY | O_NONBLOCK);
+    if(m_fd < 0)
+    {
+        qWarning("nmea: can't open %s", qPrintable(path));
+        return false;
+    }
+
+    // Raw 8N1 at the requested speed. A pty accepts this and ignores the speed.
+    struct termios tio;
+    if(isatty(m_fd) && tcgetattr(m_fd, &tio) == 0)
+    {
+        speed_t speed = B4800;
+        switch (baudRate) {
+        case 9600: speed = B9600; break;
+        case 19200: speed = B19200; break;
+        case 38400: speed = B38400; break;
+        case 57600: speed = B57600; break;
+        case 115200: speed = B115200; break;
+        default: break;
+        }
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+        tcsetattr(m_fd, TCSANOW, &tio);
+    }
+
+    m_deviceName = path;
+    // Read from the start so vario pressure flows before updates are started;
+    // positions are only published while running
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &NmeaSource::readTty);
+    return true;
+#else
+    Q_UNUSED(path)
+    Q_UNUSED(baudRate)
+    return false;
+#endif
+}
+
+bool NmeaSource::openReplay(const QString &fileName)
+{
+    m_replay.setFileName(fileName);
+    if(!m_replay.open(QIODevice::ReadOnly))
+    {
+        qWarning("nmea: can't open replay %s", qPrintable(fileName));
+        return false;
+    }
+    m_deviceName = fileName;
+    return true;
+}
+
+void NmeaSource::startUpdates()
+{
+    m_running = true;
+    if(m_replay.isOpen())
+        m_replayTimer.start(0);
+}
+
+void NmeaSource::stopUpdates()
+{
+    m_running = false;
+    m_replayTimer.stop();
+}
+
+void NmeaSource::requestUpdate(int timeout)
+{
+    Q_UNUSED(timeout)
+    if(m_running)
+        return;
+
+    m_singleUpdate = true;
+    startUpdates();
+}
+
+void NmeaSource::readDevice()
+{
+    char buffer[NMEA_READ_CHUNK];
+    qint64 length;
+    while ((length = m_device->read(buffer, NMEA_READ_CHUNK)) > 0)
+        m_parser.feed(buffer, static_cast<int>(length));
+
+    publishFixes();
+}
+
+void NmeaSource::readTty()
+{
+#ifdef Q_OS_UNIX
+    char buffer[NMEA_READ_CHUNK];
+    ssize_t length;
+    while ((length = ::read(m_fd, buffer, NMEA_READ_CHUNK)) > 0)
+        m_parser.feed(buffer, static_cast<int>(length));
+
+    // Device unplugged or the pty master closed
+    if(length == 0 || (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+    {
+        m_notifier->setEnabled(false);
+        m_error = UnknownSourceError;
+        emit QGeoPositionInfoSource::error(m_error);
+    }
+#endif
+
+    publishFixes();
+}
+
+// Feeds the log line by line until a fix completes, then waits for the time
+// difference to the previous fix so the replay runs in real time.
+void NmeaSource::replayNext()
+{
+    char line[NMEA_MAX_SENTENCE + 2];
+    NmeaFix fix;
+
+    while (!m_parser.nextFix(fix))
+    {
+        const qint64 length = m_replay.readLine(line, sizeof(line));
+        if(length <= 0)
+        {
+            m_parser.flush();
+            if(!m_parser.nextFix(fix))
+            {
+                publishSamples();
+                emit updateTimeout();
+                return;
+            }
+            break;
+        }
+        m_parser.feed(line, static_cast<int>(length));
+    }
+    publishSamples();
+
+    if(!m_running)
+        return;
+
+    m_lastPosition = toPositionInfo(fix);
+    emit positionUpdated(m_lastPosition);
+
+    int delay = 0;
+    if(m_lastReplayTime >= 0)
+        delay = qBound(0, fix.time - m_lastReplayTime, NMEA_REPLAY_MAX_GAP_MS);
+    m_lastReplayTime = fix.time;
+
+    if(m_singleUpdate)
+    {
+        m_singleUpdate = false;
+        stopUpdates();
+        return;
+    }
+    m_replayTimer.start(delay);
+}
+
+void NmeaSource::publishSamples()
+{
+    VarioSample sample;
+    while (m_parser.nextSample(sample))
+    {
+        // Devices without a raw pressure send standard atmosphere altitude
+        double pressure = sample.pressure;
+        if(std::isnan(pressure) && !std::isnan(sample.altitude))
+            pressure = AltitudeToPressure(sample.altitude, 101325.0);
+        if(!std::isnan(pressure))
+            emit pressureSample(pressure, sample.temperature);
+    }
+}
+
+void NmeaSource::publishFixes()
+{
+    publishSamples();
+
+    NmeaFix fix;
+    while (m_parser.nextFix(fix))
+    {
+        m_lastPosition = toPositionInfo(fix);
+        if(m_running)
+            emit positionUpdated(m_lastPosition);
+    }
+
+    if(m_singleUpdate && m_lastPosition.isValid())
+    {
+        m_singleUpdate = false;
+        stopUpdates();
+    }
+}
+
+QGeoPositionInfo NmeaSource::toPositionInfo(const NmeaFix &fix) const
+{
+    QGeoCoordinate coordinate(fix.latitude, fix.longitude);
+    if(!std::isnan(fix.altitude))
+        coordinate.setAltitude(fix.altitude);
+
+    QDate date = QDate::currentDate();
+    if(fix.date > 0)
+        date = QDate(2000 + fix.date % 100, (fix.date / 100) % 100, fix.date / 10000);
+
+    QGeoPositionInfo info(coordinate, QDateTime(date, QTime::fromMSecsSinceStartOfDay(fix.time), Qt::UTC));
+    if(!std::isnan(fix.groundSpeed))
+        info.setAttribute(QGeoPositionInfo::GroundSpeed, fix.groundSpeed);
+    if(!std::isnan(fix.course))
+        info.setAttribute(QGeoPositionInfo::Direction, fix.course);
+    if(!std::isnan(fix.hdop))
+        info.setAttribute(QGeoPositionInfo::HorizontalAccuracy, fix.hdop * NMEA_UERE_M);
+    if(!std::isnan(fix.vdop))
+        info.setAttribute(QGeoPositionInfo::VerticalAccuracy, fix.vdop * NMEA_UERE_M);
+    return info;
+}
+
+QGeoPositionInfo NmeaSource::lastKnownPosition(bool fromSatellitePositioningMethodsOnly) const
+{
+    Q_UNUSED(fromSatellitePositioningMethodsOnly)
+    return m_lastPosition;
+}
+
+QGeoPositionInfoSource::PositioningMethods NmeaSource::supportedPositioningMethods() const
+{
+    return SatellitePositioningMethods;
+}
+
+int NmeaSource::minimumUpdateInterval() const
+{
+    return 100;
+}
+
+QGeoPositionInfoSource::Error NmeaSource::error() const
+{
+    return m_error;
+}
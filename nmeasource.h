@@ -0,0 +1,75 @@
+#ifndef NMEASOURCE_H
+#define NMEASOURCE_H
+
+#include <QGeoPositionInfoSource>
+#include <QGeoPositionInfo>
+#include <QSocketNotifier>
+#include <QIODevice>
+#include <QTimer>
+#include <QFile>
+#include <varioparser.h>
+
+#define NMEA_READ_CHUNK 1024
+#define NMEA_REPLAY_MAX_GAP_MS 5000
+
+/*
+ * Portable NMEA position source. Sentences come from
+ *  - any QIODevice, e.g. a QSerialPort or a socket (setDevice),
+ *  - a serial device or pseudo-terminal opened directly (openTty, unix),
+ *  - a recorded log, replayed at the pace of its fix times (openReplay).
+ * Data is parsed with VarioParser, without per-sentence allocation, so 10 Hz
+ * receivers at 115200 baud are no problem. Pressure from external vario
+ * sentences is passed on with pressureSample(), whether updates run or not.
+ */
+class NmeaSource : public QGeoPositionInfoSource
+{
+    Q_OBJECT
+
+public:
+    explicit NmeaSource(QObject *parent);
+    ~NmeaSource() override;
+
+    void setDevice(QIODevice *device);
+    bool openTty(const QString &path, int baudRate);
+    bool openReplay(const QString &fileName);
+    QString deviceName() const { return m_deviceName; }
+
+    QGeoPositionInfo lastKnownPosition(bool fromSatellitePositioningMethodsOnly = false) const override;
+    PositioningMethods supportedPositioningMethods() const override;
+    int minimumUpdateInterval() const override;
+    Error error() const override;
+
+public slots:
+    void startUpdates() override;
+    void stopUpdates() override;
+    void requestUpdate(int timeout = 0) override;
+
+signals:
+    void pressureSample(double pressure, double temperature);
+
+private slots:
+    void readDevice();
+    void readTty();
+    void replayNext();
+
+private:
+    void publishFixes();
+    void publishSamples();
+    QGeoPositionInfo toPositionInfo(const NmeaFix &fix) const;
+
+private:
+    VarioParser m_parser;
+    QIODevice *m_device;
+    QSocketNotifier *m_notifier;
+    QFile m_replay;
+    QTimer m_replayTimer;
+    QGeoPositionInfo m_lastPosition;
+    QString m_deviceName;
+    Error m_error;
+    int m_fd;
+    int m_lastReplayTime;
+    bool m_running;
+    bool m_singleUpdate;
+};
+
+#endif // NMEASOURCE_H
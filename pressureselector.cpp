@@ -0,0 +1,120 @@
+#include "pressureselector.h"
+#include <QtMath>
+#include <limits>
+#include <cmath>
+
+PressureSelector::PressureSelector()
+{
+    reset();
+}
+
+void PressureSelector::reset()
+{
+    for (Source &source : m_sources)
+    {
+        source.last = 0;
+        source.pressure = 0;
+        source.previous = 0;
+        source.interval = 0;
+        source.variance = 0;
+        source.offset = 0;
+        source.count = 0;
+    }
+    m_active = -1;
+    m_output = NAN;
+    m_rivalSince = -1;
+}
+
+bool PressureSelector::isAlive(int source, qint64 timeMs) const
+{
+    const Source &s = m_sources[source];
+    return s.count > 0 && timeMs - s.last <= PRESSURE_SOURCE_TIMEOUT_MS;
+}
+
+double PressureSelector::noise(int source) const
+{
+    return qSqrt(m_sources[source].variance);
+}
+
+double PressureSelector::score(int source) const
+{
+    const Source &s = m_sources[source];
+    return s.variance * qMax(1.0, s.interval);
+}
+
+int PressureSelector::best(qint64 timeMs, bool trustedOnly) const
+{
+    int best = -1;
+    double bestScore = std::numeric_limits<double>::max();
+    for (int i = 0; i < PRESSURE_SOURCES; i++)
+    {
+        if(!isAlive(i, timeMs) || (trustedOnly && m_sources[i].count < PRESSURE_SOURCE_MIN_SAMPLES))
+            continue;
+        if(score(i) < bestScore)
+        {
+            best = i;
+            bestScore = score(i);
+        }
+    }
+    return best;
+}
+
+void PressureSelector::select(int source)
+{
+    Source &s = m_sources[source];
+    s.offset = std::isnan(m_output) ? 0 : m_output - s.pressure;
+    m_active = source;
+    m_rivalSince = -1;
+}
+
+bool PressureSelector::add(int source, qint64 timeMs, double pressure, double &selected)
+{
+    if(source < 0 || source >= PRESSURE_SOURCES || std::isnan(pressure))
+        return false;
+
+    Source &s = m_sources[source];
+    if(s.count > 0)
+    {
+        const double interval = qMax<qint64>(0, timeMs - s.last);
+        s.interval = s.count == 1 ? interval : s.interval + PRESSURE_STATS_ALPHA * (interval - s.interval);
+    }
+    if(s.count > 1)
+    {
+        // White noise of variance v gives second differences of variance 6v
+        const double difference = pressure - 2 * s.pressure + s.previous;
+        const double variance = difference * difference / 6;
+        s.variance = s.count == 2 ? variance : s.variance + PRESSURE_STATS_ALPHA * (variance - s.variance);
+    }
+    s.previous = s.pressure;
+    s.pressure = pressure;
+    s.last = timeMs;
+    s.count++;
+
+    if(m_active < 0 || !isAlive(m_active, timeMs))
+    {
+        // Anything talking beats nothing, trusted or not
+        const int candidate = best(timeMs, true);
+        select(candidate >= 0 ? candidate : source);
+    }
+    else if(m_active != source)
+    {
+        const int candidate = best(timeMs, true);
+        if(candidate == source && m_sources[m_active].count >= PRESSURE_SOURCE_MIN_SAMPLES
+                && score(source) < PRESSURE_SWITCH_RATIO * score(m_active))
+        {
+            if(m_rivalSince < 0)
+                m_rivalSince = timeMs;
+            if(timeMs - m_rivalSince >= PRESSURE_SWITCH_HOLD_MS)
+                select(source);
+        }
+        else
+            m_rivalSince = -1;
+    }
+
+    if(m_active != source)
+        return false;
+
+    selected = pressure + s.offset;
+    m_output = selected;
+    return true;
+}
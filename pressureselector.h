@@ -0,0 +1,67 @@
+#ifndef PRESSURESELECTOR_H
+#define PRESSURESELECTOR_H
+
+#include <QtGlobal>
+
+#define PRESSURE_SOURCE_INTERNAL 0          // QPressureSensor of the device
+#define PRESSURE_SOURCE_EXTERNAL 1          // vario sentences over nmea
+#define PRESSURE_SOURCES 2
+#define PRESSURE_SOURCE_TIMEOUT_MS 1000     // a source silent this long is gone
+#define PRESSURE_SOURCE_MIN_SAMPLES 20      // before its noise estimate is trusted
+#define PRESSURE_SWITCH_RATIO 0.7           // a rival must score this much better
+#define PRESSURE_SWITCH_HOLD_MS 10000       // for this long without a break
+#define PRESSURE_STATS_ALPHA 0.05           // EMA weight of noise and interval
+
+/*
+ * Picks which pressure source drives the filters. Every source gets a noise
+ * estimate from its second differences, which a steady climb doesn't
+ * disturb, and a mean sample interval. The score is their product, the
+ * variance of a one second average: a quieter or a faster sensor wins, and
+ * the slower one also lags more. A better source takes over once it has
+ * scored better by the switch ratio for the hold time, so the wander of the
+ * estimates doesn't flip between two similar sensors, and a source that
+ * went silent is replaced by the best one still talking. Each source
+ * carries an offset, set when it takes over, so the pressure handed on
+ * stays continuous across switches; the GPS altitude fusion then absorbs
+ * the calibration difference between the sensors.
+ */
+class PressureSelector
+{
+public:
+    PressureSelector();
+
+    void reset();
+
+    // Returns true with the pressure to use if this sample comes from the
+    // selected source, false if it should be ignored
+    bool add(int source, qint64 timeMs, double pressure, double &selected);
+
+    int active() const { return m_active; }
+    bool isAlive(int source, qint64 timeMs) const;
+    double noise(int source) const;                 // Pa, 1 sigma per sample
+    double interval(int source) const { return m_sources[source].interval; }   // ms
+    double score(int source) const;
+
+private:
+    struct Source
+    {
+        qint64 last;            // ms of the newest sample
+        double pressure;        // newest raw sample
+        double previous;
+        double interval;        // ms, EMA
+        double variance;        // Pa^2 per sample, EMA
+        double offset;          // Pa added while selected
+        int count;
+    };
+
+    int best(qint64 timeMs, bool trustedOnly) const;
+    void select(int source);
+
+private:
+    Source m_sources[PRESSURE_SOURCES];
+    int m_active;
+    double m_output;
+    qint64 m_rivalSince;        // ms the rival has scored better since, -1 if not
+};
+
+#endif // PRESSURESELECTOR_H
@@ -0,0 +1,109 @@
+#include "syntheticsensor.h"
+#include "altitudefusion.h"
+#include <QSensorManager>
+#include <QPressureSensor>
+#include <QtMath>
+
+// Fraction of a cycle spent climbing
+#define SYNTHETIC_THERMAL_SHARE 0.4
+
+SyntheticProfile SyntheticProfile::defaults()
+{
+    SyntheticProfile profile;
+    profile.rate = 50;
+    profile.climb = 2.5;
+    profile.sink = -1.2;
+    profile.cycle = 180;
+    profile.noise = 2.0;
+    profile.dropoutRate = 0;
+    profile.dropoutMs = 500;
+    return profile;
+}
+
+SyntheticPressureBackend::SyntheticPressureBackend(const SyntheticProfile &profile, QSensor *sensor)
+    : QSensorBackend(sensor)
+    , m_profile(profile)
+    , m_random(QRandomGenerator::securelySeeded())
+    , m_altitude(SYNTHETIC_BASE_ALTITUDE)
+    , m_lastNs(0)
+    , m_dropoutUntilNs(0)
+{
+    setReading<QPressureReading>(&m_reading);
+    addDataRate(SYNTHETIC_MIN_RATE, SYNTHETIC_MAX_RATE);
+    setDescription("Synthetic pressure sensor");
+
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, &QTimer::timeout, this, &SyntheticPressureBackend::tick);
+}
+
+void SyntheticPressureBackend::registerBackend(const SyntheticProfile &profile)
+{
+    if(QSensorManager::isBackendRegistered(QPressureSensor::type, SYNTHETIC_IDENTIFIER))
+        return;
+    // The factory lives as long as the process, like those of sensor plugins
+    QSensorManager::registerBackend(QPressureSensor::type, SYNTHETIC_IDENTIFIER, new SyntheticSensorFactory(profile));
+    QSensorManager::setDefaultBackend(QPressureSensor::type, SYNTHETIC_IDENTIFIER);
+}
+
+QSensorBackend *SyntheticSensorFactory::createBackend(QSensor *sensor)
+{
+    return new SyntheticPressureBackend(m_profile, sensor);
+}
+
+void SyntheticPressureBackend::start()
+{
+    // The sensor's requested rate wins over the profile
+    const int rate = qBound(SYNTHETIC_MIN_RATE, sensor()->dataRate() > 0 ? sensor()->dataRate() : m_profile.rate,
+                            SYNTHETIC_MAX_RATE);
+    m_clock.start();
+    m_lastNs = 0;
+    m_dropoutUntilNs = 0;
+    m_timer.start(qMax(1, 1000 / rate));
+}
+
+void SyntheticPressureBackend::stop()
+{
+    m_timer.stop();
+}
+
+double SyntheticPressureBackend::verticalSpeed(double seconds) const
+{
+    // Climb in a sine-shaped thermal core, constant sink in between
+    const double phase = std::fmod(seconds, m_profile.cycle) / m_profile.cycle;
+    if(phase < SYNTHETIC_THERMAL_SHARE)
+    {
+        const double core = qSin(M_PI * phase / SYNTHETIC_THERMAL_SHARE);
+        return m_profile.sink + (m_profile.climb - m_profile.sink) * core;
+    }
+    return m_profile.sink;
+}
+
+double SyntheticPressureBackend::gaussian()
+{
+    // Box-Muller
+    const double u = qMax(1e-12, m_random.generateDouble());
+    const double v = m_random.generateDouble();
+    return qSqrt(-2 * qLn(u)) * qCos(2 * M_PI * v);
+}
+
+void SyntheticPressureBackend::tick()
+{
+    const qint64 now = m_clock.nsecsElapsed();
+    const double dt = (now - m_lastNs) / 1e9;
+    m_lastNs = now;
+
+    // The flight goes on during a dropout, only the readings stop
+    m_altitude += verticalSpeed(now / 1e9) * dt;
+    if(now < m_dropoutUntilNs)
+        return;
+    if(m_profile.dropoutRate > 0 && m_random.generateDouble() < m_profile.dropoutRate * dt / 60)
+    {
+        m_dropoutUntilNs = now + static_cast<qint64>(m_profile.dropoutMs) * 1000000;
+        return;
+    }
+
+    m_reading.setTimestamp(static_cast<quint64>(now / 1000));
+    m_reading.setPressure(AltitudeToPressure(m_altitude, 101325.0) + m_profile.noise * gaussian());
+    m_reading.setTemperature(20.0 - SYNTHETIC_LAPSE_RATE * m_altitude);
+    newReadingAvailable();
+}
@@ -0,0 +1,78 @@
+#ifndef SYNTHETICSENSOR_H
+#define SYNTHETICSENSOR_H
+
+#include <QSensorBackend>
+#include <QSensorBackendFactory>
+#include <QPressureReading>
+#include <QRandomGenerator>
+#include <QElapsedTimer>
+#include <QTimer>
+
+#define SYNTHETIC_IDENTIFIER "xcvario.synthetic"
+#define SYNTHETIC_MIN_RATE 10           // Hz
+#define SYNTHETIC_MAX_RATE 1000         // Hz
+#define SYNTHETIC_BASE_ALTITUDE 1000.0  // m
+#define SYNTHETIC_LAPSE_RATE 0.0065     // deg C per m
+
+struct SyntheticProfile
+{
+    int rate;               // Hz
+    double climb;           // m/s in the thermal core
+    double sink;            // m/s between thermals, negative
+    double cycle;           // s, one thermal and one glide
+    double noise;           // Pa, 1 sigma
+    double dropoutRate;     // dropouts per minute
+    int dropoutMs;          // length of a dropout
+
+    static SyntheticProfile defaults();
+};
+
+/*
+ * QtSensors backend producing a synthetic pressure stream: a flight
+ * alternating thermals and glides, with gaussian noise and dropouts, at 10 Hz
+ * to 1 kHz. Once registered it is listed like a hardware sensor, so
+ * MainWindow::loadSensors and sensor_changed run unchanged on machines
+ * without a barometer.
+ */
+class SyntheticPressureBackend : public QSensorBackend
+{
+    Q_OBJECT
+
+public:
+    SyntheticPressureBackend(const SyntheticProfile &profile, QSensor *sensor);
+
+    void start() override;
+    void stop() override;
+
+    // Installs the backend for QPressureSensor under SYNTHETIC_IDENTIFIER
+    static void registerBackend(const SyntheticProfile &profile);
+
+private slots:
+    void tick();
+
+private:
+    double verticalSpeed(double seconds) const;
+    double gaussian();
+
+private:
+    SyntheticProfile m_profile;
+    QPressureReading m_reading;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    QRandomGenerator m_random;
+    double m_altitude;
+    qint64 m_lastNs;
+    qint64 m_dropoutUntilNs;
+};
+
+class SyntheticSensorFactory : public QSensorBackendFactory
+{
+public:
+    explicit SyntheticSensorFactory(const SyntheticProfile &profile) : m_profile(profile) {}
+    QSensorBackend *createBackend(QSensor *sensor) override;
+
+private:
+    SyntheticProfile m_profile;
+};
+
+#endif // SYNTHETICSENSOR_H
@@ -0,0 +1,202 @@
+#include "task.h"
+#include <QtMath>
+#include <QPointF>
+
+#define EARTH_RADIUS 6371000.0
+#define GOLDEN_RATIO 0.6180339887
+
+Task::Task()
+{
+    reset();
+}
+
+void Task::setTurnpoints(const QVector<Turnpoint> &turnpoints)
+{
+    m_turnpoints = turnpoints;
+    m_centers.resize(m_turnpoints.size());
+    for (int i = 0; i < m_turnpoints.size(); i++)
+        m_centers[i] = point(m_turnpoints.at(i).waypoint.latitude, m_turnpoints.at(i).waypoint.longitude);
+    reset();
+}
+
+void Task::reset()
+{
+    m_leg = 0;
+    m_startSide = -1;
+    m_distanceToNext = 0;
+    m_remaining = 0;
+    m_taskDistance = 0;
+    if(!isValid())
+        return;
+
+    optimize(m_turnpoints.first().waypoint.latitude, m_turnpoints.first().waypoint.longitude);
+    m_taskDistance = m_after.first();
+    m_remaining = m_taskDistance;
+}
+
+Task::Point Task::point(double latitude, double longitude)
+{
+    const double phi = qDegreesToRadians(latitude);
+    return {phi, qDegreesToRadians(longitude), qCos(phi)};
+}
+
+double Task::distance(const Point &a, const Point &b)
+{
+    const double sinLatitude = qSin((b.latitude - a.latitude) / 2);
+    const double sinLongitude = qSin((b.longitude - a.longitude) / 2);
+    const double h = sinLatitude * sinLatitude + a.cosLatitude * b.cosLatitude * sinLongitude * sinLongitude;
+    return 2 * EARTH_RADIUS * qAsin(qMin(1.0, qSqrt(h)));
+}
+
+void Task::optimize(double latitude, double longitude)
+{
+    const int count = m_turnpoints.size() - m_leg;
+    m_route.resize(m_turnpoints.size());
+    m_after.resize(m_turnpoints.size());
+    if(count <= 0)
+        return;
+
+    // Local plane around the position, metres; good to well under 0.1% over a task
+    const double latitude0 = qDegreesToRadians(latitude);
+    const double longitude0 = qDegreesToRadians(longitude);
+    const double scaleX = qCos(latitude0) * EARTH_RADIUS;
+    QVector<QPointF> centers(count), route(count);
+    QVector<double> radii(count);
+    for (int k = 0; k < count; k++)
+    {
+        const Point &center = m_centers.at(m_leg + k);
+        centers[k] = QPointF((center.longitude - longitude0) * scaleX, (center.latitude - latitude0) * EARTH_RADIUS);
+        route[k] = centers[k];
+        radii[k] = m_turnpoints.at(m_leg + k).radius;
+    }
+
+    auto length = [](const QPointF &a, const QPointF &b) {
+        return qSqrt((a.x() - b.x()) * (a.x() - b.x()) + (a.y() - b.y()) * (a.y() - b.y()));
+    };
+
+    // Each point moves to the best place on its circle for its current
+    // neighbours; a few sweeps converge for any practical task.
+    for (int iteration = 0; iteration < TASK_OPTIMIZE_ITERATIONS; iteration++)
+    {
+        for (int k = 0; k < count; k++)
+        {
+            const QPointF previous = k == 0 ? QPointF(0, 0) : route.at(k - 1);
+            const QPointF &center = centers.at(k);
+            const double radius = radii.at(k);
+
+            if(k == count - 1)
+            {
+                // Goal: the nearest point of the circle, or where we are if inside
+                const double d = length(previous, center);
+                route[k] = d <= radius ? previous : center + (previous - center) * (radius / d);
+                continue;
+            }
+
+            const QPointF next = route.at(k + 1);
+            if(k == 0 && m_leg == 0)
+            {
+                // Start, optimized from its center: the route leaves the
+                // cylinder towards the next point
+                route[k] = center + (next - center) * (radius / length(next, center));
+                continue;
+            }
+
+            const QPointF segment = next - previous;
+            const double segmentLength = segment.x() * segment.x() + segment.y() * segment.y();
+            double t = segmentLength > 0 ? QPointF::dotProduct(center - previous, segment) / segmentLength : 0;
+            t = qBound(0.0, t, 1.0);
+            const QPointF closest = previous + segment * t;
+            if(length(closest, center) <= radius)
+            {
+                // The straight line already touches the cylinder
+                route[k] = closest;
+                continue;
+            }
+
+            // Golden section search on the half circle facing both neighbours
+            const QPointF bisector = (previous - center) / length(previous, center)
+                                   + (next - center) / length(next, center);
+            const double facing = qAtan2(bisector.y(), bisector.x());
+            auto cost = [&](double angle) {
+                const QPointF onCircle = center + QPointF(qCos(angle), qSin(angle)) * radius;
+                return length(previous, onCircle) + length(onCircle, next);
+            };
+            double low = facing - M_PI / 2, high = facing + M_PI / 2;
+            double a = high - GOLDEN_RATIO * (high - low), b = low + GOLDEN_RATIO * (high - low);
+            double costA = cost(a), costB = cost(b);
+            for (int step = 0; step < 30; step++)
+            {
+                if(costA < costB)
+                {
+                    high = b;
+                    b = a;
+                    costB = costA;
+                    a = high - GOLDEN_RATIO * (high - low);
+                    costA = cost(a);
+                }
+                else
+                {
+                    low = a;
+                    a = b;
+                    costA = costB;
+                    b = low + GOLDEN_RATIO * (high - low);
+                    costB = cost(b);
+                }
+            }
+            const double angle = (low + high) / 2;
+            route[k] = center + QPointF(qCos(angle), qSin(angle)) * radius;
+        }
+    }
+
+    // Back to geographic points, then the distances to the goal on the sphere
+    for (int k = 0; k < count; k++)
+        m_route[m_leg + k] = point(qRadiansToDegrees(latitude0 + route.at(k).y() / EARTH_RADIUS),
+                                   qRadiansToDegrees(longitude0 + route.at(k).x() / scaleX));
+    m_after[m_turnpoints.size() - 1] = 0;
+    for (int i = m_turnpoints.size() - 2; i >= m_leg; i--)
+        m_after[i] = m_after.at(i + 1) + distance(m_route.at(i), m_route.at(i + 1));
+}
+
+bool Task::update(double latitude, double longitude)
+{
+    if(!isValid() || isFinished())
+        return false;
+
+    const Point here = point(latitude, longitude);
+    bool reached = false;
+
+    if(m_leg == 0)
+    {
+        const int side = distance(here, m_centers.first()) <= m_turnpoints.first().radius ? 1 : 0;
+        if(m_startSide >= 0 && side != m_startSide)
+            reached = true;
+        m_startSide = side;
+    }
+    else if(distance(here, m_centers.at(m_leg)) <= m_turnpoints.at(m_leg).radius)
+        reached = true;
+
+    if(reached)
+    {
+        m_leg++;
+        if(isFinished())
+        {
+            m_distanceToNext = 0;
+            m_remaining = 0;
+            return true;
+        }
+        optimize(latitude, longitude);
+    }
+
+    m_distanceToNext = distance(here, m_route.at(m_leg));
+    m_remaining = m_distanceToNext + m_after.at(m_leg);
+    return reached;
+}
+
+double Task::progress() const
+{
+    if(isFinished())
+        return 1;
+    if(!isStarted() || m_taskDistance <= 0)
+        return 0;
+    return qBound(0.0, 1 - m_remaining / m_taskDistance, 1.0);
+}
@@ -0,0 +1,69 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <QVector>
+#include <waypoint.h>
+
+#define TASK_OPTIMIZE_ITERATIONS 20
+
+/*
+ * Competition task: a start cylinder, turnpoint cylinders and a goal
+ * cylinder. The start is taken on the first crossing of its boundary (enter
+ * or exit start), the others when the pilot is inside.
+ *
+ * The shortest route touching the remaining cylinders is optimized when the
+ * task is set and again when a leg is completed, together with the sines and
+ * cosines of the route points and the remaining distance after each of them.
+ * A fix then costs one haversine to the next route point, and before the
+ * start one more to the start center, however many turnpoints the task has.
+ */
+class Task
+{
+public:
+    Task();
+
+    void setTurnpoints(const QVector<Turnpoint> &turnpoints);
+    void reset();
+
+    bool isValid() const { return m_turnpoints.size() >= 2; }
+    bool isStarted() const { return m_leg > 0; }
+    bool isFinished() const { return isValid() && m_leg >= m_turnpoints.size(); }
+
+    // Returns true when a turnpoint (or the start) has just been reached
+    bool update(double latitude, double longitude);
+
+    int size() const { return m_turnpoints.size(); }
+    int currentLeg() const { return m_leg; }    // index of the next turnpoint
+    const Turnpoint &next() const { return m_turnpoints.at(qMin(m_leg, m_turnpoints.size() - 1)); }
+
+    double distanceToNext() const { return m_distanceToNext; }  // m to the route point on it
+    double remaining() const { return m_remaining; }            // m along the optimized route
+    double taskDistance() const { return m_taskDistance; }      // m, optimized from the start
+    double progress() const;                                    // 0..1
+
+private:
+    struct Point
+    {
+        double latitude;        // rad
+        double longitude;       // rad
+        double cosLatitude;
+    };
+
+    static Point point(double latitude, double longitude);
+    static double distance(const Point &a, const Point &b);
+    void optimize(double latitude, double longitude);
+
+private:
+    QVector<Turnpoint> m_turnpoints;
+    QVector<Point> m_centers;
+    QVector<Point> m_route;         // optimized point on each cylinder
+    QVector<double> m_after;        // route distance from point i to the goal
+
+    int m_leg;
+    int m_startSide;                // -1 unknown, 0 outside, 1 inside the start
+    double m_distanceToNext;
+    double m_remaining;
+    double m_taskDistance;
+};
+
+#endif // TASK_H
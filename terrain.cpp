@@ -0,0 +1,193 @@
+#include "terrain.h"
+#include <QtConcurrent>
+#include <QFutureWatcher>
+#include <QThread>
+#include <QFile>
+#include <QDir>
+#include <QtMath>
+
+#define KM_PER_DEGREE 111.195
+#define TERRAIN_PAGE 4096
+
+Terrain::Terrain(const QString &directory, QObject *parent)
+    : QObject(parent)
+    , m_directory(directory)
+    , m_count(0)
+    , m_last(nullptr)
+    , m_useCounter(0)
+{
+}
+
+Terrain::~Terrain()
+{
+    for (int i = 0; i < m_count; i++)
+        delete m_tiles[i].file;
+}
+
+int Terrain::tileKey(double latitude, double longitude)
+{
+    // South-west corner, latitude -90..89 and longitude -180..179
+    return (qFloor(latitude) + 90) * 360 + (qFloor(longitude) + 180);
+}
+
+QString Terrain::tileFileName(int key) const
+{
+    const int latitude = key / 360 - 90;
+    const int longitude = key % 360 - 180;
+    return QDir(m_directory).filePath(QString("%1%2%3%4.hgt")
+            .arg(latitude < 0 ? 'S' : 'N').arg(qAbs(latitude), 2, 10, QChar('0'))
+            .arg(longitude < 0 ? 'W' : 'E').arg(qAbs(longitude), 3, 10, QChar('0')));
+}
+
+Terrain::Tile Terrain::mapTile(const QString &fileName, int key, QThread *thread)
+{
+    Tile tile = {key, nullptr, nullptr, 0, 0};
+
+    QFile *file = new QFile(fileName);
+    const qint64 size = file->size();
+    int samples = 0;
+    if(size == 3601 * 3601 * 2)
+        samples = 3601;
+    else if(size == 1201 * 1201 * 2)
+        samples = 1201;
+
+    const uchar *data = samples && file->open(QIODevice::ReadOnly) ? file->map(0, size) : nullptr;
+    if(!data)
+    {
+        delete file;
+        return tile;
+    }
+
+    if(thread)
+    {
+        // On the pool: fault the pages in here rather than on the first lookups
+        volatile uchar sink = 0;
+        for (qint64 offset = 0; offset < size; offset += TERRAIN_PAGE)
+            sink += data[offset];
+        Q_UNUSED(sink);
+
+        if(file->thread() != thread)
+            file->moveToThread(thread);
+    }
+
+    tile.file = file;
+    tile.data = data;
+    tile.samples = samples;
+    return tile;
+}
+
+Terrain::Tile *Terrain::find(int key)
+{
+    if(m_last && m_last->key == key)
+        return m_last;
+
+    for (int i = 0; i < m_count; i++)
+        if(m_tiles[i].key == key)
+            return &m_tiles[i];
+    return nullptr;
+}
+
+// Evicts the least recently used tile other than pinned
+Terrain::Tile *Terrain::insert(const Tile &tile, const Tile *pinned)
+{
+    Tile *slot = nullptr;
+    if(m_count < TERRAIN_MAX_TILES)
+        slot = &m_tiles[m_count++];
+    else
+    {
+        for (int i = 0; i < m_count; i++)
+            if(&m_tiles[i] != pinned && (!slot || m_tiles[i].lastUse < slot->lastUse))
+                slot = &m_tiles[i];
+        delete slot->file;
+    }
+
+    *slot = tile;
+    slot->lastUse = ++m_useCounter;
+    m_last = slot;
+    return slot;
+}
+
+bool Terrain::elevation(double latitude, double longitude, double &meters)
+{
+    const int key = tileKey(latitude, longitude);
+    Tile *tile = find(key);
+    if(!tile)
+    {
+        if(m_missing.contains(key))
+            return false;
+
+        // A miss the prefetch didn't cover; mapping is cheap, the pages fault in on use
+        Tile mapped = mapTile(tileFileName(key), key, nullptr);
+        if(!mapped.data)
+        {
+            m_missing.insert(key);
+            return false;
+        }
+        tile = insert(mapped);
+    }
+    tile->lastUse = ++m_useCounter;
+    m_last = tile;
+
+    // Row 0 is the northern edge, the outer rows overlap the neighbouring tiles
+    const int last = tile->samples - 1;
+    const double y = (1 - (latitude - qFloor(latitude))) * last;
+    const double x = (longitude - qFloor(longitude)) * last;
+    const int row = qMin(static_cast<int>(y), last - 1);
+    const int column = qMin(static_cast<int>(x), last - 1);
+    const double fy = y - row;
+    const double fx = x - column;
+
+    auto sample = [tile](int r, int c) {
+        const uchar *p = tile->data + 2 * (r * tile->samples + c);
+        return static_cast<qint16>((p[0] << 8) | p[1]);
+    };
+    const qint16 h00 = sample(row, column), h01 = sample(row, column + 1);
+    const qint16 h10 = sample(row + 1, column), h11 = sample(row + 1, column + 1);
+    if(h00 == TERRAIN_VOID || h01 == TERRAIN_VOID || h10 == TERRAIN_VOID || h11 == TERRAIN_VOID)
+        return false;
+
+    meters = (h00 * (1 - fx) + h01 * fx) * (1 - fy) + (h10 * (1 - fx) + h11 * fx) * fy;
+    return true;
+}
+
+void Terrain::prefetch(double latitude, double longitude, double track)
+{
+    const double north = qCos(qDegreesToRadians(track)) / KM_PER_DEGREE;
+    const double east = qSin(qDegreesToRadians(track)) / (KM_PER_DEGREE * qMax(0.01, qCos(qDegreesToRadians(latitude))));
+
+    for (double km = TERRAIN_LOOKAHEAD_KM / 4; km <= TERRAIN_LOOKAHEAD_KM; km *= 2)
+    {
+        const int key = tileKey(latitude + km * north, longitude + km * east);
+        if(find(key) || m_pending.contains(key) || m_missing.contains(key))
+            continue;
+
+        const QString fileName = tileFileName(key);
+        if(!QFile::exists(fileName))
+        {
+            m_missing.insert(key);
+            continue;
+        }
+
+        m_pending.insert(key);
+        auto watcher = new QFutureWatcher<Tile>(this);
+        connect(watcher, &QFutureWatcher<Tile>::finished, this, [this, watcher, key]() {
+            Tile tile = watcher->result();
+            watcher->deleteLater();
+            m_pending.remove(key);
+
+            if(!tile.data)
+                m_missing.insert(key);
+            else if(find(key))
+                delete tile.file;   // mapped by a lookup meanwhile
+            else
+            {
+                // Several prefetches in a row are newer than the tile in
+                // use, which must not be the one they push out
+                Tile *last = m_last;
+                insert(tile, last);
+                m_last = last;
+            }
+        });
+        watcher->setFuture(QtConcurrent::run(&Terrain::mapTile, fileName, key, thread()));
+    }
+}
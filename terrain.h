@@ -0,0 +1,67 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <QObject>
+#include <QString>
+#include <QSet>
+
+class QFile;
+class QThread;
+
+#define TERRAIN_MAX_TILES 4             // mapped tiles, 26 MB each for SRTM1
+#define TERRAIN_LOOKAHEAD_KM 10.0
+#define TERRAIN_VOID -32768
+
+/*
+ * Ground elevation from SRTM .hgt tiles (SRTM1 3601 or SRTM3 1201 samples
+ * per row, big-endian 16 bit, named like N46E007.hgt) in a local directory.
+ * Tiles are memory mapped on first use and kept in a small LRU, so resident
+ * memory stays bounded by TERRAIN_MAX_TILES. prefetch() maps the tiles the
+ * track is heading into on the thread pool and touches their pages, so the
+ * lookup that crosses a tile edge doesn't fault them in on the UI thread;
+ * a prefetched tile never evicts the one in use.
+ * A lookup in the last used tile is a bilinear interpolation of four samples.
+ */
+class Terrain : public QObject
+{
+    Q_OBJECT
+
+public:
+    Terrain(const QString &directory, QObject *parent);
+    ~Terrain();
+
+    // Meters above mean sea level; false without a tile or on voids
+    bool elevation(double latitude, double longitude, double &meters);
+
+    // track in deg true
+    void prefetch(double latitude, double longitude, double track);
+
+    int tileCount() const { return m_count; }
+
+private:
+    struct Tile
+    {
+        int key;
+        QFile *file;
+        const uchar *data;
+        int samples;        // per row and column
+        quint64 lastUse;
+    };
+
+    static int tileKey(double latitude, double longitude);
+    static Tile mapTile(const QString &fileName, int key, QThread *thread);
+    QString tileFileName(int key) const;
+    Tile *find(int key);
+    Tile *insert(const Tile &tile, const Tile *pinned = nullptr);
+
+private:
+    QString m_directory;
+    Tile m_tiles[TERRAIN_MAX_TILES];
+    int m_count;
+    Tile *m_last;
+    quint64 m_useCounter;
+    QSet<int> m_pending;
+    QSet<int> m_missing;
+};
+
+#endif // TERRAIN_H
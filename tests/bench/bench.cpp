@@ -0,0 +1,364 @@
+#include <QtTest>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QTemporaryDir>
+#include <QTemporaryFile>
+#include <QXmlStreamReader>
+#include <cstdio>
+#include <random>
+#include <kalmanfilter.h>
+#include <altitudefusion.h>
+#include <piecewiselinearfunction.h>
+#include <generator.h>
+#include <igcrecord.h>
+#include <trace.h>
+#include <metrics.h>
+
+// As in mainwindow.h and variobeep.cpp
+#define KF_VAR_ACCEL 0.0075
+#define KF_VAR_MEASUREMENT 0.05
+#define AUDIO_SAMPLE_RATE 44100
+#define TONE_HZ 750
+
+#define SAMPLES 1024                // inputs cycled through, a power of two
+#define SEA_LEVEL_PRESSURE 1013.25  // hPa
+
+static const MetricCounter benchCounter("bench.counter");
+static const MetricHistogram benchHistogram("bench.histogram");
+
+/*
+ * Benchmarks of the hot paths that run per sensor sample, per beep and per
+ * fix, without widgets or sensors. "-o file,json" (file "-" for stdout)
+ * writes the results as JSON for tracking regressions between releases.
+ */
+class Bench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void kalmanUpdate();
+    void pressureToAltitude();
+    void addNewPoint();
+    void getValue();
+    void generateData_data();
+    void generateData();
+    void readData();
+    void formatBRecord();
+    void igcAppend_data();
+    void igcAppend();
+    void traceScope_data();
+    void traceScope();
+    void counterAdd();
+    void histogramRecord();
+    void metricScope();
+    void metricsSnapshot();
+
+private:
+    QVector<double> m_pressures;    // hPa, a slow climb with sensor noise
+    QVector<double> m_varios;       // m/s
+    QAudioFormat m_format;
+};
+
+void Bench::initTestCase()
+{
+    std::mt19937 random(1);
+    std::normal_distribution<double> noise(0, 0.02);
+    std::uniform_real_distribution<double> vario(-3, 6);
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        m_pressures.append(850 - i * 0.001 + noise(random));
+        m_varios.append(vario(random));
+    }
+
+    m_format.setSampleRate(AUDIO_SAMPLE_RATE);
+    m_format.setChannelCount(1);
+    m_format.setSampleSize(16);
+    m_format.setCodec("audio/pcm");
+    m_format.setByteOrder(QAudioFormat::LittleEndian);
+    m_format.setSampleType(QAudioFormat::SignedInt);
+}
+
+static void varioTable(PiecewiseLinearFunction &function)
+{
+    // VarioBeep's beep period table
+    function.addNewPoint(QPointF(0, 0.4763));
+    function.addNewPoint(QPointF(0.441, 0.3619));
+    function.addNewPoint(QPointF(1.029, 0.2238));
+    function.addNewPoint(QPointF(1.559, 0.1565));
+    function.addNewPoint(QPointF(2.471, 0.0985));
+    function.addNewPoint(QPointF(3.571, 0.0741));
+    function.addNewPoint(QPointF(5.0, 0.05));
+}
+
+void Bench::kalmanUpdate()
+{
+    KalmanFilter filter(KF_VAR_ACCEL);
+    filter.Reset(m_pressures.first());
+    int i = 0;
+    QBENCHMARK {
+        filter.Update(m_pressures.at(i++ & (SAMPLES - 1)), KF_VAR_MEASUREMENT, 0.02);
+    }
+    QVERIFY(qAbs(filter.GetXAbs() - 850) < 2);
+}
+
+void Bench::pressureToAltitude()
+{
+    double sum = 0;
+    int i = 0;
+    QBENCHMARK {
+        sum += PressureToAltitude(m_pressures.at(i++ & (SAMPLES - 1)), SEA_LEVEL_PRESSURE);
+    }
+    QVERIFY(sum > 0);
+}
+
+void Bench::addNewPoint()
+{
+    int size = 0;
+    QBENCHMARK {
+        PiecewiseLinearFunction function;
+        varioTable(function);
+        size = function.getSize();
+    }
+    QCOMPARE(size, 6);
+}
+
+void Bench::getValue()
+{
+    PiecewiseLinearFunction function;
+    varioTable(function);
+    double sum = 0;
+    int i = 0;
+    QBENCHMARK {
+        sum += function.getValue(m_varios.at(i++ & (SAMPLES - 1)));
+    }
+    QVERIFY(sum > 0);
+}
+
+void Bench::generateData_data()
+{
+    QTest::addColumn<double>("vario");
+
+    QTest::newRow("0.5 m/s") << 0.5;
+    QTest::newRow("2 m/s") << 2.0;
+}
+
+// One beep as VarioBeep makes it for a vario value
+void Bench::generateData()
+{
+    QFETCH(double, vario);
+
+    PiecewiseLinearFunction function;
+    varioTable(function);
+    const qint64 durationUs = static_cast<qint64>(function.getValue(vario) * 1000);
+    Generator generator(QAudioFormat(), 0, TONE_HZ, nullptr);
+    QBENCHMARK {
+        generator.generateData(m_format, durationUs, TONE_HZ);
+    }
+    QVERIFY(generator.bytesAvailable() > 0);
+}
+
+// The audio output pulls a period at a time
+void Bench::readData()
+{
+    PiecewiseLinearFunction function;
+    varioTable(function);
+    Generator generator(m_format, static_cast<qint64>(function.getValue(0.5) * 1000), TONE_HZ, nullptr);
+    generator.start();
+    QByteArray period(4096, 0);
+    QBENCHMARK {
+        generator.read(period.data(), period.size());
+    }
+}
+
+void Bench::formatBRecord()
+{
+    IgcFix fix;
+    fix.time = 11 * 3600 + 1 * 60 + 35;
+    fix.latitude = 52.10572;
+    fix.longitude = -0.1033;
+    fix.pressureAltitude = 587;
+    fix.gpsAltitude = 558;
+    fix.valid = true;
+
+    char record[IGC_MAX_LINE];
+    int length = 0;
+    int i = 0;
+    QBENCHMARK {
+        fix.latitude += 1e-6;
+        length = ::formatBRecord(fix, record);
+        length += formatSignedField(qRound(m_varios.at(i++ & (SAMPLES - 1)) * 100), 4, record + length);
+    }
+    QCOMPARE(length, IGC_B_RECORD_LENGTH + 4);
+}
+
+void Bench::igcAppend_data()
+{
+    QTest::addColumn<bool>("reopen");
+
+    QTest::newRow("kept open") << false;
+    QTest::newRow("reopened per fix") << true;
+}
+
+// A fix appended as MainWindow::updateIGC does it, flushed so a crash loses
+// at most one; reopening per fix is how it used to be
+void Bench::igcAppend()
+{
+    QFETCH(bool, reopen);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QFile file(dir.filePath("bench.igc"));
+    QVERIFY(file.open(QIODevice::Append | QIODevice::Text));
+
+    IgcFix fix = { 11 * 3600, 46.5, 8.0, 2000, 1980, true };
+    char record[IGC_MAX_LINE];
+    QBENCHMARK {
+        fix.time++;
+        if(reopen)
+        {
+            file.close();
+            file.open(QIODevice::Append | QIODevice::Text);
+        }
+        int length = ::formatBRecord(fix, record);
+        length += formatSignedField(120, 4, record + length);
+        record[length++] = '\n';
+        file.write(record, length);
+        file.flush();
+    }
+    QVERIFY(file.size() > 0);
+}
+
+void Bench::traceScope_data()
+{
+    QTest::addColumn<bool>("enabled");
+
+    QTest::newRow("disabled") << false;
+    QTest::newRow("enabled") << true;
+}
+
+// An empty TRACE_SCOPE: the cost a trace point adds to the code around it
+void Bench::traceScope()
+{
+    QFETCH(bool, enabled);
+
+    Trace::setEnabled(enabled);
+    QBENCHMARK {
+        TRACE_SCOPE("bench");
+    }
+    Trace::setEnabled(false);
+}
+
+void Bench::counterAdd()
+{
+    QBENCHMARK {
+        benchCounter.add();
+    }
+}
+
+void Bench::histogramRecord()
+{
+    qint64 value = 0;
+    QBENCHMARK {
+        // Spread over the buckets, 0 to about 1 ms
+        benchHistogram.record(value);
+        value = (value * 7 + 13) & 0xfffff;
+    }
+}
+
+// Two clock reads and a histogram record around the measured code
+void Bench::metricScope()
+{
+    QBENCHMARK {
+        MetricScope scope(benchHistogram);
+    }
+}
+
+void Bench::metricsSnapshot()
+{
+    MetricsSnapshot snapshot;
+    QBENCHMARK {
+        snapshot = Metrics::snapshot();
+    }
+
+    bool counted = false;
+    for (const QPair<QString, quint64> &counter : snapshot.counters)
+        counted |= counter.first == "bench.counter" && counter.second > 0;
+    QVERIFY(counted);
+}
+
+// Keeps the BenchmarkResult elements of a QtTest xml log
+static bool writeJson(const QString &xmlFileName, const QString &fileName)
+{
+    QFile xml(xmlFileName);
+    if(!xml.open(QIODevice::ReadOnly))
+        return false;
+
+    QJsonArray results;
+    QString function;
+    QXmlStreamReader reader(&xml);
+    while (!reader.atEnd())
+    {
+        reader.readNext();
+        if(!reader.isStartElement())
+            continue;
+        const QXmlStreamAttributes attributes = reader.attributes();
+        if(reader.name() == QLatin1String("TestFunction"))
+            function = attributes.value("name").toString();
+        else if(reader.name() == QLatin1String("BenchmarkResult"))
+        {
+            QJsonObject result;
+            result.insert("function", function);
+            result.insert("tag", attributes.value("tag").toString());
+            result.insert("metric", attributes.value("metric").toString());
+            result.insert("value", attributes.value("value").toDouble());
+            result.insert("iterations", attributes.value("iterations").toInt());
+            results.append(result);
+        }
+    }
+    if(reader.hasError())
+        return false;
+
+    QJsonObject root;
+    root.insert("qt", QString(qVersion()));
+    root.insert("benchmarks", results);
+    const QByteArray json = QJsonDocument(root).toJson();
+    if(fileName == "-")
+        return fwrite(json.constData(), 1, json.size(), stdout) == size_t(json.size());
+
+    QSaveFile file(fileName);
+    return file.open(QIODevice::WriteOnly) && file.write(json) == json.size() && file.commit();
+}
+
+// QtTest has no JSON logger: "-o file,json" runs the xml one into a
+// temporary file, which is converted when the run is done
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList arguments = app.arguments();
+    QTemporaryFile xml;
+    QString jsonFileName;
+    for (int i = 1; i + 1 < arguments.size(); i++)
+    {
+        if(arguments.at(i) == "-o" && arguments.at(i + 1).endsWith(",json"))
+        {
+            if(!xml.open())
+                return 1;
+            jsonFileName = arguments.at(i + 1).section(',', 0, -2);
+            arguments[i + 1] = xml.fileName() + ",xml";
+        }
+    }
+
+    Bench bench;
+    const int failed = QTest::qExec(&bench, arguments);
+    if(!jsonFileName.isEmpty() && !writeJson(xml.fileName(), jsonFileName))
+    {
+        qWarning("Could not write %s", qPrintable(jsonFileName));
+        return 1;
+    }
+    return failed;
+}
+
+#include "bench.moc"
@@ -0,0 +1,23 @@
+include(../tests.pri)
+
+QT += multimedia
+
+TARGET = bench
+
+SOURCES += bench.cpp \
+    ../../kalmanfilter.cpp \
+    ../../altitudefusion.cpp \
+    ../../piecewiselinearfunction.cpp \
+    ../../generator.cpp \
+    ../../igcrecord.cpp \
+    ../../trace.cpp \
+    ../../metrics.cpp
+
+HEADERS += \
+    ../../kalmanfilter.h \
+    ../../altitudefusion.h \
+    ../../piecewiselinearfunction.h \
+    ../../generator.h \
+    ../../igcrecord.h \
+    ../../trace.h \
+    ../../metrics.h
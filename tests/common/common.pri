@@ -0,0 +1,5 @@
+# Local stand-in for a Leonardo server
+QT += network
+
+SOURCES += $$PWD/stubserver.cpp
+HEADERS += $$PWD/stubserver.h
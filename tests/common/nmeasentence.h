@@ -0,0 +1,15 @@
+#ifndef NMEASENTENCE_H
+#define NMEASENTENCE_H
+
+#include <QByteArray>
+
+// Wraps a sentence body in '$', checksum and CRLF
+inline QByteArray sentence(const QByteArray &body)
+{
+    quint8 checksum = 0;
+    for (char c : body)
+        checksum ^= static_cast<quint8>(c);
+    return "$" + body + "*" + QByteArray::number(checksum, 16).toUpper().rightJustified(2, '0') + "\r\n";
+}
+
+#endif // NMEASENTENCE_H
@@ -0,0 +1,229 @@
+#include "stubserver.h"
+#include <QHostAddress>
+
+#define STUB_TICK_MS 10
+
+StubServer::StubServer(QObject *parent)
+    : QObject(parent)
+    , m_status(200)
+    , m_body("<html>Your flight has been submitted</html>")
+    , m_failCount(0)
+    , m_failStatus(503)
+    , m_keepBodies(true)
+    , m_throttle(0)
+    , m_connections(0)
+    , m_active(0)
+    , m_maxConcurrent(0)
+{
+    connect(&m_server, &QTcpServer::newConnection, this, &StubServer::newConnection);
+    m_throttleTimer.setInterval(STUB_TICK_MS);
+    connect(&m_throttleTimer, &QTimer::timeout, this, &StubServer::throttleTick);
+}
+
+bool StubServer::listen()
+{
+    return m_server.listen(QHostAddress::LocalHost);
+}
+
+QUrl StubServer::url(const QString &path) const
+{
+    return QUrl(QString("http://127.0.0.1:%1%2").arg(m_server.serverPort()).arg(path));
+}
+
+void StubServer::setResponse(int status, const QByteArray &body)
+{
+    m_status = status;
+    m_body = body;
+}
+
+void StubServer::failNext(int count, int status)
+{
+    m_failCount = count;
+    m_failStatus = status;
+}
+
+void StubServer::setThrottle(qint64 bytesPerSecond)
+{
+    m_throttle = bytesPerSecond;
+    if(m_throttle > 0)
+        m_throttleTimer.start();
+    else
+        m_throttleTimer.stop();
+}
+
+void StubServer::newConnection()
+{
+    while (QTcpSocket *socket = m_server.nextPendingConnection())
+    {
+        Client client;
+        client.socket = socket;
+        client.id = ++m_connections;
+        client.inBody = false;
+        client.remaining = 0;
+        client.hash = nullptr;
+        if(m_throttle > 0)
+            socket->setReadBufferSize(m_throttle * STUB_TICK_MS / 1000 + 1);
+        m_clients.insert(socket, client);
+
+        connect(socket, &QTcpSocket::readyRead, this, &StubServer::readClient);
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            Client client = m_clients.take(socket);
+            if(client.inBody)
+                m_active--;
+            delete client.hash;
+            socket->deleteLater();
+        });
+    }
+}
+
+void StubServer::readClient()
+{
+    if(m_throttle > 0)
+        return;
+
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    auto found = m_clients.find(socket);
+    if(found != m_clients.end())
+        read(found.value(), -1);
+}
+
+void StubServer::throttleTick()
+{
+    const qint64 budget = qMax<qint64>(1, m_throttle * STUB_TICK_MS / 1000);
+    for (auto it = m_clients.begin(); it != m_clients.end(); ++it)
+        read(it.value(), budget);
+}
+
+void StubServer::read(Client &client, qint64 budget)
+{
+    const QByteArray data = budget < 0 ? client.socket->readAll() : client.socket->read(budget);
+    if(data.isEmpty())
+        return;
+    client.buffer.append(data);
+    consume(client);
+}
+
+void StubServer::consume(Client &client)
+{
+    for (;;)
+    {
+        if(!client.inBody)
+        {
+            const int end = client.buffer.indexOf("\r\n\r\n");
+            if(end < 0)
+                return;
+
+            const QList<QByteArray> lines = client.buffer.left(end).split('\n');
+            client.buffer.remove(0, end + 4);
+
+            Request &request = client.request;
+            request = Request();
+            request.connection = client.id;
+            request.bodySize = 0;
+            const QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+            request.method = requestLine.value(0);
+            request.path = requestLine.value(1);
+            for (int i = 1; i < lines.size(); i++)
+            {
+                const int colon = lines.at(i).indexOf(':');
+                if(colon > 0)
+                    request.headers.insert(lines.at(i).left(colon).trimmed().toLower(), lines.at(i).mid(colon + 1).trimmed());
+            }
+
+            client.inBody = true;
+            client.remaining = request.headers.value("content-length").toLongLong();
+            delete client.hash;
+            client.hash = new QCryptographicHash(QCryptographicHash::Sha1);
+            m_active++;
+            m_maxConcurrent = qMax(m_maxConcurrent, m_active);
+        }
+
+        const int take = static_cast<int>(qMin<qint64>(client.remaining, client.buffer.size()));
+        if(take > 0)
+        {
+            client.hash->addData(client.buffer.constData(), take);
+            if(m_keepBodies)
+                client.request.body.append(client.buffer.constData(), take);
+            client.request.bodySize += take;
+            client.buffer.remove(0, take);
+            client.remaining -= take;
+        }
+        if(client.remaining > 0)
+            return;
+
+        respond(client);
+    }
+}
+
+void StubServer::respond(Client &client)
+{
+    client.inBody = false;
+    m_active--;
+    client.request.sha1 = client.hash->result();
+    m_requests.append(client.request);
+
+    int status = m_status;
+    QByteArray body = m_body;
+    if(m_failCount > 0)
+    {
+        m_failCount--;
+        status = m_failStatus;
+        body = "<html>unavailable</html>";
+    }
+
+    QByteArray response = "HTTP/1.1 " + QByteArray::number(status) + (status < 400 ? " OK" : " Error") + "\r\n";
+    response += "Content-Type: text/html\r\n";
+    response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    response += "Connection: keep-alive\r\n\r\n";
+    response += body;
+    client.socket->write(response);
+
+    emit requestReceived();
+}
+
+QHash<QByteArray, QByteArray> StubServer::formFields(const Request &request)
+{
+    QHash<QByteArray, QByteArray> fields;
+    const QByteArray contentType = request.headers.value("content-type");
+    const int at = contentType.indexOf("boundary=");
+    if(at < 0)
+        return fields;
+    QByteArray boundary = contentType.mid(at + 9);
+    if(boundary.startsWith('"'))
+        boundary = boundary.mid(1, boundary.size() - 2);
+    const QByteArray separator = "--" + boundary;
+
+    int from = request.body.indexOf(separator);
+    while (from >= 0)
+    {
+        from += separator.size();
+        if(request.body.mid(from, 2) == "--")
+            break;
+        const int next = request.body.indexOf(separator, from);
+        if(next < 0)
+            break;
+
+        // "\r\n" headers "\r\n\r\n" value "\r\n"
+        const QByteArray part = request.body.mid(from + 2, next - from - 4);
+        const int headerEnd = part.indexOf("\r\n\r\n");
+        const QByteArray headers = part.left(headerEnd);
+        const int nameAt = headers.indexOf("name=\"");
+        if(headerEnd >= 0 && nameAt >= 0)
+        {
+            const int nameEnd = headers.indexOf('"', nameAt + 6);
+            fields.insert(headers.mid(nameAt + 6, nameEnd - nameAt - 6), part.mid(headerEnd + 4));
+        }
+        from = next;
+    }
+    return fields;
+}
+
+QByteArray StubServer::formDisposition(const Request &request, const QByteArray &name)
+{
+    const QByteArray marker = "name=\"" + name + "\"";
+    const int at = request.body.indexOf(marker);
+    if(at < 0)
+        return QByteArray();
+    const int start = request.body.lastIndexOf("\r\n", at) + 2;
+    return request.body.mid(start, request.body.indexOf("\r\n", at) - start);
+}
@@ -0,0 +1,97 @@
+#ifndef STUBSERVER_H
+#define STUBSERVER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QCryptographicHash>
+#include <QTimer>
+#include <QVector>
+#include <QHash>
+#include <QUrl>
+
+/*
+ * Minimal HTTP/1.1 server on localhost for the upload tests. Requests are
+ * parsed as they stream in and answered with a canned response; the next
+ * failCount requests get failStatus instead, to inject failures. Bodies are
+ * kept for inspection, or only hashed when keepBodies is off so a large
+ * upload doesn't grow the test process. A throttle limits how fast request
+ * bytes are read, which through TCP flow control limits the sender.
+ * Connections are kept alive, so connectionCount() shows reuse.
+ */
+class StubServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Request
+    {
+        QByteArray method;
+        QByteArray path;
+        QHash<QByteArray, QByteArray> headers;  // lower case names
+        QByteArray body;
+        QByteArray sha1;
+        qint64 bodySize;
+        int connection;
+    };
+
+    explicit StubServer(QObject *parent = nullptr);
+
+    bool listen();
+    QUrl url(const QString &path = "/leonardo/flight_submit.php") const;
+
+    void setResponse(int status, const QByteArray &body);
+    void failNext(int count, int status = 503);
+    void setKeepBodies(bool keep) { m_keepBodies = keep; }
+    void setThrottle(qint64 bytesPerSecond);
+
+    const QVector<Request> &requests() const { return m_requests; }
+    int connectionCount() const { return m_connections; }
+    int maxConcurrent() const { return m_maxConcurrent; }
+
+    // Fields of a multipart/form-data body by name
+    static QHash<QByteArray, QByteArray> formFields(const Request &request);
+    // Content-Disposition of the named part
+    static QByteArray formDisposition(const Request &request, const QByteArray &name);
+
+signals:
+    void requestReceived();
+
+private slots:
+    void newConnection();
+    void readClient();
+    void throttleTick();
+
+private:
+    struct Client
+    {
+        QTcpSocket *socket;
+        int id;
+        QByteArray buffer;
+        bool inBody;
+        qint64 remaining;
+        Request request;
+        QCryptographicHash *hash;
+    };
+
+    void read(Client &client, qint64 budget);
+    void consume(Client &client);
+    void respond(Client &client);
+
+private:
+    QTcpServer m_server;
+    QTimer m_throttleTimer;
+    QHash<QTcpSocket *, Client> m_clients;
+    QVector<Request> m_requests;
+    int m_status;
+    QByteArray m_body;
+    int m_failCount;
+    int m_failStatus;
+    bool m_keepBodies;
+    qint64 m_throttle;
+    int m_connections;
+    int m_active;
+    int m_maxConcurrent;
+};
+
+#endif // STUBSERVER_H
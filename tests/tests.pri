@@ -0,0 +1,10 @@
+# Shared by every test: the app sources are compiled in directly, the way
+# xcvario.pro lists them, so tests need neither widgets nor sensors unless
+# they add them.
+QT += testlib
+QT -= gui
+CONFIG += testcase console c++11
+CONFIG -= app_bundle
+
+INCLUDEPATH += $$PWD/.. $$PWD/common
+DEPENDPATH += $$PWD/.. $$PWD/common
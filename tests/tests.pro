@@ -0,0 +1,24 @@
+# Unit tests and benchmarks, run with "qmake tests.pro && make && make check"
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    tst_networkaccessmanager \
+    tst_uploadqueue \
+    tst_trackingclient \
+    tst_nmeasource \
+    tst_altitudefusion \
+    tst_xcscore \
+    tst_thermalstore \
+    tst_windestimator \
+    tst_instrumentpanel \
+    tst_varioparser \
+    tst_syntheticsensor \
+    tst_tracksimplifier \
+    tst_igcvalidator \
+    tst_airspace \
+    tst_terrain \
+    tst_task \
+    tst_history \
+    tst_logbook \
+    tst_climbstats \
+    bench
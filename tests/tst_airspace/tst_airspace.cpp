@@ -0,0 +1,400 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <airspace.h>
+#include <cmath>
+
+#define METRES_PER_DEGREE 111195.0
+#define METRES_PER_NM 1852.0
+#define METRES_PER_FT 0.3048
+
+// A 0.1 x 0.1 degree box from 46N 8E, ground to 3500 ft, and a 2 NM
+// circle around 46.5N 8.5E from FL65 to FL95
+#define OPENAIR \
+    "* test airspaces\r\n" \
+    "AC R\r\n" \
+    "AN Box\r\n" \
+    "AL GND\r\n" \
+    "AH 3500ft MSL\r\n" \
+    "DP 46:00:00 N 008:00:00 E\r\n" \
+    "DP 46:06:00 N 008:00:00 E\r\n" \
+    "DP 46:06:00 N 008:06:00 E\r\n" \
+    "DP 46:00:00 N 008:06:00 E\r\n" \
+    "AC C\r\n" \
+    "AN Circle\r\n" \
+    "AL FL65\r\n" \
+    "AH FL95\r\n" \
+    "V X=46:30:00 N 008:30:00 E\r\n" \
+    "DC 2\r\n"
+
+class TestAirspace : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void polygons();
+    void arcs();
+    void heights_data();
+    void heights();
+    void insideAndDistance();
+    void clearance_data();
+    void clearance();
+    void cacheRoundTrip();
+    void queryMatchesFullScan();
+    void query();
+
+private:
+    QString writeFile(const QString &name, const QByteArray &content);
+    QString syntheticFile(int count);
+
+private:
+    QTemporaryDir m_dir;
+};
+
+void TestAirspace::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+}
+
+QString TestAirspace::writeFile(const QString &name, const QByteArray &content)
+{
+    QFile file(m_dir.filePath(name));
+    if(!file.open(QIODevice::WriteOnly))
+        return QString();
+    file.write(content);
+    return file.fileName();
+}
+
+// count boxes and circles of about 2 km on a grid over the Alps
+QString TestAirspace::syntheticFile(int count)
+{
+    QByteArray content;
+    const int columns = static_cast<int>(std::ceil(std::sqrt(count)));
+    for (int i = 0; i < count; i++)
+    {
+        const double latitude = 45.0 + (i / columns) * 0.05;
+        const double longitude = 6.0 + (i % columns) * 0.07;
+        content += QString("AC %1\r\nAN Synthetic %2\r\nAL %3ft MSL\r\nAH FL%4\r\n")
+                .arg(i % 3 ? "R" : "CTR").arg(i).arg(1000 * (i % 5)).arg(65 + 10 * (i % 4)).toLatin1();
+        if(i % 2)
+        {
+            content += QString("V X=%1N %2E\r\nDC 1.1\r\n").arg(latitude, 0, 'f', 5).arg(longitude, 0, 'f', 5).toLatin1();
+            continue;
+        }
+        for (int corner = 0; corner < 4; corner++)
+        {
+            const double cornerLatitude = latitude + (corner == 1 || corner == 2 ? 0.02 : 0);
+            const double cornerLongitude = longitude + (corner >= 2 ? 0.03 : 0);
+            content += QString("DP %1N %2E\r\n").arg(cornerLatitude, 0, 'f', 5).arg(cornerLongitude, 0, 'f', 5).toLatin1();
+        }
+    }
+    return writeFile(QString("synthetic%1.txt").arg(count), content);
+}
+
+void TestAirspace::polygons()
+{
+    AirspaceIndex index;
+    QVERIFY(index.parse(writeFile("polygons.txt", OPENAIR)));
+    QCOMPARE(index.size(), 2);
+
+    const Airspace &box = index.at(0);
+    QCOMPARE(box.name, QString("Box"));
+    QCOMPARE(box.type, QString("R"));
+    QCOMPARE(box.count, 4);
+    QCOMPARE(box.minLatitude, 46.0);
+    QCOMPARE(box.maxLatitude, 46.1);
+    QCOMPARE(box.minLongitude, 8.0);
+    QCOMPARE(box.maxLongitude, 8.1);
+
+    // A point every AIRSPACE_ARC_STEP degrees, the first not repeated
+    const Airspace &circle = index.at(1);
+    QCOMPARE(circle.name, QString("Circle"));
+    QCOMPARE(circle.type, QString("C"));
+    QCOMPARE(circle.count, static_cast<int>(360 / AIRSPACE_ARC_STEP));
+    const double radius = 2 * METRES_PER_NM / METRES_PER_DEGREE;
+    QVERIFY(qAbs(circle.maxLatitude - (46.5 + radius)) < 1e-9);
+    QVERIFY(qAbs(circle.minLatitude - (46.5 - radius)) < 1e-9);
+
+    // Fewer than three points is not an area; ignored, not fatal
+    AirspaceIndex degenerate;
+    QVERIFY(degenerate.parse(writeFile("degenerate.txt", "AC R\r\nAN Line\r\nDP 46:00:00 N 008:00:00 E\r\n"
+                                                        "DP 46:06:00 N 008:00:00 E\r\n" OPENAIR)));
+    QCOMPARE(degenerate.size(), 2);
+    QCOMPARE(degenerate.at(0).name, QString("Box"));
+}
+
+// DA and DB arcs around V X=, clockwise unless V D=-
+void TestAirspace::arcs()
+{
+    const QByteArray content =
+            "AC Q\r\nAN Clockwise\r\nV X=46:30:00 N 008:30:00 E\r\n"
+            "DP 46:30:00 N 008:30:00 E\r\nDA 1,0,90\r\n"
+            "AC Q\r\nAN Counter\r\nV X=46:30:00 N 008:30:00 E\r\nV D=-\r\n"
+            "DP 46:30:00 N 008:30:00 E\r\nDA 1,0,90\r\n"
+            "AC Q\r\nAN Between\r\nV X=46:30:00 N 008:30:00 E\r\n"
+            "DP 46:30:00 N 008:30:00 E\r\nDB 46:31:00 N 008:30:00 E,46:30:00 N 008:31:00 E\r\n";
+
+    AirspaceIndex index;
+    QVERIFY(index.parse(writeFile("arcs.txt", content)));
+    QCOMPARE(index.size(), 3);
+
+    const double radius = METRES_PER_NM / METRES_PER_DEGREE;
+    const double cosLatitude = std::cos(qDegreesToRadians(46.5));
+
+    // Quarter circle north to east: center plus 90 / 5 + 1 points, all in
+    // the north east quadrant
+    const Airspace &clockwise = index.at(0);
+    QCOMPARE(clockwise.count, 1 + 19);
+    QVERIFY(qAbs(clockwise.maxLatitude - (46.5 + radius)) < 1e-9);
+    QVERIFY(qAbs(clockwise.maxLongitude - (8.5 + radius / cosLatitude)) < 1e-9);
+    QCOMPARE(clockwise.minLatitude, 46.5);
+    QCOMPARE(clockwise.minLongitude, 8.5);
+
+    // The other way round: three quarters, through west and south
+    const Airspace &counter = index.at(1);
+    QCOMPARE(counter.count, 1 + 55);
+    QVERIFY(qAbs(counter.minLatitude - (46.5 - radius)) < 1e-9);
+    QVERIFY(qAbs(counter.minLongitude - (8.5 - radius / cosLatitude)) < 1e-9);
+
+    // DB takes the radius from the start point, 1' north, and ends on the
+    // bearing of the end point, due east
+    const Airspace &between = index.at(2);
+    QCOMPARE(between.count, 1 + 19);
+    QVERIFY(qAbs(between.maxLatitude - (46.5 + 1.0 / 60)) < 1e-9);
+    QVERIFY(qAbs(between.maxLongitude - (8.5 + 1.0 / 60 / cosLatitude)) < 1e-9);
+}
+
+void TestAirspace::heights_data()
+{
+    QTest::addColumn<QByteArray>("text");
+    QTest::addColumn<double>("metres");
+    QTest::addColumn<bool>("agl");
+
+    QTest::newRow("GND") << QByteArray("GND") << 0.0 << true;
+    QTest::newRow("SFC") << QByteArray("SFC") << 0.0 << true;
+    QTest::newRow("UNL") << QByteArray("UNL") << AIRSPACE_UNLIMITED << false;
+    QTest::newRow("FL95") << QByteArray("FL95") << 9500 * METRES_PER_FT << false;
+    QTest::newRow("FL 65") << QByteArray("FL 65") << 6500 * METRES_PER_FT << false;
+    QTest::newRow("ft MSL") << QByteArray("3500ft MSL") << 3500 * METRES_PER_FT << false;
+    QTest::newRow("bare MSL") << QByteArray("3500 MSL") << 3500 * METRES_PER_FT << false;
+    QTest::newRow("bare number") << QByteArray("4500") << 4500 * METRES_PER_FT << false;
+    QTest::newRow("ft AGL") << QByteArray("2000 ft AGL") << 2000 * METRES_PER_FT << true;
+    QTest::newRow("F AGL") << QByteArray("2000F AGL") << 2000 * METRES_PER_FT << true;
+    QTest::newRow("m") << QByteArray("1000m") << 1000.0 << false;
+    QTest::newRow("m MSL") << QByteArray("1000 m MSL") << 1000.0 << false;
+    QTest::newRow("m AGL") << QByteArray("1500 M AGL") << 1500.0 << true;
+    QTest::newRow("lower case") << QByteArray("fl75") << 7500 * METRES_PER_FT << false;
+}
+
+// AL and AH share the parser; both are read from the same text
+void TestAirspace::heights()
+{
+    QFETCH(QByteArray, text);
+    QFETCH(double, metres);
+    QFETCH(bool, agl);
+
+    const QByteArray content = "AC R\r\nAN Height\r\nAL " + text + "\r\nAH " + text + "\r\n"
+            "DP 46:00:00 N 008:00:00 E\r\nDP 46:06:00 N 008:00:00 E\r\nDP 46:06:00 N 008:06:00 E\r\n";
+    AirspaceIndex index;
+    QVERIFY(index.parse(writeFile("height.txt", content)));
+    QVERIFY(qAbs(index.at(0).floor - metres) < 1e-9);
+    QCOMPARE(index.at(0).floorAgl, agl);
+    QVERIFY(qAbs(index.at(0).ceiling - metres) < 1e-9);
+    QCOMPARE(index.at(0).ceilingAgl, agl);
+}
+
+void TestAirspace::insideAndDistance()
+{
+    AirspaceIndex index;
+    QVERIFY(index.parse(writeFile("distance.txt", OPENAIR)));
+    QVector<AirspaceHit> hits;
+
+    // Middle of the box: the east and west edges are nearest
+    QCOMPARE(index.query(46.05, 8.05, 500, 0, 10000, hits), 1);
+    QCOMPARE(hits.at(0).index, 0);
+    QVERIFY(hits.at(0).inside);
+    const double halfWidth = 0.05 * METRES_PER_DEGREE * std::cos(qDegreesToRadians(46.05));
+    QVERIFY(qAbs(hits.at(0).distance - halfWidth) < 0.01);
+
+    // 1 km east of the east edge, and 1 km north of the north east corner
+    const double eastLongitude = 8.1 + 1000 / (METRES_PER_DEGREE * std::cos(qDegreesToRadians(46.05)));
+    QCOMPARE(index.query(46.05, eastLongitude, 500, 0, 2000, hits), 1);
+    QVERIFY(!hits.at(0).inside);
+    QVERIFY(qAbs(hits.at(0).distance - 1000) < 0.01);
+    QCOMPARE(index.query(46.1 + 1000 / METRES_PER_DEGREE, 8.1, 500, 0, 2000, hits), 1);
+    QVERIFY(!hits.at(0).inside);
+    QVERIFY(qAbs(hits.at(0).distance - 1000) < 0.01);
+
+    // Beyond the search radius nothing is reported
+    QCOMPARE(index.query(46.05, eastLongitude, 500, 0, 900, hits), 0);
+    QVERIFY(hits.isEmpty());
+
+    // Circle center: the nearest boundary is an edge midpoint of the
+    // tessellation, r cos(step / 2) away
+    QCOMPARE(index.query(46.5, 8.5, 2000, 0, 5000, hits), 1);
+    QCOMPARE(hits.at(0).index, 1);
+    QVERIFY(hits.at(0).inside);
+    const double inscribed = 2 * METRES_PER_NM * std::cos(qDegreesToRadians(AIRSPACE_ARC_STEP / 2));
+    QVERIFY(qAbs(hits.at(0).distance - inscribed) < 0.5);
+
+    // 3 NM north of the center, 1 NM outside
+    QCOMPARE(index.query(46.5 + 3 * METRES_PER_NM / METRES_PER_DEGREE, 8.5, 2000, 0, 5000, hits), 1);
+    QVERIFY(!hits.at(0).inside);
+    QVERIFY(qAbs(hits.at(0).distance - METRES_PER_NM) < 0.5);
+}
+
+void TestAirspace::clearance_data()
+{
+    QTest::addColumn<QByteArray>("floor");
+    QTest::addColumn<QByteArray>("ceiling");
+    QTest::addColumn<double>("altitude");
+    QTest::addColumn<double>("ground");
+    QTest::addColumn<double>("clearance");
+
+    // Band 300 .. 1066.8 m with the floor on 300 m ground
+    QTest::newRow("above") << QByteArray("GND") << QByteArray("3500ft") << 1500.0 << 300.0 << 1500 - 1066.8;
+    QTest::newRow("inside, near floor") << QByteArray("GND") << QByteArray("3500ft") << 500.0 << 300.0 << -200.0;
+    QTest::newRow("inside, near ceiling") << QByteArray("GND") << QByteArray("3500ft") << 1000.0 << 300.0 << -(1066.8 - 1000);
+    QTest::newRow("on ground") << QByteArray("GND") << QByteArray("3500ft") << 300.0 << 300.0 << 0.0;
+    // Floor 2000 ft above 300 m ground is 909.6 m
+    QTest::newRow("below AGL floor") << QByteArray("2000 ft AGL") << QByteArray("FL95") << 800.0 << 300.0 << 909.6 - 800;
+    QTest::newRow("below FL") << QByteArray("FL65") << QByteArray("FL95") << 1500.0 << 300.0 << 1981.2 - 1500;
+    QTest::newRow("AGL ceiling") << QByteArray("GND") << QByteArray("1000 m AGL") << 1400.0 << 500.0 << -100.0;
+    QTest::newRow("unlimited") << QByteArray("1000m") << QByteArray("UNL") << 5000.0 << 0.0 << -4000.0;
+}
+
+void TestAirspace::clearance()
+{
+    QFETCH(QByteArray, floor);
+    QFETCH(QByteArray, ceiling);
+    QFETCH(double, altitude);
+    QFETCH(double, ground);
+    QFETCH(double, clearance);
+
+    const QByteArray content = "AC R\r\nAN Band\r\nAL " + floor + "\r\nAH " + ceiling + "\r\n"
+            "DP 46:00:00 N 008:00:00 E\r\nDP 46:06:00 N 008:00:00 E\r\n"
+            "DP 46:06:00 N 008:06:00 E\r\nDP 46:00:00 N 008:06:00 E\r\n";
+    AirspaceIndex index;
+    QVERIFY(index.parse(writeFile("band.txt", content)));
+
+    QVector<AirspaceHit> hits;
+    QCOMPARE(index.query(46.05, 8.05, altitude, ground, 1000, hits), 1);
+    QVERIFY(qAbs(hits.at(0).clearance - clearance) < 1e-6);
+}
+
+// The cache is used while the source's size and mtime match, even if the
+// content changed, and dropped as soon as the mtime differs
+void TestAirspace::cacheRoundTrip()
+{
+    const QString fileName = writeFile("cached.txt", OPENAIR);
+    const QString cacheFileName = m_dir.filePath("cached.cache");
+
+    AirspaceIndex parsed;
+    QVERIFY(parsed.load(fileName, cacheFileName));
+    QVERIFY(QFile::exists(cacheFileName));
+
+    AirspaceIndex cached;
+    QVERIFY(cached.load(fileName, cacheFileName));
+    QCOMPARE(cached.size(), parsed.size());
+    QVector<AirspaceHit> parsedHits, cachedHits;
+    for (int i = 0; i < parsed.size(); i++)
+    {
+        QCOMPARE(cached.at(i).name, parsed.at(i).name);
+        QCOMPARE(cached.at(i).count, parsed.at(i).count);
+        QCOMPARE(cached.at(i).floor, parsed.at(i).floor);
+        QCOMPARE(cached.at(i).ceilingAgl, parsed.at(i).ceilingAgl);
+    }
+    QCOMPARE(cached.query(46.05, 8.05, 500, 0, 10000, cachedHits), parsed.query(46.05, 8.05, 500, 0, 10000, parsedHits));
+    QCOMPARE(cachedHits.at(0).distance, parsedHits.at(0).distance);
+
+    // Same size, same mtime: the stale cache still wins
+    QFile source(fileName);
+    QVERIFY(source.open(QIODevice::ReadWrite));
+    const QDateTime modified = source.fileTime(QFileDevice::FileModificationTime);
+    QByteArray renamed(OPENAIR);
+    renamed.replace("AN Box", "AN Xob");
+    QCOMPARE(renamed.size(), QByteArray(OPENAIR).size());
+    source.write(renamed);
+    source.flush();
+    QVERIFY(source.setFileTime(modified, QFileDevice::FileModificationTime));
+    source.close();
+
+    AirspaceIndex stale;
+    QVERIFY(stale.load(fileName, cacheFileName));
+    QCOMPARE(stale.at(0).name, QString("Box"));
+
+    // A new mtime invalidates it, and the rewritten cache has the new name
+    QVERIFY(source.open(QIODevice::ReadWrite));
+    QVERIFY(source.setFileTime(modified.addSecs(10), QFileDevice::FileModificationTime));
+    source.close();
+
+    AirspaceIndex reparsed;
+    QVERIFY(reparsed.load(fileName, cacheFileName));
+    QCOMPARE(reparsed.at(0).name, QString("Xob"));
+    AirspaceIndex recached;
+    QVERIFY(recached.load(fileName, cacheFileName));
+    QCOMPARE(recached.at(0).name, QString("Xob"));
+
+    // A cache that doesn't parse is ignored
+    QFile cache(cacheFileName);
+    QVERIFY(cache.open(QIODevice::WriteOnly));
+    cache.write("garbage");
+    cache.close();
+    AirspaceIndex corrupt;
+    QVERIFY(corrupt.load(fileName, cacheFileName));
+    QCOMPARE(corrupt.size(), 2);
+}
+
+// The tree finds exactly what testing every airspace finds
+void TestAirspace::queryMatchesFullScan()
+{
+    AirspaceIndex index;
+    QVERIFY(index.parse(syntheticFile(5000)));
+    QCOMPARE(index.size(), 5000);
+
+    QVector<AirspaceHit> hits, all;
+    for (int i = 0; i < 200; i++)
+    {
+        const double latitude = 44.9 + (i % 20) * 0.19;
+        const double longitude = 5.9 + (i / 20) * 0.52;
+        const double radius = 500 + (i % 7) * 1000;
+
+        index.query(latitude, longitude, 1500, 500, radius, hits);
+        index.query(latitude, longitude, 1500, 500, 1e7, all);
+        QCOMPARE(all.size(), index.size());
+
+        QVector<int> expected;
+        for (const AirspaceHit &hit : all)
+        {
+            if(hit.inside || hit.distance <= radius)
+                expected.append(hit.index);
+        }
+        QVector<int> found;
+        for (const AirspaceHit &hit : hits)
+            found.append(hit.index);
+        std::sort(expected.begin(), expected.end());
+        std::sort(found.begin(), found.end());
+        QCOMPARE(found, expected);
+    }
+}
+
+// One query per fix on a country sized file
+void TestAirspace::query()
+{
+    AirspaceIndex index;
+    QVERIFY(index.parse(syntheticFile(5000)));
+
+    QVector<AirspaceHit> hits;
+    hits.reserve(64);
+    int found = 0;
+    QBENCHMARK
+    {
+        found = index.query(46.02, 7.51, 1500, 500, 5000, hits);
+    }
+    QVERIFY(found > 0);
+    qInfo("%d airspaces, %d within 5 km", index.size(), found);
+}
+
+QTEST_GUILESS_MAIN(TestAirspace)
+
+#include "tst_airspace.moc"
@@ -0,0 +1,9 @@
+include(../tests.pri)
+
+TARGET = tst_airspace
+
+SOURCES += tst_airspace.cpp \
+    ../../airspace.cpp
+
+HEADERS += \
+    ../../airspace.h
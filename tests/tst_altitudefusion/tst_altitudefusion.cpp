@@ -0,0 +1,125 @@
+#include <QtTest>
+#include <altitudefusion.h>
+#include <cmath>
+#include <random>
+
+#define FLIGHT_SECONDS 7200
+#define GLITCH_EVERY_S 500      // GPS altitude jumps, e.g. on a satellite change
+#define GLITCH_M 150
+
+// True altitude of a two hour flight: long climbs and glides with thermals on top
+static double trueAltitude(int t)
+{
+    return 1500 + 800 * std::sin(t / 600.0) + 200 * std::sin(t / 47.0);
+}
+
+class TestAltitudeFusion : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void replayFlight_data();
+    void replayFlight();
+    void pressureRoundTrip();
+};
+
+void TestAltitudeFusion::replayFlight_data()
+{
+    QTest::addColumn<double>("qnh");           // Pa at takeoff
+    QTest::addColumn<double>("drift");         // Pa per hour
+    QTest::addColumn<double>("gpsSigma");      // m
+
+    QTest::newRow("high, falling") << 102000.0 << -100.0 << 8.0;
+    QTest::newRow("low, rising") << 99000.0 << 100.0 << 8.0;
+    QTest::newRow("standard, noisy gps") << 101325.0 << 0.0 << 15.0;
+    QTest::newRow("high, good gps") << 103500.0 << -50.0 << 4.0;
+}
+
+// Replays a synthetic flight at 1 Hz: the barometer sees the true altitude
+// through the actual QNH, GPS adds noise of the reported accuracy and the odd
+// glitch. The fused altitude must settle within seconds, then track the truth
+// much better than GPS alone, through the QNH drift, and ignore the glitches.
+void TestAltitudeFusion::replayFlight()
+{
+    QFETCH(double, qnh);
+    QFETCH(double, drift);
+    QFETCH(double, gpsSigma);
+
+    std::mt19937 random(32);
+    std::normal_distribution<double> noise(0, gpsSigma);
+    AltitudeFusion fusion;
+
+    int converged = -1;
+    int glitches = 0;
+    int rejected = 0;
+    int glitchesRejected = 0;
+    double fusedSquares = 0;
+    double gpsSquares = 0;
+    double maxError = 0;
+    int samples = 0;
+    double finalQnh = 0;
+    double estimatedQnh = 0;
+
+    for (int t = 0; t < FLIGHT_SECONDS; t++)
+    {
+        const double altitude = trueAltitude(t);
+        const double seaLevel = qnh + drift * t / 3600;
+        const double pressure = AltitudeToPressure(altitude, seaLevel);
+        const double baro = PressureToAltitude(pressure, 101325.0);
+
+        double gps = altitude + noise(random);
+        const bool glitch = t > 120 && t % GLITCH_EVERY_S == 0;
+        if(glitch)
+        {
+            gps += GLITCH_M;
+            glitches++;
+        }
+
+        if(!fusion.Update(gps, baro, gpsSigma * 1.25, t > 0 ? 1 : 0))
+        {
+            rejected++;
+            if(glitch)
+                glitchesRejected++;
+        }
+        if(converged < 0 && fusion.IsConverged())
+            converged = t;
+
+        if(t >= 60)
+        {
+            const double error = baro + fusion.GetOffset() - altitude;
+            fusedSquares += error * error;
+            gpsSquares += (gps - altitude) * (gps - altitude);
+            maxError = qMax(maxError, std::fabs(error));
+            samples++;
+        }
+        finalQnh = seaLevel;
+        estimatedQnh = fusion.GetQnh(pressure, baro);
+    }
+
+    const double fusedRms = std::sqrt(fusedSquares / samples);
+    const double gpsRms = std::sqrt(gpsSquares / samples);
+    qInfo("converged after %d s, rms %.2f m fused vs %.2f m gps, max %.2f m, QNH off by %.1f Pa",
+          converged, fusedRms, gpsRms, maxError, estimatedQnh - finalQnh);
+
+    QVERIFY(converged >= 0 && converged <= 30);
+    QVERIFY(fusedRms < 3);
+    QVERIFY(fusedRms < gpsRms / 3);
+    QVERIFY(maxError < 6);
+    QCOMPARE(glitchesRejected, glitches);
+    QVERIFY(rejected <= glitches + FLIGHT_SECONDS / 1000);
+    QVERIFY(std::fabs(estimatedQnh - finalQnh) < 50);
+}
+
+void TestAltitudeFusion::pressureRoundTrip()
+{
+    for (double altitude = -200; altitude < 9000; altitude += 250)
+    {
+        const double pressure = AltitudeToPressure(altitude, 101325.0);
+        QVERIFY(std::fabs(PressureToAltitude(pressure, 101325.0) - altitude) < 1e-6);
+    }
+    QVERIFY(std::fabs(PressureToAltitude(101325.0, 101325.0)) < 1e-9);
+}
+
+QTEST_GUILESS_MAIN(TestAltitudeFusion)
+
+#include "tst_altitudefusion.moc"
@@ -0,0 +1,9 @@
+include(../tests.pri)
+
+TARGET = tst_altitudefusion
+
+SOURCES += tst_altitudefusion.cpp \
+    ../../altitudefusion.cpp
+
+HEADERS += \
+    ../../altitudefusion.h
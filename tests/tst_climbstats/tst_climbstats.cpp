@@ -0,0 +1,211 @@
+#include <QtTest>
+#include <climbstats.h>
+#include <cmath>
+
+#define RUN_S 60
+#define THERMAL_S 20.0          // period of the climb and sink cycle
+#define NOISE 0.5               // m/s, at most either way
+#define SPIKE 8.0               // m/s, one sample
+#define SPIKE_S 45
+
+struct Sample
+{
+    qint64 time;
+    double value;
+    double dt;
+};
+
+// A minute of vario at rate Hz with noise from a fixed linear congruential
+// generator, and optionally a single sample spike up at SPIKE_S and one
+// down right after it
+static QVector<Sample> feed(int rate, bool spike)
+{
+    const int count = RUN_S * rate;
+    QVector<Sample> samples;
+    samples.reserve(count);
+    quint32 seed = 12345;
+    for (int i = 0; i < count; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        const double noise = (static_cast<double>(seed >> 8) / (1 << 24) * 2 - 1) * NOISE;
+        const double seconds = static_cast<double>(i) / rate;
+        double value = 2 * std::sin(2 * M_PI * seconds / THERMAL_S) + noise;
+        if(spike && i == SPIKE_S * rate)
+            value = SPIKE;
+        else if(spike && i == SPIKE_S * rate + 1)
+            value = -SPIKE;
+        samples.append({ 36000000 + static_cast<qint64>(i) * 1000 / rate, value, 1.0 / rate });
+    }
+    return samples;
+}
+
+struct Expected
+{
+    double average;
+    double minimum;
+    double maximum;
+};
+
+// Time-weighted average, minimum and maximum of the samples newer than
+// since, scanning back from the last one
+static Expected bruteForce(const QVector<Sample> &samples, int last, qint64 since)
+{
+    Expected expected = { 0, samples.at(last).value, samples.at(last).value };
+    double sum = 0, time = 0;
+    for (int i = last; i >= 0 && samples.at(i).time > since; i--)
+    {
+        sum += samples.at(i).value * samples.at(i).dt;
+        time += samples.at(i).dt;
+        expected.minimum = qMin(expected.minimum, samples.at(i).value);
+        expected.maximum = qMax(expected.maximum, samples.at(i).value);
+    }
+    expected.average = sum / time;
+    return expected;
+}
+
+class TestClimbStats : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void window_data();
+    void window();
+    void stats();
+    void add_data();
+    void add();
+};
+
+void TestClimbStats::window_data()
+{
+    QTest::addColumn<double>("seconds");
+    QTest::addColumn<int>("rate");
+    QTest::addColumn<bool>("spike");
+
+    for (double seconds : { 1.0, 10.0, 30.0 })
+    {
+        for (int rate : { 10, 100, 1000 })
+        {
+            for (bool spike : { false, true })
+            {
+                const QByteArray tag = QString("%1 s, %2 Hz%3").arg(seconds).arg(rate).arg(spike ? ", spike" : "").toLatin1();
+                QTest::newRow(tag.constData()) << seconds << rate << spike;
+            }
+        }
+    }
+}
+
+// Against a scan of the raw samples every tenth of a second. A closed
+// bucket stays in the window while its newest sample does, so its older
+// samples may reach back up to one bucket further than the scan.
+void TestClimbStats::window()
+{
+    QFETCH(double, seconds);
+    QFETCH(int, rate);
+    QFETCH(bool, spike);
+
+    const QVector<Sample> samples = feed(rate, spike);
+    const qint64 length = static_cast<qint64>(seconds * 1000);
+    const qint64 bucket = length / (CLIMB_WINDOW_CAPACITY - 1) + 1;
+    // Largest share of the window the bucket at its old end can add
+    const double share = static_cast<double>(bucket + 1000 / rate) / length;
+
+    ClimbWindow window(seconds);
+    QVERIFY(window.isEmpty());
+    double worst = 0;
+    for (int i = 0; i < samples.size(); i++)
+    {
+        window.add(samples.at(i).time, samples.at(i).value, samples.at(i).dt);
+        if(i % qMax(1, rate / 10))
+            continue;
+
+        const qint64 now = samples.at(i).time;
+        const Expected inner = bruteForce(samples, i, now - length);
+        const Expected outer = bruteForce(samples, i, now - length - bucket);
+
+        const double error = qAbs(window.average() - inner.average);
+        worst = qMax(worst, error);
+        QVERIFY2(error <= 2 * (2 + NOISE + SPIKE) * share + 1e-9,
+                 qPrintable(QString("average %1, expected %2 at %3 ms").arg(window.average()).arg(inner.average).arg(now - samples.first().time)));
+        QVERIFY2(window.minimum() <= inner.minimum && window.minimum() >= outer.minimum,
+                 qPrintable(QString("minimum %1, expected %2 at %3 ms").arg(window.minimum()).arg(inner.minimum).arg(now - samples.first().time)));
+        QVERIFY2(window.maximum() >= inner.maximum && window.maximum() <= outer.maximum,
+                 qPrintable(QString("maximum %1, expected %2 at %3 ms").arg(window.maximum()).arg(inner.maximum).arg(now - samples.first().time)));
+    }
+    qInfo("%.0f s window at %d Hz: average off by at most %.4f m/s", seconds, rate, worst);
+
+    // The spikes are still in a window that reaches back to them
+    const bool reaches = samples.last().time - length < samples.at(SPIKE_S * rate).time;
+    if(spike && reaches)
+    {
+        QCOMPARE(window.maximum(), SPIKE);
+        QCOMPARE(window.minimum(), -SPIKE);
+    }
+    else
+    {
+        QVERIFY(window.maximum() < SPIKE);
+        QVERIFY(window.minimum() > -SPIKE);
+    }
+
+    window.reset();
+    QVERIFY(window.isEmpty());
+    QCOMPARE(window.average(), 0.0);
+}
+
+// The thermal values follow the altitude while circling and clear after it
+void TestClimbStats::stats()
+{
+    ClimbStats stats;
+    qint64 time = 36000000;
+    double altitude = 1000;
+    for (int i = 0; i < 600; i++, time += 100)
+    {
+        const bool circling = i >= 100 && i < 500;
+        const double vario = circling ? (i % 50 < 40 ? 2.0 : -1.0) : -1.0;
+        altitude += vario * 0.1;
+        stats.update(time, vario, altitude, 0.1, circling);
+
+        if(i == 499)
+        {
+            QVERIFY(stats.inThermal());
+            // After the first circling sample 319 climbing at 2 m/s, 80 sinking at 1 m/s
+            QVERIFY(qAbs(stats.thermalGain() - (319 * 0.2 - 80 * 0.1)) < 1e-6);
+            QVERIFY(qAbs(stats.thermalTotalGain() - 319 * 0.2) < 1e-6);
+            QVERIFY(qAbs(stats.thermalAverage() - stats.thermalGain() / 39.9) < 1e-6);
+            QVERIFY(qAbs(stats.average30() - (240 * 2.0 - 60 * 1.0) / 300) < 1e-6);
+            QCOMPARE(stats.maxClimb(), 2.0);
+            QCOMPARE(stats.maxSink(), -1.0);
+        }
+    }
+    QVERIFY(!stats.inThermal());
+    QCOMPARE(stats.thermalGain(), 0.0);
+    QCOMPARE(stats.current(), -1.0);
+}
+
+void TestClimbStats::add_data()
+{
+    QTest::addColumn<int>("rate");
+
+    QTest::newRow("10 Hz") << 10;
+    QTest::newRow("100 Hz") << 100;
+    QTest::newRow("1 kHz") << 1000;
+}
+
+// Per sample cost of the three windows of a minute's feed
+void TestClimbStats::add()
+{
+    QFETCH(int, rate);
+
+    const QVector<Sample> samples = feed(rate, true);
+    ClimbStats stats;
+    QBENCHMARK
+    {
+        stats.reset();
+        for (const Sample &sample : samples)
+            stats.update(sample.time, sample.value, 1000, sample.dt, false);
+    }
+    QCOMPARE(stats.maxClimb(), SPIKE);
+}
+
+QTEST_GUILESS_MAIN(TestClimbStats)
+
+#include "tst_climbstats.moc"
@@ -0,0 +1,9 @@
+include(../tests.pri)
+
+TARGET = tst_climbstats
+
+SOURCES += tst_climbstats.cpp \
+    ../../climbstats.cpp
+
+HEADERS += \
+    ../../climbstats.h
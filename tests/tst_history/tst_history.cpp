@@ -0,0 +1,271 @@
+#include <QtTest>
+#include <history.h>
+#include <cmath>
+#include <limits>
+
+#define FEED_START 36000000     // ms, 10:00
+#define FEED_PERIOD 100         // ms, 10 Hz
+#define FEED_HOURS 5
+#define THERMAL_S 120.0         // period of the climb and sink cycle
+#define NOISE 0.3               // m/s, at most either way
+
+struct Sample
+{
+    qint64 time;
+    double value;
+};
+
+// Five hours of a 10 Hz vario: climbs and sinks with noise from a fixed
+// linear congruential generator so every run sees the same feed
+static QVector<Sample> feed()
+{
+    const int count = FEED_HOURS * 3600 * 1000 / FEED_PERIOD;
+    QVector<Sample> samples;
+    samples.reserve(count);
+    quint32 seed = 12345;
+    for (int i = 0; i < count; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        const double noise = (static_cast<double>(seed >> 8) / (1 << 24) * 2 - 1) * NOISE;
+        const double seconds = i * FEED_PERIOD / 1000.0;
+        samples.append({ FEED_START + static_cast<qint64>(i) * FEED_PERIOD, 2.5 * std::sin(2 * M_PI * seconds / THERMAL_S) + noise });
+    }
+    return samples;
+}
+
+// Per column minimum and maximum of the raw samples, put into buckets of
+// bucketLength and the buckets into columns as minMax() does
+static void bruteForce(const QVector<Sample> &samples, qint64 from, qint64 to, int columns, qint64 bucketLength,
+                       QVector<float> &minimum, QVector<float> &maximum)
+{
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    minimum.fill(nan, columns);
+    maximum.fill(nan, columns);
+    const double columnLength = static_cast<double>(to - from) / columns;
+    for (const Sample &sample : samples)
+    {
+        const qint64 start = sample.time - sample.time % bucketLength;
+        if(start + bucketLength <= from || start >= to)
+            continue;
+        const int column = qBound(0, static_cast<int>((qMax(start, from) - from) / columnLength), columns - 1);
+        const float value = static_cast<float>(sample.value);
+        if(qIsNaN(minimum[column]) || value < minimum[column])
+            minimum[column] = value;
+        if(qIsNaN(maximum[column]) || value > maximum[column])
+            maximum[column] = value;
+    }
+}
+
+static bool same(float a, float b)
+{
+    return (qIsNaN(a) && qIsNaN(b)) || a == b;
+}
+
+class TestHistory : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void ringWraparound_data();
+    void ringWraparound();
+    void minMax_data();
+    void minMax();
+    void lttb_data();
+    void lttb();
+    void append();
+    void minMaxSpeed();
+
+private:
+    QVector<Sample> m_samples;
+    HistoryChannel m_channel;
+};
+
+void TestHistory::initTestCase()
+{
+    m_samples = feed();
+    for (const Sample &sample : m_samples)
+        m_channel.append(sample.time, sample.value);
+    QCOMPARE(m_channel.firstTime(), m_samples.first().time);
+    QCOMPARE(m_channel.lastTime(), m_samples.last().time);
+}
+
+void TestHistory::ringWraparound_data()
+{
+    QTest::addColumn<int>("extra");
+
+    // Buckets past HISTORY_LEVEL_CAPACITY on the finest level
+    QTest::newRow("one") << 1;
+    QTest::newRow("half a ring") << HISTORY_LEVEL_CAPACITY / 2;
+    QTest::newRow("three rings") << 3 * HISTORY_LEVEL_CAPACITY + 7;
+}
+
+// One sample per finest bucket, valued by its index: the ring keeps the
+// newest HISTORY_LEVEL_CAPACITY closed buckets plus the open one, across
+// the seam, and a span reaching one bucket further comes from the next
+// level, whose buckets are two samples long
+void TestHistory::ringWraparound()
+{
+    QFETCH(int, extra);
+
+    HistoryChannel channel;
+    const int count = HISTORY_LEVEL_CAPACITY + extra;
+    for (int i = 0; i < count; i++)
+        channel.append(FEED_START + static_cast<qint64>(i) * HISTORY_BASE_MS, i);
+    channel.append(FEED_START, -1);      // out of order, ignored
+
+    const int oldest = count - 1 - HISTORY_LEVEL_CAPACITY;
+    auto time = [](int index) { return FEED_START + static_cast<qint64>(index) * HISTORY_BASE_MS; };
+
+    QVector<float> minimum(HISTORY_LEVEL_CAPACITY + 1), maximum(HISTORY_LEVEL_CAPACITY + 1);
+    channel.minMax(time(oldest), time(count), HISTORY_LEVEL_CAPACITY + 1, minimum.data(), maximum.data());
+    for (int column = 0; column <= HISTORY_LEVEL_CAPACITY; column++)
+    {
+        QCOMPARE(minimum.at(column), static_cast<float>(oldest + column));
+        QCOMPARE(maximum.at(column), static_cast<float>(oldest + column));
+    }
+
+    // From the middle of the ring, which wraps for all but the first row
+    const int middle = oldest + HISTORY_LEVEL_CAPACITY / 3;
+    channel.minMax(time(middle), time(middle + 100), 100, minimum.data(), maximum.data());
+    for (int column = 0; column < 100; column++)
+        QCOMPARE(minimum.at(column), static_cast<float>(middle + column));
+
+    const int columns = HISTORY_LEVEL_CAPACITY + 2;
+    minimum.resize(columns);
+    maximum.resize(columns);
+    channel.minMax(time(oldest - 1), time(count), columns, minimum.data(), maximum.data());
+    int filled = 0;
+    float lowest = count, highest = -1;
+    for (int column = 0; column < columns; column++)
+    {
+        if(qIsNaN(minimum.at(column)))
+            continue;
+        filled++;
+        lowest = qMin(lowest, minimum.at(column));
+        highest = qMax(highest, maximum.at(column));
+    }
+    QVERIFY(filled < columns);
+    const int first = qMax(oldest - 1, 0);
+    QCOMPARE(lowest, static_cast<float>(first - first % 2));
+    QCOMPARE(highest, static_cast<float>(count - 1));
+}
+
+void TestHistory::minMax_data()
+{
+    QTest::addColumn<qint64>("from");
+    QTest::addColumn<qint64>("to");
+    QTest::addColumn<int>("columns");
+    QTest::addColumn<qint64>("bucketLength");
+
+    const qint64 end = FEED_START + static_cast<qint64>(FEED_HOURS) * 3600000;
+    const qint64 minute = 60000, hour = 3600000;
+
+    // Columns as long as a level's buckets draw from that level
+    QTest::newRow("last minute, 0.1 s") << end - minute << end << 600 << qint64(100);
+    QTest::newRow("last half hour, 1.6 s") << end - 30 * minute << end << 1125 << qint64(1600);
+    QTest::newRow("last 4 h, 12.8 s") << end - 4 * hour << end << 1125 << qint64(12800);
+
+    // Longer columns draw from the finest level not longer than them
+    QTest::newRow("whole flight, 1000 columns") << qint64(FEED_START) << end << 1000 << qint64(12800);
+    QTest::newRow("first hour, 60 columns") << qint64(FEED_START) << FEED_START + hour << 60 << qint64(51200);
+
+    // The finer rings don't reach back five hours: coarsened to the first
+    // level that does, 12.8 s buckets covering 7.3 h
+    QTest::newRow("first hour, 0.1 s") << qint64(FEED_START) << FEED_START + hour << 36000 << qint64(12800);
+    QTest::newRow("last 10 min, 4 h ago") << end - 4 * hour << end - 4 * hour + 10 * minute << 600 << qint64(12800);
+}
+
+// minMax() against a scan of the raw samples at the level it should use
+void TestHistory::minMax()
+{
+    QFETCH(qint64, from);
+    QFETCH(qint64, to);
+    QFETCH(int, columns);
+    QFETCH(qint64, bucketLength);
+
+    QVector<float> minimum(columns), maximum(columns);
+    m_channel.minMax(from, to, columns, minimum.data(), maximum.data());
+
+    QVector<float> expectedMinimum, expectedMaximum;
+    bruteForce(m_samples, from, to, columns, bucketLength, expectedMinimum, expectedMaximum);
+
+    int filled = 0;
+    for (int column = 0; column < columns; column++)
+    {
+        QVERIFY2(same(minimum.at(column), expectedMinimum.at(column)) && same(maximum.at(column), expectedMaximum.at(column)),
+                 qPrintable(QString("column %1: %2..%3, expected %4..%5").arg(column)
+                            .arg(minimum.at(column)).arg(maximum.at(column))
+                            .arg(expectedMinimum.at(column)).arg(expectedMaximum.at(column))));
+        if(!qIsNaN(minimum.at(column)))
+            filled++;
+    }
+    QVERIFY(filled > 0);
+}
+
+void TestHistory::lttb_data()
+{
+    QTest::addColumn<qint64>("span");
+    QTest::addColumn<int>("points");
+
+    QTest::newRow("last 10 min, 300 points") << qint64(600000) << 300;
+    QTest::newRow("last hour, 500 points") << qint64(3600000) << 500;
+    QTest::newRow("whole flight, 1000 points") << qint64(FEED_HOURS) * 3600000 << 1000;
+    QTest::newRow("last 10 s, 500 points") << qint64(10000) << 500;
+}
+
+// Exactly points out when there are more bucket means than that, all of
+// them otherwise; the first and last are the buckets at the span's ends
+void TestHistory::lttb()
+{
+    QFETCH(qint64, span);
+    QFETCH(int, points);
+
+    const qint64 to = m_samples.last().time + FEED_PERIOD;
+    const qint64 from = to - span;
+    QVector<QPointF> out;
+    m_channel.lttb(from, to, points, out);
+
+    const int samples = static_cast<int>(span / FEED_PERIOD);
+    QCOMPARE(out.size(), qMin(points, samples));
+    const double slack = qMax(static_cast<double>(span) / points, static_cast<double>(FEED_PERIOD));
+    QVERIFY(qAbs(out.first().x() - from) <= slack);
+    QVERIFY(qAbs(out.last().x() - to) <= slack);
+    for (int i = 1; i < out.size(); i++)
+        QVERIFY(out.at(i).x() > out.at(i - 1).x());
+    for (const QPointF &point : out)
+        QVERIFY(qAbs(point.y()) <= 2.5 + NOISE);
+
+    m_channel.lttb(from, to, 2, out);
+    QVERIFY(out.isEmpty());
+}
+
+// Per sample cost over a five hour flight
+void TestHistory::append()
+{
+    HistoryChannel channel;
+    QBENCHMARK
+    {
+        channel.reset();
+        for (const Sample &sample : m_samples)
+            channel.append(sample.time, sample.value);
+    }
+    QCOMPARE(channel.lastTime(), m_samples.last().time);
+}
+
+// A redraw of the whole flight and of the last ten minutes, 1000 columns
+void TestHistory::minMaxSpeed()
+{
+    QVector<float> minimum(1000), maximum(1000);
+    const qint64 to = m_samples.last().time + FEED_PERIOD;
+    QBENCHMARK
+    {
+        m_channel.minMax(FEED_START, to, 1000, minimum.data(), maximum.data());
+        m_channel.minMax(to - 600000, to, 1000, minimum.data(), maximum.data());
+    }
+    QVERIFY(!qIsNaN(minimum.first()));
+}
+
+QTEST_GUILESS_MAIN(TestHistory)
+
+#include "tst_history.moc"
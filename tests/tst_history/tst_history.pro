@@ -0,0 +1,9 @@
+include(../tests.pri)
+
+TARGET = tst_history
+
+SOURCES += tst_history.cpp \
+    ../../history.cpp
+
+HEADERS += \
+    ../../history.h
@@ -0,0 +1,337 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <igcvalidator.h>
+#include <igcrecord.h>
+
+#define HEADER "AXGD000 XcVario v1.0\r\nHFDTE110620\r\n"
+#define POSITION "5206343N00006198WA0058700558"
+
+// A B record at the given time of day with the fields after it
+static QByteArray bRecord(int time, const char *position = POSITION)
+{
+    char clock[8];
+    qsnprintf(clock, sizeof(clock), "%02d%02d%02d", time / 3600, time / 60 % 60, time % 60);
+    return QByteArray("B") + clock + position + "\r\n";
+}
+
+class TestIgcValidator : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void validFile_data();
+    void validFile();
+    void defects_data();
+    void defects();
+    void dateHeader_data();
+    void dateHeader();
+    void monotonicTime_data();
+    void monotonicTime();
+    void missingFile();
+    void boundedIssueList();
+    void repairRoundTrip();
+    void validateLongFlight();
+
+private:
+    QString writeFile(const QString &name, const QByteArray &content);
+
+private:
+    QTemporaryDir m_dir;
+};
+
+void TestIgcValidator::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+}
+
+QString TestIgcValidator::writeFile(const QString &name, const QByteArray &content)
+{
+    QFile file(m_dir.filePath(name));
+    if(!file.open(QIODevice::WriteOnly))
+        return QString();
+    file.write(content);
+    return file.fileName();
+}
+
+void TestIgcValidator::validFile_data()
+{
+    QTest::addColumn<QByteArray>("content");
+    QTest::addColumn<int>("fixes");
+
+    QTest::newRow("crlf") << QByteArray(HEADER) + bRecord(39695) + bRecord(39696) << 2;
+    QTest::newRow("lf") << QByteArray("AXGD000\nHFDTE110620\n") + bRecord(39695).replace("\r\n", "\n") << 1;
+    QTest::newRow("no final newline") << QByteArray(HEADER) + bRecord(39695).left(35) << 1;
+    QTest::newRow("I extension") << QByteArray(HEADER "I013638VAR\r\n") + bRecord(39695, POSITION "+050") << 1;
+    QTest::newRow("south west") << QByteArray(HEADER) + bRecord(39695, "3352000S07053000WA0058700558") << 1;
+    QTest::newRow("negative altitude") << QByteArray(HEADER) + bRecord(39695, POSITION).replace("00587", "-0012") << 1;
+    QTest::newRow("other records") << QByteArray(HEADER "LXGD comment\r\n") + bRecord(39695) + "GABCDEF\r\n" << 1;
+}
+
+void TestIgcValidator::validFile()
+{
+    QFETCH(QByteArray, content);
+    QFETCH(int, fixes);
+
+    IgcValidator validator;
+    QVERIFY2(validator.validate(writeFile("valid.igc", content)), qPrintable(validator.firstIssue()));
+    QVERIFY(validator.isValid());
+    QCOMPARE(validator.issueCount(), 0);
+    QCOMPARE(validator.fixCount(), fixes);
+    QVERIFY(validator.firstIssue().isEmpty());
+}
+
+void TestIgcValidator::defects_data()
+{
+    QTest::addColumn<QByteArray>("content");
+    QTest::addColumn<int>("line");
+    QTest::addColumn<int>("column");
+    QTest::addColumn<bool>("repairable");
+
+    const QByteArray fix = bRecord(39695);
+    QTest::newRow("empty line") << QByteArray(HEADER) + fix + "\r\n" + bRecord(39696) << 4 << 1 << true;
+    QTest::newRow("no A record") << QByteArray("HFDTE110620\r\n") + fix << 1 << 1 << false;
+    QTest::newRow("unknown record") << QByteArray(HEADER "Zulu\r\n") + fix << 3 << 1 << false;
+    QTest::newRow("B before HFDTE") << QByteArray("AXGD000\r\n") + fix << 2 << 1 << false;
+    QTest::newRow("no B records") << QByteArray(HEADER "LXGD comment\r\n") << 3 << 1 << false;
+    QTest::newRow("short B record") << QByteArray(HEADER) + fix.left(30) + "\r\n" << 3 << 31 << false;
+    QTest::newRow("hour") << QByteArray(HEADER) + bRecord(24 * 3600) << 3 << 2 << false;
+    QTest::newRow("minute") << QByteArray(HEADER "B116035" POSITION "\r\n") << 3 << 4 << false;
+    QTest::newRow("second") << QByteArray(HEADER "B110160" POSITION "\r\n") << 3 << 6 << false;
+    QTest::newRow("latitude degrees") << QByteArray(HEADER) + bRecord(39695, "9100000N00006198WA0058700558") << 3 << 8 << false;
+    QTest::newRow("latitude digit") << QByteArray(HEADER) + bRecord(39695, "52063x3N00006198WA0058700558") << 3 << 13 << false;
+    QTest::newRow("latitude hemisphere") << QByteArray(HEADER) + bRecord(39695, "5206343X00006198WA0058700558") << 3 << 15 << false;
+    QTest::newRow("longitude degrees") << QByteArray(HEADER) + bRecord(39695, "5206343N18100000EA0058700558") << 3 << 16 << false;
+    QTest::newRow("longitude hemisphere") << QByteArray(HEADER) + bRecord(39695, "5206343N00006198XA0058700558") << 3 << 24 << false;
+    QTest::newRow("validity") << QByteArray(HEADER) + bRecord(39695, "5206343N00006198WX0058700558") << 3 << 25 << false;
+    QTest::newRow("altitude") << QByteArray(HEADER) + bRecord(39695, "5206343N00006198WA00587005x8") << 3 << 34 << false;
+    // Written by older versions: "%2.3f" minutes without the leading zero,
+    // and minutes rounded up to 60.000
+    QTest::newRow("4-digit minutes") << QByteArray(HEADER) + bRecord(39695, "525123N00006198WA0058700558+050") << 3 << 14 << true;
+    QTest::newRow("60 minutes") << QByteArray(HEADER) + bRecord(39695, "5260000N00006198WA0058700558") << 3 << 10 << true;
+    QTest::newRow("time backwards") << QByteArray(HEADER) + fix + bRecord(39690) << 4 << 2 << true;
+}
+
+// The first issue points at the defect; one defect is one issue
+void TestIgcValidator::defects()
+{
+    QFETCH(QByteArray, content);
+    QFETCH(int, line);
+    QFETCH(int, column);
+    QFETCH(bool, repairable);
+
+    IgcValidator validator;
+    QVERIFY(!validator.validate(writeFile("defect.igc", content)));
+    QVERIFY(!validator.isValid());
+    QCOMPARE(validator.issueCount(), 1);
+    QCOMPARE(validator.issues().size(), 1);
+
+    const IgcIssue &issue = validator.issues().first();
+    QCOMPARE(issue.line, line);
+    QCOMPARE(issue.column, column);
+    QCOMPARE(issue.repairable, repairable);
+    QCOMPARE(validator.isRepairable(), repairable);
+    QVERIFY(!issue.message.isEmpty());
+    QVERIFY(validator.firstIssue().startsWith(QString("Line %1, column %2: ").arg(line).arg(column)));
+}
+
+void TestIgcValidator::dateHeader_data()
+{
+    QTest::addColumn<QByteArray>("header");
+    QTest::addColumn<int>("column");    // 0 if valid
+
+    QTest::newRow("2008") << QByteArray("HFDTE110620") << 0;
+    QTest::newRow("2016") << QByteArray("HFDTEDATE:110620,01") << 0;
+    QTest::newRow("short") << QByteArray("HFDTE1106") << 6;
+    QTest::newRow("2016 short") << QByteArray("HFDTEDATE:1106") << 11;
+    QTest::newRow("letter") << QByteArray("HFDTE11x620") << 8;
+    QTest::newRow("day 0") << QByteArray("HFDTE000620") << 6;
+    QTest::newRow("day 32") << QByteArray("HFDTE320620") << 6;
+    QTest::newRow("month 0") << QByteArray("HFDTE110020") << 8;
+    QTest::newRow("month 13") << QByteArray("HFDTE111320") << 8;
+    QTest::newRow("2016 month 13") << QByteArray("HFDTEDATE:111320,01") << 13;
+}
+
+void TestIgcValidator::dateHeader()
+{
+    QFETCH(QByteArray, header);
+    QFETCH(int, column);
+
+    IgcValidator validator;
+    const bool valid = validator.validate(writeFile("date.igc", "AXGD000\r\n" + header + "\r\n" + bRecord(39695)));
+    QCOMPARE(valid, column == 0);
+    if(valid)
+        return;
+
+    // A malformed date doesn't count as one, so the fix is also reported
+    QCOMPARE(validator.issueCount(), 2);
+    QCOMPARE(validator.issues().at(0).line, 2);
+    QCOMPARE(validator.issues().at(0).column, column);
+    QVERIFY(!validator.issues().at(0).repairable);
+    QCOMPARE(validator.issues().at(1).line, 3);
+}
+
+void TestIgcValidator::monotonicTime_data()
+{
+    QTest::addColumn<QVector<int>>("times");
+    QTest::addColumn<int>("backwardsLine");     // 0 if none
+
+    QTest::newRow("increasing") << QVector<int>{ 39695, 39696, 39700 } << 0;
+    QTest::newRow("repeated") << QVector<int>{ 39695, 39695, 39696 } << 0;
+    QTest::newRow("one second back") << QVector<int>{ 39695, 39696, 39695 } << 5;
+    QTest::newRow("an hour back") << QVector<int>{ 39695, 39695 - 3600 } << 4;
+    QTest::newRow("midnight") << QVector<int>{ 86398, 86399, 0, 1 } << 0;
+    QTest::newRow("back after midnight") << QVector<int>{ 86399, 0, 2, 1 } << 6;
+}
+
+// Times never go backwards, except at midnight
+void TestIgcValidator::monotonicTime()
+{
+    QFETCH(QVector<int>, times);
+    QFETCH(int, backwardsLine);
+
+    QByteArray content(HEADER);
+    for (int time : times)
+        content += bRecord(time);
+
+    IgcValidator validator;
+    const bool valid = validator.validate(writeFile("time.igc", content));
+    QCOMPARE(valid, backwardsLine == 0);
+    if(valid)
+    {
+        QCOMPARE(validator.fixCount(), times.size());
+        return;
+    }
+
+    QCOMPARE(validator.issueCount(), 1);
+    QCOMPARE(validator.issues().first().line, backwardsLine);
+    QCOMPARE(validator.issues().first().column, 2);
+    QVERIFY(validator.isRepairable());
+    QCOMPARE(validator.fixCount(), times.size() - 1);
+}
+
+void TestIgcValidator::missingFile()
+{
+    IgcValidator validator;
+    QVERIFY(!validator.validate(m_dir.filePath("missing.igc")));
+    QCOMPARE(validator.issueCount(), 1);
+    QCOMPARE(validator.issues().first().line, 0);
+    QVERIFY(!validator.isRepairable());
+    QVERIFY(!validator.repair(m_dir.filePath("missing.igc"), m_dir.filePath("missing_repaired.igc")));
+    QVERIFY(!QFile::exists(m_dir.filePath("missing_repaired.igc")));
+}
+
+// Every issue is counted, only the first IGC_MAX_REPORTED_ISSUES are kept
+void TestIgcValidator::boundedIssueList()
+{
+    QByteArray content(HEADER);
+    for (int i = 0; i < IGC_MAX_REPORTED_ISSUES + 50; i++)
+        content += "\r\n";
+    content += bRecord(39695);
+
+    IgcValidator validator;
+    QVERIFY(!validator.validate(writeFile("issues.igc", content)));
+    QCOMPARE(validator.issueCount(), IGC_MAX_REPORTED_ISSUES + 50);
+    QCOMPARE(validator.issues().size(), IGC_MAX_REPORTED_ISSUES);
+    QCOMPARE(validator.issues().last().line, IGC_MAX_REPORTED_ISSUES + 2);
+}
+
+// All repairable defects in one file; the _repaired.igc copy validates and
+// every B record in it parses to the intended fix
+void TestIgcValidator::repairRoundTrip()
+{
+    QByteArray content(HEADER);
+    content += bRecord(39695);
+    content += "\r\n";
+    content += bRecord(39696, "525123N00006198WA0058700558+050");
+    content += bRecord(39697, "5260000N00006198WA0058700558");
+    content += bRecord(39690);
+    content += bRecord(39698, "5206343N0006198WA0058700558");
+    content += "LXGD end\r\n";
+    const QString fileName = writeFile("flight.igc", content);
+    const QByteArray original = content;
+
+    IgcValidator validator;
+    QVERIFY(!validator.validate(fileName));
+    QCOMPARE(validator.issueCount(), 5);
+    QVERIFY(validator.isRepairable());
+
+    const QString repairedFileName = IgcValidator::repairedFileName(fileName);
+    QCOMPARE(repairedFileName, m_dir.filePath("flight_repaired.igc"));
+    QVERIFY(validator.repair(fileName, repairedFileName));
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.readAll(), original);
+    file.close();
+
+    IgcValidator repaired;
+    QVERIFY2(repaired.validate(repairedFileName), qPrintable(repaired.firstIssue()));
+    QCOMPARE(repaired.fixCount(), 4);
+
+    QFile out(repairedFileName);
+    QVERIFY(out.open(QIODevice::ReadOnly));
+    QVector<IgcFix> fixes;
+    QVector<QByteArray> records;
+    while (!out.atEnd())
+    {
+        const QByteArray line = out.readLine();
+        QVERIFY(line.endsWith("\r\n"));
+        if(!line.startsWith('B'))
+            continue;
+
+        IgcFix fix;
+        QCOMPARE(parseBRecord(line.constData(), line.size() - 2, fix), 0);
+        fixes.append(fix);
+        records.append(line);
+    }
+
+    QCOMPARE(fixes.size(), 4);
+    QCOMPARE(fixes.at(0).time, 39695);
+    QCOMPARE(fixes.at(1).time, 39696);
+    QCOMPARE(fixes.at(2).time, 39697);
+    QCOMPARE(fixes.at(3).time, 39698);
+    QCOMPARE(records.at(1), bRecord(39696, "5205123N00006198WA0058700558+050"));
+    QCOMPARE(fixes.at(1).latitude, 52 + 5.123 / 60);
+    QCOMPARE(fixes.at(2).latitude, 52 + 59.999 / 60);
+    QCOMPARE(fixes.at(3).longitude, -(0 + 6.198 / 60));
+    QCOMPARE(fixes.at(0).pressureAltitude, 587);
+    QCOMPARE(fixes.at(0).gpsAltitude, 558);
+}
+
+// 5 h at 1 Hz, the size of a long cross-country flight
+void TestIgcValidator::validateLongFlight()
+{
+    QByteArray content(HEADER);
+    const int fixes = 5 * 3600;
+    content.reserve(content.size() + fixes * (IGC_B_RECORD_LENGTH + 2));
+    IgcFix fix;
+    fix.latitude = 46.5;
+    fix.longitude = 8.0;
+    fix.valid = true;
+    char line[IGC_B_RECORD_LENGTH];
+    for (int i = 0; i < fixes; i++)
+    {
+        fix.time = 36000 + i;
+        fix.latitude += 1e-4 * ((i / 60) % 2 ? 1 : -1);
+        fix.longitude += 1e-4;
+        fix.pressureAltitude = 1500 + (i % 600);
+        fix.gpsAltitude = fix.pressureAltitude + 30;
+        content.append(line, formatBRecord(fix, line));
+        content.append("\r\n");
+    }
+    const QString fileName = writeFile("long.igc", content);
+
+    IgcValidator validator;
+    bool valid = false;
+    QBENCHMARK
+    {
+        valid = validator.validate(fileName);
+    }
+    QVERIFY(valid);
+    QCOMPARE(validator.fixCount(), fixes);
+}
+
+QTEST_GUILESS_MAIN(TestIgcValidator)
+
+#include "tst_igcvalidator.moc"
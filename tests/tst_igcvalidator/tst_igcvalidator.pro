@@ -0,0 +1,11 @@
+include(../tests.pri)
+
+TARGET = tst_igcvalidator
+
+SOURCES += tst_igcvalidator.cpp \
+    ../../igcvalidator.cpp \
+    ../../igcrecord.cpp
+
+HEADERS += \
+    ../../igcvalidator.h \
+    ../../igcrecord.h
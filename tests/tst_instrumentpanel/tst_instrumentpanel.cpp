@@ -0,0 +1,189 @@
+#include <cstdlib>
+#include <atomic>
+#include <QtTest>
+#include <QApplication>
+#include <QLabel>
+#include <QPaintEvent>
+#include <instrumentpanel.h>
+
+#define PANEL_WIDTH 480
+#define PANEL_HEIGHT 800
+#define FRAMES 200
+
+// Every malloc of the process, operator new included, is counted by
+// interposing glibc's; elsewhere allocations aren't measured
+#if defined(__GLIBC__)
+#define COUNTS_ALLOCATIONS
+extern "C" void *__libc_malloc(size_t size);
+static std::atomic<qint64> allocations(0);
+
+extern "C" void *malloc(size_t size) __THROW
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+#endif
+
+// The vario label text of MainWindow::fillVario
+static QString varioHtml(double vario)
+{
+    return "<span style='font-size:110pt; font-weight:600; color:#FFDD33;'>"
+            + QString::number(vario, 'f', 1) + "</span>"
+            + "<span style='font-size:36pt; font-weight:600; color:#00cccc;'> m/s</span><br />"
+            + "<span style='font-size:24pt; font-weight:600; color:#F2EDED;'>10s 1.2  30s 0.8</span>";
+}
+
+// Consecutive frames differ in the displayed text
+static double frameVario(int frame)
+{
+    return (frame % 100) / 10.0 - 5;
+}
+
+// Counts the paint events of a widget and keeps the last dirty rectangle
+class PaintCounter : public QObject
+{
+public:
+    PaintCounter() : paints(0) {}
+
+    bool eventFilter(QObject *watched, QEvent *event) override
+    {
+        if(event->type() == QEvent::Paint)
+        {
+            paints++;
+            dirty = static_cast<QPaintEvent *>(event)->rect();
+        }
+        return QObject::eventFilter(watched, event);
+    }
+
+    int paints;
+    QRect dirty;
+};
+
+class TestInstrumentPanel : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void repaintsOnlyChangedField();
+    void paintFrame_data();
+    void paintFrame();
+    void allocationsPerFrame();
+};
+
+void TestInstrumentPanel::repaintsOnlyChangedField()
+{
+    InstrumentPanel panel;
+    panel.resize(PANEL_WIDTH, PANEL_HEIGHT);
+    panel.setGpsHtml("<span style='font-size:32pt;'>12 : 00 : 00</span><br />Altitude: 1500.0 m");
+    panel.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&panel));
+    QCoreApplication::processEvents();
+
+    PaintCounter counter;
+    panel.installEventFilter(&counter);
+
+    panel.setVario(1.23);
+    QCoreApplication::processEvents();
+    QCOMPARE(counter.paints, 1);
+    QCOMPARE(counter.dirty, QRect(0, 0, PANEL_WIDTH, PANEL_HEIGHT * 35 / 100));
+    QVERIFY(panel.lastPaintNs() > 0);
+
+    // The same text to one decimal doesn't repaint
+    panel.setVario(1.21);
+    panel.setGpsHtml("<span style='font-size:32pt;'>12 : 00 : 00</span><br />Altitude: 1500.0 m");
+    QCoreApplication::processEvents();
+    QCOMPARE(counter.paints, 1);
+
+    panel.setAltitude(1500);
+    QCoreApplication::processEvents();
+    QCOMPARE(counter.paints, 2);
+    QVERIFY(!counter.dirty.intersects(QRect(0, 0, PANEL_WIDTH, PANEL_HEIGHT * 35 / 100)));
+}
+
+void TestInstrumentPanel::paintFrame_data()
+{
+    QTest::addColumn<bool>("label");
+
+    QTest::newRow("panel") << false;
+    QTest::newRow("label") << true;
+}
+
+// One vario update and the repaint it causes, the panel against the label
+// it replaces
+void TestInstrumentPanel::paintFrame()
+{
+    QFETCH(bool, label);
+
+    InstrumentPanel panel;
+    QLabel varioLabel;
+    QWidget *widget = label ? static_cast<QWidget *>(&varioLabel) : &panel;
+    widget->resize(PANEL_WIDTH, PANEL_HEIGHT);
+    widget->show();
+    QVERIFY(QTest::qWaitForWindowExposed(widget));
+
+    int frame = 0;
+    QBENCHMARK {
+        const double vario = frameVario(frame++);
+        if(label)
+            varioLabel.setText(varioHtml(vario));
+        else
+            panel.setVario(vario);
+        QCoreApplication::processEvents();
+    }
+}
+
+void TestInstrumentPanel::allocationsPerFrame()
+{
+#ifndef COUNTS_ALLOCATIONS
+    QSKIP("Allocations are only counted with glibc");
+#else
+    InstrumentPanel panel;
+    panel.resize(PANEL_WIDTH, PANEL_HEIGHT);
+    panel.show();
+    QLabel varioLabel;
+    varioLabel.resize(PANEL_WIDTH, PANEL_HEIGHT);
+    varioLabel.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&panel));
+    QVERIFY(QTest::qWaitForWindowExposed(&varioLabel));
+
+    // Warm up caches, atlases and the backing stores first
+    for (int i = 0; i < FRAMES; i++)
+    {
+        panel.setVario(frameVario(i));
+        varioLabel.setText(varioHtml(frameVario(i)));
+        QCoreApplication::processEvents();
+    }
+
+    qint64 start = allocations.load();
+    for (int i = 0; i < FRAMES; i++)
+    {
+        panel.setVario(frameVario(i));
+        QCoreApplication::processEvents();
+    }
+    const double panelAllocations = double(allocations.load() - start) / FRAMES;
+
+    start = allocations.load();
+    for (int i = 0; i < FRAMES; i++)
+    {
+        varioLabel.setText(varioHtml(frameVario(i)));
+        QCoreApplication::processEvents();
+    }
+    const double labelAllocations = double(allocations.load() - start) / FRAMES;
+
+    qInfo("allocations per frame: panel %.1f, label %.1f; last panel paint %lld ns",
+          panelAllocations, labelAllocations, panel.lastPaintNs());
+    QVERIFY(panelAllocations < labelAllocations);
+#endif
+}
+
+// Widgets need a platform; the offscreen one works without a display
+int main(int argc, char *argv[])
+{
+    if(!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    TestInstrumentPanel test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_instrumentpanel.moc"
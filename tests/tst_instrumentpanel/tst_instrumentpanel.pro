@@ -0,0 +1,15 @@
+include(../tests.pri)
+
+QT += gui widgets
+
+TARGET = tst_instrumentpanel
+
+SOURCES += tst_instrumentpanel.cpp \
+    ../../instrumentpanel.cpp \
+    ../../trace.cpp \
+    ../../metrics.cpp
+
+HEADERS += \
+    ../../instrumentpanel.h \
+    ../../trace.h \
+    ../../metrics.h
@@ -0,0 +1,419 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <logbook.h>
+#include <igcrecord.h>
+#include <cmath>
+
+#define METRES_PER_DEGREE 111195.0
+#define GLIDE_SPEED 15.0        // m/s
+#define BOOK_SIZE 5000          // flights in the timed book
+
+static LogbookEntry flight(const QString &fileName, const QDate &date, int takeoff, double distance)
+{
+    LogbookEntry entry;
+    entry.fileName = fileName;
+    entry.modified = QDateTime(date, QTime(0, 0), Qt::UTC).toMSecsSinceEpoch() + takeoff * 1000LL;
+    entry.date = date;
+    entry.takeoff = takeoff;
+    entry.duration = 3600;
+    entry.maxAltitude = 2000 + takeoff % 1000;
+    entry.distance = distance;
+    entry.score = distance * 1.5;
+    entry.uploadStatus = LogbookEntry::NotUploaded;
+    return entry;
+}
+
+static void compareEntries(const LogbookEntry &a, const LogbookEntry &b)
+{
+    QCOMPARE(a.fileName, b.fileName);
+    QCOMPARE(a.modified, b.modified);
+    QCOMPARE(a.date, b.date);
+    QCOMPARE(a.takeoff, b.takeoff);
+    QCOMPARE(a.duration, b.duration);
+    QCOMPARE(a.maxAltitude, b.maxAltitude);
+    QCOMPARE(a.distance, b.distance);
+    QCOMPARE(a.score, b.score);
+    QCOMPARE(a.uploadStatus, b.uploadStatus);
+}
+
+// One fix per second straight north from takeoff, climbing a metre a second
+static bool writeIgc(const QString &fileName, const char *dateHeader, int takeoff, int seconds)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write("AXGD000 XcVario v1.0\r\n");
+    file.write(dateHeader);
+    file.write("\r\n");
+    char line[IGC_B_RECORD_LENGTH + 2];
+    for (int i = 0; i < seconds; i++)
+    {
+        IgcFix fix;
+        fix.time = (takeoff + i) % 86400;
+        fix.latitude = 46.0 + i * GLIDE_SPEED / METRES_PER_DEGREE;
+        fix.longitude = 8.0;
+        fix.pressureAltitude = 1000 + i;
+        fix.gpsAltitude = 1000 + i;
+        fix.valid = true;
+        const int length = formatBRecord(fix, line);
+        line[length] = '\r';
+        line[length + 1] = '\n';
+        file.write(line, length + 2);
+    }
+    return true;
+}
+
+static qint64 fileSize(const QString &fileName)
+{
+    return QFileInfo(fileName).size();
+}
+
+class TestLogbook : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void loadAppendReload();
+    void truncatedTail_data();
+    void truncatedTail();
+    void compaction();
+    void repairedCopies();
+    void summarize();
+    void backfillKeepsUploadStatus();
+    void filter_data();
+    void filter();
+    void largeBook();
+
+private:
+    QTemporaryDir m_dir;
+};
+
+void TestLogbook::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+}
+
+// A missing book starts empty; flights and statuses come back on reload
+void TestLogbook::loadAppendReload()
+{
+    const QString fileName = m_dir.filePath("reload.book");
+    QVector<LogbookEntry> flights;
+    {
+        Logbook book(fileName, m_dir.path(), nullptr);
+        QVERIFY(book.load());
+        QCOMPARE(book.size(), 0);
+
+        for (int i = 0; i < 5; i++)
+        {
+            flights.append(flight(QString("2020-06-%1-XCV-001-01.igc").arg(10 + i), QDate(2020, 6, 10 + i), 36000 + i, 20.5 * i));
+            book.addFlight(flights.last());
+        }
+        book.setUploadStatus(flights.at(1).fileName, LogbookEntry::Queued);
+        book.setUploadStatus(flights.at(1).fileName, LogbookEntry::Uploaded);
+        book.setUploadStatus(flights.at(3).fileName, LogbookEntry::Rejected);
+        book.setUploadStatus("unknown.igc", LogbookEntry::Uploaded);
+        flights[1].uploadStatus = LogbookEntry::Uploaded;
+        flights[3].uploadStatus = LogbookEntry::Rejected;
+
+        // A flight logged again replaces its summary, keeping the status
+        flights[1].distance = 99.5;
+        LogbookEntry again = flights.at(1);
+        again.uploadStatus = LogbookEntry::NotUploaded;
+        book.addFlight(again);
+        QCOMPARE(book.size(), 5);
+        compareEntries(book.at(1), flights.at(1));
+    }
+
+    Logbook book(fileName, m_dir.path(), nullptr);
+    QVERIFY(book.load());
+    QCOMPARE(book.size(), flights.size());
+    for (int i = 0; i < flights.size(); i++)
+    {
+        QCOMPARE(book.indexOf(flights.at(i).fileName), i);
+        compareEntries(book.at(i), flights.at(i));
+    }
+}
+
+void TestLogbook::truncatedTail_data()
+{
+    QTest::addColumn<int>("cut");
+    QTest::addColumn<QByteArray>("garbage");
+
+    // Bytes cut off the last record, or appended after it
+    QTest::newRow("type byte left") << -1 << QByteArray();
+    QTest::newRow("half a record") << 20 << QByteArray();
+    QTest::newRow("last byte") << 1 << QByteArray();
+    QTest::newRow("unknown record type") << 0 << QByteArray("\x07\x00\x00\x00", 4);
+}
+
+// A crash mid-append leaves a torn record: load() keeps everything before
+// it, cuts the file back to the last good record and appends from there
+void TestLogbook::truncatedTail()
+{
+    QFETCH(int, cut);
+    QFETCH(QByteArray, garbage);
+
+    const QString fileName = m_dir.filePath(QString("torn%1.book").arg(QTest::currentDataTag()).remove(' '));
+    QFile::remove(fileName);
+    qint64 good;
+    {
+        Logbook book(fileName, m_dir.path(), nullptr);
+        QVERIFY(book.load());
+        book.addFlight(flight("a.igc", QDate(2021, 5, 1), 40000, 10));
+        book.addFlight(flight("b.igc", QDate(2021, 5, 2), 40000, 20));
+        good = fileSize(fileName);
+        book.addFlight(flight("c.igc", QDate(2021, 5, 3), 40000, 30));
+    }
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    if(cut < 0)
+        QVERIFY(file.resize(good + 1));
+    else if(cut > 0)
+        QVERIFY(file.resize(file.size() - cut));
+    else
+    {
+        good = file.size();
+        QVERIFY(file.seek(good));
+        file.write(garbage);
+    }
+    file.close();
+
+    Logbook book(fileName, m_dir.path(), nullptr);
+    QVERIFY(book.load());
+    QCOMPARE(fileSize(fileName), good);
+    QCOMPARE(book.size(), cut == 0 ? 3 : 2);
+    QCOMPARE(book.at(1).fileName, QString("b.igc"));
+
+    book.addFlight(flight("d.igc", QDate(2021, 5, 4), 40000, 40));
+    Logbook reloaded(fileName, m_dir.path(), nullptr);
+    QVERIFY(reloaded.load());
+    QCOMPARE(reloaded.size(), book.size());
+    QCOMPARE(reloaded.at(reloaded.size() - 1).fileName, QString("d.igc"));
+}
+
+// The book is rewritten once it holds more than 2 * size + 16 records, and
+// the upload statuses of the status records are in the rewritten one
+void TestLogbook::compaction()
+{
+    const QString fileName = m_dir.filePath("compaction.book");
+    const int flights = 3;
+    const int threshold = 2 * flights + 16;
+    {
+        Logbook book(fileName, m_dir.path(), nullptr);
+        QVERIFY(book.load());
+        for (int i = 0; i < flights; i++)
+            book.addFlight(flight(QString("%1.igc").arg(i), QDate(2022, 7, 1 + i), 40000, 10 * i));
+        for (int i = flights; i < threshold; i++)
+            book.setUploadStatus(QString("%1.igc").arg(i % flights), i % 2 ? LogbookEntry::Queued : LogbookEntry::Uploaded);
+    }
+
+    // At the threshold nothing changes
+    const qint64 full = fileSize(fileName);
+    {
+        Logbook book(fileName, m_dir.path(), nullptr);
+        QVERIFY(book.load());
+        QCOMPARE(fileSize(fileName), full);
+        book.setUploadStatus("1.igc", LogbookEntry::Rejected);
+    }
+
+    // One past it the file shrinks to the three flight records
+    const qint64 grown = fileSize(fileName);
+    QVERIFY(grown > full);
+    QVector<int> statuses;
+    {
+        Logbook book(fileName, m_dir.path(), nullptr);
+        QVERIFY(book.load());
+        QVERIFY(fileSize(fileName) < full / 5);
+        for (int i = 0; i < flights; i++)
+            statuses.append(book.at(i).uploadStatus);
+    }
+    QCOMPARE(statuses.at(0), int(LogbookEntry::Queued));
+    QCOMPARE(statuses.at(1), int(LogbookEntry::Rejected));
+    QCOMPARE(statuses.at(2), int(LogbookEntry::Uploaded));
+
+    const qint64 compacted = fileSize(fileName);
+    Logbook book(fileName, m_dir.path(), nullptr);
+    QVERIFY(book.load());
+    QCOMPARE(fileSize(fileName), compacted);
+    for (int i = 0; i < flights; i++)
+        QCOMPARE(book.at(i).uploadStatus, statuses.at(i));
+}
+
+// Uploads of a repaired copy are the original flight's, unless the copy
+// is in the book itself
+void TestLogbook::repairedCopies()
+{
+    const QString fileName = m_dir.filePath("repaired.book");
+    Logbook book(fileName, m_dir.path(), nullptr);
+    QVERIFY(book.load());
+    book.addFlight(flight("flight.igc", QDate(2023, 8, 1), 40000, 10));
+    book.addFlight(flight("other.igc", QDate(2023, 8, 2), 40000, 10));
+    book.addFlight(flight("other_repaired.igc", QDate(2023, 8, 2), 40000, 10));
+
+    QCOMPARE(book.indexOf("flight_repaired.igc"), 0);
+    QCOMPARE(book.indexOf(m_dir.filePath("flight_repaired.igc")), 0);
+    QCOMPARE(book.indexOf("other_repaired.igc"), 2);
+    QCOMPARE(book.indexOf("missing_repaired.igc"), -1);
+
+    book.setUploadStatus(m_dir.filePath("flight_repaired.igc"), LogbookEntry::Uploaded);
+    QCOMPARE(book.at(0).uploadStatus, int(LogbookEntry::Uploaded));
+    QCOMPARE(book.at(2).uploadStatus, int(LogbookEntry::NotUploaded));
+}
+
+// Date from either HFDTE form, takeoff, duration and altitude from the fixes
+void TestLogbook::summarize()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(writeIgc(dir.filePath("2008.igc"), "HFDTE110620", 36000, 1800));
+    QVERIFY(writeIgc(dir.filePath("2016.igc"), "HFDTEDATE:120620,01", 86000, 1000));
+
+    const LogbookEntry first = Logbook::summarize(dir.filePath("2008.igc"));
+    QCOMPARE(first.fileName, QString("2008.igc"));
+    QCOMPARE(first.date, QDate(2020, 6, 11));
+    QCOMPARE(first.takeoff, 36000);
+    QCOMPARE(first.duration, 1799);
+    QCOMPARE(first.maxAltitude, 1000 + 1799);
+    const double flown = 1799 * GLIDE_SPEED / 1000;
+    QVERIFY2(qAbs(first.distance - flown) < 0.01 * flown, qPrintable(QString("%1 km").arg(first.distance)));
+    QCOMPARE(first.uploadStatus, int(LogbookEntry::NotUploaded));
+
+    // Across midnight UTC
+    const LogbookEntry second = Logbook::summarize(dir.filePath("2016.igc"));
+    QCOMPARE(second.date, QDate(2020, 6, 12));
+    QCOMPARE(second.takeoff, 86000);
+    QCOMPARE(second.duration, 999);
+}
+
+// Changed files are summarized again without losing their upload status,
+// new ones are added, repaired copies are left out
+void TestLogbook::backfillKeepsUploadStatus()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(writeIgc(dir.filePath("a.igc"), "HFDTE010720", 36000, 600));
+    QVERIFY(writeIgc(dir.filePath("b.igc"), "HFDTE020720", 37000, 600));
+    QVERIFY(writeIgc(dir.filePath("b_repaired.igc"), "HFDTE020720", 37000, 600));
+    const QString fileName = dir.filePath("logbook.dat");
+
+    Logbook book(fileName, dir.path(), nullptr);
+    QVERIFY(book.load());
+    QSignalSpy backfilled(&book, &Logbook::backfilled);
+    book.backfill();
+    QVERIFY(backfilled.wait(10000));
+    QCOMPARE(backfilled.last().first().toInt(), 2);
+    QCOMPARE(book.size(), 2);
+    QVERIFY(book.indexOf("a.igc") >= 0);
+    QVERIFY(book.indexOf("b.igc") >= 0);
+
+    book.setUploadStatus("a.igc", LogbookEntry::Uploaded);
+    book.setUploadStatus("b_repaired.igc", LogbookEntry::Rejected);
+
+    // a.igc rewritten later, with a later takeoff
+    QVERIFY(writeIgc(dir.filePath("a.igc"), "HFDTE010720", 39000, 600));
+    QFile file(dir.filePath("a.igc"));
+    QVERIFY(file.open(QIODevice::Append));
+    QVERIFY(file.setFileTime(QDateTime::currentDateTimeUtc().addSecs(10), QFileDevice::FileModificationTime));
+    file.close();
+    QVERIFY(writeIgc(dir.filePath("c.igc"), "HFDTE030720", 38000, 600));
+
+    book.backfill();
+    QVERIFY(backfilled.wait(10000));
+    QCOMPARE(backfilled.last().first().toInt(), 2);
+    QCOMPARE(book.size(), 3);
+    QCOMPARE(book.at(book.indexOf("a.igc")).takeoff, 39000);
+    QCOMPARE(book.at(book.indexOf("a.igc")).uploadStatus, int(LogbookEntry::Uploaded));
+    QCOMPARE(book.at(book.indexOf("b.igc")).uploadStatus, int(LogbookEntry::Rejected));
+    QCOMPARE(book.at(book.indexOf("c.igc")).uploadStatus, int(LogbookEntry::NotUploaded));
+
+    // Nothing new: no work and no signal
+    book.backfill();
+    QTest::qWait(100);
+    QCOMPARE(backfilled.count(), 2);
+
+    Logbook reloaded(fileName, dir.path(), nullptr);
+    QVERIFY(reloaded.load());
+    QCOMPARE(reloaded.size(), 3);
+    for (int i = 0; i < reloaded.size(); i++)
+        compareEntries(reloaded.at(i), book.at(i));
+}
+
+void TestLogbook::filter_data()
+{
+    QTest::addColumn<QDate>("from");
+    QTest::addColumn<QDate>("to");
+    QTest::addColumn<double>("minDistance");
+    QTest::addColumn<QStringList>("expected");
+
+    QTest::newRow("all, newest first") << QDate() << QDate() << 0.0
+            << QStringList({ "jul2-late", "jul2-early", "jul1", "jun30", "may" });
+    QTest::newRow("from") << QDate(2024, 7, 1) << QDate() << 0.0
+            << QStringList({ "jul2-late", "jul2-early", "jul1" });
+    QTest::newRow("to") << QDate() << QDate(2024, 7, 1) << 0.0
+            << QStringList({ "jul1", "jun30", "may" });
+    QTest::newRow("one day") << QDate(2024, 7, 2) << QDate(2024, 7, 2) << 0.0
+            << QStringList({ "jul2-late", "jul2-early" });
+    QTest::newRow("distance") << QDate() << QDate() << 50.0
+            << QStringList({ "jul2-early", "jun30" });
+    QTest::newRow("empty range") << QDate(2024, 8, 1) << QDate(2024, 7, 1) << 0.0 << QStringList();
+}
+
+void TestLogbook::filter()
+{
+    QFETCH(QDate, from);
+    QFETCH(QDate, to);
+    QFETCH(double, minDistance);
+    QFETCH(QStringList, expected);
+
+    Logbook book(m_dir.filePath(QString("filter%1.book").arg(QTest::currentDataTag()).remove(' ')), m_dir.path(), nullptr);
+    QVERIFY(book.load());
+    book.addFlight(flight("jul1", QDate(2024, 7, 1), 40000, 20));
+    book.addFlight(flight("may", QDate(2024, 5, 20), 40000, 30));
+    book.addFlight(flight("jul2-early", QDate(2024, 7, 2), 30000, 80));
+    book.addFlight(flight("jun30", QDate(2024, 6, 30), 40000, 50));
+    book.addFlight(flight("jul2-late", QDate(2024, 7, 2), 50000, 10));
+
+    QStringList names;
+    for (int index : book.filter(from, to, minDistance))
+        names << book.at(index).fileName;
+    QCOMPARE(names, expected);
+}
+
+// Loading and filtering a book of several seasons' flights
+void TestLogbook::largeBook()
+{
+    const QString fileName = m_dir.filePath("large.book");
+    {
+        Logbook book(fileName, m_dir.path(), nullptr);
+        QVERIFY(book.load());
+        for (int i = 0; i < BOOK_SIZE; i++)
+            book.addFlight(flight(QString("%1.igc").arg(i), QDate(2010, 1, 1).addDays(i), 30000 + i % 20000, i % 150));
+    }
+
+    Logbook book(fileName, m_dir.path(), nullptr);
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(book.load());
+    const qint64 loadMs = timer.elapsed();
+    QCOMPARE(book.size(), BOOK_SIZE);
+
+    timer.restart();
+    const QVector<int> found = book.filter(QDate(2015, 1, 1), QDate(), 50);
+    const qint64 filterMs = timer.elapsed();
+    QVERIFY(!found.isEmpty());
+    for (int i = 1; i < found.size(); i++)
+        QVERIFY(book.at(found.at(i - 1)).date > book.at(found.at(i)).date);
+    qInfo("%d flights: load %lld ms, filter %lld ms to %d", BOOK_SIZE, loadMs, filterMs, found.size());
+
+    QBENCHMARK
+    {
+        book.load();
+        book.filter(QDate(2015, 1, 1), QDate(), 50);
+    }
+}
+
+QTEST_GUILESS_MAIN(TestLogbook)
+
+#include "tst_logbook.moc"
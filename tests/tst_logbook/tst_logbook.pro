@@ -0,0 +1,16 @@
+include(../tests.pri)
+
+QT += concurrent positioning
+
+TARGET = tst_logbook
+
+SOURCES += tst_logbook.cpp \
+    ../../logbook.cpp \
+    ../../igcrecord.cpp \
+    ../../tracksimplifier.cpp \
+    ../../xcscore.cpp
+
+HEADERS += \
+    ../../logbook.h \
+    ../../tracksimplifier.h \
+    ../../xcscore.h
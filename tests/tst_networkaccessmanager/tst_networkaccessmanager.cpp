@@ -0,0 +1,308 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <networkaccessmanager.h>
+#include <igcrecord.h>
+#include <stubserver.h>
+#include <zlib.h>
+#include <cmath>
+
+#ifdef Q_OS_LINUX
+#include <sys/resource.h>
+#endif
+
+#define METRES_PER_DEGREE 111195.0
+#define GLIDE_SPEED 15.0        // m/s
+#define CIRCLE_RATE 18.0        // deg/s
+#define GLIDE_S 180
+#define CIRCLE_S 110
+#define SINK 1.0                // m/s
+#define GPS_NOISE 1.5           // m, at most either way
+
+// Peak resident set size so far, KiB; 0 where unknown
+static long peakRss()
+{
+#ifdef Q_OS_LINUX
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == 0)
+        return usage.ru_maxrss;
+#endif
+    return 0;
+}
+
+// 1 Hz fixes of a flight alternating a glide with five and a half circles,
+// out and back at a steady altitude however long the file, with GPS noise
+// from a fixed generator. Every B record differs like in a logged file and
+// the whole deflates about 4.5 times.
+static QString writeIgc(const QString &fileName, qint64 bytes)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly))
+        return QString();
+    qint64 written = file.write("AXGD000 XcVario v1.0\r\nHFDTE110620\r\n");
+
+    quint32 seed = 12345;
+    auto noise = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (static_cast<double>(seed >> 8) / (1 << 24) * 2 - 1) * GPS_NOISE;
+    };
+
+    IgcFix fix;
+    fix.valid = true;
+    double latitude = 46.5;
+    double longitude = 8.0;
+    double altitude = 1500;
+    double heading = 30;
+    char line[IGC_B_RECORD_LENGTH + 2];
+    for (int i = 0; written < bytes; i++)
+    {
+        if(i % (GLIDE_S + CIRCLE_S) >= GLIDE_S)
+        {
+            heading = std::fmod(heading + CIRCLE_RATE, 360);
+            altitude += SINK * GLIDE_S / CIRCLE_S;
+        }
+        else
+        {
+            altitude -= SINK;
+        }
+        fix.time = (36000 + i) % 86400;
+        latitude += GLIDE_SPEED * std::cos(qDegreesToRadians(heading)) / METRES_PER_DEGREE;
+        longitude += GLIDE_SPEED * std::sin(qDegreesToRadians(heading)) / (METRES_PER_DEGREE * std::cos(qDegreesToRadians(latitude)));
+        fix.latitude = latitude + noise() / METRES_PER_DEGREE;
+        fix.longitude = longitude + noise() / (METRES_PER_DEGREE * std::cos(qDegreesToRadians(latitude)));
+        fix.pressureAltitude = qRound(altitude);
+        fix.gpsAltitude = qRound(altitude + 30 + noise());
+
+        const int length = formatBRecord(fix, line);
+        line[length] = '\r';
+        line[length + 1] = '\n';
+        written += file.write(line, length + 2);
+    }
+    return fileName;
+}
+
+// Inflates a gzip or zlib stream; empty on error
+static QByteArray inflateBody(const QByteArray &body)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if(inflateInit2(&zs, MAX_WBITS + 32) != Z_OK)
+        return QByteArray();
+
+    QByteArray out;
+    char chunk[16384];
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(body.constData()));
+    zs.avail_in = static_cast<uInt>(body.size());
+    int status;
+    do {
+        zs.next_out = reinterpret_cast<Bytef *>(chunk);
+        zs.avail_out = sizeof(chunk);
+        status = inflate(&zs, Z_NO_FLUSH);
+        out.append(chunk, static_cast<int>(sizeof(chunk) - zs.avail_out));
+    } while (status == Z_OK);
+    inflateEnd(&zs);
+    return status == Z_STREAM_END ? out : QByteArray();
+}
+
+class TestNetworkAccessManager : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void leonardoForm();
+    void streamsLargeFile();
+    void compressedBody_data();
+    void compressedBody();
+    void responseMarkers_data();
+    void responseMarkers();
+    void throttledUploadStats_data();
+    void throttledUploadStats();
+
+private:
+    NetworkAccessManager::SubmitResult submit(NetworkAccessManager &network, const QString &fileName);
+
+private:
+    QTemporaryDir m_dir;
+    StubServer m_server;
+    QUrl m_url;
+};
+
+void TestNetworkAccessManager::initTestCase()
+{
+    qRegisterMetaType<NetworkAccessManager::SubmitResult>();
+    QVERIFY(m_dir.isValid());
+    QVERIFY(m_server.listen());
+    m_url = m_server.url();
+}
+
+NetworkAccessManager::SubmitResult TestNetworkAccessManager::submit(NetworkAccessManager &network, const QString &fileName)
+{
+    QSignalSpy finished(&network, &NetworkAccessManager::submitFinished);
+    if(!network.submitFlight(7, m_url, "pilot", "secret", fileName))
+        return NetworkAccessManager::NetworkError;
+    if(!finished.wait(60000))
+        return NetworkAccessManager::NetworkError;
+    if(finished.first().at(0).toInt() != 7)
+        return NetworkAccessManager::NetworkError;
+    return finished.first().at(1).value<NetworkAccessManager::SubmitResult>();
+}
+
+void TestNetworkAccessManager::leonardoForm()
+{
+    const QString fileName = writeIgc(m_dir.filePath("small.igc"), 4096);
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QByteArray content = file.readAll();
+
+    NetworkAccessManager network(m_url, nullptr);
+    QCOMPARE(submit(network, fileName), NetworkAccessManager::Submitted);
+
+    const StubServer::Request &request = m_server.requests().last();
+    QCOMPARE(request.method, QByteArray("POST"));
+    QCOMPARE(request.path, QByteArray("/leonardo/flight_submit.php"));
+    QVERIFY(request.headers.value("content-type").startsWith("multipart/form-data"));
+
+    // What Leonardo's flight_submit.php reads from $_POST
+    const QHash<QByteArray, QByteArray> fields = StubServer::formFields(request);
+    QCOMPARE(fields.value("user"), QByteArray("pilot"));
+    QCOMPARE(fields.value("pass"), QByteArray("secret"));
+    QCOMPARE(fields.value("igcfn"), QByteArray("small"));
+    QCOMPARE(fields.value("Klasse"), QByteArray("3"));
+    QCOMPARE(fields.value("IGCigcIGC"), content);
+    QVERIFY(!StubServer::formDisposition(request, "IGCigcIGC").contains("filename"));
+}
+
+void TestNetworkAccessManager::streamsLargeFile()
+{
+    const qint64 size = 32 * 1024 * 1024;
+    const QString fileName = writeIgc(m_dir.filePath("large.igc"), size);
+    QVERIFY(!fileName.isEmpty());
+    const qint64 fileSize = QFileInfo(fileName).size();
+
+    m_server.setKeepBodies(false);
+    const long before = peakRss();
+
+    NetworkAccessManager network(m_url, nullptr);
+    QCOMPARE(submit(network, fileName), NetworkAccessManager::Submitted);
+
+    const long after = peakRss();
+    m_server.setKeepBodies(true);
+
+    // The whole file went out, wrapped in a few hundred bytes of form
+    const StubServer::Request &request = m_server.requests().last();
+    QVERIFY(request.bodySize > fileSize);
+    QVERIFY(request.bodySize < fileSize + 1024);
+
+    // Read from disk while sending: the old readAll/percent-encode path
+    // peaked at several times the file size
+    qInfo("upload of %lld bytes: peak RSS grew by %ld KiB", fileSize, after - before);
+    if(before > 0)
+        QVERIFY2(after - before < 8 * 1024, "peak memory grew with the file size");
+}
+
+void TestNetworkAccessManager::compressedBody_data()
+{
+    QTest::addColumn<int>("encoding");
+    QTest::addColumn<QByteArray>("header");
+    QTest::newRow("gzip") << int(NetworkAccessManager::Gzip) << QByteArray("gzip");
+    QTest::newRow("deflate") << int(NetworkAccessManager::Deflate) << QByteArray("deflate");
+}
+
+void TestNetworkAccessManager::compressedBody()
+{
+    QFETCH(int, encoding);
+    QFETCH(QByteArray, header);
+
+    const QString fileName = writeIgc(m_dir.filePath("compressed.igc"), 256 * 1024);
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QByteArray content = file.readAll();
+
+    NetworkAccessManager network(m_url, nullptr);
+    network.setContentEncoding(NetworkAccessManager::serverKey(m_url), NetworkAccessManager::ContentEncoding(encoding));
+    QCOMPARE(submit(network, fileName), NetworkAccessManager::Submitted);
+
+    StubServer::Request request = m_server.requests().last();
+    QCOMPARE(request.headers.value("content-encoding"), header);
+    QVERIFY(request.body.size() < content.size() / 4);
+
+    // Same form as the uncompressed one once the server inflates it
+    request.body = inflateBody(request.body);
+    QVERIFY(!request.body.isEmpty());
+    const QHash<QByteArray, QByteArray> fields = StubServer::formFields(request);
+    QCOMPARE(fields.value("user"), QByteArray("pilot"));
+    QCOMPARE(fields.value("igcfn"), QByteArray("compressed"));
+    QCOMPARE(fields.value("IGCigcIGC"), content);
+}
+
+void TestNetworkAccessManager::responseMarkers_data()
+{
+    QTest::addColumn<QByteArray>("body");
+    QTest::addColumn<int>("result");
+
+    const QByteArray padding(RESPONSE_CHUNK - 10, 'x');
+    QTest::newRow("submitted") << QByteArray("<html>flight submitted</html>") << int(NetworkAccessManager::Submitted);
+    QTest::newRow("invalid user") << QByteArray("<b>Invalid user data</b>") << int(NetworkAccessManager::InvalidUser);
+    QTest::newRow("invalid igc") << QByteArray("problem: This is not a valid .igc file") << int(NetworkAccessManager::InvalidIgc);
+    // Markers split across two read chunks
+    QTest::newRow("user across chunks") << padding + "Invalid user data" << int(NetworkAccessManager::InvalidUser);
+    QTest::newRow("igc across chunks") << padding + "This is not a valid .igc file" << int(NetworkAccessManager::InvalidIgc);
+    QTest::newRow("marker after display text") << QByteArray(RESPONSE_TEXT_MAX * 4, ' ') + "Invalid user data"
+                                               << int(NetworkAccessManager::InvalidUser);
+}
+
+void TestNetworkAccessManager::responseMarkers()
+{
+    QFETCH(QByteArray, body);
+    QFETCH(int, result);
+
+    const QString fileName = writeIgc(m_dir.filePath("response.igc"), 1024);
+    m_server.setResponse(200, body);
+    NetworkAccessManager network(m_url, nullptr);
+    QSignalSpy text(&network, &NetworkAccessManager::responseResult);
+    QCOMPARE(int(submit(network, fileName)), result);
+    m_server.setResponse(200, "<html>Your flight has been submitted</html>");
+
+    // Only a bounded prefix is kept for display
+    QCOMPARE(text.size(), 1);
+    QVERIFY(text.first().at(0).toString().size() <= RESPONSE_TEXT_MAX);
+}
+
+void TestNetworkAccessManager::throttledUploadStats_data()
+{
+    QTest::addColumn<int>("encoding");
+    QTest::newRow("identity") << int(NetworkAccessManager::Identity);
+    QTest::newRow("gzip") << int(NetworkAccessManager::Gzip);
+    QTest::newRow("deflate") << int(NetworkAccessManager::Deflate);
+}
+
+void TestNetworkAccessManager::throttledUploadStats()
+{
+    QFETCH(int, encoding);
+
+    // About a minute of 1 Hz fixes per KiB; a 1 MiB flight over a weak link
+    const QString fileName = writeIgc(m_dir.filePath("throttled.igc"), 1024 * 1024);
+    const qint64 fileSize = QFileInfo(fileName).size();
+    m_server.setThrottle(256 * 1024);
+
+    NetworkAccessManager network(m_url, nullptr);
+    network.setContentEncoding(NetworkAccessManager::serverKey(m_url), NetworkAccessManager::ContentEncoding(encoding));
+    QSignalSpy stats(&network, &NetworkAccessManager::uploadStats);
+    QCOMPARE(submit(network, fileName), NetworkAccessManager::Submitted);
+    m_server.setThrottle(0);
+
+    QCOMPARE(stats.size(), 1);
+    const qint64 rawBytes = stats.first().at(1).toLongLong();
+    const qint64 wireBytes = stats.first().at(2).toLongLong();
+    const qint64 msecs = stats.first().at(3).toLongLong();
+    QVERIFY(rawBytes >= fileSize);
+    QVERIFY(wireBytes > 0 && wireBytes <= m_server.requests().last().bodySize);
+    if(encoding != NetworkAccessManager::Identity)
+        QVERIFY(wireBytes < rawBytes / 4);
+    qInfo("%s: %lld bytes raw, %lld on the wire, %lld ms at 256 KiB/s",
+          QTest::currentDataTag(), rawBytes, wireBytes, msecs);
+}
+
+QTEST_GUILESS_MAIN(TestNetworkAccessManager)
+
+#include "tst_networkaccessmanager.moc"
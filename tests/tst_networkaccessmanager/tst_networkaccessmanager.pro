@@ -0,0 +1,17 @@
+include(../tests.pri)
+include(../common/common.pri)
+
+QT += concurrent
+LIBS += -lz
+
+TARGET = tst_networkaccessmanager
+
+SOURCES += tst_networkaccessmanager.cpp \
+    ../../networkaccessmanager.cpp \
+    ../../igcrecord.cpp \
+    ../../trace.cpp \
+    ../../metrics.cpp
+
+HEADERS += \
+    ../../networkaccessmanager.h \
+    ../../igcrecord.h
@@ -0,0 +1,327 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <nmeasource.h>
+#include <nmeasentence.h>
+#include <cmath>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+// Start of the recorded flight, 11:00:00 UTC on 11 June 2020
+#define FLIGHT_START_MS (11 * 3600 * 1000)
+#define FLIGHT_PERIOD_MS 100    // 10 Hz receiver
+
+static double flightLatitude(int epoch)
+{
+    return 46.5 + epoch * 1e-5;
+}
+
+// One epoch as a u-blox at 10 Hz sends it, plus an LK8EX1 pressure sentence
+static QByteArray flightEpoch(int epoch)
+{
+    const int time = FLIGHT_START_MS + epoch * FLIGHT_PERIOD_MS;
+    const QByteArray hhmmss = QString::asprintf("%02d%02d%02d.%02d", time / 3600000, (time / 60000) % 60,
+                                                (time / 1000) % 60, (time % 1000) / 10).toLatin1();
+    const double latitude = flightLatitude(epoch);
+    const QByteArray lat = QString::asprintf("%02d%08.5f", int(latitude), (latitude - int(latitude)) * 60).toLatin1();
+    const QByteArray altitude = QByteArray::number(2000 + epoch * 0.1, 'f', 1);
+
+    QByteArray data;
+    data += sentence("GPGGA," + hhmmss + "," + lat + ",N,00800.00000,E,1,09,0.8," + altitude + ",M,48.0,M,,");
+    data += sentence("GPGSA,A,3,04,05,09,12,24,25,29,31,32,,,,1.6,0.8,1.4");
+    data += sentence("GPRMC," + hhmmss + ",A," + lat + ",N,00800.00000,E,2.2,000.0,110620,,,A");
+    data += sentence("GPVTG,000.0,T,,M,2.2,N,4.1,K,A");
+    data += sentence("LK8EX1," + QByteArray::number(80000 - epoch) + ",99999,150,25,999");
+    return data;
+}
+
+static QByteArray flight(int epochs)
+{
+    QByteArray data;
+    for (int i = 0; i < epochs; i++)
+        data += flightEpoch(i);
+    return data;
+}
+
+// Parser that exposes the samples of the vario sentences
+class TestParser : public VarioParser
+{
+public:
+    int drain()
+    {
+        NmeaFix fix;
+        VarioSample sample;
+        int count = 0;
+        while (nextFix(fix))
+            count++;
+        while (nextSample(sample))
+            ;
+        return count;
+    }
+};
+
+#ifdef Q_OS_UNIX
+// Pseudo-terminal pair: the test writes to the master, NmeaSource reads the slave
+class Pty
+{
+public:
+    Pty() : m_master(-1)
+    {
+        m_master = posix_openpt(O_RDWR | O_NOCTTY);
+        if(m_master >= 0 && (grantpt(m_master) != 0 || unlockpt(m_master) != 0))
+        {
+            ::close(m_master);
+            m_master = -1;
+        }
+    }
+    ~Pty()
+    {
+        if(m_master >= 0)
+            ::close(m_master);
+    }
+
+    bool isValid() const { return m_master >= 0; }
+    QString slaveName() const { return QString::fromLocal8Bit(ptsname(m_master)); }
+    bool write(const QByteArray &data)
+    {
+        return ::write(m_master, data.constData(), static_cast<size_t>(data.size())) == data.size();
+    }
+
+private:
+    int m_master;
+};
+#endif
+
+class TestNmeaSource : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void referenceSentences();
+    void checksums();
+    void splitFeed();
+    void ttyPressureBeforeStart();
+    void ttyTenHz();
+    void replay();
+    void parseRate();
+};
+
+void TestNmeaSource::initTestCase()
+{
+    qRegisterMetaType<QGeoPositionInfo>();
+}
+
+void TestNmeaSource::referenceSentences()
+{
+    // The examples of the NMEA 0183 references
+    const QByteArray data =
+            "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n"
+            "$GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1*39\r\n"
+            "$GPVTG,054.7,T,034.4,M,005.5,N,010.2,K*48\r\n"
+            "$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n";
+
+    VarioParser parser;
+    parser.feed(data.constData(), data.size());
+    QCOMPARE(parser.sentenceCount(), qint64(4));
+    QCOMPARE(parser.checksumErrors(), qint64(0));
+
+    NmeaFix fix, next;
+    QVERIFY(parser.nextFix(fix));
+    QVERIFY(!parser.nextFix(next));
+    QCOMPARE(fix.time, (12 * 3600 + 35 * 60 + 19) * 1000);
+    QCOMPARE(fix.date, 230394);
+    QVERIFY(qAbs(fix.latitude - (48 + 7.038 / 60)) < 1e-9);
+    QVERIFY(qAbs(fix.longitude - (11 + 31.0 / 60)) < 1e-9);
+    QCOMPARE(fix.altitude, 545.4);
+    QCOMPARE(fix.satellites, 8);
+    QCOMPARE(fix.fixType, 3);
+    QCOMPARE(fix.hdop, 1.3);
+    QCOMPARE(fix.vdop, 2.1);
+    // RMC comes last and wins over VTG
+    QVERIFY(qAbs(fix.groundSpeed - 22.4 * 0.514444) < 1e-9);
+    QCOMPARE(fix.course, 84.4);
+    QVERIFY(fix.valid);
+}
+
+void TestNmeaSource::checksums()
+{
+    TestParser parser;
+
+    // A flipped digit
+    const QByteArray corrupt = "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*46\r\n";
+    parser.feed(corrupt.constData(), corrupt.size());
+    QCOMPARE(parser.checksumErrors(), qint64(1));
+    QCOMPARE(parser.sentenceCount(), qint64(0));
+
+    // The checksum is optional, and so is the CR
+    const QByteArray bare = "$GPGGA,123520,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,\n"
+                            "$GPRMC,123520,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W\n";
+    parser.feed(bare.constData(), bare.size());
+    QCOMPARE(parser.sentenceCount(), qint64(2));
+    QCOMPARE(parser.drain(), 1);
+
+    // Line noise in front of a sentence is skipped
+    const QByteArray noisy = "\x7fgarbage" + flightEpoch(0);
+    parser.feed(noisy.constData(), noisy.size());
+    QCOMPARE(parser.checksumErrors(), qint64(1));
+    QCOMPARE(parser.drain(), 1);
+}
+
+void TestNmeaSource::splitFeed()
+{
+    const QByteArray data = flight(50);
+
+    TestParser whole;
+    whole.feed(data.constData(), data.size());
+    whole.flush();
+
+    // Byte by byte, as a slow serial port delivers it
+    TestParser split;
+    int fixes = 0;
+    for (int i = 0; i < data.size(); i++)
+    {
+        split.feed(data.constData() + i, 1);
+        fixes += split.drain();
+    }
+    split.flush();
+    fixes += split.drain();
+
+    QCOMPARE(whole.sentenceCount(), qint64(50 * 5));
+    QCOMPARE(split.sentenceCount(), whole.sentenceCount());
+    QCOMPARE(fixes, 50);
+    QCOMPARE(split.checksumErrors(), qint64(0));
+}
+
+void TestNmeaSource::ttyPressureBeforeStart()
+{
+#ifdef Q_OS_UNIX
+    Pty pty;
+    QVERIFY(pty.isValid());
+
+    NmeaSource source(nullptr);
+    QVERIFY(source.openTty(pty.slaveName(), 115200));
+    QSignalSpy pressure(&source, &NmeaSource::pressureSample);
+    QSignalSpy positions(&source, &NmeaSource::positionUpdated);
+
+    // Before Start: pressure flows, positions are parsed but not published
+    QVERIFY(pty.write(flightEpoch(0) + flightEpoch(1) + flightEpoch(2)));
+    QTRY_COMPARE(pressure.size(), 3);
+    QCOMPARE(pressure.first().at(0).toDouble(), 80000.0);
+    QCOMPARE(positions.size(), 0);
+    QVERIFY(source.lastKnownPosition().isValid());
+
+    source.startUpdates();
+    QVERIFY(pty.write(flightEpoch(3)));
+    QTRY_COMPARE(positions.size(), 1);
+    QCOMPARE(pressure.size(), 4);
+
+    // And keeps flowing once stopped
+    source.stopUpdates();
+    QVERIFY(pty.write(flightEpoch(4)));
+    QTRY_COMPARE(pressure.size(), 5);
+    QCOMPARE(positions.size(), 1);
+#else
+    QSKIP("needs a pseudo-terminal");
+#endif
+}
+
+void TestNmeaSource::ttyTenHz()
+{
+#ifdef Q_OS_UNIX
+    Pty pty;
+    QVERIFY(pty.isValid());
+
+    NmeaSource source(nullptr);
+    QVERIFY(source.openTty(pty.slaveName(), 115200));
+    QSignalSpy positions(&source, &NmeaSource::positionUpdated);
+    source.startUpdates();
+
+    // Ten seconds at 10 Hz, a second per write to stay within the tty buffer
+    const int seconds = 10;
+    const int perSecond = 1000 / FLIGHT_PERIOD_MS;
+    for (int s = 0; s < seconds; s++)
+    {
+        QByteArray data;
+        for (int i = 0; i < perSecond; i++)
+            data += flightEpoch(s * perSecond + i);
+        QVERIFY(pty.write(data));
+        QTRY_COMPARE(positions.size(), (s + 1) * perSecond);
+    }
+
+    for (int i = 0; i < positions.size(); i++)
+    {
+        const QGeoPositionInfo info = positions.at(i).at(0).value<QGeoPositionInfo>();
+        QVERIFY(qAbs(info.coordinate().latitude() - flightLatitude(i)) < 1e-7);
+        QVERIFY(qAbs(info.coordinate().longitude() - 8.0) < 1e-9);
+        // RMC dates are ddmmyy
+        QCOMPARE(info.timestamp().date(), QDate(2020, 6, 11));
+        QCOMPARE(info.timestamp().time().msecsSinceStartOfDay(), FLIGHT_START_MS + i * FLIGHT_PERIOD_MS);
+        QVERIFY(info.hasAttribute(QGeoPositionInfo::VerticalAccuracy));
+    }
+#else
+    QSKIP("needs a pseudo-terminal");
+#endif
+}
+
+void TestNmeaSource::replay()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QFile file(dir.filePath("flight.nmea"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    const int epochs = 20;
+    file.write(flight(epochs));
+    file.close();
+
+    NmeaSource source(nullptr);
+    QVERIFY(source.openReplay(file.fileName()));
+    QSignalSpy positions(&source, &NmeaSource::positionUpdated);
+    QSignalSpy pressure(&source, &NmeaSource::pressureSample);
+    QSignalSpy finished(&source, &NmeaSource::updateTimeout);
+
+    QElapsedTimer timer;
+    timer.start();
+    source.startUpdates();
+    QVERIFY(finished.wait(10000));
+
+    // All fixes, at the pace they were recorded
+    QCOMPARE(positions.size(), epochs);
+    QCOMPARE(pressure.size(), epochs);
+    QVERIFY(timer.elapsed() >= (epochs - 1) * FLIGHT_PERIOD_MS * 8 / 10);
+}
+
+void TestNmeaSource::parseRate()
+{
+    // One minute of a 10 Hz receiver with a vario on the same line
+    const int epochs = 600;
+    const QByteArray data = flight(epochs);
+    TestParser parser;
+
+    QBENCHMARK {
+        for (int at = 0; at < data.size(); at += NMEA_READ_CHUNK)
+        {
+            parser.feed(data.constData() + at, qMin(NMEA_READ_CHUNK, data.size() - at));
+            parser.drain();
+        }
+    }
+    QCOMPARE(parser.checksumErrors(), qint64(0));
+
+    QElapsedTimer timer;
+    timer.start();
+    const int rounds = 20;
+    for (int i = 0; i < rounds; i++)
+    {
+        parser.feed(data.constData(), data.size());
+        parser.drain();
+    }
+    const qint64 nsecs = qMax<qint64>(1, timer.nsecsElapsed());
+    qInfo("%.0f sentences per second", double(epochs) * 5 * rounds * 1e9 / nsecs);
+}
+
+QTEST_GUILESS_MAIN(TestNmeaSource)
+
+#include "tst_nmeasource.moc"
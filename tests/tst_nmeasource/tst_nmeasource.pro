@@ -0,0 +1,15 @@
+include(../tests.pri)
+
+QT += positioning
+
+TARGET = tst_nmeasource
+
+SOURCES += tst_nmeasource.cpp \
+    ../../nmeasource.cpp \
+    ../../nmeaparser.cpp \
+    ../../varioparser.cpp \
+    ../../altitudefusion.cpp
+
+HEADERS += \
+    ../../nmeasource.h \
+    ../common/nmeasentence.h
@@ -0,0 +1,104 @@
+#include <QtTest>
+#include <QPressureSensor>
+#include <syntheticsensor.h>
+#include <altitudefusion.h>
+
+#define RUN_MS 6000
+#define DROPOUTS_PER_MINUTE 120
+#define DROPOUT_MS 300
+
+class TestSyntheticSensor : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void listedAsPressureSensor();
+    void loadRun_data();
+    void loadRun();
+};
+
+void TestSyntheticSensor::initTestCase()
+{
+    SyntheticProfile profile = SyntheticProfile::defaults();
+    profile.dropoutRate = DROPOUTS_PER_MINUTE;
+    profile.dropoutMs = DROPOUT_MS;
+    SyntheticPressureBackend::registerBackend(profile);
+}
+
+// What MainWindow::loadSensors sees on a machine without a barometer
+void TestSyntheticSensor::listedAsPressureSensor()
+{
+    QVERIFY(QSensor::sensorTypes().contains(QPressureSensor::type));
+    QVERIFY(QSensor::sensorsForType(QPressureSensor::type).contains(SYNTHETIC_IDENTIFIER));
+    QCOMPARE(QSensor::defaultSensorForType(QPressureSensor::type), QByteArray(SYNTHETIC_IDENTIFIER));
+
+    QPressureSensor sensor;
+    QVERIFY(sensor.connectToBackend());
+    QCOMPARE(sensor.identifier(), QByteArray(SYNTHETIC_IDENTIFIER));
+}
+
+void TestSyntheticSensor::loadRun_data()
+{
+    QTest::addColumn<int>("rate");
+
+    QTest::newRow("10 Hz") << 10;
+    QTest::newRow("1 kHz") << 1000;
+}
+
+// Drives a QPressureSensor as MainWindow does and counts the readings that
+// arrive and the dropouts between them
+void TestSyntheticSensor::loadRun()
+{
+    QFETCH(int, rate);
+
+    QPressureSensor sensor;
+    sensor.setIdentifier(SYNTHETIC_IDENTIFIER);
+    sensor.setDataRate(rate);
+
+    // A gap is a dropout once it is clearly longer than timer jitter allows
+    const quint64 periodUs = 1000000 / rate;
+    const quint64 dropoutGapUs = qMax<quint64>(periodUs * 5 / 2, DROPOUT_MS * 1000 / 2);
+    int readings = 0;
+    int dropouts = 0;
+    quint64 last = 0;
+    quint64 longestGap = 0;
+    double minAltitude = 1e9;
+    double maxAltitude = -1e9;
+    connect(&sensor, &QSensor::readingChanged, this, [&]() {
+        const QPressureReading *reading = sensor.reading();
+        if(readings > 0)
+        {
+            const quint64 gap = reading->timestamp() - last;
+            longestGap = qMax(longestGap, gap);
+            if(gap >= dropoutGapUs)
+                dropouts++;
+        }
+        last = reading->timestamp();
+        readings++;
+        const double altitude = PressureToAltitude(reading->pressure(), 101325.0);
+        minAltitude = qMin(minAltitude, altitude);
+        maxAltitude = qMax(maxAltitude, altitude);
+    });
+
+    QVERIFY(sensor.start());
+    QTest::qWait(RUN_MS);
+    sensor.stop();
+
+    const int expected = rate * RUN_MS / 1000;
+    qInfo("%d Hz: %d of %d readings, %d dropouts, longest gap %.1f ms",
+          rate, readings, expected, dropouts, longestGap / 1000.0);
+
+    // Dropouts take about 40% of the run; the rest must keep up
+    QVERIFY(readings > expected / 5);
+    QVERIFY(readings <= expected * 11 / 10);
+    QVERIFY(dropouts > 0);
+    QVERIFY(dropouts <= RUN_MS * DROPOUTS_PER_MINUTE / 60000 * 2);
+    QVERIFY(longestGap >= DROPOUT_MS * 1000 / 2);
+    QVERIFY(minAltitude > SYNTHETIC_BASE_ALTITUDE - 100);
+    QVERIFY(maxAltitude < SYNTHETIC_BASE_ALTITUDE + 100);
+}
+
+QTEST_GUILESS_MAIN(TestSyntheticSensor)
+
+#include "tst_syntheticsensor.moc"
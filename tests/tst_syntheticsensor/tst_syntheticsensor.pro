@@ -0,0 +1,13 @@
+include(../tests.pri)
+
+QT += sensors
+
+TARGET = tst_syntheticsensor
+
+SOURCES += tst_syntheticsensor.cpp \
+    ../../syntheticsensor.cpp \
+    ../../altitudefusion.cpp
+
+HEADERS += \
+    ../../syntheticsensor.h \
+    ../../altitudefusion.h
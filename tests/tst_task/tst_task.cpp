@@ -0,0 +1,369 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <task.h>
+#include <waypoint.h>
+#include <cmath>
+
+#define EARTH_RADIUS 6371000.0
+#define METRES_PER_DEGREE 111195.0
+#define METRES_PER_FT 0.3048
+#define METRES_PER_NM 1852.0
+#define CIRCLE_POINTS 720       // per cylinder for the brute force route
+#define STEP 100.0              // m per fix flying the task
+
+// Names with commas, a broken coordinate, southern and western hemispheres,
+// elevations in feet. The first related task goes from takeoff over an
+// unknown point to the goal and back to takeoff; the second is ignored.
+#define CUP_FILE \
+    "name,code,country,lat,lon,elev,style,rwdir,rwlen,freq,desc\r\n" \
+    "\"Takeoff\",\"TO\",CH,4600.000N,00800.000E,1500.0m,4,,,,\r\n" \
+    "\"Start\",\"ST\",CH,4610.000N,00810.000E,800m,1,,,,\r\n" \
+    "\"Monte, Generoso\",\"GEN\",CH,4555.800N,00900.600E,5600ft,1,,,,\"Summit, antenna\"\r\n" \
+    "\"Turn A\",\"TA\",CH,4630.000N,00830.000E,1200.0m,1,,,,\r\n" \
+    "\"Broken\",\"BR\",CH,46xx.000N,00800.000E,0m,1,,,,\r\n" \
+    "\"Goal\",\"GL\",CH,4620.000N,00900.000E,500m,1,,,,\r\n" \
+    "\"South West\",\"SW\",AR,3130.500S,06415.250W,400m,1,,,,\r\n" \
+    "-----Related Tasks-----\r\n" \
+    "\"Test task\",\"Takeoff\",\"Start\",\"Monte, Generoso\",\"Turn A\",\"Nowhere\",\"Goal\",\"Takeoff\"\r\n" \
+    "Options,NoStart=10:00:00,TaskTime=03:00:00\r\n" \
+    "ObsZone=0,Style=2,R1=3km,A1=180\r\n" \
+    "ObsZone=1,Style=1,R1=2500m,A1=180\r\n" \
+    "ObsZone=2,Style=1,R1=1nm,A1=180\r\n" \
+    "ObsZone=3,Style=1,R1=9km,A1=180\r\n" \
+    "\"Second task\",\"Takeoff\",\"Turn A\",\"Goal\",\"Takeoff\"\r\n" \
+    "ObsZone=0,Style=2,R1=9km\r\n"
+
+// Four header lines, altitude in feet in field 14, -777 when unknown
+#define WPT_FILE \
+    "OziExplorer Waypoint File Version 1.1\r\n" \
+    "WGS 84\r\n" \
+    "Reserved 2\r\n" \
+    "Reserved 3\r\n" \
+    "   1,Start          ,  46.166667,   8.166667,45000.00000,  0, 1, 3,         0,     65535,Start, 0, 0,    0,   2625\r\n" \
+    "   2,Turn A         ,  46.500000,   8.500000,45000.00000,  0, 1, 3,         0,     65535,     , 0, 0,    0,   -777\r\n" \
+    "   3,Broken         ,  north,   8.500000,45000.00000,  0, 1, 3,         0,     65535,     , 0, 0,    0,   1000\r\n" \
+    "   4,Short          ,  46.1\r\n" \
+    "   5,South West     , -31.508333, -64.254167\r\n"
+
+static Turnpoint turnpoint(double latitude, double longitude, double radius)
+{
+    Turnpoint turnpoint;
+    turnpoint.waypoint.name = QString("%1 %2").arg(latitude).arg(longitude);
+    turnpoint.waypoint.code = turnpoint.waypoint.name;
+    turnpoint.waypoint.latitude = latitude;
+    turnpoint.waypoint.longitude = longitude;
+    turnpoint.waypoint.elevation = 0;
+    turnpoint.radius = radius;
+    return turnpoint;
+}
+
+static double haversine(double latitude1, double longitude1, double latitude2, double longitude2)
+{
+    const double sinLatitude = std::sin(qDegreesToRadians(latitude2 - latitude1) / 2);
+    const double sinLongitude = std::sin(qDegreesToRadians(longitude2 - longitude1) / 2);
+    const double h = sinLatitude * sinLatitude
+            + std::cos(qDegreesToRadians(latitude1)) * std::cos(qDegreesToRadians(latitude2)) * sinLongitude * sinLongitude;
+    return 2 * EARTH_RADIUS * std::asin(qMin(1.0, std::sqrt(h)));
+}
+
+// Shortest route from the start cylinder over every turnpoint cylinder to
+// the goal cylinder, by dynamic programming over CIRCLE_POINTS points on
+// each. Correct as long as no two cylinders overlap.
+static double bruteForceDistance(const QVector<Turnpoint> &task)
+{
+    QVector<QVector<QPair<double, double>>> circles;
+    for (const Turnpoint &turnpoint : task)
+    {
+        QVector<QPair<double, double>> circle;
+        for (int i = 0; i < CIRCLE_POINTS; i++)
+        {
+            const double angle = 2 * M_PI * i / CIRCLE_POINTS;
+            const double latitude = turnpoint.waypoint.latitude + turnpoint.radius * std::cos(angle) / METRES_PER_DEGREE;
+            circle.append(qMakePair(latitude, turnpoint.waypoint.longitude
+                    + turnpoint.radius * std::sin(angle) / (METRES_PER_DEGREE * std::cos(qDegreesToRadians(latitude)))));
+        }
+        circles.append(circle);
+    }
+
+    QVector<double> best(CIRCLE_POINTS, 0);
+    for (int k = 1; k < circles.size(); k++)
+    {
+        QVector<double> next(CIRCLE_POINTS, 1e12);
+        for (int i = 0; i < CIRCLE_POINTS; i++)
+        {
+            for (int j = 0; j < CIRCLE_POINTS; j++)
+            {
+                const double d = best.at(j) + haversine(circles[k - 1][j].first, circles[k - 1][j].second,
+                                                        circles[k][i].first, circles[k][i].second);
+                next[i] = qMin(next.at(i), d);
+            }
+        }
+        best = next;
+    }
+    return *std::min_element(best.begin(), best.end());
+}
+
+// Fixes STEP m apart along the meridian
+static double northOf(double latitude, double metres)
+{
+    return latitude + metres / METRES_PER_DEGREE;
+}
+
+class TestTask : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cup();
+    void wpt();
+    void missingFile();
+    void optimizedDistance_data();
+    void optimizedDistance();
+    void startCrossing_data();
+    void startCrossing();
+    void turnpointOrder();
+    void progress();
+
+private:
+    QString writeFile(const QString &name, const QByteArray &content);
+
+private:
+    QTemporaryDir m_dir;
+};
+
+void TestTask::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+}
+
+QString TestTask::writeFile(const QString &name, const QByteArray &content)
+{
+    QFile file(m_dir.filePath(name));
+    if(!file.open(QIODevice::WriteOnly))
+        return QString();
+    file.write(content);
+    return file.fileName();
+}
+
+void TestTask::cup()
+{
+    const QString fileName = writeFile("task.cup", CUP_FILE);
+    QVector<Waypoint> waypoints;
+    QVector<Turnpoint> task;
+    QVERIFY(loadWaypoints(fileName, waypoints, &task));
+
+    QCOMPARE(waypoints.size(), 6);
+    QCOMPARE(waypoints.at(2).name, QString("Monte, Generoso"));
+    QCOMPARE(waypoints.at(2).code, QString("GEN"));
+    QVERIFY(qAbs(waypoints.at(2).latitude - 45.93) < 1e-9);
+    QVERIFY(qAbs(waypoints.at(2).longitude - 9.01) < 1e-9);
+    QVERIFY(qAbs(waypoints.at(2).elevation - 5600 * METRES_PER_FT) < 1e-6);
+    QCOMPARE(waypoints.at(4).name, QString("Goal"));
+    QVERIFY(qAbs(waypoints.at(5).latitude + (31 + 30.5 / 60)) < 1e-9);
+    QVERIFY(qAbs(waypoints.at(5).longitude + (64 + 15.25 / 60)) < 1e-9);
+
+    // Takeoff, landing and the unknown point dropped, zones keep their numbers
+    QCOMPARE(task.size(), 4);
+    QCOMPARE(task.at(0).waypoint.name, QString("Start"));
+    QCOMPARE(task.at(1).waypoint.name, QString("Monte, Generoso"));
+    QCOMPARE(task.at(2).waypoint.name, QString("Turn A"));
+    QCOMPARE(task.at(3).waypoint.name, QString("Goal"));
+    QCOMPARE(task.at(0).radius, 3000.0);
+    QCOMPARE(task.at(1).radius, 2500.0);
+    QCOMPARE(task.at(2).radius, METRES_PER_NM);
+    QCOMPARE(task.at(3).radius, TURNPOINT_RADIUS);
+
+    // Without a task asked for the waypoints are the same
+    QVector<Waypoint> only;
+    QVERIFY(loadWaypoints(fileName, only));
+    QCOMPARE(only.size(), waypoints.size());
+}
+
+void TestTask::wpt()
+{
+    const QString fileName = writeFile("points.wpt", WPT_FILE);
+    QVector<Waypoint> waypoints;
+    QVector<Turnpoint> task = { turnpoint(46, 8, 400) };
+    QVERIFY(loadWaypoints(fileName, waypoints, &task));
+    QVERIFY(task.isEmpty());
+
+    QCOMPARE(waypoints.size(), 3);
+    QCOMPARE(waypoints.at(0).name, QString("Start"));
+    QVERIFY(qAbs(waypoints.at(0).latitude - 46.166667) < 1e-9);
+    QVERIFY(qAbs(waypoints.at(0).elevation - 2625 * METRES_PER_FT) < 1e-6);
+    QCOMPARE(waypoints.at(1).name, QString("Turn A"));
+    QCOMPARE(waypoints.at(1).elevation, 0.0);
+    QCOMPARE(waypoints.at(2).name, QString("South West"));
+    QVERIFY(qAbs(waypoints.at(2).longitude + 64.254167) < 1e-9);
+    QCOMPARE(waypoints.at(2).elevation, 0.0);
+}
+
+void TestTask::missingFile()
+{
+    QVector<Waypoint> waypoints;
+    QVERIFY(!loadWaypoints(m_dir.filePath("missing.cup"), waypoints));
+    QVERIFY(!loadWaypoints(writeFile("empty.wpt", "header\r\n"), waypoints));
+}
+
+void TestTask::optimizedDistance_data()
+{
+    QTest::addColumn<int>("turnpoints");
+    QTest::addColumn<quint32>("seed");
+
+    QTest::newRow("2 points") << 2 << 1u;
+    QTest::newRow("3 points") << 3 << 2u;
+    QTest::newRow("4 points") << 4 << 3u;
+    QTest::newRow("5 points") << 5 << 4u;
+    QTest::newRow("6 points") << 6 << 5u;
+    QTest::newRow("6 points again") << 6 << 6u;
+}
+
+// The route the task optimizes is as short as the brute force one over
+// random tasks of 400 m to 5 km cylinders spread over about 100 km
+void TestTask::optimizedDistance()
+{
+    QFETCH(int, turnpoints);
+    QFETCH(quint32, seed);
+
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<double>(seed >> 8) / (1 << 24);
+    };
+
+    QVector<Turnpoint> turnpointList;
+    while (turnpointList.size() < turnpoints)
+    {
+        const Turnpoint candidate = turnpoint(46 + random(), 7.5 + random() * 1.5, 400 + random() * 4600);
+        bool overlaps = false;
+        for (const Turnpoint &other : turnpointList)
+            overlaps |= haversine(candidate.waypoint.latitude, candidate.waypoint.longitude,
+                                  other.waypoint.latitude, other.waypoint.longitude) < candidate.radius + other.radius + 1000;
+        if(!overlaps)
+            turnpointList.append(candidate);
+    }
+
+    Task task;
+    task.setTurnpoints(turnpointList);
+    QVERIFY(task.isValid());
+
+    double centers = 0;
+    for (int i = 1; i < turnpointList.size(); i++)
+        centers += haversine(turnpointList[i - 1].waypoint.latitude, turnpointList[i - 1].waypoint.longitude,
+                             turnpointList[i].waypoint.latitude, turnpointList[i].waypoint.longitude);
+
+    const double expected = bruteForceDistance(turnpointList);
+    const double error = (task.taskDistance() - expected) / expected;
+    qInfo("%d points: %.0f m optimized, %.0f m brute force, %.0f m center to center", turnpoints, task.taskDistance(), expected, centers);
+    QVERIFY2(qAbs(error) < 0.001, qPrintable(QString("%1 % off").arg(error * 100)));
+    QCOMPARE(task.remaining(), task.taskDistance());
+}
+
+void TestTask::startCrossing_data()
+{
+    QTest::addColumn<double>("from");
+    QTest::addColumn<double>("to");
+    QTest::addColumn<double>("crossing");
+
+    // Metres north of the start center, start radius 3 km
+    QTest::newRow("exit start") << 0.0 << 6000.0 << 3000.0;
+    QTest::newRow("enter start") << -6000.0 << 0.0 << -3000.0;
+}
+
+// The start is taken on the first boundary crossing either way, not on the
+// first fix inside or outside
+void TestTask::startCrossing()
+{
+    QFETCH(double, from);
+    QFETCH(double, to);
+    QFETCH(double, crossing);
+
+    Task task;
+    task.setTurnpoints({ turnpoint(46, 8, 3000), turnpoint(46.5, 8, 1000), turnpoint(47, 8, 1000) });
+    QVERIFY(!task.isStarted());
+    QCOMPARE(task.progress(), 0.0);
+
+    int reached = 0;
+    double started = 0;
+    for (double metres = from; metres <= to; metres += STEP)
+    {
+        if(task.update(northOf(46, metres), 8))
+        {
+            reached++;
+            started = metres;
+        }
+        QCOMPARE(task.isStarted(), reached > 0);
+    }
+
+    QCOMPARE(reached, 1);
+    QVERIFY(qAbs(started - crossing) <= STEP);
+    QCOMPARE(task.currentLeg(), 1);
+    QCOMPARE(task.next().waypoint.latitude, 46.5);
+}
+
+// A later turnpoint flown through first doesn't count
+void TestTask::turnpointOrder()
+{
+    Task task;
+    task.setTurnpoints({ turnpoint(46, 8, 1000), turnpoint(46.2, 8, 1000), turnpoint(46.1, 8, 1000), turnpoint(46.3, 8, 1000) });
+
+    task.update(46, 8);
+    QVERIFY(task.update(northOf(46, 1100), 8));
+    QCOMPARE(task.currentLeg(), 1);
+
+    QVERIFY(!task.update(46.1, 8));
+    QCOMPARE(task.currentLeg(), 1);
+    QVERIFY(task.update(46.2, 8));
+    QCOMPARE(task.currentLeg(), 2);
+    QVERIFY(!task.update(46.3, 8));
+    QVERIFY(task.update(46.1, 8));
+    QCOMPARE(task.currentLeg(), 3);
+    QVERIFY(task.update(46.3, 8));
+    QVERIFY(task.isFinished());
+    QVERIFY(!task.update(46.3, 8));
+}
+
+// Straight north through a turnpoint the line crosses: the remaining
+// distance is the flown one taken off the optimized route, the turnpoint
+// is tagged on entering its cylinder and goal on entering the goal's
+void TestTask::progress()
+{
+    Task task;
+    task.setTurnpoints({ turnpoint(46, 8, 1000), turnpoint(46.5, 8, 1000), turnpoint(47, 8, 1000) });
+    const double goalLine = haversine(46, 8, 47, 8) - 1000;
+    QVERIFY(qAbs(task.taskDistance() - (goalLine - 1000)) < 0.001 * goalLine);
+
+    int tagged = 0;
+    for (double metres = 0; metres <= goalLine + STEP; metres += STEP)
+    {
+        const double latitude = northOf(46, metres);
+        if(task.update(latitude, 8))
+        {
+            tagged++;
+            if(tagged == 2)
+                QVERIFY(qAbs(metres - (haversine(46, 8, 46.5, 8) - 1000)) <= STEP);
+        }
+
+        if(!task.isStarted())
+            QCOMPARE(task.progress(), 0.0);
+        else if(!task.isFinished())
+        {
+            QVERIFY2(qAbs(task.remaining() - (goalLine - metres)) < 0.001 * goalLine,
+                     qPrintable(QString("%1 m remaining at %2 m").arg(task.remaining()).arg(metres)));
+            QVERIFY(qAbs(task.progress() - (metres - 1000) / task.taskDistance()) < 0.01);
+        }
+    }
+
+    QCOMPARE(tagged, 3);
+    QVERIFY(task.isFinished());
+    QCOMPARE(task.progress(), 1.0);
+    QCOMPARE(task.remaining(), 0.0);
+
+    task.reset();
+    QVERIFY(!task.isStarted());
+    QCOMPARE(task.remaining(), task.taskDistance());
+}
+
+QTEST_GUILESS_MAIN(TestTask)
+
+#include "tst_task.moc"
@@ -0,0 +1,11 @@
+include(../tests.pri)
+
+TARGET = tst_task
+
+SOURCES += tst_task.cpp \
+    ../../task.cpp \
+    ../../waypoint.cpp
+
+HEADERS += \
+    ../../task.h \
+    ../../waypoint.h
@@ -0,0 +1,257 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QThreadPool>
+#include <terrain.h>
+#include <cmath>
+
+#define SRTM3_SAMPLES 1201
+#define SRTM3_LAST (SRTM3_SAMPLES - 1)
+
+// Sample heights on one grid over all tiles, counted in samples north of
+// 90S and east of 180W, so the overlapping outer rows of neighbouring tiles
+// agree. The product term keeps a cell from being a plane, which a nearest
+// sample or a linear fit would pass on.
+static int height(int north, int east)
+{
+    return (east * 7 + north * 3) % 5000 + (east % 17) * (north % 13) - 200;
+}
+
+static int gridNorth(double latitude)
+{
+    return qRound((latitude + 90) * SRTM3_LAST);
+}
+
+static int gridEast(double longitude)
+{
+    return qRound((longitude + 180) * SRTM3_LAST);
+}
+
+// Northern and eastern hemisphere only
+static QString tileName(const QString &directory, int latitude, int longitude)
+{
+    return QDir(directory).filePath(QString("N%1E%2.hgt").arg(latitude, 2, 10, QChar('0')).arg(longitude, 3, 10, QChar('0')));
+}
+
+// SRTM3 tile with its south-west corner at latitude, longitude
+static bool writeTile(const QString &directory, int latitude, int longitude)
+{
+    QByteArray data(SRTM3_SAMPLES * SRTM3_SAMPLES * 2, Qt::Uninitialized);
+    char *p = data.data();
+    for (int row = 0; row < SRTM3_SAMPLES; row++)
+    {
+        for (int column = 0; column < SRTM3_SAMPLES; column++)
+        {
+            const int h = height((latitude + 91) * SRTM3_LAST - row, (longitude + 180) * SRTM3_LAST + column);
+            *p++ = static_cast<char>((h >> 8) & 0xff);
+            *p++ = static_cast<char>(h & 0xff);
+        }
+    }
+
+    QFile file(tileName(directory, latitude, longitude));
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+// Lets finished prefetches reach the terrain
+static void settle()
+{
+    QThreadPool::globalInstance()->waitForDone();
+    QTest::qWait(10);
+}
+
+class TestTerrain : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void bilinear_data();
+    void bilinear();
+    void voids_data();
+    void voids();
+    void missingTile();
+    void leastRecentlyUsed();
+    void prefetchKeepsPinned();
+    void elevation();
+
+private:
+    QTemporaryDir m_dir;
+};
+
+// N46E007 with a void at 46.5N 7.5E, and its northern and eastern neighbours
+void TestTerrain::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+    QVERIFY(writeTile(m_dir.path(), 46, 7));
+    QVERIFY(writeTile(m_dir.path(), 47, 7));
+    QVERIFY(writeTile(m_dir.path(), 46, 8));
+
+    QFile file(tileName(m_dir.path(), 46, 7));
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.seek(2 * (SRTM3_LAST / 2 * SRTM3_SAMPLES + SRTM3_LAST / 2)));
+    const char voidSample[2] = { static_cast<char>(0x80), 0x00 };
+    QCOMPARE(file.write(voidSample, 2), qint64(2));
+}
+
+void TestTerrain::bilinear_data()
+{
+    QTest::addColumn<double>("latitude");
+    QTest::addColumn<double>("longitude");
+    QTest::addColumn<double>("expected");
+
+    const double cell = 1.0 / SRTM3_LAST;
+    const int n = gridNorth(46.25), e = gridEast(7.75);
+    QTest::newRow("sample") << 46.25 << 7.75 << double(height(n, e));
+    QTest::newRow("cell midpoint") << 46.25 + cell / 2 << 7.75 + cell / 2
+            << (height(n, e) + height(n + 1, e) + height(n, e + 1) + height(n + 1, e + 1)) / 4.0;
+    QTest::newRow("quarter cell") << 46.25 + cell / 4 << 7.75 + cell * 3 / 4
+            << (height(n, e) * 0.25 + height(n, e + 1) * 0.75) * 0.75 + (height(n + 1, e) * 0.25 + height(n + 1, e + 1) * 0.75) * 0.25;
+
+    // An edge is the outer row or column of the tile it rounds down into,
+    // and just inside the neighbour's matches it
+    QTest::newRow("northern edge") << 47.0 << 7.25 << double(height(gridNorth(47), gridEast(7.25)));
+    QTest::newRow("below northern edge") << 47.0 - 1e-9 << 7.25 << double(height(gridNorth(47), gridEast(7.25)));
+    QTest::newRow("eastern edge") << 46.25 << 8.0 << double(height(n, gridEast(8)));
+    QTest::newRow("west of eastern edge") << 46.25 << 8.0 - 1e-9 << double(height(n, gridEast(8)));
+    QTest::newRow("south-west corner") << 46.0 << 7.0 << double(height(gridNorth(46), gridEast(7)));
+    QTest::newRow("north-east corner") << 47.0 - 1e-9 << 8.0 - 1e-9 << double(height(gridNorth(47), gridEast(8)));
+}
+
+void TestTerrain::bilinear()
+{
+    QFETCH(double, latitude);
+    QFETCH(double, longitude);
+    QFETCH(double, expected);
+
+    Terrain terrain(m_dir.path(), nullptr);
+    double meters = 0;
+    QVERIFY(terrain.elevation(latitude, longitude, meters));
+    QVERIFY2(qAbs(meters - expected) < 1e-3, qPrintable(QString("%1 m, expected %2 m").arg(meters).arg(expected)));
+}
+
+void TestTerrain::voids_data()
+{
+    QTest::addColumn<double>("latitude");
+    QTest::addColumn<double>("longitude");
+    QTest::addColumn<bool>("found");
+
+    const double cell = 1.0 / SRTM3_LAST;
+    QTest::newRow("void sample") << 46.5 << 7.5 << false;
+    QTest::newRow("cell north-west") << 46.5 + cell / 2 << 7.5 - cell / 2 << false;
+    QTest::newRow("cell north-east") << 46.5 + cell / 2 << 7.5 + cell / 2 << false;
+    QTest::newRow("cell south-west") << 46.5 - cell / 2 << 7.5 - cell / 2 << false;
+    QTest::newRow("cell south-east") << 46.5 - cell / 2 << 7.5 + cell / 2 << false;
+    QTest::newRow("next cell north") << 46.5 + cell * 3 / 2 << 7.5 + cell / 2 << true;
+    QTest::newRow("next cell west") << 46.5 + cell / 2 << 7.5 - cell * 3 / 2 << true;
+}
+
+// Any cell touching a void sample has no elevation, its neighbours do
+void TestTerrain::voids()
+{
+    QFETCH(double, latitude);
+    QFETCH(double, longitude);
+    QFETCH(bool, found);
+
+    Terrain terrain(m_dir.path(), nullptr);
+    double meters = 0;
+    QCOMPARE(terrain.elevation(latitude, longitude, meters), found);
+
+    // A void is not a missing tile
+    QVERIFY(terrain.elevation(46.25, 7.75, meters));
+    QCOMPARE(terrain.tileCount(), 1);
+}
+
+void TestTerrain::missingTile()
+{
+    Terrain terrain(m_dir.path(), nullptr);
+    double meters = 0;
+    QVERIFY(!terrain.elevation(10.5, 10.5, meters));
+    QVERIFY(!terrain.elevation(-0.5, -0.5, meters));
+    QCOMPARE(terrain.tileCount(), 0);
+}
+
+// Mapped tiles stay at TERRAIN_MAX_TILES and the least recently used goes.
+// A tile file removed while mapped shows whether the tile is still cached.
+void TestTerrain::leastRecentlyUsed()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const int tiles = TERRAIN_MAX_TILES + 2;
+    for (int i = 0; i < tiles; i++)
+        QVERIFY(writeTile(dir.path(), 46, i));
+
+    Terrain terrain(dir.path(), nullptr);
+    double meters = 0;
+    for (int i = 0; i < tiles; i++)
+    {
+        QVERIFY(terrain.elevation(46.5, i + 0.5, meters));
+        QCOMPARE(terrain.tileCount(), qMin(i + 1, TERRAIN_MAX_TILES));
+    }
+
+    // Cached now: the last TERRAIN_MAX_TILES. Using the oldest of them again
+    // makes the next one go for tile 0.
+    const int oldest = tiles - TERRAIN_MAX_TILES;
+    QVERIFY(terrain.elevation(46.5, oldest + 0.5, meters));
+    QVERIFY(terrain.elevation(46.5, 0.5, meters));
+    QCOMPARE(terrain.tileCount(), TERRAIN_MAX_TILES);
+
+    for (int i = 0; i < tiles; i++)
+        QFile::remove(tileName(dir.path(), 46, i));
+    for (int i = 0; i < tiles; i++)
+    {
+        const bool cached = i == 0 || i == oldest || i > oldest + 1;
+        QCOMPARE(terrain.elevation(46.5, i + 0.5, meters), cached);
+    }
+}
+
+// More prefetched tiles than fit push each other out, never the tile in use
+void TestTerrain::prefetchKeepsPinned()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const int tiles = TERRAIN_MAX_TILES + 2;
+    for (int i = 0; i < tiles; i++)
+        QVERIFY(writeTile(dir.path(), 46, i));
+
+    Terrain terrain(dir.path(), nullptr);
+    double pinned = 0;
+    QVERIFY(terrain.elevation(46.5, 0.5, pinned));
+
+    // Heading north from mid tile all lookahead points stay in that tile
+    for (int i = 1; i < tiles; i++)
+    {
+        terrain.prefetch(46.5, i + 0.5, 0);
+        settle();
+        QCOMPARE(terrain.tileCount(), qMin(i + 1, TERRAIN_MAX_TILES));
+    }
+
+    for (int i = 0; i < tiles; i++)
+        QFile::remove(tileName(dir.path(), 46, i));
+    double meters = 0;
+    QVERIFY(terrain.elevation(46.5, 0.5, meters));
+    QCOMPARE(meters, pinned);
+    for (int i = 1; i < tiles; i++)
+        QCOMPARE(terrain.elevation(46.5, i + 0.5, meters), i >= tiles - (TERRAIN_MAX_TILES - 1));
+}
+
+// Lookups spread over a warm tile, as a flight samples the ground below
+void TestTerrain::elevation()
+{
+    Terrain terrain(m_dir.path(), nullptr);
+    double meters = 0;
+    QVERIFY(terrain.elevation(46.1, 7.1, meters));
+
+    double sum = 0;
+    QBENCHMARK
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            if(terrain.elevation(46.1 + i * 0.0008, 7.1 + i * 0.0007, meters))
+                sum += meters;
+        }
+    }
+    QVERIFY(sum != 0);
+}
+
+QTEST_GUILESS_MAIN(TestTerrain)
+
+#include "tst_terrain.moc"
@@ -0,0 +1,11 @@
+include(../tests.pri)
+
+QT += concurrent
+
+TARGET = tst_terrain
+
+SOURCES += tst_terrain.cpp \
+    ../../terrain.cpp
+
+HEADERS += \
+    ../../terrain.h
@@ -0,0 +1,158 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <thermalstore.h>
+#include <igcrecord.h>
+#include <cmath>
+
+#define METRES_PER_DEGREE 111195.0
+#define GLIDE_SPEED 15.0        // m/s
+#define CIRCLE_RATE 18.0        // deg/s
+#define CLIMB 2.0               // m/s
+#define BASE 1000.0             // m
+
+// One fix per second: a minute straight north, two minutes circling in a
+// 2 m/s thermal, 40 s straight again
+struct FlightFix
+{
+    int time;
+    double heading;
+    double latitude;
+    double longitude;
+    double altitude;
+};
+
+static QVector<FlightFix> flight(double latitude, double longitude, int startTime)
+{
+    QVector<FlightFix> fixes;
+    double heading = 0;
+    double altitude = BASE;
+    for (int i = 0; i < 240; i++)
+    {
+        if(i >= 60 && i < 180)
+        {
+            heading = std::fmod(heading + CIRCLE_RATE, 360);
+            altitude += CLIMB;
+        }
+        latitude += GLIDE_SPEED * std::cos(qDegreesToRadians(heading)) / METRES_PER_DEGREE;
+        longitude += GLIDE_SPEED * std::sin(qDegreesToRadians(heading)) / (METRES_PER_DEGREE * std::cos(qDegreesToRadians(latitude)));
+        fixes.append(FlightFix{ startTime + i, heading, latitude, longitude, altitude });
+    }
+    return fixes;
+}
+
+static bool writeIgc(const QString &fileName, const QVector<FlightFix> &fixes)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write("AXGD000 XcVario v1.0\r\nHFDTE110620\r\n");
+    char line[IGC_B_RECORD_LENGTH + 2];
+    for (const FlightFix &fix : fixes)
+    {
+        IgcFix record;
+        record.time = fix.time;
+        record.latitude = fix.latitude;
+        record.longitude = fix.longitude;
+        record.pressureAltitude = qRound(fix.altitude);
+        record.gpsAltitude = qRound(fix.altitude);
+        record.valid = true;
+        const int length = formatBRecord(record, line);
+        line[length] = '\r';
+        line[length + 1] = '\n';
+        file.write(line, length + 2);
+    }
+    return true;
+}
+
+class TestThermalStore : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void climbFromCirclingStart();
+    void thermalsInFile();
+    void archiveMergesLiveThermals();
+};
+
+// The climb is measured from where the turning began, not from where the
+// detector was sure about it CIRCLING_ENTER_S later
+void TestThermalStore::climbFromCirclingStart()
+{
+    CirclingDetector detector;
+    int thermals = 0;
+    for (const FlightFix &fix : flight(46.5, 8.0, 36000))
+    {
+        if(detector.update(qint64(fix.time) * 1000, fix.heading, fix.latitude, fix.longitude, fix.altitude, 0))
+            thermals++;
+    }
+    QCOMPARE(thermals, 1);
+
+    const Thermal &thermal = detector.thermal();
+    QVERIFY(qAbs(detector.entryAltitude() - BASE) < 2 * CLIMB);
+    QVERIFY(thermal.time <= (36000 + 62) * 1000LL);
+    QCOMPARE(thermal.base, BASE);
+    QCOMPARE(thermal.top, BASE + 120 * CLIMB);
+    QVERIFY(qAbs(thermal.climb - (thermal.top - BASE) / thermal.duration) < 0.05);
+}
+
+void TestThermalStore::thermalsInFile()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath("flight.igc");
+    QVERIFY(writeIgc(fileName, flight(46.5, 8.0, 36000)));
+
+    const QVector<Thermal> thermals = ThermalStore::thermalsInFile(fileName);
+    QCOMPARE(thermals.size(), 1);
+    QCOMPARE(thermals.first().base, BASE);
+    QCOMPARE(thermals.first().top, BASE + 120 * CLIMB);
+    QVERIFY(thermals.first().climb > 0.9 * (120 * CLIMB) / thermals.first().duration);
+    // Time of day, as the archive has it
+    QVERIFY(qAbs(thermals.first().time - (36000 + 60) * 1000LL) < 5000);
+}
+
+void TestThermalStore::archiveMergesLiveThermals()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    // The flight in progress at 10:00, and an older one elsewhere at 12:00
+    QVERIFY(writeIgc(dir.filePath("current.igc"), flight(46.5, 8.0, 36000)));
+    QVERIFY(writeIgc(dir.filePath("older.igc"), flight(47.0, 9.0, 43200)));
+    const Thermal archived = ThermalStore::thermalsInFile(dir.filePath("current.igc")).value(0);
+    QVERIFY(archived.duration > 0);
+
+    ThermalStore store(dir.filePath("thermals.dat"), nullptr);
+    QSignalSpy indexed(&store, &ThermalStore::archiveIndexed);
+    store.buildFromArchive(dir.path());
+
+    // Found live while the archive is read: the current flight's thermal,
+    // with its epoch time, and one the archive doesn't have
+    Thermal live = archived;
+    live.latitude += 0.001;
+    live.time = QDateTime(QDate(2020, 6, 11), QTime(10, 1), Qt::UTC).toMSecsSinceEpoch();
+    store.add(live);
+    Thermal other = archived;
+    other.latitude = 45.0;
+    other.longitude = 7.0;
+    store.add(other);
+
+    QVERIFY(indexed.wait(10000));
+    QCOMPARE(store.size(), 3);
+    QCOMPARE(store.at(0).time, live.time);
+    QCOMPARE(store.at(1).latitude, 45.0);
+    QVERIFY(store.nearest(47.01, 9.0, 5) == 2);
+
+    // Saved merged
+    ThermalStore reloaded(dir.filePath("thermals.dat"), nullptr);
+    QVERIFY(reloaded.load());
+    QCOMPARE(reloaded.size(), 3);
+
+    // Indexing again adds nothing
+    store.buildFromArchive(dir.path());
+    QVERIFY(indexed.wait(10000));
+    QCOMPARE(store.size(), 3);
+}
+
+QTEST_GUILESS_MAIN(TestThermalStore)
+
+#include "tst_thermalstore.moc"
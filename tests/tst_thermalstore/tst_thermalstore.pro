@@ -0,0 +1,14 @@
+include(../tests.pri)
+
+QT += concurrent
+
+TARGET = tst_thermalstore
+
+SOURCES += tst_thermalstore.cpp \
+    ../../thermalstore.cpp \
+    ../../circlingdetector.cpp \
+    ../../igcrecord.cpp
+
+HEADERS += \
+    ../../thermalstore.h \
+    ../../circlingdetector.h
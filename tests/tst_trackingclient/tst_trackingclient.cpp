@@ -0,0 +1,261 @@
+#include <QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <trackingclient.h>
+
+struct DecodedFix
+{
+    qint64 time;        // s
+    qint32 latitude;    // 1e-5 deg
+    qint32 longitude;
+    qint32 altitude;    // m
+};
+
+// Decodes the hello and frames of trackingclient.h from a byte stream
+class TrackDecoder
+{
+public:
+    TrackDecoder() : m_pos(0), m_frames(0) {}
+
+    // False on a malformed stream; stops at an incomplete frame
+    bool decode(const QByteArray &data)
+    {
+        while (m_pos < data.size())
+        {
+            int pos = m_pos;
+            if(data.mid(pos, 3) == QByteArray("XT\x01", 3))
+            {
+                // Hello, sent without a length prefix
+                pos += 3;
+                quint64 pilotLength;
+                if(!varint(data, pos, pilotLength) || pos + int(pilotLength) > data.size())
+                    return true;
+                m_pilot = data.mid(pos, int(pilotLength));
+                m_pos = pos + int(pilotLength);
+                continue;
+            }
+
+            quint64 length;
+            if(!varint(data, pos, length))
+                return true;
+            if(pos + int(length) > data.size())
+                return true;
+
+            const QByteArray payload = data.mid(pos, int(length));
+            m_pos = pos + int(length);
+            if(!payload.startsWith(QByteArray("XT\x02", 3)))
+                return false;
+
+            int at = 3;
+            quint64 count;
+            if(!varint(payload, at, count))
+                return false;
+            DecodedFix last = { 0, 0, 0, 0 };
+            for (quint64 i = 0; i < count; i++)
+            {
+                qint64 values[4];
+                for (qint64 &value : values)
+                {
+                    quint64 raw;
+                    if(!varint(payload, at, raw))
+                        return false;
+                    value = static_cast<qint64>(raw >> 1) ^ -static_cast<qint64>(raw & 1);
+                }
+                last.time += values[0];
+                last.latitude += static_cast<qint32>(values[1]);
+                last.longitude += static_cast<qint32>(values[2]);
+                last.altitude += static_cast<qint32>(values[3]);
+                m_fixes.append(last);
+            }
+            if(at != payload.size())
+                return false;
+            m_frames++;
+        }
+        return true;
+    }
+
+    QByteArray pilot() const { return m_pilot; }
+    int frames() const { return m_frames; }
+    const QVector<DecodedFix> &fixes() const { return m_fixes; }
+
+private:
+    static bool varint(const QByteArray &data, int &pos, quint64 &value)
+    {
+        value = 0;
+        for (int shift = 0; pos < data.size() && shift < 64; shift += 7)
+        {
+            const quint8 byte = static_cast<quint8>(data.at(pos++));
+            value |= static_cast<quint64>(byte & 0x7f) << shift;
+            if(!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+private:
+    int m_pos;
+    int m_frames;
+    QByteArray m_pilot;
+    QVector<DecodedFix> m_fixes;
+};
+
+static QGeoPositionInfo position(qint64 msecs, double latitude, double longitude, double altitude)
+{
+    return QGeoPositionInfo(QGeoCoordinate(latitude, longitude, altitude),
+                            QDateTime::fromMSecsSinceEpoch(msecs, Qt::UTC));
+}
+
+class TestTrackingClient : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void keepsOneFixPerSpacing_data();
+    void keepsOneFixPerSpacing();
+    void boundedWhileOffline();
+    void sendsToStandInServer();
+    void dropsUnsentOnStop();
+
+private:
+    qint64 m_start;
+};
+
+void TestTrackingClient::init()
+{
+    m_start = QDateTime(QDate(2020, 6, 11), QTime(11, 0), Qt::UTC).toMSecsSinceEpoch();
+}
+
+void TestTrackingClient::keepsOneFixPerSpacing_data()
+{
+    QTest::addColumn<int>("periodMs");
+    QTest::addColumn<int>("jitterMs");
+    QTest::addColumn<int>("expected");
+
+    // 60 s of fixes
+    QTest::newRow("1 Hz") << 1000 << 0 << 60;
+    QTest::newRow("1 Hz, jitter") << 1000 << 3 << 60;
+    QTest::newRow("5 Hz") << 200 << 0 << 60;
+    QTest::newRow("10 Hz") << 100 << 0 << 60;
+    QTest::newRow("10 Hz, jitter") << 100 << 2 << 60;
+}
+
+void TestTrackingClient::keepsOneFixPerSpacing()
+{
+    QFETCH(int, periodMs);
+    QFETCH(int, jitterMs);
+    QFETCH(int, expected);
+
+    // Nothing listens, so everything stays in the buffer
+    TrackingClient client(nullptr);
+    client.setServer("127.0.0.1", 9);
+    client.setInterval(3600000);
+    client.start();
+
+    const int count = 60000 / periodMs;
+    for (int i = 0; i < count; i++)
+    {
+        const int jitter = (i & 1) ? jitterMs : -jitterMs;
+        client.addFix(position(m_start + qint64(i) * periodMs + jitter, 46.5 + i * 1e-4, 8.0, 2000));
+    }
+    QVERIFY(qAbs(client.pendingFixes() - expected) <= 1);
+}
+
+void TestTrackingClient::boundedWhileOffline()
+{
+    TrackingClient client(nullptr);
+    client.setServer("127.0.0.1", 9);
+    client.setInterval(3600000);
+    client.start();
+
+    // Three hours at 1 Hz with no link
+    for (int i = 0; i < 3 * 3600; i++)
+    {
+        client.addFix(position(m_start + qint64(i) * 1000, 46.5 + i * 1e-5, 8.0, 2000));
+        QVERIFY(client.pendingFixes() <= TRACKING_MAX_FIXES);
+    }
+    QVERIFY(client.fixesDropped() > 0);
+    QCOMPARE(client.pendingFixes() + client.fixesDropped(), qint64(3 * 3600));
+}
+
+void TestTrackingClient::sendsToStandInServer()
+{
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QByteArray received;
+    int connections = 0;
+    connect(&server, &QTcpServer::newConnection, this, [&]() {
+        QTcpSocket *socket = server.nextPendingConnection();
+        connections++;
+        connect(socket, &QTcpSocket::readyRead, this, [&received, socket]() { received += socket->readAll(); });
+    });
+
+    TrackingClient client(nullptr);
+    client.setServer("127.0.0.1", server.serverPort());
+    client.setPilot("pilot");
+    client.setInterval(50);
+    client.start();
+
+    // Two minutes of a 5 Hz receiver, fed in real 15 s batches worth of fixes
+    const int fixes = 120 * 5;
+    for (int i = 0; i < fixes; i++)
+    {
+        client.addFix(position(m_start + qint64(i) * 200, 46.5 + i * 2e-5, 8.0 + i * 1e-5, 2000 + i % 37));
+        if(i % 75 == 74)
+            QTRY_COMPARE_WITH_TIMEOUT(client.pendingFixes(), 0, 5000);
+    }
+    client.stop();
+    QTRY_COMPARE_WITH_TIMEOUT(received.size(), int(client.bytesSent()), 5000);
+
+    TrackDecoder decoder;
+    QVERIFY(decoder.decode(received));
+    QCOMPARE(decoder.pilot(), QByteArray("pilot"));
+    QCOMPARE(connections, 1);
+    QCOMPARE(decoder.fixes().size(), 120);
+    QCOMPARE(qint64(decoder.fixes().size()), client.fixesSent());
+
+    // Fixes come back exactly, at the kept 1 s spacing
+    for (int i = 0; i < decoder.fixes().size(); i++)
+    {
+        const DecodedFix &fix = decoder.fixes().at(i);
+        QCOMPARE(fix.time, (m_start + qint64(i) * 1000) / 1000);
+        QCOMPARE(fix.latitude, qRound((46.5 + i * 5 * 2e-5) * 1e5));
+        QCOMPARE(fix.longitude, qRound((8.0 + i * 5 * 1e-5) * 1e5));
+        QCOMPARE(fix.altitude, 2000 + (i * 5) % 37);
+    }
+
+    // The uplink cost: one wake-up per frame plus the connect
+    const double bytesPerFix = double(client.bytesSent()) / client.fixesSent();
+    qInfo("%lld bytes in %d frames, %lld wakeups: %.1f bytes per fix, about %.0f bytes per hour at 1 Hz",
+          client.bytesSent(), decoder.frames(), client.wakeups(), bytesPerFix, bytesPerFix * 3600);
+    QVERIFY(client.wakeups() <= decoder.frames() + 1);
+    QVERIFY(bytesPerFix < 16);
+}
+
+// Stopping without a connection can't send the buffer: those fixes count
+// as dropped and the next flight starts empty
+void TestTrackingClient::dropsUnsentOnStop()
+{
+    TrackingClient client(nullptr);
+    client.setServer("127.0.0.1", 9);
+    client.setInterval(3600000);
+    client.start();
+
+    for (int i = 0; i < 30; i++)
+        client.addFix(position(m_start + qint64(i) * 1000, 46.5 + i * 1e-4, 8.0, 2000));
+    QCOMPARE(client.pendingFixes(), 30);
+
+    client.stop();
+    QCOMPARE(client.pendingFixes(), 0);
+    QCOMPARE(client.fixesSent(), qint64(0));
+    QCOMPARE(client.fixesDropped(), qint64(30));
+
+    client.start();
+    QCOMPARE(client.pendingFixes(), 0);
+    client.addFix(position(m_start + 3600000, 47.0, 8.0, 2000));
+    QCOMPARE(client.pendingFixes(), 1);
+}
+
+QTEST_GUILESS_MAIN(TestTrackingClient)
+
+#include "tst_trackingclient.moc"
@@ -0,0 +1,12 @@
+include(../tests.pri)
+
+QT += network positioning
+
+TARGET = tst_trackingclient
+
+SOURCES += tst_trackingclient.cpp \
+    ../../trackingclient.cpp \
+    ../../trace.cpp
+
+HEADERS += \
+    ../../trackingclient.h
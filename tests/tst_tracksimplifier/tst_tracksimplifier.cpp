@@ -0,0 +1,213 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <tracksimplifier.h>
+#include <igcrecord.h>
+#include <cmath>
+
+#define METRES_PER_DEGREE 111195.0
+#define GLIDE_SPEED 15.0        // m/s
+#define CIRCLE_RATE 18.0        // deg/s
+#define CLIMB 2.0               // m/s
+#define SINK 1.0                // m/s
+#define GPS_NOISE 1.5           // m, at most either way
+#define FLIGHT_S 7200           // one fix per second
+
+// Two hours of three minutes gliding, two minutes circling, with GPS noise.
+// The noise comes from a fixed linear congruential generator so every run
+// sees the same track.
+static QVector<IgcFix> flight(int length)
+{
+    QVector<IgcFix> fixes;
+    fixes.reserve(length);
+    quint32 seed = 12345;
+    auto noise = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (static_cast<double>(seed >> 8) / (1 << 24) * 2 - 1) * GPS_NOISE;
+    };
+
+    double latitude = 46.5;
+    double longitude = 8.0;
+    double altitude = 1500;
+    double heading = 0;
+    for (int i = 0; i < length; i++)
+    {
+        if(i % 300 >= 180)
+        {
+            heading = std::fmod(heading + CIRCLE_RATE, 360);
+            altitude += CLIMB;
+        }
+        else
+        {
+            altitude -= SINK;
+        }
+        latitude += GLIDE_SPEED * std::cos(qDegreesToRadians(heading)) / METRES_PER_DEGREE;
+        longitude += GLIDE_SPEED * std::sin(qDegreesToRadians(heading)) / (METRES_PER_DEGREE * std::cos(qDegreesToRadians(latitude)));
+
+        IgcFix fix;
+        fix.time = 36000 + i;
+        fix.latitude = latitude + noise() / METRES_PER_DEGREE;
+        fix.longitude = longitude + noise() / (METRES_PER_DEGREE * std::cos(qDegreesToRadians(latitude)));
+        fix.pressureAltitude = qRound(altitude + noise());
+        fix.gpsAltitude = fix.pressureAltitude;
+        fix.valid = true;
+        fixes.append(fix);
+    }
+    return fixes;
+}
+
+static QVector<IgcFix> simplify(const QVector<IgcFix> &fixes, double tolerance)
+{
+    TrackSimplifier simplifier(tolerance);
+    for (const IgcFix &fix : fixes)
+        simplifier.add(fix);
+    simplifier.flush();
+    return simplifier.track();
+}
+
+// Metres in the plane of the first fix, as the simplifier measures
+struct Point
+{
+    double x, y, z;
+};
+
+static Point project(const IgcFix &fix, const IgcFix &origin)
+{
+    const double scaleX = METRES_PER_DEGREE * std::cos(qDegreesToRadians(origin.latitude));
+    return { (fix.longitude - origin.longitude) * scaleX, (fix.latitude - origin.latitude) * METRES_PER_DEGREE, static_cast<double>(fix.pressureAltitude) };
+}
+
+static double segmentDistance(const Point &p, const Point &a, const Point &b)
+{
+    const double dx = b.x - a.x, dy = b.y - a.y, dz = b.z - a.z;
+    const double px = p.x - a.x, py = p.y - a.y, pz = p.z - a.z;
+    const double length = dx * dx + dy * dy + dz * dz;
+    const double t = length > 0 ? qBound(0.0, (px * dx + py * dy + pz * dz) / length, 1.0) : 0;
+    const double ex = px - t * dx, ey = py - t * dy, ez = pz - t * dz;
+    return std::sqrt(ex * ex + ey * ey + ez * ez);
+}
+
+class TestTrackSimplifier : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void toleranceBound_data();
+    void toleranceBound();
+    void straightGlide();
+    void simplifyFile();
+    void add();
+};
+
+void TestTrackSimplifier::toleranceBound_data()
+{
+    QTest::addColumn<double>("tolerance");
+    QTest::addColumn<double>("maxRatio");
+
+    // Kept fixes per input fix; circling at 18 deg/s dominates
+    QTest::newRow("2 m") << 2.0 << 0.6;
+    QTest::newRow("10 m") << 10.0 << 0.15;
+    QTest::newRow("50 m") << 50.0 << 0.06;
+}
+
+// Every dropped fix lies within the tolerance of the simplified segment
+// between the kept fixes either side of it
+void TestTrackSimplifier::toleranceBound()
+{
+    QFETCH(double, tolerance);
+    QFETCH(double, maxRatio);
+
+    const QVector<IgcFix> fixes = flight(FLIGHT_S);
+    const QVector<IgcFix> track = simplify(fixes, tolerance);
+    QVERIFY(track.size() >= 2);
+    QCOMPARE(track.first().time, fixes.first().time);
+    QCOMPARE(track.last().time, fixes.last().time);
+
+    const IgcFix &origin = fixes.first();
+    double worst = 0;
+    int segment = 0;
+    for (const IgcFix &fix : fixes)
+    {
+        while (track[segment + 1].time < fix.time)
+            segment++;
+        const double distance = segmentDistance(project(fix, origin), project(track[segment], origin), project(track[segment + 1], origin));
+        QVERIFY2(distance <= tolerance + 1e-6, qPrintable(QString("fix at %1 s is %2 m off").arg(fix.time).arg(distance)));
+        worst = qMax(worst, distance);
+    }
+
+    const double ratio = static_cast<double>(track.size()) / fixes.size();
+    qInfo("%.0f m: %d of %d fixes kept (%.1f %%), worst %.2f m", tolerance, track.size(), fixes.size(), ratio * 100, worst);
+    QVERIFY(ratio < maxRatio);
+}
+
+// Without noise a straight glide only keeps a fix when the window is full
+void TestTrackSimplifier::straightGlide()
+{
+    TrackSimplifier simplifier(1.0);
+    for (int i = 0; i < 10000; i++)
+    {
+        IgcFix fix;
+        fix.time = i;
+        fix.latitude = 46.5 + i * GLIDE_SPEED / METRES_PER_DEGREE;
+        fix.longitude = 8.0;
+        fix.pressureAltitude = 1500;
+        fix.gpsAltitude = 1500;
+        fix.valid = true;
+        simplifier.add(fix);
+    }
+    simplifier.flush();
+
+    QCOMPARE(simplifier.inputCount(), 10000);
+    QVERIFY(simplifier.track().size() <= 10000 / TRACK_SIMPLIFY_WINDOW + 2);
+}
+
+// A logged file gives what streaming the same B records does
+void TestTrackSimplifier::simplifyFile()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath("flight.igc");
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("AXGD000 XcVario v1.0\r\nHFDTE110620\r\n");
+    char line[IGC_B_RECORD_LENGTH + 2];
+    for (const IgcFix &fix : flight(FLIGHT_S))
+    {
+        const int length = formatBRecord(fix, line);
+        line[length] = '\r';
+        line[length + 1] = '\n';
+        file.write(line, length + 2);
+    }
+    file.close();
+
+    QVector<IgcFix> fixes;
+    QVERIFY(readIgcFixes(fileName, fixes));
+    QCOMPARE(fixes.size(), FLIGHT_S);
+    const QVector<IgcFix> expected = simplify(fixes, TRACK_SIMPLIFY_TOLERANCE);
+
+    QVector<IgcFix> track;
+    QVERIFY(TrackSimplifier::simplifyFile(fileName, TRACK_SIMPLIFY_TOLERANCE, track));
+    QCOMPARE(track.size(), expected.size());
+    for (int i = 0; i < track.size(); i++)
+        QCOMPARE(track[i].time, expected[i].time);
+
+    QVERIFY(!TrackSimplifier::simplifyFile(dir.filePath("missing.igc"), TRACK_SIMPLIFY_TOLERANCE, track));
+}
+
+// Per fix cost of a live flight, window scans included
+void TestTrackSimplifier::add()
+{
+    const QVector<IgcFix> fixes = flight(FLIGHT_S);
+    TrackSimplifier simplifier;
+    QBENCHMARK
+    {
+        simplifier.reset();
+        for (const IgcFix &fix : fixes)
+            simplifier.add(fix);
+    }
+    qInfo("%d of %d fixes kept", simplifier.track().size(), fixes.size());
+}
+
+QTEST_GUILESS_MAIN(TestTrackSimplifier)
+
+#include "tst_tracksimplifier.moc"
@@ -0,0 +1,11 @@
+include(../tests.pri)
+
+TARGET = tst_tracksimplifier
+
+SOURCES += tst_tracksimplifier.cpp \
+    ../../tracksimplifier.cpp \
+    ../../igcrecord.cpp
+
+HEADERS += \
+    ../../tracksimplifier.h \
+    ../../igcrecord.h
@@ -0,0 +1,229 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <uploadqueue.h>
+#include <stubserver.h>
+
+#define TEST_BACKOFF_MS 50
+
+class TestUploadQueue : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void retriesWithBackoff();
+    void persistsFailedAttempts();
+    void resumesAfterRestart();
+    void keepsServerBackoffAfterRestart();
+    void drainsManyFlightsOverFewConnections();
+
+private:
+    QString writeIgc(const QString &name);
+    QJsonArray savedEntries() const;
+    QJsonObject savedServers() const;
+
+private:
+    QTemporaryDir m_dir;
+    QString m_queueFile;
+};
+
+void TestUploadQueue::initTestCase()
+{
+    qRegisterMetaType<NetworkAccessManager::SubmitResult>();
+    QVERIFY(m_dir.isValid());
+}
+
+void TestUploadQueue::init()
+{
+    m_queueFile = m_dir.filePath(QString(QTest::currentTestFunction()) + ".json");
+}
+
+QString TestUploadQueue::writeIgc(const QString &name)
+{
+    QFile file(m_dir.filePath(name));
+    if(!file.open(QIODevice::WriteOnly))
+        return QString();
+    file.write("AXGD000 XcVario v1.0\r\nHFDTE110620\r\nB1101355206343N00006198WA0058700558+050\r\n");
+    return file.fileName();
+}
+
+QJsonArray TestUploadQueue::savedEntries() const
+{
+    QFile file(m_queueFile);
+    if(!file.open(QIODevice::ReadOnly))
+        return QJsonArray();
+    return QJsonDocument::fromJson(file.readAll()).object().value("entries").toArray();
+}
+
+QJsonObject TestUploadQueue::savedServers() const
+{
+    QFile file(m_queueFile);
+    if(!file.open(QIODevice::ReadOnly))
+        return QJsonObject();
+    return QJsonDocument::fromJson(file.readAll()).object().value("servers").toObject();
+}
+
+void TestUploadQueue::retriesWithBackoff()
+{
+    StubServer server;
+    QVERIFY(server.listen());
+    server.failNext(2);
+
+    QUrl url = server.url();
+    NetworkAccessManager network(url, nullptr);
+    UploadQueue queue(&network, m_queueFile, nullptr);
+    queue.setBackoffBase(TEST_BACKOFF_MS);
+    queue.setServers(QList<QUrl>() << url);
+    queue.setCredentials("pilot", "secret");
+
+    QSignalSpy uploaded(&queue, &UploadQueue::flightUploaded);
+    QElapsedTimer timer;
+    timer.start();
+    queue.enqueue(writeIgc("retry.igc"));
+
+    QVERIFY(uploaded.wait(10000));
+    QCOMPARE(server.requests().size(), 3);
+    QCOMPARE(queue.pendingCount(), 0);
+    QVERIFY(savedEntries().isEmpty());
+    // Two backoffs of at least 80% of 1x and 2x the base
+    QVERIFY(timer.elapsed() >= TEST_BACKOFF_MS * 3 * 8 / 10);
+}
+
+void TestUploadQueue::persistsFailedAttempts()
+{
+    StubServer server;
+    QVERIFY(server.listen());
+    QUrl url = server.url();
+    NetworkAccessManager network(url, nullptr);
+
+    // Exists, but can't be opened: submitFlight fails before any request
+    const QString fileName = m_dir.filePath("directory.igc");
+    QVERIFY(QDir().mkpath(fileName));
+
+    {
+        UploadQueue queue(&network, m_queueFile, nullptr);
+        queue.setBackoffBase(60000);
+        queue.setServers(QList<QUrl>() << url);
+        queue.setCredentials("pilot", "secret");
+        queue.enqueue(fileName);
+    }
+
+    const QJsonArray entries = savedEntries();
+    QCOMPARE(entries.size(), 1);
+    QCOMPARE(entries.at(0).toObject().value("attempts").toInt(), 1);
+    QVERIFY(entries.at(0).toObject().value("notBefore").toDouble() > QDateTime::currentMSecsSinceEpoch());
+    QCOMPARE(server.requests().size(), 0);
+}
+
+void TestUploadQueue::resumesAfterRestart()
+{
+    StubServer first, second;
+    QVERIFY(first.listen());
+    QVERIFY(second.listen());
+    QUrl url = first.url();
+    const QList<QUrl> servers = QList<QUrl>() << first.url() << second.url();
+    const QString fileName = writeIgc("restart.igc");
+    NetworkAccessManager network(url, nullptr);
+
+    // No credentials yet: queued and saved, nothing sent
+    {
+        UploadQueue queue(&network, m_queueFile, nullptr);
+        queue.setServers(servers);
+        queue.enqueue(fileName);
+        QCOMPARE(queue.pendingCount(), 2);
+    }
+    QCOMPARE(savedEntries().size(), 2);
+    QCOMPARE(first.requests().size() + second.requests().size(), 0);
+
+    UploadQueue queue(&network, m_queueFile, nullptr);
+    QCOMPARE(queue.pendingCount(), 2);
+    queue.setServers(servers);
+    QSignalSpy uploaded(&queue, &UploadQueue::flightUploaded);
+    queue.setCredentials("pilot", "secret");
+
+    QTRY_COMPARE_WITH_TIMEOUT(uploaded.size(), 2, 10000);
+    QCOMPARE(first.requests().size(), 1);
+    QCOMPARE(second.requests().size(), 1);
+    QVERIFY(savedEntries().isEmpty());
+}
+
+// A failing server stays backed off across a restart: a flight queued after
+// it waits instead of going out at once
+void TestUploadQueue::keepsServerBackoffAfterRestart()
+{
+    StubServer server;
+    QVERIFY(server.listen());
+    server.failNext(1);
+
+    QUrl url = server.url();
+    const QString key = NetworkAccessManager::serverKey(url);
+    NetworkAccessManager network(url, nullptr);
+
+    {
+        UploadQueue queue(&network, m_queueFile, nullptr);
+        queue.setBackoffBase(60000);
+        queue.setServers(QList<QUrl>() << url);
+        queue.setCredentials("pilot", "secret");
+        queue.enqueue(writeIgc("failed.igc"));
+        QTRY_VERIFY_WITH_TIMEOUT(savedServers().contains(key), 10000);
+    }
+    QCOMPARE(server.requests().size(), 1);
+
+    const QJsonObject saved = savedServers().value(key).toObject();
+    QCOMPARE(saved.value("failures").toInt(), 1);
+    QVERIFY(saved.value("notBefore").toDouble() > QDateTime::currentMSecsSinceEpoch());
+
+    UploadQueue queue(&network, m_queueFile, nullptr);
+    queue.setBackoffBase(60000);
+    queue.setServers(QList<QUrl>() << url);
+    queue.setCredentials("pilot", "secret");
+    queue.enqueue(writeIgc("later.igc"));
+
+    QCOMPARE(queue.pendingCount(), 2);
+    QTest::qWait(500);
+    QCOMPARE(server.requests().size(), 1);
+    QVERIFY(savedServers().contains(key));
+}
+
+void TestUploadQueue::drainsManyFlightsOverFewConnections()
+{
+    const int flights = 6;
+    StubServer first, second;
+    QVERIFY(first.listen());
+    QVERIFY(second.listen());
+    // Slow enough that requests overlap
+    first.setThrottle(64 * 1024);
+    second.setThrottle(64 * 1024);
+    // One failure per server on the way
+    first.failNext(1);
+    second.failNext(1);
+
+    QUrl url = first.url();
+    NetworkAccessManager network(url, nullptr);
+    UploadQueue queue(&network, m_queueFile, nullptr);
+    queue.setBackoffBase(TEST_BACKOFF_MS);
+    queue.setServers(QList<QUrl>() << first.url() << second.url());
+    queue.setCredentials("pilot", "secret");
+
+    QSignalSpy uploaded(&queue, &UploadQueue::flightUploaded);
+    for (int i = 0; i < flights; i++)
+        queue.enqueue(writeIgc(QString("flight%1.igc").arg(i)));
+
+    QTRY_COMPARE_WITH_TIMEOUT(uploaded.size(), 2 * flights, 30000);
+    QCOMPARE(first.requests().size(), flights + 1);
+    QCOMPARE(second.requests().size(), flights + 1);
+
+    // Bounded per server, and the connections are reused (keep-alive)
+    QVERIFY(first.maxConcurrent() <= UPLOAD_MAX_PER_SERVER);
+    QVERIFY(second.maxConcurrent() <= UPLOAD_MAX_PER_SERVER);
+    QVERIFY(first.connectionCount() <= UPLOAD_MAX_PER_SERVER);
+    QVERIFY(second.connectionCount() <= UPLOAD_MAX_PER_SERVER);
+}
+
+QTEST_GUILESS_MAIN(TestUploadQueue)
+
+#include "tst_uploadqueue.moc"
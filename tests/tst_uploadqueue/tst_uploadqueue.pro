@@ -0,0 +1,17 @@
+include(../tests.pri)
+include(../common/common.pri)
+
+QT += concurrent
+LIBS += -lz
+
+TARGET = tst_uploadqueue
+
+SOURCES += tst_uploadqueue.cpp \
+    ../../uploadqueue.cpp \
+    ../../networkaccessmanager.cpp \
+    ../../trace.cpp \
+    ../../metrics.cpp
+
+HEADERS += \
+    ../../uploadqueue.h \
+    ../../networkaccessmanager.h
@@ -0,0 +1,251 @@
+#include <QtTest>
+#include <varioparser.h>
+#include <pressureselector.h>
+#include <nmeasentence.h>
+#include <cmath>
+#include <random>
+
+// NaN for "not sent" compares equal to NaN
+static bool same(double actual, double expected)
+{
+    if(std::isnan(expected))
+        return std::isnan(actual);
+    return qAbs(actual - expected) < 1e-9;
+}
+
+static QVector<VarioSample> parse(const QByteArray &data)
+{
+    VarioParser parser;
+    parser.feed(data.constData(), data.size());
+    QVector<VarioSample> samples;
+    VarioSample sample;
+    while (parser.nextSample(sample))
+        samples.append(sample);
+    return samples;
+}
+
+struct SelectorRun
+{
+    int switches;
+    int active;
+    qint64 lastSwitch;      // ms, -1 without a switch
+    double maxJump;         // Pa, largest output step at a switch
+};
+
+// Two sensors on the same climbing air mass: the internal one 30 Pa off,
+// each with its own noise and period. The external one stops at silentFrom.
+static SelectorRun runSelector(double internalNoise, double externalNoise, int internalPeriod, int externalPeriod,
+                               qint64 duration, qint64 silentFrom, int seed)
+{
+    std::mt19937 random(seed);
+    std::normal_distribution<double> noise(0, 1);
+    const double noises[PRESSURE_SOURCES] = { internalNoise, externalNoise };
+    const int periods[PRESSURE_SOURCES] = { internalPeriod, externalPeriod };
+    const double offsets[PRESSURE_SOURCES] = { 30, 0 };
+    qint64 next[PRESSURE_SOURCES] = { 0, externalPeriod / 2 };
+
+    PressureSelector selector;
+    SelectorRun run = { 0, -1, -1, 0 };
+    double output = NAN;
+    for (;;)
+    {
+        const int source = next[PRESSURE_SOURCE_INTERNAL] <= next[PRESSURE_SOURCE_EXTERNAL]
+                ? PRESSURE_SOURCE_INTERNAL : PRESSURE_SOURCE_EXTERNAL;
+        const qint64 time = next[source];
+        if(time > duration)
+            break;
+        next[source] += periods[source];
+        if(source == PRESSURE_SOURCE_EXTERNAL && time >= silentFrom)
+            continue;
+
+        const double pressure = 90000 - time * 0.01 + offsets[source] + noises[source] * noise(random);
+        double selected;
+        if(!selector.add(source, time, pressure, selected))
+            continue;
+        if(selector.active() != run.active)
+        {
+            if(run.active >= 0)
+            {
+                run.switches++;
+                run.lastSwitch = time;
+                run.maxJump = qMax(run.maxJump, qAbs(selected - output));
+            }
+            run.active = selector.active();
+        }
+        output = selected;
+    }
+    return run;
+}
+
+class TestVarioParser : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void sentences_data();
+    void sentences();
+    void blueFlyStream();
+    void rejectsBadChecksum();
+    void quieterSourceTakesOver_data();
+    void quieterSourceTakesOver();
+    void similarSourcesDontFlip_data();
+    void similarSourcesDontFlip();
+    void silentSourceReplaced();
+    void parseRate();
+};
+
+void TestVarioParser::sentences_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<double>("pressure");
+    QTest::addColumn<double>("altitude");
+    QTest::addColumn<double>("vario");
+    QTest::addColumn<double>("temperature");
+
+    QTest::newRow("$LK8EX1") << sentence("LK8EX1,98765,99999,-150,25,999")
+                             << 98765.0 << double(NAN) << -1.5 << 25.0;
+    QTest::newRow("$LK8EX1 altitude only") << sentence("LK8EX1,999999,1234,9999,99,999")
+                                           << double(NAN) << 1234.0 << double(NAN) << double(NAN);
+    QTest::newRow("$PRS,") << sentence("PRS,1828E") << 98958.0 << double(NAN) << double(NAN) << double(NAN);
+    QTest::newRow("$PRS") << QByteArray("$PRS 1828E\r\n") << 98958.0 << double(NAN) << double(NAN) << double(NAN);
+    QTest::newRow("PRS") << QByteArray("PRS 1828E\n") << 98958.0 << double(NAN) << double(NAN) << double(NAN);
+    QTest::newRow("PRS CRLF") << QByteArray("PRS 1828e\r\n") << 98958.0 << double(NAN) << double(NAN) << double(NAN);
+    QTest::newRow("$POV") << sentence("POV,P,1013.25,E,1.50,T,20.5")
+                          << 101325.0 << double(NAN) << 1.5 << 20.5;
+    QTest::newRow("$POV vario only") << sentence("POV,E,-0.75") << double(NAN) << double(NAN) << -0.75 << double(NAN);
+}
+
+void TestVarioParser::sentences()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(double, pressure);
+    QFETCH(double, altitude);
+    QFETCH(double, vario);
+    QFETCH(double, temperature);
+
+    const QVector<VarioSample> samples = parse(data);
+    QCOMPARE(samples.size(), 1);
+    QVERIFY(same(samples.first().pressure, pressure));
+    QVERIFY(same(samples.first().altitude, altitude));
+    QVERIFY(same(samples.first().vario, vario));
+    QVERIFY(same(samples.first().temperature, temperature));
+}
+
+// A BlueFlyVario at 50 Hz next to a GPS, split at arbitrary points
+void TestVarioParser::blueFlyStream()
+{
+    QByteArray data;
+    for (int i = 0; i < 100; i++)
+    {
+        data += "PRS " + QByteArray::number(98958 - i, 16).toUpper() + "\r\n";
+        if(i % 5 == 0)
+            data += sentence("GPGGA,110000.00,4630.00000,N,00800.00000,E,1,09,0.8,2000.0,M,48.0,M,,");
+        if(i == 50)
+            data += "PRS\r\nPRS xyz\r\nnoise\r\n";
+    }
+
+    VarioParser parser;
+    VarioSample sample;
+    int count = 0;
+    double last = 0;
+    for (int at = 0; at < data.size(); at += 7)
+    {
+        parser.feed(data.constData() + at, qMin(7, data.size() - at));
+        while (parser.nextSample(sample))
+        {
+            QCOMPARE(sample.pressure, double(98958 - count));
+            last = sample.pressure;
+            count++;
+        }
+    }
+    QCOMPARE(count, 100);
+    QCOMPARE(last, 98859.0);
+}
+
+void TestVarioParser::rejectsBadChecksum()
+{
+    QByteArray data = sentence("LK8EX1,98765,99999,-150,25,999");
+    data[10] = '6';
+    VarioParser parser;
+    parser.feed(data.constData(), data.size());
+    VarioSample sample;
+    QVERIFY(!parser.nextSample(sample));
+    QCOMPARE(parser.checksumErrors(), qint64(1));
+}
+
+void TestVarioParser::quieterSourceTakesOver_data()
+{
+    QTest::addColumn<int>("seed");
+    for (int seed = 1; seed <= 5; seed++)
+        QTest::newRow(qPrintable(QString("seed %1").arg(seed))) << seed;
+}
+
+// An external vario ten times quieter than the phone's sensor takes over
+// once, after the hold time, without a step in the output
+void TestVarioParser::quieterSourceTakesOver()
+{
+    QFETCH(int, seed);
+
+    const SelectorRun run = runSelector(10, 1, 50, 50, 60000, 60000, seed);
+    QCOMPARE(run.switches, 1);
+    QCOMPARE(run.active, PRESSURE_SOURCE_EXTERNAL);
+    QVERIFY(run.lastSwitch >= PRESSURE_SWITCH_HOLD_MS);
+    QVERIFY(run.lastSwitch < PRESSURE_SWITCH_HOLD_MS + 2000);
+    QVERIFY(run.maxJump < 1e-6);
+}
+
+void TestVarioParser::similarSourcesDontFlip_data()
+{
+    QTest::addColumn<int>("externalPeriod");
+    QTest::addColumn<int>("seed");
+
+    for (int seed = 1; seed <= 3; seed++)
+    {
+        QTest::newRow(qPrintable(QString("same rate, seed %1").arg(seed))) << 50 << seed;
+        QTest::newRow(qPrintable(QString("half rate, seed %1").arg(seed))) << 100 << seed;
+    }
+}
+
+// Ten minutes of two sensors of the same noise: the wander of the noise
+// estimates must not switch between them
+void TestVarioParser::similarSourcesDontFlip()
+{
+    QFETCH(int, externalPeriod);
+    QFETCH(int, seed);
+
+    const SelectorRun run = runSelector(2, 2, 50, externalPeriod, 600000, 600000, seed);
+    QCOMPARE(run.switches, 0);
+    QCOMPARE(run.active, PRESSURE_SOURCE_INTERNAL);
+}
+
+// The external vario goes silent: the internal sensor takes back over at
+// its first sample after the timeout, continuing the output
+void TestVarioParser::silentSourceReplaced()
+{
+    const SelectorRun run = runSelector(10, 1, 50, 50, 23000, 20000, 1);
+    QCOMPARE(run.switches, 2);
+    QCOMPARE(run.active, PRESSURE_SOURCE_INTERNAL);
+    QVERIFY(run.lastSwitch > 20000 + PRESSURE_SOURCE_TIMEOUT_MS - 100);
+    QVERIFY(run.lastSwitch <= 20000 + PRESSURE_SOURCE_TIMEOUT_MS + 100);
+    QVERIFY(run.maxJump < 1e-6);
+}
+
+// One second of a BlueFlyVario at its fastest, about 1 kHz
+void TestVarioParser::parseRate()
+{
+    QByteArray data;
+    for (int i = 0; i < 1000; i++)
+        data += "PRS " + QByteArray::number(98958 - i % 50, 16).toUpper() + "\r\n";
+
+    VarioParser parser;
+    VarioSample sample;
+    QBENCHMARK {
+        parser.feed(data.constData(), data.size());
+        while (parser.nextSample(sample))
+            ;
+    }
+}
+
+QTEST_GUILESS_MAIN(TestVarioParser)
+
+#include "tst_varioparser.moc"
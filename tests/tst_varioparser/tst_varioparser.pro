@@ -0,0 +1,14 @@
+include(../tests.pri)
+
+TARGET = tst_varioparser
+
+SOURCES += tst_varioparser.cpp \
+    ../../varioparser.cpp \
+    ../../nmeaparser.cpp \
+    ../../pressureselector.cpp
+
+HEADERS += \
+    ../../varioparser.h \
+    ../../nmeaparser.h \
+    ../../pressureselector.h \
+    ../common/nmeasentence.h
@@ -0,0 +1,163 @@
+#include <QtTest>
+#include <windestimator.h>
+#include <cmath>
+#include <random>
+
+#define AIRSPEED 11.0           // m/s
+#define CIRCLE_RATE 18.0        // deg/s, a circle in 20 s
+
+// Synthetic track at 1 Hz: the glider flies at AIRSPEED on a heading and
+// the wind (towards east and north, m/s) adds to it. GPS noise is optional.
+class Glider
+{
+public:
+    Glider() : m_time(0), m_heading(0), m_speedNoise(0), m_trackNoise(0), m_random(7) {}
+
+    void setNoise(double speed, double track)
+    {
+        m_speedNoise = speed;
+        m_trackNoise = track;
+    }
+
+    void fly(WindEstimator &wind, double windX, double windY, int seconds, bool circling)
+    {
+        std::normal_distribution<double> normal(0, 1);
+        for (int i = 0; i < seconds; i++, m_time += 1000)
+        {
+            m_heading = circling ? std::fmod(m_heading + CIRCLE_RATE, 360) : 0;
+            const double x = AIRSPEED * std::sin(qDegreesToRadians(m_heading)) + windX;
+            const double y = AIRSPEED * std::cos(qDegreesToRadians(m_heading)) + windY;
+            double track = qRadiansToDegrees(std::atan2(x, y)) + m_trackNoise * normal(m_random);
+            if(track < 0)
+                track += 360;
+            wind.update(m_time, std::hypot(x, y) + m_speedNoise * normal(m_random), track, circling);
+        }
+    }
+
+private:
+    qint64 m_time;
+    double m_heading;
+    double m_speedNoise;
+    double m_trackNoise;
+    std::mt19937 m_random;
+};
+
+// Wind vector of a wind of speed blowing from a direction
+static double towardsEast(double speed, double from)
+{
+    return -speed * std::sin(qDegreesToRadians(from));
+}
+
+static double towardsNorth(double speed, double from)
+{
+    return -speed * std::cos(qDegreesToRadians(from));
+}
+
+static double angleBetween(double a, double b)
+{
+    return qAbs(std::remainder(a - b, 360.0));
+}
+
+class TestWindEstimator : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void exactCircles();
+    void noisyCircles_data();
+    void noisyCircles();
+    void straightFlightDrift();
+    void newThermalRefits();
+    void updateCost();
+};
+
+void TestWindEstimator::exactCircles()
+{
+    WindEstimator wind;
+    Glider glider;
+    glider.fly(wind, towardsEast(5, 270), towardsNorth(5, 270), 40, true);
+
+    QVERIFY(qAbs(wind.speed() - 5) < 1e-6);
+    QVERIFY(angleBetween(wind.direction(), 270) < 1e-4);
+    QVERIFY(qAbs(wind.airspeed() - AIRSPEED) < 1e-6);
+    QVERIFY(wind.confidence() > 0.99);
+}
+
+void TestWindEstimator::noisyCircles_data()
+{
+    QTest::addColumn<double>("speed");
+    QTest::addColumn<double>("from");
+
+    QTest::newRow("calm") << 0.0 << 0.0;
+    QTest::newRow("3 m/s from 120") << 3.0 << 120.0;
+    QTest::newRow("5 m/s from 270") << 5.0 << 270.0;
+    QTest::newRow("8 m/s from 180") << 8.0 << 180.0;
+    QTest::newRow("10 m/s from 45") << 10.0 << 45.0;
+}
+
+// Three circles with 0.3 m/s speed and 2 deg track noise
+void TestWindEstimator::noisyCircles()
+{
+    QFETCH(double, speed);
+    QFETCH(double, from);
+
+    WindEstimator wind;
+    Glider glider;
+    glider.setNoise(0.3, 2);
+    glider.fly(wind, towardsEast(speed, from), towardsNorth(speed, from), 60, true);
+
+    qInfo("%.2f m/s from %.1f, airspeed %.2f, confidence %.2f",
+          wind.speed(), wind.direction(), wind.airspeed(), wind.confidence());
+    QVERIFY(qAbs(wind.speed() - speed) < 0.5);
+    if(speed >= 3)
+        QVERIFY(angleBetween(wind.direction(), from) < 6);
+    QVERIFY(qAbs(wind.airspeed() - AIRSPEED) < 0.3);
+    QVERIFY(wind.confidence() > 0.5);
+}
+
+// The wind picks up 2 m/s from the north during a glide north: only that
+// component is observable, and the estimate follows it
+void TestWindEstimator::straightFlightDrift()
+{
+    WindEstimator wind;
+    Glider glider;
+    glider.fly(wind, 5, 0, 40, true);
+    const double fitted = wind.confidence();
+
+    glider.fly(wind, 5, -2, 180, false);
+    const double trueSpeed = std::hypot(5.0, 2.0);
+    const double trueFrom = qRadiansToDegrees(std::atan2(-5.0, 2.0)) + 360;
+    QVERIFY(qAbs(wind.speed() - trueSpeed) < 0.1);
+    QVERIFY(angleBetween(wind.direction(), trueFrom) < 2);
+
+    // Confidence halves every WIND_DECAY_S without circling
+    glider.fly(wind, 5, -2, int(WIND_DECAY_S) - 180, false);
+    QVERIFY(qAbs(wind.confidence() / fitted - 0.5) < 0.01);
+}
+
+void TestWindEstimator::newThermalRefits()
+{
+    WindEstimator wind;
+    Glider glider;
+    glider.fly(wind, 5, 0, 40, true);
+    glider.fly(wind, 5, 0, 60, false);
+
+    // Another thermal, another wind: the old samples don't linger
+    glider.fly(wind, -4, 3, 40, true);
+    QVERIFY(qAbs(wind.speed() - 5) < 1e-6);
+    QVERIFY(angleBetween(wind.direction(), qRadiansToDegrees(std::atan2(4.0, -3.0))) < 1e-4);
+}
+
+void TestWindEstimator::updateCost()
+{
+    WindEstimator wind;
+    Glider glider;
+    glider.setNoise(0.3, 2);
+    QBENCHMARK {
+        glider.fly(wind, 5, 0, 1000, true);
+    }
+}
+
+QTEST_GUILESS_MAIN(TestWindEstimator)
+
+#include "tst_windestimator.moc"
@@ -0,0 +1,9 @@
+include(../tests.pri)
+
+TARGET = tst_windestimator
+
+SOURCES += tst_windestimator.cpp \
+    ../../windestimator.cpp
+
+HEADERS += \
+    ../../windestimator.h
@@ -0,0 +1,254 @@
+#include <QtTest>
+#include <xcscore.h>
+#include <cmath>
+#include <random>
+
+#define KM_PER_DEGREE_LATITUDE 111.195
+#define ORIGIN_LATITUDE 46.5
+#define ORIGIN_LONGITUDE 8.0
+
+struct ReferencePoint
+{
+    double x;
+    double y;
+};
+
+struct ReferenceResult
+{
+    double free;
+    double flat;
+    double fai;
+};
+
+static double km(const ReferencePoint &a, const ReferencePoint &b)
+{
+    return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+}
+
+// Synthetic flights, in km east and north of the origin:
+//  0 wandering, a random walk in heading
+//  1 triangle flown with thermal circles on the legs
+//  2 out and return
+static QVector<QGeoCoordinate> flight(int kind, int seed, int fixes)
+{
+    std::mt19937 random(seed);
+    std::normal_distribution<double> noise(0, 1);
+    const double kmPerDegreeLongitude = KM_PER_DEGREE_LATITUDE * std::cos(qDegreesToRadians(ORIGIN_LATITUDE));
+    const double corners[4][2] = { { 0, 0 }, { 30, 5 }, { 15, 28 }, { 1, 1 } };
+
+    QVector<QGeoCoordinate> track;
+    double x = 0;
+    double y = 0;
+    double heading = 0;
+    for (int i = 0; i < fixes; i++)
+    {
+        if(kind == 0)
+        {
+            heading += 0.3 * noise(random);
+            x += 0.12 * std::cos(heading);
+            y += 0.12 * std::sin(heading);
+        }
+        else
+        {
+            const double leg = 3.0 * i / fixes;
+            if(kind == 1)
+            {
+                const int l = qMin(2, int(leg));
+                const double u = leg - l;
+                x = corners[l][0] + (corners[l + 1][0] - corners[l][0]) * u;
+                y = corners[l][1] + (corners[l + 1][1] - corners[l][1]) * u;
+            }
+            else
+            {
+                x = (leg < 1.5 ? leg : 3 - leg) * 25;
+                y = 0.5 * std::sin(leg * 7);
+            }
+            x += 0.15 * std::cos(i * 0.7);
+            y += 0.15 * std::sin(i * 0.7);
+        }
+        track.append(QGeoCoordinate(ORIGIN_LATITUDE + y / KM_PER_DEGREE_LATITUDE,
+                                    ORIGIN_LONGITUDE + x / kmPerDegreeLongitude));
+    }
+    return track;
+}
+
+// Exhaustive search over the fixes XcScore keeps in its track: the same
+// projection and spacing, every turnpoint combination, O(n^3)
+static ReferenceResult reference(const QVector<QGeoCoordinate> &fixes)
+{
+    const double kmPerDegreeLongitude = KM_PER_DEGREE_LATITUDE * std::cos(qDegreesToRadians(fixes.first().latitude()));
+    QVector<ReferencePoint> track;
+    for (const QGeoCoordinate &fix : fixes)
+    {
+        const ReferencePoint point = { (fix.longitude() - fixes.first().longitude()) * kmPerDegreeLongitude,
+                                       (fix.latitude() - fixes.first().latitude()) * KM_PER_DEGREE_LATITUDE };
+        if(track.isEmpty() || km(point, track.last()) >= XC_INITIAL_SPACING_KM)
+            track.append(point);
+    }
+    const int n = track.size();
+
+    ReferenceResult result = { 0, 0, 0 };
+    QVector<double> best(n, 0);
+    for (int k = 1; k <= XC_FREE_LEGS; k++)
+    {
+        QVector<double> next(n, 0);
+        for (int j = 0; j < n; j++)
+        {
+            for (int i = 0; i <= j; i++)
+                next[j] = qMax(next[j], best[i] + km(track[i], track[j]));
+        }
+        best = next;
+    }
+    for (double total : best)
+        result.free = qMax(result.free, total);
+
+    // Smallest closing distance between a fix up to a and one from c on
+    QVector<double> gap(n * n);
+    for (int a = 0; a < n; a++)
+    {
+        for (int c = n - 1; c >= a; c--)
+        {
+            double g = km(track[a], track[c]);
+            if(a > 0)
+                g = qMin(g, gap[(a - 1) * n + c]);
+            if(c < n - 1)
+                g = qMin(g, gap[a * n + c + 1]);
+            gap[a * n + c] = g;
+        }
+    }
+
+    for (int a = 0; a < n; a++)
+    {
+        for (int c = a + 2; c < n; c++)
+        {
+            const double closing = gap[a * n + c];
+            const double ac = km(track[a], track[c]);
+            for (int b = a + 1; b < c; b++)
+            {
+                const double ab = km(track[a], track[b]);
+                const double bc = km(track[b], track[c]);
+                const double perimeter = ab + bc + ac;
+                if(closing > XC_CLOSING_RATIO * perimeter)
+                    continue;
+                result.flat = qMax(result.flat, perimeter - closing);
+                if(qMin(ab, qMin(bc, ac)) >= XC_FAI_MIN_LEG_RATIO * perimeter)
+                    result.fai = qMax(result.fai, perimeter - closing);
+            }
+        }
+    }
+    return result;
+}
+
+class TestXcScore : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void exactBeforeThinning_data();
+    void exactBeforeThinning();
+    void withinErrorBound_data();
+    void withinErrorBound();
+    void resetStartsNewFlight();
+    void costPerFix();
+};
+
+void TestXcScore::exactBeforeThinning_data()
+{
+    QTest::addColumn<int>("seed");
+    for (int seed = 1; seed <= 6; seed++)
+        QTest::newRow(qPrintable(QString("wandering %1").arg(seed))) << seed;
+}
+
+void TestXcScore::exactBeforeThinning()
+{
+    QFETCH(int, seed);
+
+    const QVector<QGeoCoordinate> fixes = flight(0, seed, XC_MAX_POINTS - 20);
+    XcScore score;
+    for (const QGeoCoordinate &fix : fixes)
+        score.addFix(fix);
+    QCOMPARE(score.pointCount(), score.trackCount());
+    QCOMPARE(score.errorBound(), 0.0);
+
+    const ReferenceResult expected = reference(fixes);
+    QVERIFY(qAbs(score.freeDistance().distance - expected.free) < 1e-3);
+    QVERIFY(qAbs(score.flatTriangle().distance - expected.flat) < 1e-3);
+    QVERIFY(qAbs(score.faiTriangle().distance - expected.fai) < 1e-3);
+}
+
+void TestXcScore::withinErrorBound_data()
+{
+    QTest::addColumn<int>("kind");
+    QTest::addColumn<int>("seed");
+
+    QTest::newRow("wandering 1") << 0 << 1;
+    QTest::newRow("wandering 2") << 0 << 2;
+    QTest::newRow("wandering 3") << 0 << 3;
+    QTest::newRow("triangle") << 1 << 1;
+    QTest::newRow("out and return") << 2 << 1;
+}
+
+// Long enough to re-thin: never better than the optimum over the track,
+// never worse by more than errorBound(), and in practice within 5%
+void TestXcScore::withinErrorBound()
+{
+    QFETCH(int, kind);
+    QFETCH(int, seed);
+
+    const QVector<QGeoCoordinate> fixes = flight(kind, seed, 1200);
+    XcScore score;
+    for (const QGeoCoordinate &fix : fixes)
+        score.addFix(fix);
+    QVERIFY(score.pointCount() < score.trackCount());
+
+    const ReferenceResult expected = reference(fixes);
+    const double bound = score.errorBound();
+    const double found[3] = { score.freeDistance().distance, score.flatTriangle().distance, score.faiTriangle().distance };
+    const double optimum[3] = { expected.free, expected.flat, expected.fai };
+    qInfo("%d of %d fixes kept, bound %.2f km; free %.2f of %.2f, flat %.2f of %.2f, FAI %.2f of %.2f km",
+          score.pointCount(), score.trackCount(), bound,
+          found[0], optimum[0], found[1], optimum[1], found[2], optimum[2]);
+
+    for (int i = 0; i < 3; i++)
+    {
+        QVERIFY(found[i] <= optimum[i] + 1e-3);
+        QVERIFY(found[i] >= optimum[i] - bound);
+        QVERIFY(found[i] >= optimum[i] * 0.95);
+    }
+}
+
+void TestXcScore::resetStartsNewFlight()
+{
+    XcScore score;
+    for (const QGeoCoordinate &fix : flight(1, 1, 600))
+        score.addFix(fix);
+    QVERIFY(score.best().score > 100);
+
+    // A short second flight elsewhere doesn't inherit the first one
+    score.reset();
+    QCOMPARE(score.best().score, 0.0);
+    QCOMPARE(score.trackCount(), 0);
+    QVector<QGeoCoordinate> second = flight(0, 4, 100);
+    for (QGeoCoordinate &fix : second)
+        fix.setLatitude(fix.latitude() + 1);
+    for (const QGeoCoordinate &fix : second)
+        score.addFix(fix);
+    QVERIFY(score.best().distance < 20);
+    for (const QGeoCoordinate &turnpoint : score.best().turnpoints)
+        QVERIFY(turnpoint.latitude() > ORIGIN_LATITUDE + 0.5);
+}
+
+void TestXcScore::costPerFix()
+{
+    // Several hours of fixes, re-thinned many times
+    const QVector<QGeoCoordinate> fixes = flight(0, 1, 6000);
+    QBENCHMARK {
+        XcScore score;
+        for (const QGeoCoordinate &fix : fixes)
+            score.addFix(fix);
+    }
+}
+
+QTEST_GUILESS_MAIN(TestXcScore)
+
+#include "tst_xcscore.moc"
@@ -0,0 +1,11 @@
+include(../tests.pri)
+
+QT += positioning
+
+TARGET = tst_xcscore
+
+SOURCES += tst_xcscore.cpp \
+    ../../xcscore.cpp
+
+HEADERS += \
+    ../../xcscore.h
@@ -0,0 +1,242 @@
+#include "thermalstore.h"
+#include <QtConcurrent>
+#include <QFutureWatcher>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFile>
+#include <QDir>
+#include <QtMath>
+#include <igcrecord.h>
+
+#define KM_PER_DEGREE 111.195
+
+ThermalStore::ThermalStore(const QString &fileName, QObject *parent)
+    : QObject(parent)
+    , m_fileName(fileName)
+    , m_building(false)
+{
+}
+
+int ThermalStore::cellOf(double degrees)
+{
+    return static_cast<int>(qFloor(degrees / THERMAL_CELL_DEG));
+}
+
+quint64 ThermalStore::cellKey(int row, int column)
+{
+    return (static_cast<quint64>(static_cast<quint32>(row)) << 32) | static_cast<quint32>(column);
+}
+
+void ThermalStore::insertIndex(int index)
+{
+    const Thermal &thermal = m_thermals.at(index);
+    m_cells[cellKey(cellOf(thermal.latitude), cellOf(thermal.longitude))].append(index);
+}
+
+void ThermalStore::rebuildIndex()
+{
+    m_cells.clear();
+    for (int i = 0; i < m_thermals.size(); i++)
+        insertIndex(i);
+}
+
+// Archive thermals only know the UTC time of day, so two thermals are the
+// same if their times of day overlap at about the same place
+bool ThermalStore::sameThermal(const Thermal &a, const Thermal &b)
+{
+    const qint64 day = 24 * 3600 * 1000;
+    const qint64 startA = a.time % day;
+    const qint64 startB = b.time % day;
+    return startA < startB + b.duration * 1000 && startB < startA + a.duration * 1000
+            && qAbs(a.latitude - b.latitude) < THERMAL_CELL_DEG
+            && qAbs(a.longitude - b.longitude) < THERMAL_CELL_DEG;
+}
+
+// True if one of the first count thermals is the same as thermal
+bool ThermalStore::contains(const Thermal &thermal, int count) const
+{
+    const int row = cellOf(thermal.latitude);
+    const int column = cellOf(thermal.longitude);
+    for (int r = row - 1; r <= row + 1; r++)
+    {
+        for (int c = column - 1; c <= column + 1; c++)
+        {
+            auto cell = m_cells.constFind(cellKey(r, c));
+            if(cell == m_cells.constEnd())
+                continue;
+            for (int index : cell.value())
+            {
+                if(index < count && sameThermal(m_thermals.at(index), thermal))
+                    return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ThermalStore::add(const Thermal &thermal)
+{
+    m_thermals.append(thermal);
+    insertIndex(m_thermals.size() - 1);
+}
+
+int ThermalStore::nearest(double latitude, double longitude, double maxKm, double *distanceKm) const
+{
+    const double kmPerDegreeLongitude = KM_PER_DEGREE * qCos(qDegreesToRadians(latitude));
+    // Narrowest cell side: every ring r lies at least r times this away
+    const double cellKm = THERMAL_CELL_DEG * qMin(KM_PER_DEGREE, kmPerDegreeLongitude);
+    const int maxRing = static_cast<int>(qCeil(maxKm / cellKm));
+    const int row = cellOf(latitude);
+    const int column = cellOf(longitude);
+
+    int best = -1;
+    double bestKm = maxKm;
+
+    for (int ring = 0; ring <= maxRing && (ring - 1) * cellKm <= bestKm; ring++)
+    {
+        for (int r = row - ring; r <= row + ring; r++)
+        {
+            // Only the border of the ring; the inside was visited already
+            const int step = (r == row - ring || r == row + ring) ? 1 : 2 * ring;
+            for (int c = column - ring; c <= column + ring; c += qMax(step, 1))
+            {
+                auto cell = m_cells.constFind(cellKey(r, c));
+                if(cell == m_cells.constEnd())
+                    continue;
+
+                for (int index : cell.value())
+                {
+                    const Thermal &thermal = m_thermals.at(index);
+                    const double dx = (thermal.longitude - longitude) * kmPerDegreeLongitude;
+                    const double dy = (thermal.latitude - latitude) * KM_PER_DEGREE;
+                    const double km = qSqrt(dx * dx + dy * dy);
+                    if(km < bestKm)
+                    {
+                        bestKm = km;
+                        best = index;
+                    }
+                }
+            }
+        }
+    }
+
+    if(distanceKm)
+        *distanceKm = bestKm;
+    return best;
+}
+
+QVector<Thermal> ThermalStore::thermalsInFile(const QString &fileName)
+{
+    QVector<Thermal> thermals;
+    QVector<IgcFix> fixes;
+    if(!readIgcFixes(fileName, fixes) || fixes.size() < 2)
+        return thermals;
+
+    CirclingDetector detector;
+    qint64 dayOffset = 0;
+    for (int i = 1; i < fixes.size(); i++)
+    {
+        const IgcFix &previous = fixes.at(i - 1);
+        const IgcFix &fix = fixes.at(i);
+        int dt = fix.time - previous.time;
+        if(dt < -12 * 3600)
+        {
+            // Past midnight UTC
+            dt += 24 * 3600;
+            dayOffset += 24 * 3600;
+        }
+        if(dt <= 0)
+            continue;
+
+        // The track only gives course over ground and altitude differences
+        const double dx = (fix.longitude - previous.longitude) * qCos(qDegreesToRadians(fix.latitude));
+        const double dy = fix.latitude - previous.latitude;
+        const double heading = qRadiansToDegrees(qAtan2(dx, dy));
+        const double altitude = fix.pressureAltitude != 0 ? fix.pressureAltitude : fix.gpsAltitude;
+        const double previousAltitude = previous.pressureAltitude != 0 ? previous.pressureAltitude : previous.gpsAltitude;
+        const double vario = (altitude - previousAltitude) / dt;
+
+        if(detector.update((fix.time + dayOffset) * 1000, heading, fix.latitude, fix.longitude, altitude, vario))
+            thermals.append(detector.thermal());
+    }
+    return thermals;
+}
+
+void ThermalStore::buildFromArchive(const QString &directory)
+{
+    if(m_building)
+        return;
+    m_building = true;
+
+    QStringList files;
+    QDir dir(directory);
+    foreach (const QString &name, dir.entryList(QStringList() << "*.igc", QDir::Files))
+        files << dir.absoluteFilePath(name);
+
+    auto watcher = new QFutureWatcher<QVector<Thermal>>(this);
+    connect(watcher, &QFutureWatcher<QVector<Thermal>>::finished, this, [this, watcher]() {
+        // Thermals added meanwhile, live from the flight in progress, stay.
+        // Its igc file is in the archive too, so skip the archive's copies.
+        const int kept = m_thermals.size();
+        foreach (const QVector<Thermal> &found, watcher->future().results())
+        {
+            for (const Thermal &thermal : found)
+            {
+                if(!contains(thermal, kept))
+                    add(thermal);
+            }
+        }
+        watcher->deleteLater();
+
+        save();
+        m_building = false;
+        emit archiveIndexed(m_thermals.size());
+    });
+    watcher->setFuture(QtConcurrent::mapped(files, &ThermalStore::thermalsInFile));
+}
+
+bool ThermalStore::load()
+{
+    QFile file(m_fileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    qint32 version, count;
+    in >> version >> count;
+    if(version != THERMAL_STORE_VERSION || count < 0)
+        return false;
+
+    m_thermals.resize(count);
+    for (Thermal &thermal : m_thermals)
+    {
+        qint32 duration;
+        in >> thermal.latitude >> thermal.longitude >> thermal.base >> thermal.top
+           >> thermal.climb >> thermal.time >> duration;
+        thermal.duration = duration;
+    }
+    if(in.status() != QDataStream::Ok)
+    {
+        m_thermals.clear();
+        return false;
+    }
+
+    rebuildIndex();
+    return true;
+}
+
+bool ThermalStore::save() const
+{
+    QSaveFile file(m_fileName);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out << qint32(THERMAL_STORE_VERSION) << qint32(m_thermals.size());
+    for (const Thermal &thermal : m_thermals)
+    {
+        out << thermal.latitude << thermal.longitude << thermal.base << thermal.top
+            << thermal.climb << thermal.time << qint32(thermal.duration);
+    }
+    return file.commit();
+}
@@ -0,0 +1,61 @@
+#ifndef THERMALSTORE_H
+#define THERMALSTORE_H
+
+#include <QObject>
+#include <QVector>
+#include <QHash>
+#include <QStringList>
+#include <circlingdetector.h>
+
+#define THERMAL_CELL_DEG 0.01           // about 1.1 km north-south
+#define THERMAL_STORE_VERSION 1
+
+/*
+ * Thermals of all past flights in a uniform latitude/longitude grid.
+ * Nearest-thermal queries only visit the rings of cells around the query
+ * point until no closer thermal is possible, which takes microseconds
+ * regardless of the archive size. The store is saved as a small binary file
+ * and can be rebuilt from the igc archive on a thread pool, one file per
+ * task.
+ */
+class ThermalStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    ThermalStore(const QString &fileName, QObject *parent);
+
+    bool load();
+    bool save() const;
+
+    void add(const Thermal &thermal);
+    int size() const { return m_thermals.size(); }
+    const Thermal &at(int index) const { return m_thermals.at(index); }
+
+    // Index of the closest thermal within maxKm, -1 if there is none
+    int nearest(double latitude, double longitude, double maxKm, double *distanceKm = nullptr) const;
+
+    // Re-detects thermals in every igc file of the directory in parallel,
+    // then merges them into the store and emits archiveIndexed.
+    void buildFromArchive(const QString &directory);
+    static QVector<Thermal> thermalsInFile(const QString &fileName);
+
+signals:
+    void archiveIndexed(int thermals);
+
+private:
+    static quint64 cellKey(int row, int column);
+    static int cellOf(double degrees);
+    static bool sameThermal(const Thermal &a, const Thermal &b);
+    bool contains(const Thermal &thermal, int count) const;
+    void insertIndex(int index);
+    void rebuildIndex();
+
+private:
+    QString m_fileName;
+    QVector<Thermal> m_thermals;
+    QHash<quint64, QVector<int>> m_cells;
+    bool m_building;
+};
+
+#endif // THERMALSTORE_H
@@ -0,0 +1,136 @@
+#include "trace.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+
+struct TraceBuffer
+{
+    QMutex mutex;
+    QVector<TraceEvent> events;
+    QString threadName;
+    int id;
+    int head;
+    bool wrapped;
+};
+
+std::atomic<bool> Trace::s_enabled(false);
+
+// Buffers outlive their threads so a dump still shows work of finished ones
+static QMutex registryMutex;
+static QList<TraceBuffer *> registry;
+static thread_local TraceBuffer *threadBuffer = nullptr;
+
+static const QElapsedTimer &traceClock()
+{
+    static const QElapsedTimer clock = [] {
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+    return clock;
+}
+
+static TraceBuffer *registerThread()
+{
+    TraceBuffer *buffer = new TraceBuffer;
+    buffer->events.resize(TRACE_BUFFER_EVENTS);
+    buffer->head = 0;
+    buffer->wrapped = false;
+
+    QThread *thread = QThread::currentThread();
+    if(QCoreApplication::instance() && thread == QCoreApplication::instance()->thread())
+        buffer->threadName = "main";
+    else
+        buffer->threadName = thread->objectName();
+
+    QMutexLocker locker(&registryMutex);
+    buffer->id = registry.size() + 1;
+    if(buffer->threadName.isEmpty())
+        buffer->threadName = "thread " + QString::number(buffer->id);
+    registry.append(buffer);
+    return buffer;
+}
+
+void Trace::setEnabled(bool enabled)
+{
+    traceClock();
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+qint64 Trace::now()
+{
+    return traceClock().nsecsElapsed();
+}
+
+void Trace::record(const char *name, qint64 start, qint64 duration)
+{
+    if(!threadBuffer)
+        threadBuffer = registerThread();
+
+    QMutexLocker locker(&threadBuffer->mutex);
+    TraceEvent &event = threadBuffer->events[threadBuffer->head];
+    event.name = name;
+    event.start = start;
+    event.duration = duration;
+    if(++threadBuffer->head == TRACE_BUFFER_EVENTS)
+    {
+        threadBuffer->head = 0;
+        threadBuffer->wrapped = true;
+    }
+}
+
+static void appendMicroseconds(QByteArray &out, qint64 ns)
+{
+    out.append(QByteArray::number(ns / 1000));
+    out.append('.');
+    out.append(QByteArray::number(ns % 1000).rightJustified(3, '0'));
+}
+
+bool Trace::writeChromeJson(const QString &fileName)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QByteArray out("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+
+    QMutexLocker registryLocker(&registryMutex);
+    for (TraceBuffer *buffer : registry)
+    {
+        if(!first)
+            out.append(",\n");
+        first = false;
+        out.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + QByteArray::number(buffer->id)
+                   + ",\"args\":{\"name\":\"" + buffer->threadName.toUtf8().replace('"', '\'') + "\"}}");
+
+        QMutexLocker locker(&buffer->mutex);
+        const int count = buffer->wrapped ? TRACE_BUFFER_EVENTS : buffer->head;
+        const int oldest = buffer->wrapped ? buffer->head : 0;
+        for (int i = 0; i < count; i++)
+        {
+            const TraceEvent &event = buffer->events.at((oldest + i) % TRACE_BUFFER_EVENTS);
+            out.append(",\n{\"name\":\"");
+            out.append(event.name);
+            out.append("\",\"ph\":\"X\",\"pid\":1,\"tid\":");
+            out.append(QByteArray::number(buffer->id));
+            out.append(",\"ts\":");
+            appendMicroseconds(out, event.start);
+            out.append(",\"dur\":");
+            appendMicroseconds(out, event.duration);
+            out.append('}');
+        }
+
+        // Written per thread so a long trace isn't held in memory twice
+        if(file.write(out) != out.size())
+            return false;
+        out.clear();
+    }
+
+    out.append("\n]}\n");
+    return file.write(out) == out.size();
+}
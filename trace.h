@@ -0,0 +1,60 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+#include <atomic>
+
+#define TRACE_BUFFER_EVENTS 16384   // per thread, the oldest are overwritten
+
+struct TraceEvent
+{
+    const char *name;       // string literal, never copied
+    qint64 start;           // ns since the first trace clock read
+    qint64 duration;        // ns
+};
+
+/*
+ * Hot-path tracing. Each thread records complete events into its own ring of
+ * TRACE_BUFFER_EVENTS, guarded by a mutex only the dump ever contends for.
+ * While disabled a trace point costs one relaxed atomic load. The rings are
+ * written as Chrome trace JSON, which chrome://tracing and Perfetto open.
+ */
+class Trace
+{
+public:
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled);
+
+    static qint64 now();
+    static void record(const char *name, qint64 start, qint64 duration);
+    static bool writeChromeJson(const QString &fileName);
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name)
+        : m_name(Trace::isEnabled() ? name : nullptr)
+        , m_start(m_name ? Trace::now() : 0)
+    {
+    }
+
+    ~TraceScope()
+    {
+        if(m_name)
+            Trace::record(m_name, m_start, Trace::now() - m_start);
+    }
+
+private:
+    const char *m_name;
+    qint64 m_start;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+#endif // TRACE_H
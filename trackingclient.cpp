@@ -0,0 +1,200 @@
+#include "trackingclient.h"
+#include <QDebug>
+#include <QtMath>
+#include <trace.h>
+
+TrackingClient::TrackingClient(QObject *parent)
+    : QObject(parent)
+    , m_socket(new QTcpSocket(this))
+    , m_port(0)
+    , m_running(false)
+    , m_lastKeptTime(-1)
+    , m_bytesSent(0)
+    , m_wakeups(0)
+    , m_fixesSent(0)
+    , m_fixesDropped(0)
+{
+    m_fixes.reserve(TRACKING_MAX_FIXES);
+    m_timer.setInterval(TRACKING_DEFAULT_INTERVAL_MS);
+    connect(&m_timer, &QTimer::timeout, this, &TrackingClient::sendPending);
+    connect(m_socket, &QTcpSocket::connected, this, &TrackingClient::connected);
+}
+
+void TrackingClient::setServer(const QString &host, quint16 port)
+{
+    m_host = host;
+    m_port = port;
+}
+
+void TrackingClient::setPilot(const QString &pilot)
+{
+    m_pilot = pilot;
+}
+
+void TrackingClient::setInterval(int msec)
+{
+    m_timer.setInterval(msec);
+}
+
+void TrackingClient::start()
+{
+    if(m_host.isEmpty() || m_running)
+        return;
+
+    // A new flight: nothing of the last one is sent with it
+    m_fixesDropped += m_fixes.size();
+    m_fixes.clear();
+    m_running = true;
+    m_lastKeptTime = -1;
+    m_flightTime.start();
+    m_timer.start();
+}
+
+void TrackingClient::stop()
+{
+    if(!m_running)
+        return;
+
+    // The last frame goes out even under back-pressure, disconnectFromHost
+    // waits until it is written. Without a connection there is no time to
+    // make one, so what is left is counted as dropped.
+    if(m_socket->state() == QAbstractSocket::ConnectedState && !m_fixes.isEmpty())
+        writeFrame();
+    m_fixesDropped += m_fixes.size();
+    m_fixes.clear();
+
+    m_running = false;
+    m_timer.stop();
+    m_socket->disconnectFromHost();
+
+    qDebug() << "tracking:" << m_fixesSent << "fixes sent," << m_fixesDropped << "dropped,"
+             << m_bytesSent << "bytes," << m_wakeups << "wakeups," << bytesPerHour() << "bytes/h";
+}
+
+void TrackingClient::addFix(const QGeoPositionInfo &gpsPos)
+{
+    if(!m_running)
+        return;
+
+    const QGeoCoordinate coord = gpsPos.coordinate();
+
+    Fix fix;
+    fix.time = gpsPos.timestamp().toMSecsSinceEpoch();
+    fix.latitude = qRound(coord.latitude() * 1e5);
+    fix.longitude = qRound(coord.longitude() * 1e5);
+    fix.altitude = qIsNaN(coord.altitude()) ? 0 : qRound(coord.altitude());
+
+    // Fixes arriving faster than the tracking resolution are dropped; the
+    // spacing is measured from the last kept fix, also across sends
+    if(m_lastKeptTime >= 0 && fix.time - m_lastKeptTime < TRACKING_MIN_SPACING_MS - TRACKING_JITTER_MS)
+        return;
+
+    if(m_fixes.size() == TRACKING_MAX_FIXES)
+        thinOut();
+    m_fixes.append(fix);
+    m_lastKeptTime = fix.time;
+}
+
+// Drops every other fix from the older half, so a long offline stretch
+// halves in resolution instead of losing its beginning.
+void TrackingClient::thinOut()
+{
+    const int half = m_fixes.size() / 2;
+    int out = 0;
+    for (int in = 0; in < m_fixes.size(); in++)
+    {
+        if(in < half && (in & 1))
+            continue;
+        m_fixes[out++] = m_fixes.at(in);
+    }
+    m_fixesDropped += m_fixes.size() - out;
+    m_fixes.resize(out);
+}
+
+void TrackingClient::sendPending()
+{
+    TRACE_SCOPE("tracking.send");
+    if(m_fixes.isEmpty())
+        return;
+
+    if(m_socket->state() == QAbstractSocket::UnconnectedState)
+    {
+        m_wakeups++;
+        m_socket->connectToHost(m_host, m_port);
+        return;
+    }
+
+    // Back-pressure: keep coalescing locally until the link drains
+    if(m_socket->state() != QAbstractSocket::ConnectedState
+            || m_socket->bytesToWrite() > TRACKING_MAX_PENDING_BYTES)
+        return;
+
+    writeFrame();
+}
+
+void TrackingClient::writeFrame()
+{
+    m_wakeups++;
+    const QByteArray frame = encodeFrame();
+    m_socket->write(frame);
+    m_bytesSent += frame.size();
+    m_fixesSent += m_fixes.size();
+    m_fixes.clear();
+}
+
+void TrackingClient::connected()
+{
+    TRACE_SCOPE("tracking.connected");
+    // Identify once per connection, then flush what piled up meanwhile
+    QByteArray hello("XT\x01", 3);
+    const QByteArray pilot = m_pilot.toUtf8();
+    appendVarint(hello, static_cast<quint64>(pilot.size()));
+    hello.append(pilot);
+    m_socket->write(hello);
+    m_bytesSent += hello.size();
+
+    sendPending();
+}
+
+QByteArray TrackingClient::encodeFrame() const
+{
+    QByteArray payload("XT\x02", 3);
+    appendVarint(payload, static_cast<quint64>(m_fixes.size()));
+
+    Fix last = { 0, 0, 0, 0 };
+    for (const Fix &fix : m_fixes)
+    {
+        appendSigned(payload, fix.time / 1000 - last.time / 1000);
+        appendSigned(payload, fix.latitude - last.latitude);
+        appendSigned(payload, fix.longitude - last.longitude);
+        appendSigned(payload, fix.altitude - last.altitude);
+        last = fix;
+    }
+
+    QByteArray frame;
+    appendVarint(frame, static_cast<quint64>(payload.size()));
+    frame.append(payload);
+    return frame;
+}
+
+void TrackingClient::appendVarint(QByteArray &out, quint64 value)
+{
+    while (value >= 0x80)
+    {
+        out.append(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.append(static_cast<char>(value));
+}
+
+void TrackingClient::appendSigned(QByteArray &out, qint64 value)
+{
+    appendVarint(out, (static_cast<quint64>(value) << 1) ^ static_cast<quint64>(value >> 63));
+}
+
+qreal TrackingClient::bytesPerHour() const
+{
+    if(!m_flightTime.isValid() || m_flightTime.elapsed() == 0)
+        return 0;
+    return m_bytesSent * 3600000.0 / m_flightTime.elapsed();
+}
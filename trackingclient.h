@@ -0,0 +1,90 @@
+#ifndef TRACKINGCLIENT_H
+#define TRACKINGCLIENT_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QGeoPositionInfo>
+
+#define TRACKING_MAX_FIXES 512
+#define TRACKING_MIN_SPACING_MS 1000
+#define TRACKING_JITTER_MS 50           // 1 Hz receivers don't tick exactly
+#define TRACKING_MAX_PENDING_BYTES 4096
+#define TRACKING_DEFAULT_INTERVAL_MS 15000
+
+/*
+ * Live tracking uplink. Fixes from positionUpdated are buffered in a fixed
+ * size ring and sent every interval over one persistent TCP connection as a
+ * delta-encoded frame:
+ *
+ *   varint length | 'X' 'T' version | varint count |
+ *   zigzag varint (dt s, dlat 1e-5 deg, dlon 1e-5 deg, dalt m) per fix
+ *
+ * The first fix of every frame is relative to zero, so frames are
+ * independent of each other. Fixes closer than TRACKING_MIN_SPACING_MS to
+ * the last kept one are dropped, and when the ring fills up while offline
+ * every other old fix is dropped, so memory stays bounded and the track
+ * keeps its full extent at reduced resolution. Fixes that can't be sent
+ * when tracking stops count as dropped. All socket work is asynchronous.
+ */
+class TrackingClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    TrackingClient(QObject *parent);
+
+    void setServer(const QString &host, quint16 port);
+    void setPilot(const QString &pilot);
+    void setInterval(int msec);
+
+    void start();
+    void stop();
+    void addFix(const QGeoPositionInfo &gpsPos);
+
+    // Counters for judging the uplink cost of a flight
+    qint64 bytesSent() const { return m_bytesSent; }
+    qint64 wakeups() const { return m_wakeups; }
+    qint64 fixesSent() const { return m_fixesSent; }
+    qint64 fixesDropped() const { return m_fixesDropped; }
+    int pendingFixes() const { return m_fixes.size(); }
+    qreal bytesPerHour() const;
+
+private slots:
+    void sendPending();
+    void connected();
+
+private:
+    struct Fix
+    {
+        qint64 time;
+        qint32 latitude;
+        qint32 longitude;
+        qint32 altitude;
+    };
+
+    void thinOut();
+    void writeFrame();
+    QByteArray encodeFrame() const;
+    static void appendVarint(QByteArray &out, quint64 value);
+    static void appendSigned(QByteArray &out, qint64 value);
+
+private:
+    QTcpSocket *m_socket;
+    QTimer m_timer;
+    QElapsedTimer m_flightTime;
+    QString m_host;
+    quint16 m_port;
+    QString m_pilot;
+    QVector<Fix> m_fixes;
+    bool m_running;
+    qint64 m_lastKeptTime;
+    qint64 m_bytesSent;
+    qint64 m_wakeups;
+    qint64 m_fixesSent;
+    qint64 m_fixesDropped;
+};
+
+#endif // TRACKINGCLIENT_H
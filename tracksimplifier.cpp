@@ -0,0 +1,105 @@
+#include "tracksimplifier.h"
+#include <QtMath>
+
+#define M_PER_DEGREE 111195.0
+
+TrackSimplifier::TrackSimplifier(double tolerance)
+    : m_tolerance(tolerance)
+{
+    reset();
+}
+
+void TrackSimplifier::reset()
+{
+    m_track.clear();
+    m_inputCount = 0;
+    m_latitude0 = 0;
+    m_longitude0 = 0;
+    m_scaleX = M_PER_DEGREE;
+    m_anchor = {0, 0, 0};
+    m_heldCount = 0;
+}
+
+TrackSimplifier::Projected TrackSimplifier::project(const IgcFix &fix) const
+{
+    const double altitude = fix.pressureAltitude != 0 ? fix.pressureAltitude : fix.gpsAltitude;
+    return {(fix.longitude - m_longitude0) * m_scaleX, (fix.latitude - m_latitude0) * M_PER_DEGREE, altitude};
+}
+
+void TrackSimplifier::keep(const IgcFix &fix, const Projected &projected)
+{
+    m_track.append(fix);
+    m_anchor = projected;
+}
+
+bool TrackSimplifier::withinTolerance(const Projected &end) const
+{
+    const double dx = end.x - m_anchor.x;
+    const double dy = end.y - m_anchor.y;
+    const double dz = end.z - m_anchor.z;
+    const double length = dx * dx + dy * dy + dz * dz;
+    const double tolerance = m_tolerance * m_tolerance;
+
+    for (int i = 0; i < m_heldCount; i++)
+    {
+        const Projected &p = m_heldProjected[i];
+        const double px = p.x - m_anchor.x;
+        const double py = p.y - m_anchor.y;
+        const double pz = p.z - m_anchor.z;
+        double t = length > 0 ? (px * dx + py * dy + pz * dz) / length : 0;
+        t = qBound(0.0, t, 1.0);
+        const double ex = px - t * dx;
+        const double ey = py - t * dy;
+        const double ez = pz - t * dz;
+        if(ex * ex + ey * ey + ez * ez > tolerance)
+            return false;
+    }
+    return true;
+}
+
+bool TrackSimplifier::add(const IgcFix &fix)
+{
+    if(m_inputCount++ == 0)
+    {
+        m_latitude0 = fix.latitude;
+        m_longitude0 = fix.longitude;
+        m_scaleX = M_PER_DEGREE * qCos(qDegreesToRadians(fix.latitude));
+        keep(fix, project(fix));
+        return true;
+    }
+
+    const Projected projected = project(fix);
+    bool kept = false;
+    if(m_heldCount == TRACK_SIMPLIFY_WINDOW || !withinTolerance(projected))
+    {
+        keep(m_held[m_heldCount - 1], m_heldProjected[m_heldCount - 1]);
+        m_heldCount = 0;
+        kept = true;
+    }
+
+    m_held[m_heldCount] = fix;
+    m_heldProjected[m_heldCount] = projected;
+    m_heldCount++;
+    return kept;
+}
+
+void TrackSimplifier::flush()
+{
+    if(m_heldCount > 0)
+        keep(m_held[m_heldCount - 1], m_heldProjected[m_heldCount - 1]);
+    m_heldCount = 0;
+}
+
+bool TrackSimplifier::simplifyFile(const QString &fileName, double tolerance, QVector<IgcFix> &track)
+{
+    QVector<IgcFix> fixes;
+    if(!readIgcFixes(fileName, fixes))
+        return false;
+
+    TrackSimplifier simplifier(tolerance);
+    for (const IgcFix &fix : fixes)
+        simplifier.add(fix);
+    simplifier.flush();
+    track = simplifier.track();
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef TRACKSIMPLIFIER_H
+#define TRACKSIMPLIFIER_H
+
+#include <QVector>
+#include <igcrecord.h>
+
+#define TRACK_SIMPLIFY_WINDOW 256       // fixes held back at most
+#define TRACK_SIMPLIFY_TOLERANCE 10.0   // m
+
+/*
+ * Streaming line simplification (opening window Douglas-Peucker). Fixes are
+ * held back while every one of them stays within the tolerance of the line
+ * from the last kept fix to the newest; when one would not, the fix before
+ * the newest is kept and becomes the new anchor. Every dropped fix is
+ * therefore within the tolerance, in metres horizontally and vertically, of
+ * the simplified track. The window bounds both the memory and the work per
+ * fix, which makes it usable live as well as on whole igc files.
+ */
+class TrackSimplifier
+{
+public:
+    explicit TrackSimplifier(double tolerance = TRACK_SIMPLIFY_TOLERANCE);
+
+    void reset();
+    void setTolerance(double tolerance) { m_tolerance = tolerance; }
+
+    // Returns true if a fix was appended to track()
+    bool add(const IgcFix &fix);
+    // Keeps the newest held back fix, call at the end of the track
+    void flush();
+
+    const QVector<IgcFix> &track() const { return m_track; }
+    int inputCount() const { return m_inputCount; }
+
+    // The simplified B records of an igc file
+    static bool simplifyFile(const QString &fileName, double tolerance, QVector<IgcFix> &track);
+
+private:
+    struct Projected
+    {
+        double x, y, z;     // m in the plane of the first fix
+    };
+
+    Projected project(const IgcFix &fix) const;
+    bool withinTolerance(const Projected &end) const;
+    void keep(const IgcFix &fix, const Projected &projected);
+
+private:
+    double m_tolerance;
+    QVector<IgcFix> m_track;
+    int m_inputCount;
+
+    double m_latitude0;
+    double m_longitude0;
+    double m_scaleX;
+
+    Projected m_anchor;
+    IgcFix m_held[TRACK_SIMPLIFY_WINDOW];
+    Projected m_heldProjected[TRACK_SIMPLIFY_WINDOW];
+    int m_heldCount;
+};
+
+#endif // TRACKSIMPLIFIER_H
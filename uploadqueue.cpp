@@ -0,0 +1,297 @@
+#include "uploadqueue.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QRandomGenerator>
+#include <QDebug>
+
+UploadQueue::UploadQueue(NetworkAccessManager *network, const QString &queueFile, QObject *parent)
+    : QObject(parent)
+    , m_network(network)
+    , m_queueFile(queueFile)
+    , m_backoffBase(UPLOAD_BACKOFF_BASE_MS)
+    , m_inFlight(0)
+    , m_nextId(1)
+{
+    m_retryTimer.setSingleShot(true);
+    connect(&m_retryTimer, &QTimer::timeout, this, &UploadQueue::drain);
+    connect(m_network, &NetworkAccessManager::submitFinished, this, &UploadQueue::submitFinished);
+    load();
+}
+
+void UploadQueue::setServers(const QList<QUrl> &servers)
+{
+    m_servers = servers;
+}
+
+void UploadQueue::setBackoffBase(int msec)
+{
+    m_backoffBase = msec;
+}
+
+void UploadQueue::setCredentials(const QString &user, const QString &pass)
+{
+    m_user = user;
+    m_pass = pass;
+
+    // New credentials: give entries parked by a login failure another try
+    for (Entry &entry : m_entries)
+    {
+        if(entry.state == WaitingForLogin)
+            entry.state = Pending;
+    }
+    drain();
+}
+
+void UploadQueue::enqueue(const QString &fileName)
+{
+    for (const QUrl &server : m_servers)
+    {
+        if(findEntry(fileName, server) >= 0)
+            continue;
+
+        Entry entry;
+        entry.id = m_nextId++;
+        entry.fileName = fileName;
+        entry.server = server;
+        entry.state = Pending;
+        entry.attempts = 0;
+        entry.notBefore = 0;
+        m_entries.append(entry);
+    }
+    save();
+    emit queueChanged(m_entries.size());
+    drain();
+}
+
+void UploadQueue::drain()
+{
+    if(m_user.isEmpty() || m_pass.isEmpty())
+        return;
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    bool changed = false;
+
+    for (int i = 0; i < m_entries.size() && m_inFlight < UPLOAD_MAX_IN_FLIGHT; )
+    {
+        Entry &entry = m_entries[i];
+        Server &server = m_serverState[NetworkAccessManager::serverKey(entry.server)];
+
+        if(entry.state != Pending || entry.notBefore > now
+                || server.notBefore > now || server.inFlight >= UPLOAD_MAX_PER_SERVER)
+        {
+            i++;
+            continue;
+        }
+
+        if(!QFile::exists(entry.fileName))
+        {
+            qDebug() << "upload queue: file is gone" << entry.fileName;
+            removeEntry(i);
+            changed = true;
+            continue;
+        }
+
+        if(!m_network->submitFlight(entry.id, entry.server, m_user, m_pass, entry.fileName))
+        {
+            entry.attempts++;
+            entry.notBefore = now + backoff(entry.attempts);
+            changed = true;
+            i++;
+            continue;
+        }
+
+        entry.state = InFlight;
+        server.inFlight++;
+        m_inFlight++;
+        i++;
+    }
+
+    // Backoff state has to survive a crash like everything else in the queue
+    if(changed)
+    {
+        save();
+        emit queueChanged(m_entries.size());
+    }
+    scheduleRetry(now);
+}
+
+void UploadQueue::submitFinished(int id, NetworkAccessManager::SubmitResult result)
+{
+    // Ignores submissions not started by the queue, e.g. sendRequest()
+    const int index = findEntry(id);
+    if(index < 0 || m_entries.at(index).state != InFlight)
+        return;
+
+    m_inFlight--;
+
+    Entry &entry = m_entries[index];
+    Server &server = m_serverState[NetworkAccessManager::serverKey(entry.server)];
+    server.inFlight--;
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    switch (result) {
+    case NetworkAccessManager::Submitted:
+        server.failures = 0;
+        server.notBefore = 0;
+        emit flightUploaded(entry.fileName, entry.server);
+        removeEntry(index);
+        break;
+    case NetworkAccessManager::InvalidIgc:
+        emit flightRejected(entry.fileName, entry.server);
+        removeEntry(index);
+        break;
+    case NetworkAccessManager::InvalidUser:
+        entry.state = WaitingForLogin;
+        break;
+    case NetworkAccessManager::NetworkError:
+        // A failing server delays all its entries, not only this one
+        entry.state = Pending;
+        entry.attempts++;
+        entry.notBefore = now + backoff(entry.attempts);
+        server.failures++;
+        server.notBefore = now + backoff(server.failures);
+        break;
+    }
+
+    save();
+    emit queueChanged(m_entries.size());
+    drain();
+}
+
+void UploadQueue::scheduleRetry(qint64 now)
+{
+    qint64 next = -1;
+    for (const Entry &entry : m_entries)
+    {
+        if(entry.state != Pending)
+            continue;
+
+        const qint64 due = qMax(entry.notBefore, m_serverState.value(NetworkAccessManager::serverKey(entry.server)).notBefore);
+        if(due > now && (next < 0 || due < next))
+            next = due;
+    }
+
+    if(next < 0)
+        m_retryTimer.stop();
+    else
+        m_retryTimer.start(static_cast<int>(qMin<qint64>(next - now, UPLOAD_BACKOFF_MAX_MS)));
+}
+
+qint64 UploadQueue::backoff(int attempts) const
+{
+    qint64 delay = m_backoffBase;
+    for (int i = 1; i < attempts && delay < UPLOAD_BACKOFF_MAX_MS; i++)
+        delay *= 2;
+    delay = qMin<qint64>(delay, UPLOAD_BACKOFF_MAX_MS);
+
+    // +-20% jitter so several servers don't retry in lockstep
+    return delay * (80 + QRandomGenerator::global()->bounded(41)) / 100;
+}
+
+int UploadQueue::findEntry(int id) const
+{
+    for (int i = 0; i < m_entries.size(); i++)
+    {
+        if(m_entries.at(i).id == id)
+            return i;
+    }
+    return -1;
+}
+
+int UploadQueue::findEntry(const QString &fileName, const QUrl &server) const
+{
+    for (int i = 0; i < m_entries.size(); i++)
+    {
+        if(m_entries.at(i).fileName == fileName && m_entries.at(i).server == server)
+            return i;
+    }
+    return -1;
+}
+
+void UploadQueue::removeEntry(int index)
+{
+    m_entries.remove(index);
+}
+
+void UploadQueue::load()
+{
+    QFile file(m_queueFile);
+    if(!file.open(QIODevice::ReadOnly))
+        return;
+
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    const QJsonArray entries = root.value("entries").toArray();
+    for (const QJsonValue &value : entries)
+    {
+        const QJsonObject object = value.toObject();
+
+        Entry entry;
+        entry.id = m_nextId++;
+        entry.fileName = object.value("file").toString();
+        entry.server = QUrl(object.value("server").toString());
+        // Requests that were in flight when the app stopped are sent again
+        entry.state = object.value("login").toBool() ? WaitingForLogin : Pending;
+        entry.attempts = object.value("attempts").toInt();
+        entry.notBefore = static_cast<qint64>(object.value("notBefore").toDouble());
+
+        if(!entry.fileName.isEmpty() && entry.server.isValid())
+            m_entries.append(entry);
+    }
+
+    const QJsonObject servers = root.value("servers").toObject();
+    for (auto it = servers.constBegin(); it != servers.constEnd(); ++it)
+    {
+        const QJsonObject object = it.value().toObject();
+
+        Server &server = m_serverState[it.key()];
+        server.inFlight = 0;
+        server.failures = object.value("failures").toInt();
+        server.notBefore = static_cast<qint64>(object.value("notBefore").toDouble());
+    }
+}
+
+void UploadQueue::save() const
+{
+    QJsonArray entries;
+    for (const Entry &entry : m_entries)
+    {
+        QJsonObject object;
+        object.insert("file", entry.fileName);
+        object.insert("server", entry.server.toString());
+        object.insert("attempts", entry.attempts);
+        object.insert("notBefore", static_cast<double>(entry.notBefore));
+        object.insert("login", entry.state == WaitingForLogin);
+        entries.append(object);
+    }
+
+    // A server that was failing before a restart is still backed off after it
+    QJsonObject servers;
+    for (auto it = m_serverState.constBegin(); it != m_serverState.constEnd(); ++it)
+    {
+        if(it->failures == 0 && it->notBefore == 0)
+            continue;
+
+        QJsonObject object;
+        object.insert("failures", it->failures);
+        object.insert("notBefore", static_cast<double>(it->notBefore));
+        servers.insert(it.key(), object);
+    }
+
+    QJsonObject root;
+    root.insert("entries", entries);
+    root.insert("servers", servers);
+
+    // QSaveFile: a crash while writing must not lose the previous queue
+    QSaveFile file(m_queueFile);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        qDebug() << "upload queue:" << file.errorString();
+        return;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    file.commit();
+}
@@ -0,0 +1,98 @@
+#ifndef UPLOADQUEUE_H
+#define UPLOADQUEUE_H
+
+#include <QObject>
+#include <QTimer>
+#include <QHash>
+#include <QVector>
+#include <QUrl>
+#include <QDateTime>
+#include <networkaccessmanager.h>
+
+#define UPLOAD_MAX_IN_FLIGHT 4
+#define UPLOAD_MAX_PER_SERVER 2
+#define UPLOAD_BACKOFF_BASE_MS 15000
+#define UPLOAD_BACKOFF_MAX_MS 3600000
+
+/*
+ * Persistent queue of flight submissions. Every flight is submitted once to
+ * each configured Leonardo server. Pending entries are written to a small
+ * json file after every change so the queue resumes after an app restart.
+ * Network failures are retried with exponential backoff, both per entry
+ * and per server, and the number of requests in flight is bounded.
+ */
+class UploadQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    UploadQueue(NetworkAccessManager *network, const QString &queueFile, QObject *parent);
+
+    void setServers(const QList<QUrl> &servers);
+    void setCredentials(const QString &user, const QString &pass);
+    // First retry delay, doubled per failure up to UPLOAD_BACKOFF_MAX_MS
+    void setBackoffBase(int msec);
+
+    // Adds the flight for every configured server and starts draining.
+    void enqueue(const QString &fileName);
+    int pendingCount() const { return m_entries.size(); }
+
+public slots:
+    void drain();
+
+signals:
+    void flightUploaded(const QString &fileName, const QUrl &server);
+    void flightRejected(const QString &fileName, const QUrl &server);
+    void queueChanged(int pending);
+
+private slots:
+    void submitFinished(int id, NetworkAccessManager::SubmitResult result);
+
+private:
+    enum State
+    {
+        Pending,
+        InFlight,
+        WaitingForLogin
+    };
+
+    struct Entry
+    {
+        int id;
+        QString fileName;
+        QUrl server;
+        State state;
+        int attempts;
+        qint64 notBefore;
+    };
+
+    struct Server
+    {
+        int inFlight;
+        int failures;
+        qint64 notBefore;
+    };
+
+    void load();
+    void save() const;
+    void removeEntry(int index);
+    void scheduleRetry(qint64 now);
+    int findEntry(int id) const;
+    int findEntry(const QString &fileName, const QUrl &server) const;
+    qint64 backoff(int attempts) const;
+
+private:
+    NetworkAccessManager *m_network;
+    QString m_queueFile;
+    QString m_user;
+    QString m_pass;
+    QList<QUrl> m_servers;
+    QVector<Entry> m_entries;
+    QHash<QString, Server> m_serverState;
+    QTimer m_retryTimer;
+    int m_backoffBase;
+    int m_inFlight;
+    int m_nextId;
+};
+
+#endif // UPLOADQUEUE_H
@@ -6,6 +6,8 @@
 #include <qendian.h>
 #include <QThread>
 #include <variobeep.h>
+#include <trace.h>
+#include <metrics.h>
 
 #define PUSH_MODE_LABEL "Enable push mode"
 #define PULL_MODE_LABEL "Enable pull mode"
@@ -16,6 +18,9 @@
 const int DataSampleRateHz = 44100;
 const int BufferSize      = 32768;
 
+static const MetricCounter audioUnderruns("audio.underruns");
+static const MetricGauge audioFill("audio.fill");
+
 
 VarioBeep::VarioBeep(int ToneSampleRateHz,int DurationUSeconds, QObject *parent)
     :   QObject (parent)
@@ -76,6 +81,10 @@ void VarioBeep::createAudioOutput()
     delete m_audioOutput;
     m_audioOutput = nullptr;
     m_audioOutput = new QAudioOutput(m_device, m_format, this);
+    connect(m_audioOutput, &QAudioOutput::stateChanged, this, [this](QAudio::State state) {
+        if(state == QAudio::IdleState && m_audioOutput->error() == QAudio::UnderrunError)
+            audioUnderruns.add();
+    });
 }
 
 void VarioBeep::startBeep()
@@ -129,23 +138,31 @@ void VarioBeep::timerEvent(QTimerEvent *event)
 {
     if(m_running)
     {
-        if(m_vario > 0)
-        {
-            m_tone = static_cast<int>(m_toneFunction->getValue(m_vario));
-        }
-        else if(m_vario < 0)
         {
-            m_tone = m_toneSampleRateHz;
+            TRACE_SCOPE("beep.decide");
+            if(m_vario > 0)
+            {
+                m_tone = static_cast<int>(m_toneFunction->getValue(m_vario));
+            }
+            else if(m_vario < 0)
+            {
+                m_tone = m_toneSampleRateHz;
+            }
         }
 
         if(m_vario < 0.25) return;
 
-        delete m_generator;
-        m_generator = new Generator(m_format, static_cast<qint64>(m_varioFunction->getValue(m_vario) * 1000), m_tone, this);
-        m_generator->start();
+        {
+            TRACE_SCOPE("beep.generate");
+            delete m_generator;
+            m_generator = new Generator(m_format, static_cast<qint64>(m_varioFunction->getValue(m_vario) * 1000), m_tone, this);
+            m_generator->start();
+        }
 
         m_audioOutput->start(m_generator);
         Sleeper::msleep(static_cast<unsigned>(m_varioFunction->getValue(m_vario) * 1000));
+        // Bytes still queued for the device when the beep ends
+        audioFill.set(m_audioOutput->bufferSize() - m_audioOutput->bytesFree());
         m_audioOutput->suspend();
         Sleeper::msleep(static_cast<unsigned>(m_varioFunction->getValue(m_vario) * 500));
     }
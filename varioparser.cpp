@@ -0,0 +1,141 @@
+#include "varioparser.h"
+#include <cmath>
+#include <cstring>
+
+// LK8EX1 placeholders for values the device doesn't have
+#define LK8EX1_NO_PRESSURE 999999
+#define LK8EX1_NO_ALTITUDE 99999
+#define LK8EX1_NO_VARIO 9999
+#define LK8EX1_NO_TEMPERATURE 99
+
+VarioParser::VarioParser()
+    : m_queueHead(0)
+    , m_queueSize(0)
+{
+}
+
+bool VarioParser::nextSample(VarioSample &sample)
+{
+    if(m_queueSize == 0)
+        return false;
+    sample = m_queue[m_queueHead];
+    m_queueHead = (m_queueHead + 1) % VARIO_SAMPLE_QUEUE;
+    m_queueSize--;
+    return true;
+}
+
+void VarioParser::queueSample(const VarioSample &sample)
+{
+    if(std::isnan(sample.pressure) && std::isnan(sample.altitude) && std::isnan(sample.vario))
+        return;
+
+    // Keep the newest samples if the consumer falls behind
+    if(m_queueSize == VARIO_SAMPLE_QUEUE)
+    {
+        m_queueHead = (m_queueHead + 1) % VARIO_SAMPLE_QUEUE;
+        m_queueSize--;
+    }
+    m_queue[(m_queueHead + m_queueSize) % VARIO_SAMPLE_QUEUE] = sample;
+    m_queueSize++;
+}
+
+bool VarioParser::parseSentence(const Field *fields, int count)
+{
+    const Field &address = fields[0];
+    if(equals(address, "LK8EX1"))
+        parseLK8EX1(fields, count);
+    else if(equals(address, "POV"))
+        parsePOV(fields, count);
+    else if(equals(address, "PRS") && count > 1)
+        parsePRS(fields[1]);
+    else if(address.length > 4 && memcmp(address.data, "PRS ", 4) == 0)
+        parsePRS(Field{address.data + 4, address.length - 4});
+    else
+        return NmeaParser::parseSentence(fields, count);
+    return true;
+}
+
+// BlueFlyVario sends its pressure lines without '$' and checksum
+bool VarioParser::parseUnframed(const char *line, int length)
+{
+    if(length <= 4 || memcmp(line, "PRS ", 4) != 0)
+        return false;
+    parsePRS(Field{line + 4, length - 4});
+    return true;
+}
+
+void VarioParser::parseLK8EX1(const Field *fields, int count)
+{
+    if(count < 5)
+        return;
+
+    VarioSample sample;
+    sample.pressure = toDouble(fields[1]);
+    sample.altitude = toDouble(fields[2]);
+    sample.vario = toDouble(fields[3]) / 100;
+    sample.temperature = toDouble(fields[4]);
+
+    if(sample.pressure >= LK8EX1_NO_PRESSURE || sample.pressure <= 0)
+        sample.pressure = NAN;
+    if(!std::isnan(sample.pressure) || sample.altitude >= LK8EX1_NO_ALTITUDE)
+        sample.altitude = NAN;
+    if(sample.vario * 100 >= LK8EX1_NO_VARIO)
+        sample.vario = NAN;
+    if(sample.temperature >= LK8EX1_NO_TEMPERATURE)
+        sample.temperature = NAN;
+    queueSample(sample);
+}
+
+void VarioParser::parsePRS(const Field &value)
+{
+    int pressure = 0;
+    int digits = 0;
+    for (int i = 0; i < value.length; i++)
+    {
+        const char c = value.data[i];
+        int digit;
+        if(c >= '0' && c <= '9')
+            digit = c - '0';
+        else if(c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else if(c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else
+            break;
+        pressure = pressure * 16 + digit;
+        if(++digits > 6)
+            return;
+    }
+    if(digits == 0)
+        return;
+
+    VarioSample sample;
+    sample.pressure = pressure;
+    sample.altitude = NAN;
+    sample.vario = NAN;
+    sample.temperature = NAN;
+    queueSample(sample);
+}
+
+void VarioParser::parsePOV(const Field *fields, int count)
+{
+    VarioSample sample;
+    sample.pressure = NAN;
+    sample.altitude = NAN;
+    sample.vario = NAN;
+    sample.temperature = NAN;
+
+    for (int i = 1; i + 1 < count; i += 2)
+    {
+        if(fields[i].length != 1)
+            continue;
+        const double value = toDouble(fields[i + 1]);
+        switch (fields[i].data[0]) {
+        case 'P': sample.pressure = value * 100; break;
+        case 'E': sample.vario = value; break;
+        case 'T': sample.temperature = value; break;
+        default: break;
+        }
+    }
+    queueSample(sample);
+}
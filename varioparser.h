@@ -0,0 +1,48 @@
+#ifndef VARIOPARSER_H
+#define VARIOPARSER_H
+
+#include <nmeaparser.h>
+
+#define VARIO_SAMPLE_QUEUE 16
+
+struct VarioSample
+{
+    double pressure;        // Pa, NaN if not sent
+    double altitude;        // m, pressure altitude when no pressure is sent, else NaN
+    double vario;           // m/s as computed by the device, NaN if not sent
+    double temperature;     // deg C, NaN if not sent
+};
+
+/*
+ * NmeaParser that also understands the sentences of external varios:
+ *  $LK8EX1,pressure,altitude,vario,temperature,battery  (LK8000, XCSoar),
+ *  PRS pressure  with hexadecimal Pa (BlueFlyVario), also sent as
+ *  $PRS pressure  and  $PRS,pressure,
+ *  $POV,P,hPa,E,m/s,T,degC,...  key/value pairs (OpenVario).
+ * Like fixes, samples are parsed in place and wait in a small queue until
+ * taken with nextSample().
+ */
+class VarioParser : public NmeaParser
+{
+public:
+    VarioParser();
+
+    bool nextSample(VarioSample &sample);
+
+protected:
+    bool parseSentence(const Field *fields, int count) override;
+    bool parseUnframed(const char *line, int length) override;
+
+private:
+    void parseLK8EX1(const Field *fields, int count);
+    void parsePRS(const Field &value);
+    void parsePOV(const Field *fields, int count);
+    void queueSample(const VarioSample &sample);
+
+private:
+    VarioSample m_queue[VARIO_SAMPLE_QUEUE];
+    int m_queueHead;
+    int m_queueSize;
+};
+
+#endif // VARIOPARSER_H
@@ -0,0 +1,200 @@
+#include "waypoint.h"
+#include <QFile>
+#include <QStringList>
+#include <QHash>
+
+#define M_PER_FT 0.3048
+#define M_PER_NM 1852.0
+#define M_PER_MILE 1609.344
+
+namespace
+{
+
+// Comma separated, fields may be quoted and contain commas
+QStringList splitCsv(const QString &line)
+{
+    QStringList fields;
+    QString field;
+    bool quoted = false;
+    for (int i = 0; i < line.size(); i++)
+    {
+        const QChar c = line.at(i);
+        if(c == '"')
+            quoted = !quoted;
+        else if(c == ',' && !quoted)
+        {
+            fields << field.trimmed();
+            field.clear();
+        }
+        else
+            field += c;
+    }
+    fields << field.trimmed();
+    return fields;
+}
+
+// "4628.500N" or "00712.250E": degrees, then decimal minutes
+bool parseCupCoordinate(const QString &text, int degreeDigits, double &value)
+{
+    if(text.size() < degreeDigits + 3)
+        return false;
+
+    bool degreesOk, minutesOk;
+    const double degrees = text.left(degreeDigits).toDouble(&degreesOk);
+    const double minutes = text.mid(degreeDigits, text.size() - degreeDigits - 1).toDouble(&minutesOk);
+    const QChar hemisphere = text.at(text.size() - 1).toUpper();
+    if(!degreesOk || !minutesOk)
+        return false;
+
+    value = degrees + minutes / 60;
+    if(hemisphere == 'S' || hemisphere == 'W')
+        value = -value;
+    return true;
+}
+
+// "1234.0m", "4000ft", "1.5km", "0.5nm"; meters if no unit
+double parseLength(QString text)
+{
+    text = text.trimmed().toLower();
+    double scale = 1;
+    if(text.endsWith("km"))
+        scale = 1000;
+    else if(text.endsWith("ft"))
+        scale = M_PER_FT;
+    else if(text.endsWith("nm"))
+        scale = M_PER_NM;
+    else if(text.endsWith("ml"))
+        scale = M_PER_MILE;
+
+    int end = text.size();
+    while (end > 0 && text.at(end - 1).isLetter())
+        end--;
+    return text.left(end).toDouble() * scale;
+}
+
+bool loadCup(QFile &file, QVector<Waypoint> &waypoints, QVector<Turnpoint> *task)
+{
+    QHash<QString, int> byName;
+    QStringList taskNames;
+    QHash<int, double> radii;
+    bool inTasks = false;
+
+    while (!file.atEnd())
+    {
+        const QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if(line.isEmpty())
+            continue;
+
+        if(line.startsWith("-----Related Tasks", Qt::CaseInsensitive))
+        {
+            inTasks = true;
+            continue;
+        }
+
+        if(!inTasks)
+        {
+            const QStringList fields = splitCsv(line);
+            if(fields.size() < 6 || fields.at(0).compare("name", Qt::CaseInsensitive) == 0)
+                continue;
+
+            Waypoint waypoint;
+            waypoint.name = fields.at(0);
+            waypoint.code = fields.at(1);
+            if(!parseCupCoordinate(fields.at(3), 2, waypoint.latitude)
+                    || !parseCupCoordinate(fields.at(4), 3, waypoint.longitude))
+                continue;
+            waypoint.elevation = parseLength(fields.at(5));
+
+            byName.insert(waypoint.name, waypoints.size());
+            waypoints.append(waypoint);
+        }
+        else if(task)
+        {
+            if(line.startsWith('"') && taskNames.isEmpty())
+                taskNames = splitCsv(line);
+            else if(line.startsWith("ObsZone=", Qt::CaseInsensitive) && !taskNames.isEmpty())
+            {
+                // ObsZone=0 is the point after takeoff
+                int zone = -1;
+                double radius = 0;
+                foreach (const QString &option, line.split(','))
+                {
+                    const QString key = option.section('=', 0, 0).trimmed();
+                    const QString value = option.section('=', 1);
+                    if(key.compare("ObsZone", Qt::CaseInsensitive) == 0)
+                        zone = value.toInt();
+                    else if(key.compare("R1", Qt::CaseInsensitive) == 0)
+                        radius = parseLength(value);
+                }
+                if(zone >= 0 && radius > 0)
+                    radii.insert(zone, radius);
+            }
+            else if(line.startsWith('"') && !taskNames.isEmpty())
+                break;      // only the first task
+        }
+    }
+
+    if(task)
+    {
+        task->clear();
+        // Task name, takeoff, start ... goal, landing
+        for (int i = 2; i < taskNames.size() - 1; i++)
+        {
+            auto found = byName.constFind(taskNames.at(i));
+            if(found == byName.constEnd())
+                continue;
+            Turnpoint turnpoint;
+            turnpoint.waypoint = waypoints.at(found.value());
+            turnpoint.radius = radii.value(i - 2, TURNPOINT_RADIUS);
+            task->append(turnpoint);
+        }
+    }
+    return !waypoints.isEmpty();
+}
+
+// OziExplorer: four header lines, then number,name,lat,lon,...; field 14 is feet, -777 if unknown
+bool loadWpt(QFile &file, QVector<Waypoint> &waypoints)
+{
+    int lineNumber = 0;
+    while (!file.atEnd())
+    {
+        const QString line = QString::fromLatin1(file.readLine()).trimmed();
+        if(++lineNumber <= 4 || line.isEmpty())
+            continue;
+
+        const QStringList fields = line.split(',');
+        if(fields.size() < 4)
+            continue;
+
+        bool latitudeOk, longitudeOk;
+        Waypoint waypoint;
+        waypoint.name = fields.at(1).trimmed();
+        waypoint.code = waypoint.name;
+        waypoint.latitude = fields.at(2).toDouble(&latitudeOk);
+        waypoint.longitude = fields.at(3).toDouble(&longitudeOk);
+        if(!latitudeOk || !longitudeOk)
+            continue;
+
+        const double feet = fields.size() > 14 ? fields.at(14).toDouble() : -777;
+        waypoint.elevation = feet == -777 ? 0 : feet * M_PER_FT;
+        waypoints.append(waypoint);
+    }
+    return !waypoints.isEmpty();
+}
+
+}
+
+bool loadWaypoints(const QString &fileName, QVector<Waypoint> &waypoints, QVector<Turnpoint> *task)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    waypoints.clear();
+    if(fileName.endsWith(".cup", Qt::CaseInsensitive))
+        return loadCup(file, waypoints, task);
+
+    if(task)
+        task->clear();
+    return loadWpt(file, waypoints);
+}
@@ -0,0 +1,32 @@
+#ifndef WAYPOINT_H
+#define WAYPOINT_H
+
+#include <QString>
+#include <QVector>
+
+#define TURNPOINT_RADIUS 400.0          // m, when the task doesn't give one
+
+struct Waypoint
+{
+    QString name;
+    QString code;
+    double latitude;
+    double longitude;
+    double elevation;       // m, 0 if unknown
+};
+
+struct Turnpoint
+{
+    Waypoint waypoint;
+    double radius;          // m
+};
+
+/*
+ * Reads a SeeYou .cup or an OziExplorer .wpt waypoint file, chosen by the
+ * extension. For .cup files the first task of the "Related Tasks" section is
+ * returned in task when asked for, without takeoff and landing, with the
+ * ObsZone R1 radii.
+ */
+bool loadWaypoints(const QString &fileName, QVector<Waypoint> &waypoints, QVector<Turnpoint> *task = nullptr);
+
+#endif // WAYPOINT_H
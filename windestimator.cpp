@@ -0,0 +1,184 @@
+#include "windestimator.h"
+#include <QtMath>
+
+WindEstimator::WindEstimator()
+{
+    reset();
+}
+
+void WindEstimator::reset()
+{
+    m_head = 0;
+    m_count = 0;
+    m_sinceResum = 0;
+    m_sx = m_sy = m_sxx = m_syy = m_sxy = m_sz = m_sxz = m_syz = m_szz = 0;
+    m_lastTime = -1;
+    m_lastTrack = 0;
+    m_coverage = 0;
+    m_circling = false;
+    m_windX = 0;
+    m_windY = 0;
+    m_airspeed = 0;
+    m_confidence = 0;
+}
+
+double WindEstimator::speed() const
+{
+    return qSqrt(m_windX * m_windX + m_windY * m_windY);
+}
+
+double WindEstimator::direction() const
+{
+    // where the wind comes from, the opposite of the wind vector
+    double from = qRadiansToDegrees(qAtan2(-m_windX, -m_windY));
+    return from < 0 ? from + 360 : from;
+}
+
+void WindEstimator::update(qint64 timeMs, double groundSpeed, double track, bool circling)
+{
+    const double dt = m_lastTime < 0 || timeMs <= m_lastTime ? 0 : (timeMs - m_lastTime) / 1000.;
+    m_lastTime = timeMs;
+
+    const double x = groundSpeed * qSin(qDegreesToRadians(track));
+    const double y = groundSpeed * qCos(qDegreesToRadians(track));
+
+    if(circling != m_circling)
+    {
+        // a new climb starts a new fit, the old samples may be from another thermal
+        m_head = 0;
+        m_count = 0;
+        m_sinceResum = 0;
+        m_sx = m_sy = m_sxx = m_syy = m_sxy = m_sz = m_sxz = m_syz = m_szz = 0;
+        m_coverage = 0;
+        m_circling = circling;
+        m_lastTrack = track;
+    }
+
+    if(m_confidence > 0 && dt > 0)
+        m_confidence *= qPow(0.5, dt / WIND_DECAY_S);
+
+    if(!circling)
+    {
+        drift(x, y, dt);
+        return;
+    }
+
+    double change = track - m_lastTrack;
+    m_lastTrack = track;
+    while (change > 180)
+        change -= 360;
+    while (change <= -180)
+        change += 360;
+    m_coverage = qMin(360.0, m_coverage + qAbs(change));
+
+    if(m_count == WIND_WINDOW)
+        add(m_x[m_head], m_y[m_head], -1);
+    else
+        m_count++;
+    m_x[m_head] = x;
+    m_y[m_head] = y;
+    m_head = (m_head + 1) % WIND_WINDOW;
+    add(x, y, 1);
+
+    // Evicting by subtraction slowly loses precision, rebuild the sums once per window
+    if(++m_sinceResum >= WIND_WINDOW)
+        resum();
+
+    if(m_count >= WIND_MIN_SAMPLES && m_coverage >= WIND_MIN_COVERAGE)
+        fit();
+}
+
+void WindEstimator::add(double x, double y, int sign)
+{
+    const double z = x * x + y * y;
+    m_sx += sign * x;
+    m_sy += sign * y;
+    m_sxx += sign * x * x;
+    m_syy += sign * y * y;
+    m_sxy += sign * x * y;
+    m_sz += sign * z;
+    m_sxz += sign * x * z;
+    m_syz += sign * y * z;
+    m_szz += sign * z * z;
+}
+
+void WindEstimator::resum()
+{
+    m_sx = m_sy = m_sxx = m_syy = m_sxy = m_sz = m_sxz = m_syz = m_szz = 0;
+    for (int i = 0; i < m_count; i++)
+        add(m_x[i], m_y[i], 1);
+    m_sinceResum = 0;
+}
+
+bool WindEstimator::fit()
+{
+    // Kasa fit: z = 2a x + 2b y + c with z = x^2 + y^2, centre (a, b),
+    // radius^2 = c + a^2 + b^2. Normal equations, solved by Cramer's rule.
+    const double n = m_count;
+    const double m00 = m_sxx, m01 = m_sxy, m02 = m_sx;
+    const double m11 = m_syy, m12 = m_sy;
+    const double m22 = n;
+    const double r0 = m_sxz, r1 = m_syz, r2 = m_sz;
+
+    const double det = m00 * (m11 * m22 - m12 * m12)
+                     - m01 * (m01 * m22 - m12 * m02)
+                     + m02 * (m01 * m12 - m11 * m02);
+    if(qAbs(det) < 1e-9)
+        return false;
+
+    const double p = (r0 * (m11 * m22 - m12 * m12)
+                    - m01 * (r1 * m22 - m12 * r2)
+                    + m02 * (r1 * m12 - m11 * r2)) / det;
+    const double q = (m00 * (r1 * m22 - m12 * r2)
+                    - r0 * (m01 * m22 - m12 * m02)
+                    + m02 * (m01 * r2 - r1 * m02)) / det;
+    const double c = (m00 * (m11 * r2 - r1 * m12)
+                    - m01 * (m01 * r2 - r1 * m02)
+                    + r0 * (m01 * m12 - m11 * m02)) / det;
+
+    const double a = p / 2;
+    const double b = q / 2;
+    const double r2sq = c + a * a + b * b;
+    if(r2sq <= 1)
+        return false;
+    const double radius = qSqrt(r2sq);
+
+    // Residual sum of (z - p x - q y - c)^2 from the same sums; each term is
+    // about 2 R (r_i - R), which gives the rms radial error.
+    double residual = m_szz + p * p * m_sxx + q * q * m_syy + c * c * n
+                    - 2 * p * m_sxz - 2 * q * m_syz - 2 * c * m_sz
+                    + 2 * p * q * m_sxy + 2 * p * c * m_sx + 2 * q * c * m_sy;
+    residual = qMax(0.0, residual);
+    const double rms = qSqrt(residual / n) / (2 * radius);
+
+    // A wind faster than the circle it is the centre of is not a circling fit
+    if(qSqrt(a * a + b * b) > radius)
+        return false;
+
+    m_windX = a;
+    m_windY = b;
+    m_airspeed = radius;
+    m_confidence = qMax(0.0, 1 - rms / (0.25 * radius)) * m_coverage / 360;
+    return true;
+}
+
+void WindEstimator::drift(double x, double y, double dt)
+{
+    if(m_airspeed <= 0 || dt <= 0)
+        return;
+
+    // The air vector g - w must have the length of the last fitted airspeed.
+    // Move the wind towards the nearest point that satisfies this; only the
+    // component along the air vector is observable from one fix, turns in
+    // straight flight gradually correct the rest.
+    const double ax = x - m_windX;
+    const double ay = y - m_windY;
+    const double air = qSqrt(ax * ax + ay * ay);
+    if(air < 1)
+        return;
+
+    const double error = air - m_airspeed;
+    const double alpha = qMin(1.0, dt / WIND_DRIFT_TIME_S);
+    m_windX += alpha * error * ax / air;
+    m_windY += alpha * error * ay / air;
+}
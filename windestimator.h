@@ -0,0 +1,68 @@
+#ifndef WINDESTIMATOR_H
+#define WINDESTIMATOR_H
+
+#include <QtGlobal>
+
+#define WIND_WINDOW 64                  // ground velocity samples in the circle fit
+#define WIND_MIN_SAMPLES 12
+#define WIND_MIN_COVERAGE 300.0         // deg of track swept before a fit is trusted
+#define WIND_DRIFT_TIME_S 60.0          // time constant of the straight flight update
+#define WIND_DECAY_S 900.0              // confidence half-life without circling
+#define WIND_MIN_CONFIDENCE 0.3         // below this the estimate is not shown
+
+/*
+ * Wind from GPS ground velocity. While circling, the ground velocity vectors
+ * lie on a circle whose centre is the wind and whose radius is the airspeed;
+ * the circle is fitted algebraically (Kasa) from running sums over a fixed
+ * window, so adding a sample and evicting the oldest is O(1). In straight
+ * flight the last fitted airspeed is assumed and the wind drifts towards the
+ * value that makes |ground - wind| equal to it.
+ *
+ * Wind is reported as speed in m/s and the direction it blows from in deg.
+ * confidence() is 0..1: fit quality times track coverage, decaying while no
+ * circling refreshes it.
+ */
+class WindEstimator
+{
+public:
+    WindEstimator();
+
+    void reset();
+
+    // groundSpeed in m/s, track in deg true
+    void update(qint64 timeMs, double groundSpeed, double track, bool circling);
+
+    bool isValid() const { return m_confidence > 0; }
+    double speed() const;
+    double direction() const;
+    double airspeed() const { return m_airspeed; }
+    double confidence() const { return m_confidence; }
+
+private:
+    void add(double x, double y, int sign);
+    void resum();
+    bool fit();
+    void drift(double x, double y, double dt);
+
+private:
+    double m_x[WIND_WINDOW];
+    double m_y[WIND_WINDOW];
+    int m_head;
+    int m_count;
+    int m_sinceResum;
+
+    // running sums for the circle fit
+    double m_sx, m_sy, m_sxx, m_syy, m_sxy, m_sz, m_sxz, m_syz, m_szz;
+
+    qint64 m_lastTime;
+    double m_lastTrack;
+    double m_coverage;
+    bool m_circling;
+
+    double m_windX;         // m/s, wind towards east
+    double m_windY;         // m/s, wind towards north
+    double m_airspeed;
+    double m_confidence;
+};
+
+#endif // WINDESTIMATOR_H
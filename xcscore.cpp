@@ -0,0 +1,516 @@
+#include "xcscore.h"
+#include <QtMath>
+#include <limits>
+
+#define KM_PER_DEGREE_LATITUDE 111.195
+
+XcScore::XcScore()
+    : m_distance(XC_MAX_POINTS * XC_MAX_POINTS)
+    , m_gap(XC_MAX_POINTS * XC_MAX_POINTS)
+    , m_flatPerimeter(XC_MAX_POINTS * XC_MAX_POINTS)
+    , m_faiPerimeter(XC_MAX_POINTS * XC_MAX_POINTS)
+    , m_prefixGap(XC_MAX_POINTS)
+{
+    for (int k = 0; k <= XC_FREE_LEGS; k++)
+    {
+        m_freeBest[k].resize(XC_MAX_POINTS);
+        m_freeFrom[k].resize(XC_MAX_POINTS);
+    }
+    m_points.reserve(XC_MAX_POINTS);
+    reset();
+}
+
+void XcScore::reset()
+{
+    m_track.clear();
+    m_points.clear();
+    m_spacing = XC_INITIAL_SPACING_KM;
+    m_originLatitude = 0;
+    m_originLongitude = 0;
+    m_kmPerDegreeLongitude = KM_PER_DEGREE_LATITUDE;
+    m_free = XcResult();
+    m_flat = XcResult();
+    m_fai = XcResult();
+    m_freeChanged = false;
+    m_flatChanged = false;
+    m_faiChanged = false;
+}
+
+const XcResult &XcScore::best() const
+{
+    if(m_fai.score >= m_flat.score && m_fai.score >= m_free.score)
+        return m_fai;
+    if(m_flat.score >= m_free.score)
+        return m_flat;
+    return m_free;
+}
+
+double XcScore::errorBound() const
+{
+    double radius = 0;
+    for (const Node &node : m_points)
+        radius = qMax(radius, node.radius);
+    return 8 * radius;
+}
+
+// Equirectangular projection around the first fix; good to well below the
+// thinning spacing for the few hundred kilometres of a flight.
+XcScore::Point XcScore::project(const QGeoCoordinate &coord) const
+{
+    Point point;
+    point.x = (coord.longitude() - m_originLongitude) * m_kmPerDegreeLongitude;
+    point.y = (coord.latitude() - m_originLatitude) * KM_PER_DEGREE_LATITUDE;
+    point.coord = coord;
+    return point;
+}
+
+double XcScore::trackDistance(int i, int j) const
+{
+    const Point &a = m_track.at(i);
+    const Point &b = m_track.at(j);
+    return qSqrt(qPow(a.x - b.x, 2) + qPow(a.y - b.y, 2));
+}
+
+// Track fixes a node's turnpoint may move to when refining: those of the
+// node and of its neighbours, where the optimum may sit near a boundary
+int XcScore::trackBegin(int node) const
+{
+    return m_points.at(qMax(node - 1, 0)).track;
+}
+
+int XcScore::trackEnd(int node) const
+{
+    return node + 2 < m_points.size() ? m_points.at(node + 2).track : m_track.size();
+}
+
+void XcScore::addFix(const QGeoCoordinate &coord)
+{
+    if(!coord.isValid())
+        return;
+
+    if(m_track.isEmpty())
+    {
+        m_originLatitude = coord.latitude();
+        m_originLongitude = coord.longitude();
+        m_kmPerDegreeLongitude = KM_PER_DEGREE_LATITUDE * qCos(qDegreesToRadians(coord.latitude()));
+    }
+
+    const Point point = project(coord);
+    if(!m_track.isEmpty())
+    {
+        const Point &last = m_track.last();
+        if(qSqrt(qPow(point.x - last.x, 2) + qPow(point.y - last.y, 2)) < XC_INITIAL_SPACING_KM)
+            return;
+    }
+    m_track.append(point);
+
+    // Close to the last node: it stands for this fix too
+    if(!m_points.isEmpty())
+    {
+        Node &last = m_points.last();
+        const double d = trackDistance(last.track, m_track.size() - 1);
+        if(d < m_spacing)
+        {
+            last.radius = qMax(last.radius, d);
+            return;
+        }
+    }
+
+    if(m_points.size() == XC_MAX_POINTS)
+    {
+        thin();
+        rebuild();
+    }
+    append(m_track.size() - 1);
+
+    if(m_freeChanged)
+        refineFree();
+    if(m_flatChanged)
+        refineTriangle(m_flat, m_flatNodes, XC_FLAT_FACTOR, false);
+    if(m_faiChanged)
+        refineTriangle(m_fai, m_faiNodes, XC_FAI_FACTOR, true);
+}
+
+void XcScore::append(int track)
+{
+    const int e = m_points.size();
+    Node node;
+    node.track = track;
+    node.radius = 0;
+    m_points.append(node);
+
+    const Point &point = m_track.at(track);
+    for (int i = 0; i < e; i++)
+    {
+        const Point &other = trackPoint(i);
+        const float d = static_cast<float>(qSqrt(qPow(point.x - other.x, 2) + qPow(point.y - other.y, 2)));
+        distance(i, e) = d;
+        distance(e, i) = d;
+    }
+    distance(e, e) = 0;
+
+    updateFree(e);
+
+    for (int a = 0; a + 2 <= e; a++)
+        updatePerimeters(a, e);
+
+    // The new point is a closing candidate for every earlier pair: lower
+    // their gaps and score only the pairs that actually improved.
+    float prefix = std::numeric_limits<float>::max();
+    for (int a = 0; a <= e; a++)
+    {
+        prefix = qMin(prefix, distance(a, e));
+        m_prefixGap[a] = prefix;
+    }
+
+    for (int a = 0; a + 2 < e; a++)
+    {
+        for (int c = a + 2; c < e; c++)
+        {
+            if(m_prefixGap[a] < gap(a, c))
+            {
+                gap(a, c) = m_prefixGap[a];
+                scoreTriangle(a, c);
+            }
+        }
+    }
+
+    for (int a = 0; a <= e; a++)
+    {
+        gap(a, e) = m_prefixGap[a];
+        if(a + 2 <= e)
+            scoreTriangle(a, e);
+    }
+}
+
+// Doubles the spacing until the kept points leave room to grow. The first
+// and the latest point always stay; a dropped point's fixes go to the kept
+// point before it, whose radius grows to cover them.
+void XcScore::thin()
+{
+    while (m_points.size() >= XC_MAX_POINTS / 2)
+    {
+        m_spacing *= 2;
+
+        int kept = 1;
+        for (int i = 1; i < m_points.size() - 1; i++)
+        {
+            Node &last = m_points[kept - 1];
+            const Node &node = m_points.at(i);
+            const double d = trackDistance(last.track, node.track);
+            if(d >= m_spacing)
+                m_points[kept++] = node;
+            else
+                last.radius = qMax(last.radius, d + node.radius);
+        }
+        m_points[kept++] = m_points.last();
+        m_points.resize(kept);
+    }
+}
+
+// Recomputes all tables for the thinned points. Results found earlier are
+// kept unless beaten, as they were scored on real fixes.
+void XcScore::rebuild()
+{
+    const int n = m_points.size();
+
+    for (int i = 0; i < n; i++)
+    {
+        distance(i, i) = 0;
+        for (int j = i + 1; j < n; j++)
+        {
+            const float d = static_cast<float>(trackDistance(m_points.at(i).track, m_points.at(j).track));
+            distance(i, j) = d;
+            distance(j, i) = d;
+        }
+    }
+
+    for (int j = 0; j < n; j++)
+        updateFree(j);
+
+    for (int a = 0; a + 2 < n; a++)
+    {
+        for (int c = a + 2; c < n; c++)
+            updatePerimeters(a, c);
+    }
+
+    // G[a][c] = min(D[a][c], G[a-1][c], G[a][c+1])
+    for (int a = 0; a < n; a++)
+    {
+        for (int c = n - 1; c >= a; c--)
+        {
+            float g = distance(a, c);
+            if(a > 0)
+                g = qMin(g, gap(a - 1, c));
+            if(c < n - 1)
+                g = qMin(g, gap(a, c + 1));
+            gap(a, c) = g;
+        }
+    }
+
+    for (int a = 0; a + 2 < n; a++)
+    {
+        for (int c = a + 2; c < n; c++)
+            scoreTriangle(a, c);
+    }
+}
+
+void XcScore::updateFree(int j)
+{
+    m_freeBest[0][j] = 0;
+    m_freeFrom[0][j] = j;
+
+    for (int k = 1; k <= XC_FREE_LEGS; k++)
+    {
+        double best = -1;
+        int from = j;
+        for (int i = 0; i <= j; i++)
+        {
+            const double value = m_freeBest[k - 1][i] + distance(i, j);
+            if(value > best)
+            {
+                best = value;
+                from = i;
+            }
+        }
+        m_freeBest[k][j] = best;
+        m_freeFrom[k][j] = from;
+    }
+
+    const double total = m_freeBest[XC_FREE_LEGS][j];
+    if(total * XC_FREE_FACTOR > m_free.score)
+    {
+        m_freeNodes[XC_FREE_LEGS] = j;
+        for (int k = XC_FREE_LEGS; k > 0; k--)
+            m_freeNodes[k - 1] = m_freeFrom[k][m_freeNodes[k]];
+
+        int track[XC_FREE_LEGS + 1];
+        for (int k = 0; k <= XC_FREE_LEGS; k++)
+            track[k] = m_points.at(m_freeNodes[k]).track;
+        setResult(m_free, total, XC_FREE_FACTOR, track, XC_FREE_LEGS + 1);
+        m_freeChanged = true;
+    }
+}
+
+// Longest perimeter over the middle turnpoint, without and with the FAI
+// leg rule. Neither depends on the closing gap, so a pair is searched once.
+void XcScore::updatePerimeters(int a, int c)
+{
+    const float ac = distance(a, c);
+    float flat = 0;
+    float fai = 0;
+    for (int b = a + 1; b < c; b++)
+    {
+        const float ab = distance(a, b);
+        const float bc = distance(b, c);
+        const float perimeter = ab + bc + ac;
+        flat = qMax(flat, perimeter);
+        if(qMin(ab, qMin(bc, ac)) >= XC_FAI_MIN_LEG_RATIO * perimeter)
+            fai = qMax(fai, perimeter);
+    }
+    flatPerimeter(a, c) = flat;
+    faiPerimeter(a, c) = fai;
+}
+
+void XcScore::scoreTriangle(int a, int c)
+{
+    const float closing = gap(a, c);
+
+    const float flat = flatPerimeter(a, c);
+    if(flat > 0 && closing <= XC_CLOSING_RATIO * flat && (flat - closing) * XC_FLAT_FACTOR > m_flat.score)
+        setTriangle(m_flat, m_flatNodes, XC_FLAT_FACTOR, a, c, false);
+
+    const float fai = faiPerimeter(a, c);
+    if(fai > 0 && closing <= XC_CLOSING_RATIO * fai && (fai - closing) * XC_FAI_FACTOR > m_fai.score)
+        setTriangle(m_fai, m_faiNodes, XC_FAI_FACTOR, a, c, true);
+}
+
+// Finds the middle turnpoint again, only when a result improves
+void XcScore::setTriangle(XcResult &result, int *indexes, double factor, int a, int c, bool fai)
+{
+    const float ac = distance(a, c);
+    const float best = fai ? faiPerimeter(a, c) : flatPerimeter(a, c);
+    int middle = a + 1;
+    for (int b = a + 1; b < c; b++)
+    {
+        const float ab = distance(a, b);
+        const float bc = distance(b, c);
+        const float perimeter = ab + bc + ac;
+        if(perimeter == best && (!fai || qMin(ab, qMin(bc, ac)) >= XC_FAI_MIN_LEG_RATIO * perimeter))
+        {
+            middle = b;
+            break;
+        }
+    }
+
+    indexes[0] = a;
+    indexes[1] = middle;
+    indexes[2] = c;
+    const int track[3] = { m_points.at(a).track, m_points.at(middle).track, m_points.at(c).track };
+    setResult(result, best - gap(a, c), factor, track, 3);
+    if(fai)
+        m_faiChanged = true;
+    else
+        m_flatChanged = true;
+}
+
+// Moves each turnpoint in turn to the best of the track fixes its node
+// stands for, keeping their order, until nothing improves.
+void XcScore::refineFree()
+{
+    m_freeChanged = false;
+
+    int track[XC_FREE_LEGS + 1];
+    double total = 0;
+    for (int k = 0; k <= XC_FREE_LEGS; k++)
+    {
+        track[k] = m_points.at(m_freeNodes[k]).track;
+        if(k > 0)
+            total += trackDistance(track[k - 1], track[k]);
+    }
+
+    for (int pass = 0; pass < XC_REFINE_PASSES; pass++)
+    {
+        bool moved = false;
+        for (int k = 0; k <= XC_FREE_LEGS; k++)
+        {
+            int from = trackBegin(m_freeNodes[k]);
+            int to = trackEnd(m_freeNodes[k]);
+            if(k > 0)
+                from = qMax(from, track[k - 1]);
+            if(k < XC_FREE_LEGS)
+                to = qMin(to, track[k + 1] + 1);
+
+            double current = 0;
+            if(k > 0)
+                current += trackDistance(track[k - 1], track[k]);
+            if(k < XC_FREE_LEGS)
+                current += trackDistance(track[k], track[k + 1]);
+
+            double best = current;
+            int bestAt = track[k];
+            for (int i = from; i < to; i++)
+            {
+                double value = 0;
+                if(k > 0)
+                    value += trackDistance(track[k - 1], i);
+                if(k < XC_FREE_LEGS)
+                    value += trackDistance(i, track[k + 1]);
+                if(value > best)
+                {
+                    best = value;
+                    bestAt = i;
+                }
+            }
+            if(bestAt != track[k])
+            {
+                total += best - current;
+                track[k] = bestAt;
+                moved = true;
+            }
+        }
+        if(!moved)
+            break;
+    }
+
+    if(total * XC_FREE_FACTOR > m_free.score)
+        setResult(m_free, total, XC_FREE_FACTOR, track, XC_FREE_LEGS + 1);
+}
+
+// Triangle distance for track fixes s <= a < b < c <= e, where s and e
+// close the triangle; negative if the closing or FAI leg rule fails.
+double XcScore::triangleDistance(const int *track, bool fai) const
+{
+    const double ab = trackDistance(track[1], track[2]);
+    const double bc = trackDistance(track[2], track[3]);
+    const double ca = trackDistance(track[3], track[1]);
+    const double perimeter = ab + bc + ca;
+    const double closing = trackDistance(track[0], track[4]);
+    if(closing > XC_CLOSING_RATIO * perimeter)
+        return -1;
+    if(fai && qMin(ab, qMin(bc, ca)) < XC_FAI_MIN_LEG_RATIO * perimeter)
+        return -1;
+    return perimeter - closing;
+}
+
+// Like refineFree, for the three turnpoints and the two closing points
+void XcScore::refineTriangle(XcResult &result, const int *indexes, double factor, bool fai)
+{
+    if(fai)
+        m_faiChanged = false;
+    else
+        m_flatChanged = false;
+
+    // The closing pair behind G[a][c]
+    const int a = indexes[0];
+    const int c = indexes[2];
+    int start = a;
+    int end = c;
+    for (int s = 0; s <= a; s++)
+    {
+        for (int e = c; e < m_points.size(); e++)
+        {
+            if(distance(s, e) < distance(start, end))
+            {
+                start = s;
+                end = e;
+            }
+        }
+    }
+
+    const int nodes[5] = { start, a, indexes[1], c, end };
+    int track[5];
+    for (int k = 0; k < 5; k++)
+        track[k] = m_points.at(nodes[k]).track;
+    double total = triangleDistance(track, fai);
+    if(total < 0)
+        return;
+
+    for (int pass = 0; pass < XC_REFINE_PASSES; pass++)
+    {
+        bool moved = false;
+        for (int k = 0; k < 5; k++)
+        {
+            int from = trackBegin(nodes[k]);
+            int to = trackEnd(nodes[k]);
+            // s <= a < b < c <= e
+            if(k > 0)
+                from = qMax(from, track[k - 1] + (k == 2 || k == 3 ? 1 : 0));
+            if(k < 4)
+                to = qMin(to, track[k + 1] + (k == 0 || k == 3 ? 1 : 0));
+
+            const int current = track[k];
+            for (int i = from; i < to; i++)
+            {
+                if(i == current)
+                    continue;
+                const int previous = track[k];
+                track[k] = i;
+                const double value = triangleDistance(track, fai);
+                if(value > total)
+                {
+                    total = value;
+                    moved = true;
+                }
+                else
+                {
+                    track[k] = previous;
+                }
+            }
+        }
+        if(!moved)
+            break;
+    }
+
+    if(total * factor > result.score)
+        setResult(result, total, factor, track + 1, 3);
+}
+
+void XcScore::setResult(XcResult &result, double distance, double factor, const int *track, int count)
+{
+    result.distance = distance;
+    result.score = distance * factor;
+    result.turnpoints.resize(count);
+    for (int i = 0; i < count; i++)
+        result.turnpoints[i] = m_track.at(track[i]).coord;
+}
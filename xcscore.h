@@ -0,0 +1,132 @@
+#ifndef XCSCORE_H
+#define XCSCORE_H
+
+#include <QVector>
+#include <QGeoCoordinate>
+
+#define XC_MAX_POINTS 200
+#define XC_INITIAL_SPACING_KM 0.05
+#define XC_FREE_LEGS 4              // start, 3 turnpoints, finish
+#define XC_FREE_FACTOR 1.5
+#define XC_FLAT_FACTOR 1.75
+#define XC_FAI_FACTOR 2.0
+#define XC_CLOSING_RATIO 0.2        // closing gap relative to the perimeter
+#define XC_FAI_MIN_LEG_RATIO 0.28
+#define XC_REFINE_PASSES 4
+
+struct XcResult
+{
+    double distance = 0;                // km, closing gap already subtracted
+    double score = 0;                   // distance * factor
+    QVector<QGeoCoordinate> turnpoints;
+};
+
+/*
+ * Online cross-country scoring in the style of Leonardo/OLC: free distance
+ * over up to three turnpoints, flat triangles and FAI triangles.
+ *
+ * Fixes at least XC_INITIAL_SPACING_KM apart are kept as the track. The
+ * optimisation runs on a coarse subset of it, points at least m_spacing
+ * apart; when more than XC_MAX_POINTS accumulate the spacing doubles and
+ * the set is re-thinned, so the per fix work is bounded by the point count,
+ * not by the flight length. Each coarse point stands for the track fixes up
+ * to the next one, all within its radius. On the coarse points the
+ * optimisation is exact:
+ *  - free distance: dynamic programming, O(legs * n) per new point,
+ *  - triangles: the longest perimeter over the middle turnpoint P[a][c] is
+ *    found once per pair, and a closing gap table G[a][c] = min d(s, e)
+ *    over s <= a and e >= c is kept. A new point adds a row of pairs and
+ *    lowers some gaps, and each changed pair is scored in O(1), so a fix
+ *    costs O(n^2) and a re-thinning O(n^3).
+ * The best coarse solutions are then refined on the track fixes their
+ * points stand for.
+ *
+ * Until the first re-thinning the coarse points are the track and the
+ * results are exact. After it, moving each turnpoint and closing point by
+ * at most its radius r changes each leg and the closing gap by at most 2r,
+ * so the results are at most errorBound() = 8 * max r below the optimum
+ * over the track: four legs of free distance, or three legs and the gap of
+ * a triangle. A triangle within that margin of the closing or FAI leg
+ * limits may be missed.
+ */
+class XcScore
+{
+public:
+    XcScore();
+
+    void reset();
+    void addFix(const QGeoCoordinate &coord);
+
+    const XcResult &freeDistance() const { return m_free; }
+    const XcResult &flatTriangle() const { return m_flat; }
+    const XcResult &faiTriangle() const { return m_fai; }
+    const XcResult &best() const;
+    int pointCount() const { return m_points.size(); }
+    int trackCount() const { return m_track.size(); }
+    double errorBound() const;      // km
+
+private:
+    struct Point
+    {
+        double x;   // km east of the first fix
+        double y;   // km north of the first fix
+        QGeoCoordinate coord;
+    };
+
+    struct Node
+    {
+        int track;      // index of the point in m_track
+        double radius;  // km, reach of the track fixes up to the next node
+    };
+
+    float &distance(int a, int b) { return m_distance[a * XC_MAX_POINTS + b]; }
+    float &gap(int a, int c) { return m_gap[a * XC_MAX_POINTS + c]; }
+    float &flatPerimeter(int a, int c) { return m_flatPerimeter[a * XC_MAX_POINTS + c]; }
+    float &faiPerimeter(int a, int c) { return m_faiPerimeter[a * XC_MAX_POINTS + c]; }
+    const Point &trackPoint(int node) const { return m_track.at(m_points.at(node).track); }
+    int trackBegin(int node) const;
+    int trackEnd(int node) const;
+    double trackDistance(int i, int j) const;
+
+    Point project(const QGeoCoordinate &coord) const;
+    void append(int track);
+    void thin();
+    void rebuild();
+    void updateFree(int j);
+    void updatePerimeters(int a, int c);
+    void scoreTriangle(int a, int c);
+    void setTriangle(XcResult &result, int *indexes, double factor, int a, int c, bool fai);
+    void refineFree();
+    void refineTriangle(XcResult &result, const int *indexes, double factor, bool fai);
+    double triangleDistance(const int *track, bool fai) const;
+    void setResult(XcResult &result, double distance, double factor, const int *track, int count);
+
+private:
+    QVector<Point> m_track;
+    QVector<Node> m_points;
+    QVector<float> m_distance;
+    QVector<float> m_gap;
+    QVector<float> m_flatPerimeter;
+    QVector<float> m_faiPerimeter;
+    QVector<float> m_prefixGap;
+    QVector<double> m_freeBest[XC_FREE_LEGS + 1];
+    QVector<int> m_freeFrom[XC_FREE_LEGS + 1];
+    double m_spacing;
+    double m_originLatitude;
+    double m_originLongitude;
+    double m_kmPerDegreeLongitude;
+
+    XcResult m_free;
+    XcResult m_flat;
+    XcResult m_fai;
+
+    // Nodes of the best coarse solutions, refined at the end of addFix
+    int m_freeNodes[XC_FREE_LEGS + 1];
+    int m_flatNodes[3];
+    int m_faiNodes[3];
+    bool m_freeChanged;
+    bool m_flatChanged;
+    bool m_faiChanged;
+};
+
+#endif // XCSCORE_H
@@ -1,6 +1,8 @@
-QT += core gui quick sensors positioning multimedia widgets network
+QT += core gui quick sensors positioning multimedia widgets network concurrent
 
-win{
+LIBS += -lz
+
+win32 {
 QT += serialport
 }
 
@@ -10,18 +12,74 @@ TEMPLATE = app
 
 SOURCES += main.cpp\
     kalmanfilter.cpp \
+    altitudefusion.cpp \
     logindialog.cpp \
     mainwindow.cpp \
     networkaccessmanager.cpp \
+    uploadqueue.cpp \
+    trackingclient.cpp \
+    igcrecord.cpp \
+    igcvalidator.cpp \
+    nmeaparser.cpp \
+    nmeasource.cpp \
+    xcscore.cpp \
+    circlingdetector.cpp \
+    thermalstore.cpp \
+    windestimator.cpp \
+    airspace.cpp \
+    terrain.cpp \
+    waypoint.cpp \
+    task.cpp \
+    tracksimplifier.cpp \
+    climbstats.cpp \
+    instrumentpanel.cpp \
+    history.cpp \
+    historygraph.cpp \
+    flightstate.cpp \
+    trace.cpp \
+    metrics.cpp \
+    metricsexporter.cpp \
+    varioparser.cpp \
+    pressureselector.cpp \
+    syntheticsensor.cpp \
+    logbook.cpp \
     variobeep.cpp \
     generator.cpp \
     piecewiselinearfunction.cpp
 
 HEADERS  += \
     kalmanfilter.h \
+    altitudefusion.h \
     logindialog.h \
     mainwindow.h \
     networkaccessmanager.h \
+    uploadqueue.h \
+    trackingclient.h \
+    igcrecord.h \
+    igcvalidator.h \
+    nmeaparser.h \
+    nmeasource.h \
+    xcscore.h \
+    circlingdetector.h \
+    thermalstore.h \
+    windestimator.h \
+    airspace.h \
+    terrain.h \
+    waypoint.h \
+    task.h \
+    tracksimplifier.h \
+    climbstats.h \
+    instrumentpanel.h \
+    history.h \
+    historygraph.h \
+    flightstate.h \
+    trace.h \
+    metrics.h \
+    metricsexporter.h \
+    varioparser.h \
+    pressureselector.h \
+    syntheticsensor.h \
+    logbook.h \
     variobeep.h \
     generator.h \
     piecewiselinearfunction.h